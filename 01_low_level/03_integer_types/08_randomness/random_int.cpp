@@ -13,6 +13,9 @@
 #include <type_traits>
 #include <vector>
 
+#include <utilities/benchmark.h>
+#include <utilities/generate.h>
+
 /**
  * @file random_int.cpp
  * @brief Integer randomness in C++ from C++98 to C++20.
@@ -127,6 +130,103 @@ static int rand_int_reject(int lo, int hi)
     return lo + static_cast<int>(rand_bounded_reject(range));
 }
 
+/**
+ * @brief Unbiased integers in a range by multiply-shift with rejection (Lemire, 2019).
+ *
+ * Both functions above pay for a division or modulo on every draw. Multiply-shift maps
+ * a 32-bit random number x into [0, bound) as the high half of the 64-bit product:
+ * @code
+ * std::uint64_t m = std::uint64_t(x) * bound;
+ * std::uint32_t result = m >> 32;
+ * @endcode
+ * Alone it's biased exactly like modulo: 2^32 mod bound values of x are "extra".
+ * They are recognized by the low half of the product: it's less than (2^32 mod bound) only for them.
+ * The threshold needs a division, but the low half is first compared with `bound` itself,
+ * and the division happens only with probability bound / 2^32, so nearly every draw costs one multiplication.
+ *
+ * The batched fill() computes the threshold once per buffer, and the loop has a single rarely taken branch.
+ *
+ * Works with any engine producing full 32-bit numbers, e.g. `std::mt19937` or `rng::pcg32`;
+ * `rng::bounded()` from utilities/generate.h is the 64-bit version.
+ */
+template <class Engine>
+class bounded_int_engine
+{
+public:
+    static_assert(Engine::min() == 0 && Engine::max() == 0xFFFFFFFFu, "engine must produce 32-bit numbers");
+
+    explicit bounded_int_engine(Engine& engine) : engine(engine)
+    {
+    }
+
+    /**
+     * @brief Unbiased number in [0, bound), bound > 0.
+     */
+    std::uint32_t operator()(std::uint32_t bound)
+    {
+        std::uint64_t m = std::uint64_t(next()) * bound;
+        std::uint32_t low = static_cast<std::uint32_t>(m);
+        if (low < bound)
+        {
+            // (2^32 - bound) % bound == 2^32 % bound
+            const std::uint32_t threshold = (0u - bound) % bound;
+            while (low < threshold)
+            {
+                m = std::uint64_t(next()) * bound;
+                low = static_cast<std::uint32_t>(m);
+            }
+        }
+        return static_cast<std::uint32_t>(m >> 32);
+    }
+
+    /**
+     * @brief Unbiased number in [lo, hi].
+     *
+     * [INT_MIN, INT_MAX] has 2^32 values, `bound` wraps to 0: every raw draw is already in range.
+     */
+    int operator()(int lo, int hi)
+    {
+        if (lo > hi)
+            std::swap(lo, hi);
+        const auto bound = static_cast<std::uint32_t>(static_cast<std::int64_t>(hi) - lo + 1);
+        if (bound == 0)
+            return static_cast<int>(next());
+        return static_cast<int>(static_cast<std::int64_t>(lo) + (*this)(bound));
+    }
+
+    /**
+     * @brief Batched variant: fill [first, last) with unbiased numbers in [lo, hi].
+     */
+    void fill(int* first, int* last, int lo, int hi)
+    {
+        if (lo > hi)
+            std::swap(lo, hi);
+        const auto bound = static_cast<std::uint32_t>(static_cast<std::int64_t>(hi) - lo + 1);
+        if (bound == 0)
+        {
+            for (; first != last; ++first)
+                *first = static_cast<int>(next());
+            return;
+        }
+        const std::uint32_t threshold = (0u - bound) % bound;
+        for (; first != last; ++first)
+        {
+            std::uint64_t m = std::uint64_t(next()) * bound;
+            while (static_cast<std::uint32_t>(m) < threshold)
+                m = std::uint64_t(next()) * bound;
+            *first = static_cast<int>(static_cast<std::int64_t>(lo) + static_cast<std::uint32_t>(m >> 32));
+        }
+    }
+
+private:
+    std::uint32_t next()
+    {
+        return static_cast<std::uint32_t>(engine());
+    }
+
+    Engine& engine;
+};
+
 /**
  * @brief Create an engine seeded with good-enough entropy for most non-crypto uses.
  *
@@ -309,6 +409,172 @@ static void histogram_small(Gen&& gen, int lo, int hi, std::size_t samples)
     std::cout << "  min=" << minv << ", max=" << maxv << "\n\n";
 }
 
+/**
+ * @brief Throughput and bias of bounded integer generation.
+ *
+ * `std::uniform_int_distribution` is unbiased, but libstdc++ and libc++ implement it with a division
+ * per draw (newer libstdc++ versions switched to multiply-shift as well).
+ * The range [0, 1'000'000'006] is nearly a quarter of 2^32, so ~6.9% of draws are rejected.
+ */
+static void compare_bounded_generation()
+{
+    constexpr std::size_t N = 10'000'000;
+    constexpr std::size_t batch = 4096;
+
+    auto eng = cpp::make_mt_engine();
+    rng::pcg32 pcg(rng::random_seed());
+    bounded_int_engine<std::mt19937> bounded_mt(eng);
+    bounded_int_engine<rng::pcg32> bounded_pcg(pcg);
+    std::vector<int> buffer(batch);
+
+    std::cout << "Bounded integers (" << N << " generations, lower is better):\n";
+    for (const int hi : {9, 1'000'000'006})
+    {
+        std::uniform_int_distribution<int> dist(0, hi);
+        const auto ms_dist = cpp::bench_ms(N, [&]()
+            { return dist(eng); });
+        const auto ms_reject = cpp::bench_ms(N, [&]()
+            { return cpp::rand_int_reject(0, hi); });
+        const auto ms_lemire = cpp::bench_ms(N, [&]()
+            { return bounded_mt(0, hi); });
+        const auto ms_lemire_pcg = cpp::bench_ms(N, [&]()
+            { return bounded_pcg(0, hi); });
+        const auto ms_batched = cpp::bench_ms(N / batch, [&]()
+            {
+                bounded_pcg.fill(buffer.data(), buffer.data() + batch, 0, hi);
+                return buffer[batch - 1]; });
+
+        std::cout << "  range [0," << hi << "]\n";
+        std::cout << "    rand() rejection              : " << ms_reject.count() << " ms\n";
+        std::cout << "    mt19937 + uniform_int_dist    : " << ms_dist.count() << " ms\n";
+        std::cout << "    mt19937 + multiply-shift      : " << ms_lemire.count() << " ms\n";
+        std::cout << "    pcg32 + multiply-shift        : " << ms_lemire_pcg.count() << " ms\n";
+        std::cout << "    pcg32 + batched multiply-shift: " << ms_batched.count() << " ms\n";
+    }
+    std::cout << "\n";
+
+    // The bias of multiply-shift is the same as of modulo and is invisible with 32-bit numbers.
+    // Scaled down to 4-bit random numbers: 16 values map to 10 results, 6 of them get two values
+    std::cout << "4-bit numbers, multiply-shift without rejection (biased)\n";
+    cpp::histogram_small([&]()
+        {
+            const std::uint32_t x = static_cast<std::uint32_t>(eng()) >> 28;
+            return static_cast<int>((x * 10) >> 4); }, 0, 9, 200'000);
+
+    std::cout << "4-bit numbers, multiply-shift with rejection of the low part < 16 % 10\n";
+    cpp::histogram_small([&]()
+        {
+            std::uint32_t m = 0;
+            do
+            {
+                m = (static_cast<std::uint32_t>(eng()) >> 28) * 10;
+            } while ((m & 0xF) < 16 % 10);
+            return static_cast<int>(m >> 4); }, 0, 9, 200'000);
+
+    std::cout << "mt19937 + multiply-shift with rejection (unbiased, no division per draw)\n";
+    cpp::histogram_small([&]()
+        { return bounded_mt(0, 9); }, 0, 9, 200'000);
+
+    std::cout << "pcg32 + batched multiply-shift\n";
+    std::vector<int> batched(200'000);
+    bounded_pcg.fill(batched.data(), batched.data() + batched.size(), 0, 9);
+    std::size_t index = 0;
+    cpp::histogram_small([&]()
+        { return batched[index++]; }, 0, 9, batched.size());
+
+    // the whole int range is 2^32 values, the bound wraps to 0 and no division may happen
+    bounded_pcg.fill(batched.data(), batched.data() + batched.size(), INT_MIN, INT_MAX);
+    const auto [low, high] = std::minmax_element(batched.begin(), batched.end());
+    const int single = bounded_mt(INT_MIN, INT_MAX);
+    std::cout << "Full range [INT_MIN, INT_MAX]: min " << *low << ", max " << *high << ", single draw " << single << ", "
+              << (*low < INT_MIN / 2 && *high > INT_MAX / 2 ? "both halves covered" : "NOT COVERED") << "\n";
+}
+
+/**
+ * @brief Sum of `n` raw outputs of an engine, the cost of the engine itself.
+ */
+template <class Engine>
+static std::uint64_t sum_raw(Engine& engine, std::size_t n)
+{
+    std::uint64_t acc = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        acc += engine();
+    return acc;
+}
+
+/**
+ * @brief Compare small modern engines with `std::mt19937`, and bulk generation of test data.
+ *
+ * - splitmix64: 8 bytes of state, a counter with a strong mixing function.
+ * - xoshiro256**: 32 bytes of state, `jump()` splits the sequence into 2^128 independent parts.
+ * - pcg32: 16 bytes of state, many streams, `advance()` skips any number of steps.
+ *
+ * All of them are seeded with a single 64-bit number and reproduce the same sequence everywhere,
+ * while results of `std::uniform_real_distribution` depend on the standard library implementation.
+ */
+static void compare_fast_engines()
+{
+    constexpr std::size_t N = 10'000'000;
+    constexpr std::uint64_t seed = 42;
+
+    bench::options opts;
+    opts.warmup = 1;
+    opts.repetitions = 5;
+
+    bench::suite engines("Raw engine output", opts);
+    std::mt19937 mt(static_cast<std::mt19937::result_type>(seed));
+    std::mt19937_64 mt64(seed);
+    rng::splitmix64 sm(seed);
+    rng::xoshiro256ss xo(seed);
+    rng::pcg32 pcg(seed);
+    engines.run("mt19937", [&]() { return sum_raw(mt, N); }, N);
+    engines.run("mt19937_64", [&]() { return sum_raw(mt64, N); }, N);
+    engines.run("splitmix64", [&]() { return sum_raw(sm, N); }, N);
+    engines.run("xoshiro256**", [&]() { return sum_raw(xo, N); }, N);
+    engines.run("pcg32", [&]() { return sum_raw(pcg, N); }, N);
+    engines.report(std::cout);
+
+    // Test data for benchmarks: 1M doubles in [0, 1000)
+    constexpr std::size_t size = 1'000'000;
+    bench::suite fill("Generate 1M doubles", opts);
+    fill.run("mt19937 + distribution", [&]()
+        {
+            std::mt19937 gen(static_cast<std::mt19937::result_type>(seed));
+            std::uniform_real_distribution<double> dist(0.0, 1000.0);
+            std::vector<double> v;
+            v.reserve(size);
+            for (std::size_t i = 0; i < size; ++i)
+                v.push_back(dist(gen));
+            return v.back(); }, size);
+    fill.run("rng::fill_uniform", [&]()
+        {
+            rng::xoshiro256ss gen(seed);
+            std::vector<double> v(size);
+            rng::fill_uniform(gen, v.data(), v.data() + size, 0.0, 1000.0);
+            return v.back(); }, size);
+    fill.run("rng::uniform_vector", [&]()
+        { return rng::uniform_vector(size, 0.0, 1000.0, seed).back(); }, size);
+    fill.report(std::cout);
+
+    // Blocks are generated by jumped subsequences, the number of threads doesn't change the data
+    std::vector<int> one(size);
+    std::vector<int> many(size);
+    rng::fill_uniform_parallel(seed, one.data(), one.data() + size, 0, 9, 1);
+    rng::fill_uniform_parallel(seed, many.data(), many.data() + size, 0, 9, 4);
+    std::cout << "Parallel generation with 1 and 4 threads is " << (one == many ? "identical" : "DIFFERENT") << "\n";
+
+    // pcg32 can skip ahead without generating the numbers
+    rng::pcg32 walked(seed);
+    rng::pcg32 skipped(seed);
+    for (int i = 0; i < 1000; ++i)
+        walked();
+    skipped.advance(1000);
+    std::cout << "pcg32: 1000 calls and advance(1000) " << (walked() == skipped() ? "agree" : "DISAGREE") << "\n";
+
+    std::size_t index = 0;
+    cpp::histogram_small([&]() { return one[index++]; }, 0, 9, 200'000);
+}
+
 } // namespace lesson
 
 /**
@@ -387,6 +653,11 @@ int main(int /*argc*/, char* /*argv*/[])
     std::cout << "  rand() rejection      : " << ms_rand_rej.count() << " ms\n";
     std::cout << "  mt19937 + distribution: " << ms_mt.count() << " ms\n\n";
 
+    cpp::compare_bounded_generation();
+
+    cpp::compare_fast_engines();
+    std::cout << "\n";
+
     // -------------------------------------------------------------------------
     // Practical guidance summary
     // -------------------------------------------------------------------------
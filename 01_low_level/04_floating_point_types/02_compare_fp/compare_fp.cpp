@@ -1,13 +1,20 @@
 #define _USE_MATH_DEFINES
 #include <iostream>
 #include <iomanip>
+#include <iterator>
 #include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
 
 // OsX workaround
 #include <cfloat>
 #include <cstdint>
 
 #include <utilities/bitwise.h>
+#include <utilities/generate.h>
+#include <utilities/benchmark.h>
+#include "compare_fp.h"
 
 // Comparing two floating-point numbers one should remember, that calculation error for floating-point 
 // is proportional to its modulus, unlike fixed-point, where error is fixed as well.
@@ -97,9 +104,205 @@ void show_close_enough()
     }
 }
 
+// close_enough() for whole arrays: regression results against references are compared
+// by ULP distance or by a mixed absolute + relative tolerance, with explicit NaN and infinity rules
+void show_bulk_compare()
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    const std::vector<double> expected = {1.0, 0.1, 0.0, -0.0, 1e-300, nan, inf, 100.0, 1e-20};
+    const std::vector<double> actual = {nextafter(1.0, 2.0), 0.1 + 1e-17, -0.0, 1e-320, 1e-300, nan, inf, 100.0 + 1e-9, 0.0};
+
+    auto print = [](const std::string& title, const fp::compare_result& r) {
+        std::cout << std::setw(36) << std::left << title << std::right << ": mismatches " << r.mismatches;
+        if (!r.equal()) {
+            std::cout << " (first " << r.first_mismatch << ")";
+        }
+        std::cout << ", max error " << r.max_abs_error << " abs, " << r.max_rel_error << " rel, " << r.max_ulps << " ULP\n";
+    };
+
+    fp::compare_options o;
+    print("4 ULP, NaN mismatch", fp::compare(expected, actual, o));
+    o.nans = fp::nan_policy::equal;
+    print("4 ULP, NaN equal", fp::compare(expected, actual, o));
+
+    // close_enough2() would fail 1e-20 vs 0: no relative tolerance is small enough near zero
+    o.mode = fp::compare_mode::tolerance;
+    o.relative = 16 * DBL_EPSILON;
+    print("16 * DBL_EPSILON relative", fp::compare(expected, actual, o));
+    o.absolute = 1e-12;
+    print("16 * DBL_EPSILON relative, 1e-12 abs", fp::compare(expected, actual, o));
+    std::cout << '\n';
+}
+
+template <typename FP>
+bool check_kernels(const std::vector<FP>& a, const std::vector<FP>& b)
+{
+    // every kernel against the scalar one, the last in the table
+    const auto& kernels = fp::compare_kernels<FP>();
+    bool ok = true;
+    for (fp::compare_mode mode : {fp::compare_mode::ulp, fp::compare_mode::tolerance}) {
+        for (fp::nan_policy nans : {fp::nan_policy::mismatch, fp::nan_policy::equal, fp::nan_policy::ignore}) {
+            for (fp::inf_policy infs : {fp::inf_policy::exact, fp::inf_policy::ignore}) {
+                for (bool early_exit : {false, true}) {
+                    fp::compare_options o;
+                    o.mode = mode;
+                    o.max_ulps = 2;
+                    o.absolute = 1e-30;
+                    o.relative = 1e-6;
+                    o.nans = nans;
+                    o.infs = infs;
+                    o.early_exit = early_exit;
+                    const fp::compare_result expected = std::end(kernels)[-1].function(a.data(), b.data(), a.size(), o);
+                    for (const auto& k : kernels) {
+                        if (!cpu::detected().contains(k.required)) {
+                            continue;
+                        }
+                        const fp::compare_result r = k.function(a.data(), b.data(), a.size(), o);
+                        ok = ok && r.first_mismatch == expected.first_mismatch;
+                        if (!early_exit) {
+                            // with early exit a SIMD kernel counts the whole vector with the first mismatch
+                            ok = ok && r.mismatches == expected.mismatches && r.max_abs_error == expected.max_abs_error &&
+                                 r.max_rel_error == expected.max_rel_error && r.max_ulps == expected.max_ulps;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+// Pairs around special values: +-0, denormals, the largest finite, infinities, NaN
+template <typename FP>
+bool check_bulk_compare()
+{
+    using limits = std::numeric_limits<FP>;
+    const std::vector<FP> specials = {FP(0), -FP(0), limits::denorm_min(), -limits::denorm_min(), limits::min(),
+                                      FP(1), -FP(1), FP(1) + limits::epsilon(), nextafter(FP(1), FP(0)), limits::max(),
+                                      -limits::max(), limits::infinity(), -limits::infinity(), limits::quiet_NaN(), FP(1e-7)};
+    std::vector<FP> a, b;
+    for (FP x : specials) {
+        for (FP y : specials) {
+            a.push_back(x);
+            b.push_back(y);
+        }
+    }
+
+    // random values with 0..3 ULP perturbations; compare() must agree with a pair by pair loop
+    RandomReal<FP> random_real(7);
+    std::vector<FP> r = random_real.generate(FP(-1000), FP(1000), 1003);
+    for (size_t i = 0; i < r.size(); ++i) {
+        FP y = r[i];
+        for (size_t k = 0; k < i % 4; ++k) {
+            y = nextafter(y, limits::infinity());
+        }
+        a.push_back(r[i]);
+        b.push_back(y);
+    }
+
+    bool ok = true;
+    fp::compare_options o;
+    o.max_ulps = 2;
+    const fp::compare_result result = std::end(fp::compare_kernels<FP>())[-1].function(a.data(), b.data(), a.size(), o);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        const bool nan = a[i] != a[i] || b[i] != b[i];
+        const bool inf = std::isinf(a[i]) || std::isinf(b[i]);
+        const bool equal = !nan && (inf ? a[i] == b[i] : fp::detail::ulp_distance(a[i], b[i]) <= 2);
+        mismatches += equal ? 0 : 1;
+    }
+    ok = ok && result.mismatches == mismatches;
+    ok = ok && fp::detail::ulp_distance(FP(0), -FP(0)) == 0 && fp::detail::ulp_distance(limits::denorm_min(), -limits::denorm_min()) == 2;
+    ok = ok && fp::detail::ulp_distance(limits::max(), limits::infinity()) == 1;
+
+    ok = ok && check_kernels(a, b);
+    // every length around the vector width, a mismatch in every position
+    for (size_t n = 0; n < 20; ++n) {
+        for (size_t bad = 0; bad <= n; ++bad) {
+            std::vector<FP> x(r.begin(), r.begin() + static_cast<std::ptrdiff_t>(n)), y = x;
+            if (bad < n) {
+                y[bad] += FP(1);
+            }
+            ok = ok && check_kernels(x, y);
+        }
+    }
+    return ok;
+}
+
+void benchmark()
+{
+    const size_t n = 1 << 22;
+    RandomReal<double> random_real(11);
+    const std::vector<double> expected = random_real.generate(-1e6, 1e6, n);
+    std::vector<double> actual = expected;
+    for (size_t i = 0; i < n; i += 3) {
+        actual[i] = nextafter(actual[i], 0.0);
+    }
+    const std::vector<float> expected_f(expected.begin(), expected.end());
+    const std::vector<float> actual_f(actual.begin(), actual.end());
+
+    {
+        bench::suite s("compare " + std::to_string(n) + " doubles, all equal");
+        s.run("close_enough2() loop", [&] {
+            size_t mismatches = 0;
+            for (size_t i = 0; i < n; ++i) {
+                mismatches += close_enough2(expected[i], actual[i]) ? 0 : 1;
+            }
+            bench::do_not_optimize(mismatches);
+        }, n);
+        for (const auto& k : fp::compare_kernels<double>()) {
+            for (fp::compare_mode mode : {fp::compare_mode::ulp, fp::compare_mode::tolerance}) {
+                if (!cpu::detected().contains(k.required)) {
+                    continue;
+                }
+                fp::compare_options o;
+                o.mode = mode;
+                o.relative = 16 * DBL_EPSILON;
+                s.run(std::string(k.name) + (mode == fp::compare_mode::ulp ? ", ULP" : ", tolerance"), [&] {
+                    bench::do_not_optimize(k.function(expected.data(), actual.data(), n, o));
+                }, n);
+            }
+        }
+        s.report(std::cout);
+    }
+    {
+        bench::suite s("compare " + std::to_string(n) + " floats, all equal");
+        for (const auto& k : fp::compare_kernels<float>()) {
+            if (!cpu::detected().contains(k.required)) {
+                continue;
+            }
+            s.run(std::string(k.name) + ", ULP", [&] {
+                bench::do_not_optimize(k.function(expected_f.data(), actual_f.data(), n, fp::compare_options()));
+            }, n);
+        }
+        s.report(std::cout);
+    }
+    {
+        // a failing regression: the first mismatch is all that's needed
+        std::vector<double> broken = actual;
+        broken[n / 100] += 1.0;
+        bench::suite s("compare " + std::to_string(n) + " doubles, mismatch at 1%");
+        for (bool early_exit : {false, true}) {
+            fp::compare_options o;
+            o.early_exit = early_exit;
+            s.run(early_exit ? "early exit" : "full scan", [&] {
+                bench::do_not_optimize(fp::compare(expected.data(), broken.data(), n, o));
+            }, n);
+        }
+        s.report(std::cout);
+    }
+}
 
 int main()
 {
-    // TODO: insert any function call
+    compare_floating_point();
+    show_close_enough();
+    std::cout << '\n';
+
+    show_bulk_compare();
+    std::cout << "compare() handles special values, float? " << check_bulk_compare<float>() << '\n';
+    std::cout << "compare() handles special values, double? " << check_bulk_compare<double>() << "\n\n";
+    benchmark();
     return 0;
-}
\ No newline at end of file
+}
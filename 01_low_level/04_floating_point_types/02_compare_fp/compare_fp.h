@@ -0,0 +1,411 @@
+#pragma once
+/*
+compare_fp.h
+Bulk comparison of float/double arrays, e.g. results of a regression run against references.
+
+Two modes:
+  - ulp:       a and b match if at most `max_ulps` representable values apart. The bits of a float
+               (sign, exponent, significand, see extract_fp_components.cpp) read as sign-magnitude integer
+               are ordered like the values; turned into two's complement (negative i -> 0x80...0 - i),
+               the distance is a subtraction and +0 and -0 are the same; infinities are never measured in ULP,
+               inf_policy decides every pair with one before the distance is computed
+  - tolerance: |a - b| <= max(absolute, relative * max(|a|, |b|)), close_enough() with a floor for values near 0
+Special values:
+  - nan_policy: mismatch (IEEE, NaN is not equal to anything), equal (NaN equals NaN), ignore (skip pairs with NaN)
+  - inf_policy: exact (infinity equals the same infinity only), ignore (skip pairs with infinity)
+Pairs with NaN or infinity don't take part in the maximum errors.
+
+The result has the first mismatch index, the number of mismatches and the maximum absolute, relative and ULP errors;
+with early_exit the comparison stops at the first mismatching vector, so the counts and maxima cover it and
+the elements before it.
+Kernels: scalar and AVX2 (8 floats or 4 doubles per step), the best one is chosen at run time.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <utilities/cpu_features.h>
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+namespace fp
+{
+
+enum class compare_mode
+{
+    ulp,
+    tolerance
+};
+
+enum class nan_policy
+{
+    mismatch,
+    equal,
+    ignore
+};
+
+enum class inf_policy
+{
+    exact,
+    ignore
+};
+
+struct compare_options
+{
+    compare_mode mode = compare_mode::ulp;
+    std::uint64_t max_ulps = 4;
+    double absolute = 0;
+    double relative = 0;
+    nan_policy nans = nan_policy::mismatch;
+    inf_policy infs = inf_policy::exact;
+    bool early_exit = false;
+};
+
+struct compare_result
+{
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    size_t first_mismatch = npos;
+    size_t mismatches = 0;
+    double max_abs_error = 0;
+    double max_rel_error = 0;
+    std::uint64_t max_ulps = 0;
+
+    bool equal() const { return mismatches == 0; }
+};
+
+namespace detail
+{
+
+template <typename FP>
+struct fp_bits;
+
+template <>
+struct fp_bits<float>
+{
+    using signed_type = std::int32_t;
+    using unsigned_type = std::uint32_t;
+};
+
+template <>
+struct fp_bits<double>
+{
+    using signed_type = std::int64_t;
+    using unsigned_type = std::uint64_t;
+};
+
+// Bits of `x` as a two's complement integer ordered like the values
+template <typename FP>
+typename fp_bits<FP>::signed_type ordered_bits(FP x)
+{
+    using U = typename fp_bits<FP>::unsigned_type;
+    U u;
+    std::memcpy(&u, &x, sizeof(u));
+    const U sign = U(1) << (sizeof(U) * 8 - 1);
+    return static_cast<typename fp_bits<FP>::signed_type>((u & sign) ? sign - u : u);
+}
+
+template <typename FP>
+std::uint64_t ulp_distance(FP a, FP b)
+{
+    using U = typename fp_bits<FP>::unsigned_type;
+    const auto ia = ordered_bits(a), ib = ordered_bits(b);
+    return ia > ib ? U(U(ia) - U(ib)) : U(U(ib) - U(ia));
+}
+
+template <typename FP>
+std::uint64_t ulp_limit(const compare_options& o)
+{
+    return std::min<std::uint64_t>(o.max_ulps, std::numeric_limits<typename fp_bits<FP>::unsigned_type>::max());
+}
+
+// Maximum errors kept in locals rather than in compare_result, which the compiler can't keep in registers
+// (a double* output may alias the input)
+struct max_errors
+{
+    double abs = 0;
+    double rel = 0;
+    std::uint64_t ulps = 0;
+};
+
+// Compare one pair, update the maxima; true if it matches
+template <typename FP>
+bool compare_one(FP a, FP b, const compare_options& o, max_errors& e)
+{
+    const FP abs_a = std::fabs(a), abs_b = std::fabs(b);
+    // false for NaN too
+    if (!(abs_a <= std::numeric_limits<FP>::max() && abs_b <= std::numeric_limits<FP>::max())) {
+        const bool nan_a = a != a, nan_b = b != b;
+        if (nan_a || nan_b) {
+            return o.nans == nan_policy::ignore || (o.nans == nan_policy::equal && nan_a && nan_b);
+        }
+        return o.infs == inf_policy::ignore || a == b;
+    }
+    const FP larger = std::max(abs_a, abs_b);
+    const FP diff = std::fabs(a - b);
+    const FP rel = diff / larger; // 0 / 0 is NaN and doesn't pass the comparison below
+    const std::uint64_t ulps = ulp_distance(a, b);
+    e.abs = diff > e.abs ? diff : e.abs;
+    e.rel = rel > e.rel ? rel : e.rel;
+    e.ulps = ulps > e.ulps ? ulps : e.ulps;
+    if (o.mode == compare_mode::ulp) {
+        return ulps <= ulp_limit<FP>(o);
+    }
+    return diff <= std::max(static_cast<FP>(o.absolute), static_cast<FP>(o.relative) * larger);
+}
+
+// Elements [first, count) one by one
+template <typename FP>
+void compare_tail(const FP* a, const FP* b, size_t first, size_t count, const compare_options& o, compare_result& r)
+{
+    max_errors e{r.max_abs_error, r.max_rel_error, r.max_ulps};
+    for (size_t i = first; i < count; ++i) {
+        if (!compare_one(a[i], b[i], o, e)) {
+            if (r.first_mismatch == compare_result::npos) {
+                r.first_mismatch = i;
+            }
+            ++r.mismatches;
+            if (o.early_exit) {
+                break;
+            }
+        }
+    }
+    r.max_abs_error = e.abs;
+    r.max_rel_error = e.rel;
+    r.max_ulps = e.ulps;
+}
+
+template <typename FP>
+compare_result compare_scalar(const FP* a, const FP* b, size_t count, const compare_options& o)
+{
+    compare_result r;
+    compare_tail(a, b, 0, count, o, r);
+    return r;
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+// Vectors of 4 doubles or 8 floats with the same operations, so the AVX2 kernel is written once
+struct avx2_double
+{
+    using fp = double;
+    using vec = __m256d;
+    static constexpr size_t lanes = 4;
+
+    __attribute__((target("avx2"))) static vec load(const fp* p) { return _mm256_loadu_pd(p); }
+    __attribute__((target("avx2"))) static vec set1(double x) { return _mm256_set1_pd(x); }
+    __attribute__((target("avx2"))) static vec zero() { return _mm256_setzero_pd(); }
+    __attribute__((target("avx2"))) static vec abs(vec x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+    __attribute__((target("avx2"))) static vec sub(vec x, vec y) { return _mm256_sub_pd(x, y); }
+    __attribute__((target("avx2"))) static vec mul(vec x, vec y) { return _mm256_mul_pd(x, y); }
+    __attribute__((target("avx2"))) static vec div(vec x, vec y) { return _mm256_div_pd(x, y); }
+    // returns `y` if `x` is NaN
+    __attribute__((target("avx2"))) static vec max(vec x, vec y) { return _mm256_max_pd(x, y); }
+    __attribute__((target("avx2"))) static __m256i unordered(vec x, vec y) { return _mm256_castpd_si256(_mm256_cmp_pd(x, y, _CMP_UNORD_Q)); }
+    __attribute__((target("avx2"))) static __m256i eq(vec x, vec y) { return _mm256_castpd_si256(_mm256_cmp_pd(x, y, _CMP_EQ_OQ)); }
+    __attribute__((target("avx2"))) static __m256i le(vec x, vec y) { return _mm256_castpd_si256(_mm256_cmp_pd(x, y, _CMP_LE_OQ)); }
+    __attribute__((target("avx2"))) static vec mask_out(__m256i m, vec x) { return _mm256_andnot_pd(_mm256_castsi256_pd(m), x); }
+    __attribute__((target("avx2"))) static unsigned movemask(__m256i m) { return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m))); }
+
+    // Integer lanes
+    __attribute__((target("avx2"))) static __m256i ordered(vec x)
+    {
+        const __m256i i = _mm256_castpd_si256(x);
+        const __m256i negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), i);
+        return _mm256_blendv_epi8(i, _mm256_sub_epi64(_mm256_set1_epi64x(INT64_MIN), i), negative);
+    }
+    __attribute__((target("avx2"))) static __m256i distance(__m256i x, __m256i y)
+    {
+        const __m256i greater = _mm256_cmpgt_epi64(x, y);
+        return _mm256_sub_epi64(_mm256_blendv_epi8(y, x, greater), _mm256_blendv_epi8(x, y, greater));
+    }
+    __attribute__((target("avx2"))) static __m256i set1_unsigned(std::uint64_t x) { return _mm256_set1_epi64x(static_cast<long long>(x)); }
+    // unsigned comparison by signed one with flipped top bits
+    __attribute__((target("avx2"))) static __m256i greater_unsigned(__m256i x, __m256i y)
+    {
+        const __m256i top = _mm256_set1_epi64x(INT64_MIN);
+        return _mm256_cmpgt_epi64(_mm256_xor_si256(x, top), _mm256_xor_si256(y, top));
+    }
+    __attribute__((target("avx2"))) static __m256i max_unsigned(__m256i x, __m256i y)
+    {
+        return _mm256_blendv_epi8(y, x, greater_unsigned(x, y));
+    }
+    __attribute__((target("avx2"))) static std::uint64_t reduce_max_unsigned(__m256i x)
+    {
+        alignas(32) std::uint64_t lane[4];
+        std::memcpy(lane, &x, sizeof(lane));
+        return std::max(std::max(lane[0], lane[1]), std::max(lane[2], lane[3]));
+    }
+    __attribute__((target("avx2"))) static double reduce_max(vec x)
+    {
+        alignas(32) double lane[4];
+        std::memcpy(lane, &x, sizeof(lane));
+        return std::max(std::max(lane[0], lane[1]), std::max(lane[2], lane[3]));
+    }
+};
+
+struct avx2_float
+{
+    using fp = float;
+    using vec = __m256;
+    static constexpr size_t lanes = 8;
+
+    __attribute__((target("avx2"))) static vec load(const fp* p) { return _mm256_loadu_ps(p); }
+    __attribute__((target("avx2"))) static vec set1(double x) { return _mm256_set1_ps(static_cast<float>(x)); }
+    __attribute__((target("avx2"))) static vec zero() { return _mm256_setzero_ps(); }
+    __attribute__((target("avx2"))) static vec abs(vec x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+    __attribute__((target("avx2"))) static vec sub(vec x, vec y) { return _mm256_sub_ps(x, y); }
+    __attribute__((target("avx2"))) static vec mul(vec x, vec y) { return _mm256_mul_ps(x, y); }
+    __attribute__((target("avx2"))) static vec div(vec x, vec y) { return _mm256_div_ps(x, y); }
+    __attribute__((target("avx2"))) static vec max(vec x, vec y) { return _mm256_max_ps(x, y); }
+    __attribute__((target("avx2"))) static __m256i unordered(vec x, vec y) { return _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_UNORD_Q)); }
+    __attribute__((target("avx2"))) static __m256i eq(vec x, vec y) { return _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_EQ_OQ)); }
+    __attribute__((target("avx2"))) static __m256i le(vec x, vec y) { return _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_LE_OQ)); }
+    __attribute__((target("avx2"))) static vec mask_out(__m256i m, vec x) { return _mm256_andnot_ps(_mm256_castsi256_ps(m), x); }
+    __attribute__((target("avx2"))) static unsigned movemask(__m256i m) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m))); }
+
+    __attribute__((target("avx2"))) static __m256i ordered(vec x)
+    {
+        const __m256i i = _mm256_castps_si256(x);
+        const __m256i negative = _mm256_srai_epi32(i, 31);
+        return _mm256_blendv_epi8(i, _mm256_sub_epi32(_mm256_set1_epi32(INT32_MIN), i), negative);
+    }
+    __attribute__((target("avx2"))) static __m256i distance(__m256i x, __m256i y)
+    {
+        return _mm256_sub_epi32(_mm256_max_epi32(x, y), _mm256_min_epi32(x, y));
+    }
+    __attribute__((target("avx2"))) static __m256i set1_unsigned(std::uint64_t x) { return _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(x))); }
+    __attribute__((target("avx2"))) static __m256i greater_unsigned(__m256i x, __m256i y)
+    {
+        // x > y if max(x, y) != y
+        return _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(x, y), y), _mm256_set1_epi32(-1));
+    }
+    __attribute__((target("avx2"))) static __m256i max_unsigned(__m256i x, __m256i y) { return _mm256_max_epu32(x, y); }
+    __attribute__((target("avx2"))) static std::uint64_t reduce_max_unsigned(__m256i x)
+    {
+        alignas(32) std::uint32_t lane[8];
+        std::memcpy(lane, &x, sizeof(lane));
+        return *std::max_element(lane, lane + 8);
+    }
+    __attribute__((target("avx2"))) static double reduce_max(vec x)
+    {
+        alignas(32) float lane[8];
+        std::memcpy(lane, &x, sizeof(lane));
+        return *std::max_element(lane, lane + 8);
+    }
+};
+
+template <typename V>
+__attribute__((target("avx2"))) compare_result compare_avx2(const typename V::fp* a, const typename V::fp* b, size_t count, const compare_options& o)
+{
+    using vec = typename V::vec;
+    const vec infinity = V::set1(std::numeric_limits<double>::infinity());
+    const vec absolute = V::set1(o.absolute), relative = V::set1(o.relative);
+    const __m256i max_ulps = V::set1_unsigned(ulp_limit<typename V::fp>(o));
+    const __m256i all = _mm256_set1_epi32(-1);
+    vec max_abs = V::zero(), max_rel = V::zero();
+    __m256i max_ulp = _mm256_setzero_si256();
+
+    compare_result r;
+    size_t i = 0;
+    for (; i + V::lanes <= count; i += V::lanes) {
+        const vec va = V::load(a + i), vb = V::load(b + i);
+        const vec abs_a = V::abs(va), abs_b = V::abs(vb);
+        const __m256i nan_a = V::unordered(va, va), nan_b = V::unordered(vb, vb);
+        const __m256i nan = _mm256_or_si256(nan_a, nan_b);
+        const __m256i inf = _mm256_andnot_si256(nan, _mm256_or_si256(V::eq(abs_a, infinity), V::eq(abs_b, infinity)));
+        const __m256i special = _mm256_or_si256(nan, inf);
+
+        // errors of regular pairs; 0 / 0 is NaN, max() keeps the previous value then
+        const vec diff = V::mask_out(special, V::abs(V::sub(va, vb)));
+        const vec larger = V::max(abs_a, abs_b);
+        max_abs = V::max(diff, max_abs);
+        max_rel = V::max(V::div(diff, larger), max_rel);
+        const __m256i ulps = _mm256_andnot_si256(special, V::distance(V::ordered(va), V::ordered(vb)));
+        max_ulp = V::max_unsigned(ulps, max_ulp);
+
+        __m256i ok = o.mode == compare_mode::ulp ? _mm256_xor_si256(V::greater_unsigned(ulps, max_ulps), all)
+                                                 : V::le(diff, V::max(absolute, V::mul(relative, larger)));
+        ok = _mm256_andnot_si256(special, ok);
+        if (o.nans == nan_policy::ignore) {
+            ok = _mm256_or_si256(ok, nan);
+        }
+        else if (o.nans == nan_policy::equal) {
+            ok = _mm256_or_si256(ok, _mm256_and_si256(nan_a, nan_b));
+        }
+        ok = _mm256_or_si256(ok, _mm256_and_si256(inf, o.infs == inf_policy::ignore ? all : V::eq(va, vb)));
+
+        const unsigned mismatch = ~V::movemask(ok) & ((1u << V::lanes) - 1);
+        if (mismatch != 0) {
+            if (r.first_mismatch == compare_result::npos) {
+                r.first_mismatch = i + static_cast<size_t>(__builtin_ctz(mismatch));
+            }
+            r.mismatches += static_cast<size_t>(__builtin_popcount(mismatch));
+            if (o.early_exit) {
+                break;
+            }
+        }
+    }
+    r.max_abs_error = V::reduce_max(max_abs);
+    r.max_rel_error = V::reduce_max(max_rel);
+    r.max_ulps = V::reduce_max_unsigned(max_ulp);
+    if (!(o.early_exit && r.mismatches > 0)) {
+        compare_tail(a, b, i, count, o, r);
+    }
+    return r;
+}
+
+#endif // CPP_CPU_X86
+
+} // namespace detail
+
+template <typename FP>
+using compare_function = compare_result (*)(const FP* a, const FP* b, size_t count, const compare_options& o);
+
+// Kernels for FP (float or double) from the fastest, those compiled for this platform;
+// cpu::select() picks the first one this CPU supports
+template <typename FP>
+const auto& compare_kernels()
+{
+    static_assert(std::is_same<FP, float>::value || std::is_same<FP, double>::value, "float or double");
+    static const cpu::implementation<compare_function<FP>> kernels[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx2", detail::compare_avx2<typename std::conditional<std::is_same<FP, float>::value, detail::avx2_float, detail::avx2_double>::type>,
+         {cpu::feature::avx2}},
+#endif
+        {"scalar", detail::compare_scalar<FP>, {}}};
+    return kernels;
+}
+
+// Compare a[i] with b[i] for i in [0, count)
+template <typename FP>
+compare_result compare(const FP* a, const FP* b, size_t count, const compare_options& o = compare_options())
+{
+    static const compare_function<FP> best = cpu::select(compare_kernels<FP>()).function;
+    return best(a, b, count, o);
+}
+
+// Arrays of different sizes don't match from the end of the shorter one
+template <typename FP>
+compare_result compare(const std::vector<FP>& a, const std::vector<FP>& b, const compare_options& o = compare_options())
+{
+    const size_t common = std::min(a.size(), b.size());
+    compare_result r = compare(a.data(), b.data(), common, o);
+    if (a.size() != b.size() && !(o.early_exit && r.mismatches > 0)) {
+        if (r.first_mismatch == compare_result::npos) {
+            r.first_mismatch = common;
+        }
+        r.mismatches += std::max(a.size(), b.size()) - common;
+    }
+    return r;
+}
+
+} // namespace fp
@@ -1,13 +1,22 @@
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
+#include <string>
+#include <vector>
 #include <cmath>
 
 // OsX workaround
 #include <cfloat>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
 #include <utilities/bitwise.h>
+#include <utilities/generate.h>
+#include <utilities/benchmark.h>
+#include "vector_math.h"
 
 // 4.Floating point functions and applications
 
@@ -44,7 +53,7 @@ void print_roundings(double val)
 
 void print_fpclassify(double val)
 {
-    int val_type = fpclassify(val);
+    int val_type = std::fpclassify(val);
     std::cout << val << " is ";
     switch (val_type) {
     case FP_INFINITE:
@@ -61,7 +70,7 @@ void print_fpclassify(double val)
         break;
     case FP_NORMAL:
         std::cout << "normal";
-        if (signbit(val)) {
+        if (std::signbit(val)) {
             std::cout << " negative" << '\n';
         }
         else {
@@ -204,14 +213,14 @@ void show_cmath_fpoint_operations()
     std::cout << "For " << nf << " isnan(nf) = " << std::isnan(nf) << '\n';
     std::cout << "For " << "isnan sqrt(-1.0) = " << std::isnan(sqrt(-1.0)) << '\n';
     // isnormal is opposite to isnan, but also checks for INF and 0
-    std::cout << "For " << "isnormal sqrt(-1.0) = " << isnormal(sqrt(-1.0)) << '\n';
+    std::cout << "For " << "isnormal sqrt(-1.0) = " << std::isnormal(sqrt(-1.0)) << '\n';
 
     // isunordered() check at least one of values is NAN
-    if (isunordered(sqrt(-1.0), 0.0))
+    if (std::isunordered(sqrt(-1.0), 0.0))
         std::cout << "sqrt(-1.0) and 0.0 cannot be ordered\n";
 
     double myinf = INFINITY;
-    if ((1 / sin(0.0) == myinf) && (!isnormal(myinf))) {
+    if ((1 / sin(0.0) == myinf) && (!std::isnormal(myinf))) {
         std::cout << "1/0 is " << myinf << '\n';
     }
 
@@ -237,7 +246,7 @@ void show_cmath_fpoint_operations()
     // (less than minimal double)
     // requires expanded representation, works slower (10-100 times)
     double subnorm = 1.0;
-    while (fpclassify(subnorm) != FP_SUBNORMAL) {
+    while (std::fpclassify(subnorm) != FP_SUBNORMAL) {
         subnorm /= 2;
     }
     print_fpclassify(subnorm);
@@ -245,8 +254,180 @@ void show_cmath_fpoint_operations()
 
 
 
-int main()
+// Array math: fp::exp/log/sin/cos from vector_math.h
+
+const fp::math_accuracy all_accuracies[] = {fp::math_accuracy::ulp3, fp::math_accuracy::ulp1, fp::math_accuracy::ulp05};
+const fp::math_op all_ops[] = {fp::math_op::exp, fp::math_op::log, fp::math_op::sin, fp::math_op::cos};
+
+// libm in double: the exact result for the float error
+double reference(fp::math_op op, double x)
+{
+    switch (op) {
+    case fp::math_op::exp: return std::exp(x);
+    case fp::math_op::log: return std::log(x);
+    case fp::math_op::sin: return std::sin(x);
+    default: return std::cos(x);
+    }
+}
+
+// libm in float: std::exp(float) etc.
+float libm_float(fp::math_op op, float x)
+{
+    switch (op) {
+    case fp::math_op::exp: return std::exp(x);
+    case fp::math_op::log: return std::log(x);
+    case fp::math_op::sin: return std::sin(x);
+    default: return std::cos(x);
+    }
+}
+
+struct accuracy_stats
 {
-    // TODO: insert any function call
+    double max_ulps = 0;
+    float worst_input = 0;
+    // NaN or infinity where another value is expected, or the other way
+    size_t special_mismatches = 0;
+
+    void add(float x, float y, double exact)
+    {
+        const float rounded = static_cast<float>(exact);
+        if (std::isnan(rounded) || std::isinf(rounded) || std::isnan(y) || std::isinf(y)) {
+            if (!(std::isnan(rounded) && std::isnan(y)) && rounded != y) {
+                ++special_mismatches;
+            }
+            return;
+        }
+        // ULP of the float nearest to the exact result, 2^-149 for subnormals and zero
+        int e = 0;
+        std::frexp(rounded, &e);
+        const double ulp = std::fabs(rounded) < FLT_MIN ? std::ldexp(1.0, -149) : std::ldexp(1.0, e - FLT_MANT_DIG);
+        const double ulps = std::fabs(y - exact) / ulp;
+        if (ulps > max_ulps) {
+            max_ulps = ulps;
+            worst_input = x;
+        }
+    }
+};
+
+// Max error in ULP over every `stride`-th float bit pattern, all of them for stride 1,
+// and the number of mismatching special values
+void measure_math_accuracy(uint32_t stride)
+{
+    const size_t chunk = 1 << 16;
+    const uint64_t patterns = uint64_t(1) << 32;
+    accuracy_stats stats[4][2][3];
+    accuracy_stats libm_stats[4];
+
+    std::vector<float> in(chunk), out(chunk);
+    std::vector<double> expected(chunk);
+    for (uint64_t first = 0; first < patterns; first += uint64_t(chunk) * stride) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(chunk, (patterns - first + stride - 1) / stride));
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t b = static_cast<uint32_t>(first + uint64_t(i) * stride);
+            std::memcpy(&in[i], &b, sizeof(b));
+        }
+        for (size_t o = 0; o < 4; ++o) {
+            for (size_t i = 0; i < n; ++i) {
+                expected[i] = reference(all_ops[o], in[i]);
+                libm_stats[o].add(in[i], libm_float(all_ops[o], in[i]), expected[i]);
+            }
+            for (size_t a = 0; a < 3; ++a) {
+                // the last kernel, libm, is the same for every accuracy: libm_stats
+                const auto& kernels = fp::math_kernels(all_ops[o], all_accuracies[a]);
+                for (size_t k = 0; k + 1 < std::size(kernels); ++k) {
+                    if (!cpu::detected().contains(kernels[k].required)) {
+                        continue;
+                    }
+                    kernels[k].function(in.data(), n, out.data());
+                    for (size_t i = 0; i < n; ++i) {
+                        stats[o][k][a].add(in[i], out[i], expected[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    auto print = [](const accuracy_stats& s) {
+        std::cout << std::setw(8) << std::fixed << std::setprecision(3) << s.max_ulps << std::defaultfloat
+                  << " at " << std::setw(14) << std::setprecision(8) << s.worst_input << std::setprecision(6);
+        if (s.special_mismatches != 0) {
+            std::cout << ", special values: " << s.special_mismatches;
+        }
+    };
+    std::cout << "Max error in ULP, every " << stride << " float bit pattern\n";
+    for (size_t o = 0; o < 4; ++o) {
+        std::cout << fp::op_name(all_ops[o]) << '\n';
+        for (size_t a = 0; a < 3; ++a) {
+            std::cout << "  " << std::left << std::setw(8) << fp::accuracy_name(all_accuracies[a]) << std::right;
+            const auto& kernels = fp::math_kernels(all_ops[o], all_accuracies[a]);
+            for (size_t k = 0; k + 1 < std::size(kernels); ++k) {
+                if (cpu::detected().contains(kernels[k].required)) {
+                    std::cout << "  " << kernels[k].name << ' ';
+                    print(stats[o][k][a]);
+                }
+            }
+            std::cout << '\n';
+        }
+        std::cout << "  " << std::left << std::setw(8) << "libm" << std::right << "  std::" << fp::op_name(all_ops[o]) << "(float) ";
+        print(libm_stats[o]);
+        std::cout << '\n';
+    }
+    std::cout << '\n';
+}
+
+void benchmark_math()
+{
+    RandomReal<float> random_real;
+    const size_t n = 100000;
+    std::vector<float> results(n);
+
+    for (fp::math_op op : all_ops) {
+        // exp over the range without overflow, log over many binades, sin/cos over a few periods
+        const std::vector<float> randoms = op == fp::math_op::exp   ? random_real.generate(-80.0F, 80.0F, n)
+                                           : op == fp::math_op::log ? random_real.generate(1e-6F, 1e6F, n)
+                                                                    : random_real.generate(-100.0F, 100.0F, n);
+        bench::suite s(std::string(fp::op_name(op)) + "(x)");
+        s.run(std::string("std::") + fp::op_name(op) + "(float)", [&] {
+            for (size_t i = 0; i < n; ++i) {
+                results[i] = libm_float(op, randoms[i]);
+            }
+            bench::clobber_memory();
+        }, n);
+        for (fp::math_accuracy a : all_accuracies) {
+            // without the last one, libm, timed above
+            const auto& kernels = fp::math_kernels(op, a);
+            for (auto k = std::begin(kernels); k + 1 != std::end(kernels); ++k) {
+                if (!cpu::detected().contains(k->required)) {
+                    continue;
+                }
+                s.run(std::string(k->name) + ", " + fp::accuracy_name(a), [&] {
+                    k->function(randoms.data(), n, results.data());
+                    bench::clobber_memory();
+                }, n);
+            }
+        }
+        s.report(std::cout);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const std::string func = argc > 1 ? argv[1] : "all";
+    if (func == "cmath" || func == "all") {
+        show_cmath_fpoint_operations();
+        std::cout << '\n';
+    }
+    if (func == "accuracy" || func == "all") {
+        // every 1021st pattern covers all binades in a few seconds, 1 is exhaustive
+        const uint32_t stride = argc > 2 ? static_cast<uint32_t>(std::max(1L, std::atol(argv[2]))) : 1021;
+        measure_math_accuracy(stride);
+    }
+    if (func == "benchmark" || func == "all") {
+        benchmark_math();
+    }
+    if (func != "cmath" && func != "accuracy" && func != "benchmark" && func != "all") {
+        std::cerr << "Usage: " << argv[0] << " [cmath|accuracy [stride]|benchmark]\n";
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,641 @@
+#pragma once
+/*
+vector_math.h
+exp, log, sin and cos over float arrays, polynomial approximations with selectable accuracy.
+
+Every function reduces the argument to a short interval and evaluates a minimax polynomial there:
+  - exp(x) = 2^n * e^r, n = round(x / ln2), |r| <= ln2 / 2, e^r = 1 + r + r^2 P(r)
+  - log(x) = e * ln2 + log(1 + f), x = (1 + f) * 2^e, sqrt(1/2) <= 1 + f < sqrt(2)
+  - sin(x), cos(x): r = x - j * pi/2, |r| <= pi/4, sin(r) = r + r^3 S(r^2), cos(r) = 1 - r^2/2 + r^4 C(r^2),
+    j mod 4 picks +-sin(r) or +-cos(r)
+Accuracy, the maximum error in units in the last place (ULP) of the float result:
+  - ulp3:  short polynomials in float; for sin/cos the reduction in float too, valid for |x| <= 8192
+  - ulp1:  longer polynomials, log(1 + f) via s = f / (2 + f), 1 + r + r^2 P(r) rounded once;
+           sin/cos reduce x and evaluate the short polynomials in double
+  - ulp05: the reduced argument and the polynomial in double, rounded to float once:
+           correctly rounded except for rare cases within 2^-20 ULP of a tie
+Special values are handled as std:: functions do: NaN -> NaN, exp(-inf) = 0, exp(+inf) = +inf, results below
+the smallest subnormal are 0, above FLT_MAX are +inf; log(0) = -inf, log(x < 0) = NaN; sin(+-0) = +-0,
+sin/cos(inf) = NaN. sin/cos of |x| beyond the reduction range go to std::sin/std::cos in double.
+
+Kernels:
+  - avx2:   8 floats per instruction, the double parts as two vectors of 4
+  - scalar: the same algorithm one float at a time, the reference for the vector one
+  - libm:   std::exp, std::log, ... in float, the fallback for CPUs without AVX2+FMA: there every fma of
+            the scalar kernel would be a library call, 2.5-5x slower than libm
+The algorithm is written once over a set of operations (scalar_float, avx2_float, ...) and on x86 compiled
+for AVX2+FMA, so the templates pass __m256 with the AVX ABI and std::fma() is one instruction. Every
+multiply-add is an explicit fma, so with -ffp-contract (the GCC default) too both kernels return the same bits.
+The best kernel is chosen at run time (utilities/cpu_features.h).
+*/
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include <utilities/cpu_features.h>
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+#include <immintrin.h>
+#define CPP_VMATH_TARGET __attribute__((target("avx2,fma")))
+#else
+#define CPP_VMATH_TARGET
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CPP_VMATH_INLINE inline __attribute__((always_inline)) CPP_VMATH_TARGET
+#else
+#define CPP_VMATH_INLINE inline
+#endif
+
+namespace fp
+{
+
+enum class math_accuracy
+{
+    ulp3,
+    ulp1,
+    ulp05
+};
+
+inline const char* accuracy_name(math_accuracy a)
+{
+    switch (a) {
+    case math_accuracy::ulp3: return "3 ULP";
+    case math_accuracy::ulp1: return "1 ULP";
+    case math_accuracy::ulp05: return "0.5 ULP";
+    }
+    return "";
+}
+
+enum class math_op
+{
+    exp,
+    log,
+    sin,
+    cos
+};
+
+inline const char* op_name(math_op op)
+{
+    switch (op) {
+    case math_op::exp: return "exp";
+    case math_op::log: return "log";
+    case math_op::sin: return "sin";
+    case math_op::cos: return "cos";
+    }
+    return "";
+}
+
+// out[i] = op(in[i])
+using math_function = void (*)(const float* in, size_t count, float* out);
+
+namespace detail
+{
+
+// Minimax coefficients, the lowest power first
+
+// e^r = 1 + r + r^2 P(r), |r| <= ln2 / 2
+constexpr double exp_p3[] = {4.999923110e-01, 1.666711569e-01, 4.189027101e-02, 8.312507533e-03};
+constexpr double exp_p1[] = {4.999999404e-01, 1.666652113e-01, 4.166838899e-02, 8.368735202e-03, 1.381455921e-03};
+constexpr double exp_p05[] = {4.99999999996636080e-01, 1.66666666672664582e-01, 4.16666669627072245e-02, 8.33333309471797831e-03,
+                              1.38888110628870506e-03, 1.98415393690324200e-04, 2.48808516231807505e-05, 2.74930329374099296e-06};
+
+// log(1 + f) = f - f^2/2 + f^3 Q(f)
+constexpr double log_q3[] = {3.333390951e-01, -2.500133812e-01, 1.996306330e-01, -1.657758504e-01,
+                             1.491476893e-01, -1.426748633e-01, 8.700430393e-02};
+// log(1 + f) = f - f^2/2 + s (f^2/2 + z W(z)), s = f / (2 + f), z = s^2
+constexpr double log_w1[] = {6.666677594e-01, 3.997744322e-01, 2.987459600e-01};
+constexpr double log_w05[] = {6.66666666758993887e-01, 3.99999955843232002e-01, 2.85721135236732759e-01,
+                              2.21759912822053651e-01, 1.95871945263171116e-01};
+
+// sin(r) = r + r^3 S(r^2), cos(r) = 1 - r^2/2 + r^4 C(r^2), |r| <= pi/4
+constexpr double sin_s1[] = {-1.666665524e-01, 8.332154714e-03, -1.951445447e-04};
+constexpr double cos_c3[] = {4.166104272e-02, -1.364809694e-03};
+constexpr double cos_c1[] = {4.166664556e-02, -1.388730831e-03, 2.443220910e-05};
+constexpr double sin_s05[] = {-1.66666666666298841e-01, 8.33333332499296489e-03, -1.98412636816617366e-04,
+                              2.75553295436370327e-06, -2.47597122775497993e-08};
+constexpr double cos_c05[] = {4.16666666665956240e-02, -1.38888888774947789e-03, 2.48015806561852385e-05,
+                              -2.75555138576794026e-07, 2.06445247693990129e-09};
+
+constexpr double log2e = 1.44269504088896339e+00;
+constexpr double two_over_pi = 6.36619772367581382e-01;
+constexpr double ln2 = 6.93147180559945286e-01;
+// ln2 = ln2_hi + ln2_lo, n * ln2_hi is exact
+constexpr double ln2_hi_f = 0.693359375;
+constexpr double ln2_lo_f = -2.12194440e-4;
+constexpr double ln2_hi = 6.93147180369123816490e-01;
+constexpr double ln2_lo = 1.90821492927058770002e-10;
+// pi/2 in 3 floats, and in 3 doubles of 33 bits, so j * pio2_1 and j * pio2_2 are exact for j < 2^20
+constexpr double pio2_1f = 1.570796371e+00;
+constexpr double pio2_2f = -4.371138829e-08;
+constexpr double pio2_3f = -1.715099417e-15;
+constexpr double pio2_1 = 1.57079632673412561417e+00;
+constexpr double pio2_2 = 6.07710050630396597660e-11;
+constexpr double pio2_3 = 2.02226624879595063154e-21;
+// |x| reduced by float and by double constants with enough precision
+constexpr float sincos_limit_f = 8192.0f;
+constexpr float sincos_limit = 524288.0f;
+
+// Operations on 1 float or double: the reference for the vector ones
+
+struct scalar_float
+{
+    using vec = float;
+    using mask = bool;
+    static constexpr size_t lanes = 1;
+
+    static vec load(const float* p) { return *p; }
+    static void store(float* p, vec x) { *p = x; }
+    static vec set(double c) { return static_cast<float>(c); }
+    static vec add(vec a, vec b) { return a + b; }
+    static vec sub(vec a, vec b) { return a - b; }
+    static vec mul(vec a, vec b) { return a * b; }
+    static vec div(vec a, vec b) { return a / b; }
+    static vec neg(vec a) { return -a; }
+    static vec fma(vec a, vec b, vec c) { return std::fma(a, b, c); }
+    static vec abs(vec a) { return std::fabs(a); }
+    // to the nearest integer, ties to even
+    static vec round(vec a) { return std::nearbyint(a); }
+    // like MINPS/MAXPS: b if either one is NaN
+    static vec min(vec a, vec b) { return a < b ? a : b; }
+    static vec max(vec a, vec b) { return a > b ? a : b; }
+    static mask lt(vec a, vec b) { return a < b; }
+    static mask gt(vec a, vec b) { return a > b; }
+    static mask eq(vec a, vec b) { return a == b; }
+    static mask unord(vec a, vec b) { return a != a || b != b; }
+    static mask mask_or(mask a, mask b) { return a || b; }
+    static bool any(mask m) { return m; }
+    static vec select(mask m, vec a, vec b) { return m ? a : b; }
+    static vec negate_if(vec a, mask m) { return m ? -a : a; }
+
+    // bit b of the integer j, |j| < 2^22
+    static mask bit(vec j, int b)
+    {
+        return (bits(j + 0x1.8p23f) >> b) & 1u;
+    }
+
+    // 2^n, integer n in [-126, 127]
+    static vec pow2(vec n)
+    {
+        return from_bits(bits(n + (0x1p23f + 127)) << 23);
+    }
+
+    // 1 + f in [sqrt(1/2), sqrt(2)) and e with x = (1 + f) * 2^e, for positive finite x
+    static vec frexp_sqrt2(vec x, vec& e)
+    {
+        const bool subnormal = x < std::numeric_limits<float>::min();
+        const std::uint32_t ix = bits(subnormal ? x * 0x1p23f : x) - 0x3f3504f3u;
+        e = static_cast<float>(static_cast<std::int32_t>(ix) >> 23) - (subnormal ? 23.0f : 0.0f);
+        return from_bits((ix & 0x7fffffu) + 0x3f3504f3u);
+    }
+
+    static std::uint32_t bits(float x)
+    {
+        std::uint32_t u;
+        std::memcpy(&u, &x, sizeof(u));
+        return u;
+    }
+
+    static float from_bits(std::uint32_t u)
+    {
+        float x;
+        std::memcpy(&x, &u, sizeof(x));
+        return x;
+    }
+};
+
+struct scalar_double
+{
+    using vec = double;
+    using mask = bool;
+
+    static vec widen(float x) { return x; }
+    static float narrow(vec x) { return static_cast<float>(x); }
+    static vec set(double c) { return c; }
+    static vec add(vec a, vec b) { return a + b; }
+    static vec sub(vec a, vec b) { return a - b; }
+    static vec mul(vec a, vec b) { return a * b; }
+    static vec div(vec a, vec b) { return a / b; }
+    static vec neg(vec a) { return -a; }
+    static vec fma(vec a, vec b, vec c) { return std::fma(a, b, c); }
+    static vec round(vec a) { return std::nearbyint(a); }
+    static vec select(mask m, vec a, vec b) { return m ? a : b; }
+    static vec negate_if(vec a, mask m) { return m ? -a : a; }
+
+    static mask bit(vec j, int b)
+    {
+        return (bits(j + 0x1.8p52) >> b) & 1u;
+    }
+
+    // 2^n, integer n in [-1022, 1023]
+    static vec pow2(vec n)
+    {
+        const std::uint64_t u = bits(n + (0x1p52 + 1023)) << 52;
+        double x;
+        std::memcpy(&x, &u, sizeof(x));
+        return x;
+    }
+
+    static std::uint64_t bits(double x)
+    {
+        std::uint64_t u;
+        std::memcpy(&u, &x, sizeof(u));
+        return u;
+    }
+};
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+struct avx2_float
+{
+    using vec = __m256;
+    using mask = __m256;
+    static constexpr size_t lanes = 8;
+
+    __attribute__((target("avx2,fma"))) static vec load(const float* p) { return _mm256_loadu_ps(p); }
+    __attribute__((target("avx2,fma"))) static void store(float* p, vec x) { _mm256_storeu_ps(p, x); }
+    __attribute__((target("avx2,fma"))) static vec set(double c) { return _mm256_set1_ps(static_cast<float>(c)); }
+    __attribute__((target("avx2,fma"))) static vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static vec sub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static vec mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static vec div(vec a, vec b) { return _mm256_div_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static vec neg(vec a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+    __attribute__((target("avx2,fma"))) static vec fma(vec a, vec b, vec c) { return _mm256_fmadd_ps(a, b, c); }
+    __attribute__((target("avx2,fma"))) static vec abs(vec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    __attribute__((target("avx2,fma"))) static vec round(vec a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    __attribute__((target("avx2,fma"))) static vec min(vec a, vec b) { return _mm256_min_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static vec max(vec a, vec b) { return _mm256_max_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static mask lt(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    __attribute__((target("avx2,fma"))) static mask gt(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    __attribute__((target("avx2,fma"))) static mask eq(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    __attribute__((target("avx2,fma"))) static mask unord(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_UNORD_Q); }
+    __attribute__((target("avx2,fma"))) static mask mask_or(mask a, mask b) { return _mm256_or_ps(a, b); }
+    __attribute__((target("avx2,fma"))) static bool any(mask m) { return _mm256_movemask_ps(m) != 0; }
+    __attribute__((target("avx2,fma"))) static vec select(mask m, vec a, vec b) { return _mm256_blendv_ps(b, a, m); }
+    __attribute__((target("avx2,fma"))) static vec negate_if(vec a, mask m) { return _mm256_xor_ps(a, _mm256_and_ps(m, _mm256_set1_ps(-0.0f))); }
+
+    __attribute__((target("avx2,fma"))) static mask bit(vec j, int b)
+    {
+        const __m256i bit = _mm256_set1_epi32(1 << b);
+        const __m256i low = _mm256_and_si256(_mm256_castps_si256(_mm256_add_ps(j, _mm256_set1_ps(0x1.8p23f))), bit);
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(low, bit));
+    }
+
+    __attribute__((target("avx2,fma"))) static vec pow2(vec n)
+    {
+        const __m256i biased = _mm256_castps_si256(_mm256_add_ps(n, _mm256_set1_ps(0x1p23f + 127)));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(biased, 23));
+    }
+
+    __attribute__((target("avx2,fma"))) static vec frexp_sqrt2(vec x, vec& e)
+    {
+        const __m256 subnormal = _mm256_cmp_ps(x, _mm256_set1_ps(std::numeric_limits<float>::min()), _CMP_LT_OQ);
+        const __m256 scaled = _mm256_blendv_ps(x, _mm256_mul_ps(x, _mm256_set1_ps(0x1p23f)), subnormal);
+        const __m256i sqrt_half = _mm256_set1_epi32(0x3f3504f3);
+        const __m256i ix = _mm256_sub_epi32(_mm256_castps_si256(scaled), sqrt_half);
+        e = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(ix, 23)), _mm256_and_ps(subnormal, _mm256_set1_ps(23.0f)));
+        return _mm256_castsi256_ps(_mm256_add_epi32(_mm256_and_si256(ix, _mm256_set1_epi32(0x7fffff)), sqrt_half));
+    }
+};
+
+// 8 doubles as two vectors of 4, the lanes of one avx2_float vector
+struct avx2_double
+{
+    struct vec
+    {
+        __m256d lo;
+        __m256d hi;
+    };
+    using mask = vec;
+
+    __attribute__((target("avx2,fma"))) static vec widen(__m256 x)
+    {
+        return {_mm256_cvtps_pd(_mm256_castps256_ps128(x)), _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1))};
+    }
+    __attribute__((target("avx2,fma"))) static __m256 narrow(vec x)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(x.lo)), _mm256_cvtpd_ps(x.hi), 1);
+    }
+    __attribute__((target("avx2,fma"))) static vec set(double c) { return {_mm256_set1_pd(c), _mm256_set1_pd(c)}; }
+    __attribute__((target("avx2,fma"))) static vec add(vec a, vec b) { return {_mm256_add_pd(a.lo, b.lo), _mm256_add_pd(a.hi, b.hi)}; }
+    __attribute__((target("avx2,fma"))) static vec sub(vec a, vec b) { return {_mm256_sub_pd(a.lo, b.lo), _mm256_sub_pd(a.hi, b.hi)}; }
+    __attribute__((target("avx2,fma"))) static vec mul(vec a, vec b) { return {_mm256_mul_pd(a.lo, b.lo), _mm256_mul_pd(a.hi, b.hi)}; }
+    __attribute__((target("avx2,fma"))) static vec div(vec a, vec b) { return {_mm256_div_pd(a.lo, b.lo), _mm256_div_pd(a.hi, b.hi)}; }
+    __attribute__((target("avx2,fma"))) static vec neg(vec a)
+    {
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        return {_mm256_xor_pd(a.lo, sign), _mm256_xor_pd(a.hi, sign)};
+    }
+    __attribute__((target("avx2,fma"))) static vec fma(vec a, vec b, vec c)
+    {
+        return {_mm256_fmadd_pd(a.lo, b.lo, c.lo), _mm256_fmadd_pd(a.hi, b.hi, c.hi)};
+    }
+    __attribute__((target("avx2,fma"))) static vec round(vec a)
+    {
+        return {_mm256_round_pd(a.lo, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC),
+                _mm256_round_pd(a.hi, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)};
+    }
+    __attribute__((target("avx2,fma"))) static vec select(mask m, vec a, vec b)
+    {
+        return {_mm256_blendv_pd(b.lo, a.lo, m.lo), _mm256_blendv_pd(b.hi, a.hi, m.hi)};
+    }
+    __attribute__((target("avx2,fma"))) static vec negate_if(vec a, mask m)
+    {
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        return {_mm256_xor_pd(a.lo, _mm256_and_pd(m.lo, sign)), _mm256_xor_pd(a.hi, _mm256_and_pd(m.hi, sign))};
+    }
+
+    __attribute__((target("avx2,fma"))) static mask bit(vec j, int b)
+    {
+        const __m256i bit = _mm256_set1_epi64x(1ll << b);
+        const __m256d magic = _mm256_set1_pd(0x1.8p52);
+        const __m256i lo = _mm256_and_si256(_mm256_castpd_si256(_mm256_add_pd(j.lo, magic)), bit);
+        const __m256i hi = _mm256_and_si256(_mm256_castpd_si256(_mm256_add_pd(j.hi, magic)), bit);
+        return {_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, bit)), _mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, bit))};
+    }
+
+    __attribute__((target("avx2,fma"))) static vec pow2(vec n)
+    {
+        const __m256d bias = _mm256_set1_pd(0x1p52 + 1023);
+        return {_mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(n.lo, bias)), 52)),
+                _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(n.hi, bias)), 52))};
+    }
+};
+
+#endif // CPP_CPU_X86
+
+// The algorithms are inlined into the kernels, all of them compiled with CPP_VMATH_TARGET
+
+// c[0] + x * (c[1] + x * (c[2] + ...))
+template <typename V, size_t N>
+CPP_VMATH_INLINE typename V::vec polynomial(typename V::vec x, const double (&c)[N])
+{
+    typename V::vec p = V::set(c[N - 1]);
+    for (size_t k = N - 1; k-- > 0;) {
+        p = V::fma(p, x, V::set(c[k]));
+    }
+    return p;
+}
+
+template <typename F, typename D, math_accuracy A>
+CPP_VMATH_INLINE typename F::vec exp_kernel(typename F::vec x)
+{
+    // e^-104 is below half of the smallest subnormal, e^89 is above FLT_MAX; NaN becomes -104 and is restored below
+    const typename F::vec clamped = F::min(F::max(x, F::set(-104.0)), F::set(89.0));
+    typename F::vec y;
+    if constexpr (A == math_accuracy::ulp05) {
+        const typename D::vec xd = D::widen(clamped);
+        const typename D::vec n = D::round(D::mul(xd, D::set(log2e)));
+        typename D::vec r = D::fma(n, D::set(-ln2_hi), xd);
+        r = D::fma(n, D::set(-ln2_lo), r);
+        const typename D::vec p = D::add(D::fma(D::mul(r, r), polynomial<D>(r, exp_p05), r), D::set(1.0));
+        // 2^n for n in [-150, 129] is a normal double, a single rounding to float
+        y = D::narrow(D::mul(p, D::pow2(n)));
+    }
+    else {
+        const typename F::vec n = F::round(F::mul(clamped, F::set(log2e)));
+        typename F::vec r = F::fma(n, F::set(-ln2_hi_f), clamped);
+        r = F::fma(n, F::set(-ln2_lo_f), r);
+        const typename F::vec q = A == math_accuracy::ulp1 ? polynomial<F>(r, exp_p1) : polynomial<F>(r, exp_p3);
+        // 1 + r = hi + lo exactly, p = 1 + r + r^2 P(r) is rounded once
+        const typename F::vec hi = F::add(F::set(1.0), r);
+        const typename F::vec lo = F::add(F::sub(F::set(1.0), hi), r);
+        const typename F::vec p = F::add(hi, F::fma(F::mul(r, r), q, lo));
+        // 2^n in two steps: 2^128 isn't a float, and below 2^-126 it would be subnormal
+        const typename F::vec n1 = F::round(F::mul(n, F::set(0.5)));
+        y = F::mul(F::mul(p, F::pow2(n1)), F::pow2(F::sub(n, n1)));
+    }
+    return F::select(F::unord(x, x), x, y);
+}
+
+template <typename F, typename D, math_accuracy A>
+CPP_VMATH_INLINE typename F::vec log_kernel(typename F::vec x)
+{
+    // 1 + f and e are exact, so is f
+    typename F::vec e;
+    const typename F::vec f = F::sub(F::frexp_sqrt2(x, e), F::set(1.0));
+    typename F::vec y;
+    if constexpr (A == math_accuracy::ulp05) {
+        const typename D::vec fd = D::widen(f);
+        const typename D::vec s = D::div(fd, D::add(D::set(2.0), fd));
+        const typename D::vec z = D::mul(s, s);
+        const typename D::vec hfsq = D::mul(D::set(0.5), D::mul(fd, fd));
+        const typename D::vec log1p = D::add(fd, D::fma(s, D::fma(z, polynomial<D>(z, log_w05), hfsq), D::neg(hfsq)));
+        y = D::narrow(D::fma(D::widen(e), D::set(ln2), log1p));
+    }
+    else {
+        const typename F::vec hfsq = F::mul(F::set(0.5), F::mul(f, f));
+        typename F::vec corr;
+        if constexpr (A == math_accuracy::ulp1) {
+            const typename F::vec s = F::div(f, F::add(F::set(2.0), f));
+            const typename F::vec z = F::mul(s, s);
+            corr = F::fma(s, F::fma(z, polynomial<F>(z, log_w1), hfsq), F::neg(hfsq));
+        }
+        else {
+            corr = F::fma(F::mul(F::mul(f, f), f), polynomial<F>(f, log_q3), F::neg(hfsq));
+        }
+        // e * ln2_hi is exact, the small terms first
+        y = F::fma(e, F::set(ln2_hi_f), F::add(f, F::fma(e, F::set(ln2_lo_f), corr)));
+    }
+    const float inf = std::numeric_limits<float>::infinity();
+    y = F::select(F::eq(x, F::set(inf)), x, y);
+    y = F::select(F::eq(x, F::set(0.0)), F::set(-inf), y);
+    y = F::select(F::lt(x, F::set(0.0)), F::set(std::numeric_limits<float>::quiet_NaN()), y);
+    return F::select(F::unord(x, x), x, y);
+}
+
+template <typename F, typename D, math_accuracy A, bool Cos>
+CPP_VMATH_INLINE typename F::vec sincos_kernel(typename F::vec x)
+{
+    const float limit = A == math_accuracy::ulp3 ? sincos_limit_f : sincos_limit;
+    typename F::vec y;
+    if constexpr (A == math_accuracy::ulp3) {
+        const typename F::vec j = F::round(F::mul(x, F::set(two_over_pi)));
+        typename F::vec r = F::fma(j, F::set(-pio2_1f), x);
+        r = F::fma(j, F::set(-pio2_2f), r);
+        r = F::fma(j, F::set(-pio2_3f), r);
+        const typename F::vec z = F::mul(r, r);
+        const typename F::vec s = F::fma(F::mul(r, z), polynomial<F>(z, sin_s1), r);
+        const typename F::vec c = F::fma(F::mul(z, z), polynomial<F>(z, cos_c3), F::fma(z, F::set(-0.5), F::set(1.0)));
+        // sin(x) is s, c, -s, -c for j mod 4 = 0, 1, 2, 3; cos(x) = sin(x + pi/2)
+        const typename F::vec q = Cos ? F::add(j, F::set(1.0)) : j;
+        y = F::negate_if(F::select(F::bit(q, 0), c, s), F::bit(q, 1));
+    }
+    else {
+        const typename D::vec xd = D::widen(x);
+        const typename D::vec j = D::round(D::mul(xd, D::set(two_over_pi)));
+        typename D::vec r = D::fma(j, D::set(-pio2_1), xd);
+        r = D::fma(j, D::set(-pio2_2), r);
+        r = D::fma(j, D::set(-pio2_3), r);
+        const typename D::vec z = D::mul(r, r);
+        // the shorter polynomials for ulp1 are within 2^-30 of sin and cos
+        const typename D::vec ps = A == math_accuracy::ulp05 ? polynomial<D>(z, sin_s05) : polynomial<D>(z, sin_s1);
+        const typename D::vec pc = A == math_accuracy::ulp05 ? polynomial<D>(z, cos_c05) : polynomial<D>(z, cos_c1);
+        const typename D::vec s = D::fma(D::mul(r, z), ps, r);
+        const typename D::vec c = D::fma(D::mul(z, z), pc, D::fma(z, D::set(-0.5), D::set(1.0)));
+        const typename D::vec q = Cos ? D::add(j, D::set(1.0)) : j;
+        y = D::narrow(D::negate_if(D::select(D::bit(q, 0), c, s), D::bit(q, 1)));
+    }
+    if constexpr (!Cos) {
+        y = F::select(F::eq(x, F::set(0.0)), x, y);
+    }
+    // infinity, NaN and arguments too large to reduce
+    if (F::any(F::mask_or(F::gt(F::abs(x), F::set(limit)), F::unord(x, x)))) {
+        float xs[F::lanes];
+        float ys[F::lanes];
+        F::store(xs, x);
+        F::store(ys, y);
+        for (size_t k = 0; k < F::lanes; ++k) {
+            if (!(std::fabs(xs[k]) <= limit)) {
+                const double xd = xs[k];
+                ys[k] = static_cast<float>(Cos ? std::cos(xd) : std::sin(xd));
+            }
+        }
+        y = F::load(ys);
+    }
+    return y;
+}
+
+template <typename F, typename D, math_op Op, math_accuracy A>
+CPP_VMATH_INLINE typename F::vec evaluate(typename F::vec x)
+{
+    if constexpr (Op == math_op::exp) {
+        return exp_kernel<F, D, A>(x);
+    }
+    else if constexpr (Op == math_op::log) {
+        return log_kernel<F, D, A>(x);
+    }
+    else {
+        return sincos_kernel<F, D, A, Op == math_op::cos>(x);
+    }
+}
+
+template <math_op Op, math_accuracy A>
+CPP_VMATH_TARGET void math_scalar(const float* in, size_t count, float* out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = evaluate<scalar_float, scalar_double, Op, A>(in[i]);
+    }
+}
+
+template <math_op Op>
+void math_libm(const float* in, size_t count, float* out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if constexpr (Op == math_op::exp) {
+            out[i] = std::exp(in[i]);
+        }
+        else if constexpr (Op == math_op::log) {
+            out[i] = std::log(in[i]);
+        }
+        else if constexpr (Op == math_op::sin) {
+            out[i] = std::sin(in[i]);
+        }
+        else {
+            out[i] = std::cos(in[i]);
+        }
+    }
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+template <math_op Op, math_accuracy A>
+__attribute__((target("avx2,fma"))) void math_avx2(const float* in, size_t count, float* out)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(out + i, evaluate<avx2_float, avx2_double, Op, A>(_mm256_loadu_ps(in + i)));
+    }
+    if (i < count) {
+        // the tail through a padded vector, so it has the same results
+        float tail[8] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+        std::memcpy(tail, in + i, (count - i) * sizeof(float));
+        _mm256_storeu_ps(tail, evaluate<avx2_float, avx2_double, Op, A>(_mm256_loadu_ps(tail)));
+        std::memcpy(out + i, tail, (count - i) * sizeof(float));
+    }
+}
+
+#endif // CPP_CPU_X86
+
+template <math_op Op, math_accuracy A>
+const auto& math_kernels()
+{
+    static const cpu::implementation<math_function> kernels[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx2", math_avx2<Op, A>, {cpu::feature::avx, cpu::feature::avx2, cpu::feature::fma}},
+        {"scalar", math_scalar<Op, A>, {cpu::feature::avx, cpu::feature::avx2, cpu::feature::fma}},
+#else
+        {"scalar", math_scalar<Op, A>, {}},
+#endif
+        {"libm", math_libm<Op>, {}}};
+    return kernels;
+}
+
+template <math_op Op>
+const auto& math_kernels(math_accuracy a)
+{
+    switch (a) {
+    case math_accuracy::ulp3: return math_kernels<Op, math_accuracy::ulp3>();
+    case math_accuracy::ulp1: return math_kernels<Op, math_accuracy::ulp1>();
+    default: return math_kernels<Op, math_accuracy::ulp05>();
+    }
+}
+
+// The first kernel this CPU supports, chosen on the first call for each function and accuracy
+template <math_op Op, math_accuracy A>
+math_function best_math()
+{
+    static const math_function best = cpu::select(math_kernels<Op, A>()).function;
+    return best;
+}
+
+template <math_op Op>
+math_function best_math(math_accuracy a)
+{
+    switch (a) {
+    case math_accuracy::ulp3: return best_math<Op, math_accuracy::ulp3>();
+    case math_accuracy::ulp1: return best_math<Op, math_accuracy::ulp1>();
+    default: return best_math<Op, math_accuracy::ulp05>();
+    }
+}
+
+} // namespace detail
+
+// Kernels of the function with the accuracy from the fastest, those compiled for this platform,
+// in the same order for all functions; cpu::select() picks the first one this CPU supports
+inline const auto& math_kernels(math_op op, math_accuracy a)
+{
+    switch (op) {
+    case math_op::exp: return detail::math_kernels<math_op::exp>(a);
+    case math_op::log: return detail::math_kernels<math_op::log>(a);
+    case math_op::sin: return detail::math_kernels<math_op::sin>(a);
+    default: return detail::math_kernels<math_op::cos>(a);
+    }
+}
+
+// out[i] = e^in[i]
+inline void exp(const float* in, size_t count, float* out, math_accuracy a = math_accuracy::ulp1)
+{
+    detail::best_math<math_op::exp>(a)(in, count, out);
+}
+
+// out[i] = ln(in[i])
+inline void log(const float* in, size_t count, float* out, math_accuracy a = math_accuracy::ulp1)
+{
+    detail::best_math<math_op::log>(a)(in, count, out);
+}
+
+inline void sin(const float* in, size_t count, float* out, math_accuracy a = math_accuracy::ulp1)
+{
+    detail::best_math<math_op::sin>(a)(in, count, out);
+}
+
+inline void cos(const float* in, size_t count, float* out, math_accuracy a = math_accuracy::ulp1)
+{
+    detail::best_math<math_op::cos>(a)(in, count, out);
+}
+
+} // namespace fp
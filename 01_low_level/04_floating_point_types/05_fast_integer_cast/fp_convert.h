@@ -0,0 +1,328 @@
+#pragma once
+/*
+fp_convert.h
+Bulk conversion of float/double arrays to int32/int64, e.g. sensor samples to fixed point.
+
+  rounding: truncate (static_cast), nearest (ties to even, as std::lrint in the default mode), floor
+  overflow: saturate  - out-of-range values clamp to the limits of the integer type, NaN gives 0
+            unchecked - the caller guarantees the range; out-of-range values give an unspecified result
+
+Kernels:
+  - scalar: std::trunc/std::floor/std::nearbyint and a cast; without SSE4.1 in the baseline x86-64,
+            trunc, floor and nearbyint are library calls
+  - sse41:  ROUNDPS/ROUNDPD round by the mode in the instruction, then CVTTPS2DQ/CVTTPD2DQ convert exactly;
+            out-of-range lanes get the "integer indefinite" 0x80000000, fixed by a comparison mask
+  - avx2:   the same over 256 bits
+SSE and AVX2 have no packed double -> int64 conversion (it's AVX-512DQ), so int64 uses the magic-number trick
+of fast_dtoll() in integer_cast.cpp: for an integer |x| < 2^51, the bits of x + 1.5 * 2^52 minus the bits
+of 1.5 * 2^52 are x. Vectors with larger values or NaN are converted by the scalar code.
+The best kernel supported by the CPU is chosen at run time (utilities/cpu_features.h).
+*/
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <utilities/cpu_features.h>
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+namespace fp
+{
+
+enum class rounding
+{
+    truncate,
+    nearest,
+    floor
+};
+
+enum class overflow
+{
+    saturate,
+    unchecked
+};
+
+template <typename From, typename To>
+using convert_function = void (*)(const From* in, size_t count, To* out);
+
+namespace detail
+{
+
+template <rounding R, typename FP>
+FP round(FP x)
+{
+    if constexpr (R == rounding::truncate) {
+        return std::trunc(x);
+    }
+    else if constexpr (R == rounding::floor) {
+        return std::floor(x);
+    }
+    else {
+        return std::nearbyint(x);
+    }
+}
+
+// Integer value of already rounded `x`
+template <typename To, bool Saturate, typename FP>
+To to_integer(FP x)
+{
+    if constexpr (Saturate) {
+        // -2^(N-1) and 2^(N-1) are exact in float and double, 2^(N-1) - 1 may be not
+        constexpr FP limit = FP(std::uint64_t(1) << (std::numeric_limits<To>::digits));
+        if (x != x) {
+            return 0;
+        }
+        if (x >= limit) {
+            return std::numeric_limits<To>::max();
+        }
+        if (x < -limit) {
+            return std::numeric_limits<To>::min();
+        }
+    }
+    return static_cast<To>(x);
+}
+
+template <typename From, typename To, rounding R, bool Saturate>
+void convert_scalar(const From* in, size_t count, To* out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = to_integer<To, Saturate>(round<R>(in[i]));
+    }
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+template <rounding R>
+constexpr int round_mode = (R == rounding::truncate ? _MM_FROUND_TO_ZERO
+                            : R == rounding::floor  ? _MM_FROUND_TO_NEG_INF
+                                                    : _MM_FROUND_TO_NEAREST_INT) | _MM_FROUND_NO_EXC;
+
+// 1.5 * 2^52 and 2^51, see fast_dtoll()
+constexpr double magic_int64 = 6755399441055744.0;
+constexpr double magic_int64_limit = 2251799813685248.0;
+
+// SSE4.1, 16 bytes of input per step
+
+template <rounding R, bool Saturate>
+__attribute__((target("sse4.1"))) inline void step_sse41(const float* in, std::int32_t* out)
+{
+    const __m128 x = _mm_round_ps(_mm_loadu_ps(in), round_mode<R>);
+    __m128i r = _mm_cvttps_epi32(x);
+    if constexpr (Saturate) {
+        // 0x80000000 ^ 0xFFFFFFFF = INT32_MAX for x >= 2^31, NaN lanes to 0
+        r = _mm_xor_si128(r, _mm_castps_si128(_mm_cmpge_ps(x, _mm_set1_ps(2147483648.0f))));
+        r = _mm_and_si128(r, _mm_castps_si128(_mm_cmpord_ps(x, x)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), r);
+}
+
+template <rounding R, bool Saturate>
+__attribute__((target("sse4.1"))) inline __m128i round_to_int32_sse41(__m128d x)
+{
+    x = _mm_round_pd(x, round_mode<R>);
+    if constexpr (Saturate) {
+        // int32 limits are exact in double: NaN to 0, then clamp
+        x = _mm_and_pd(x, _mm_cmpord_pd(x, x));
+        x = _mm_min_pd(_mm_max_pd(x, _mm_set1_pd(-2147483648.0)), _mm_set1_pd(2147483647.0));
+    }
+    return _mm_cvttpd_epi32(x);
+}
+
+template <rounding R, bool Saturate>
+__attribute__((target("sse4.1"))) inline void step_sse41(const double* in, std::int32_t* out)
+{
+    const __m128i r = round_to_int32_sse41<R, Saturate>(_mm_loadu_pd(in));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), r);
+}
+
+// Rounded lanes to int64 by the magic number, by the scalar code if any lane is out of its range
+template <bool Saturate>
+__attribute__((target("sse4.1"))) inline void store_int64_sse41(__m128d x, std::int64_t* out)
+{
+    const __m128d magnitude = _mm_andnot_pd(_mm_set1_pd(-0.0), x);
+    if (_mm_movemask_pd(_mm_cmplt_pd(magnitude, _mm_set1_pd(magic_int64_limit))) == 0x3) {
+        const __m128d magic = _mm_set1_pd(magic_int64);
+        const __m128i r = _mm_sub_epi64(_mm_castpd_si128(_mm_add_pd(x, magic)), _mm_castpd_si128(magic));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), r);
+        return;
+    }
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, x);
+    out[0] = to_integer<std::int64_t, Saturate>(lanes[0]);
+    out[1] = to_integer<std::int64_t, Saturate>(lanes[1]);
+}
+
+template <rounding R, bool Saturate>
+__attribute__((target("sse4.1"))) inline void step_sse41(const double* in, std::int64_t* out)
+{
+    store_int64_sse41<Saturate>(_mm_round_pd(_mm_loadu_pd(in), round_mode<R>), out);
+}
+
+template <rounding R, bool Saturate>
+__attribute__((target("sse4.1"))) inline void step_sse41(const float* in, std::int64_t* out)
+{
+    // float -> double is exact
+    const __m128 x = _mm_loadu_ps(in);
+    store_int64_sse41<Saturate>(_mm_round_pd(_mm_cvtps_pd(x), round_mode<R>), out);
+    store_int64_sse41<Saturate>(_mm_round_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), round_mode<R>), out + 2);
+}
+
+template <typename From, typename To, rounding R, bool Saturate>
+__attribute__((target("sse4.1"))) void convert_sse41(const From* in, size_t count, To* out)
+{
+    constexpr size_t lanes = 16 / sizeof(From);
+    size_t i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        step_sse41<R, Saturate>(in + i, out + i);
+    }
+    convert_scalar<From, To, R, Saturate>(in + i, count - i, out + i);
+}
+
+// AVX2, 32 bytes of input per step
+
+template <rounding R, bool Saturate>
+__attribute__((target("avx2"))) inline void step_avx2(const float* in, std::int32_t* out)
+{
+    const __m256 x = _mm256_round_ps(_mm256_loadu_ps(in), round_mode<R>);
+    __m256i r = _mm256_cvttps_epi32(x);
+    if constexpr (Saturate) {
+        r = _mm256_xor_si256(r, _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_set1_ps(2147483648.0f), _CMP_GE_OQ)));
+        r = _mm256_and_si256(r, _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_ORD_Q)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), r);
+}
+
+template <rounding R, bool Saturate>
+__attribute__((target("avx2"))) inline void step_avx2(const double* in, std::int32_t* out)
+{
+    __m256d x = _mm256_round_pd(_mm256_loadu_pd(in), round_mode<R>);
+    if constexpr (Saturate) {
+        x = _mm256_and_pd(x, _mm256_cmp_pd(x, x, _CMP_ORD_Q));
+        x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-2147483648.0)), _mm256_set1_pd(2147483647.0));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_cvttpd_epi32(x));
+}
+
+template <bool Saturate>
+__attribute__((target("avx2"))) inline void store_int64_avx2(__m256d x, std::int64_t* out)
+{
+    const __m256d magnitude = _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+    if (_mm256_movemask_pd(_mm256_cmp_pd(magnitude, _mm256_set1_pd(magic_int64_limit), _CMP_LT_OQ)) == 0xF) {
+        const __m256d magic = _mm256_set1_pd(magic_int64);
+        const __m256i r = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(x, magic)), _mm256_castpd_si256(magic));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), r);
+        return;
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, x);
+    for (size_t k = 0; k < 4; ++k) {
+        out[k] = to_integer<std::int64_t, Saturate>(lanes[k]);
+    }
+}
+
+template <rounding R, bool Saturate>
+__attribute__((target("avx2"))) inline void step_avx2(const double* in, std::int64_t* out)
+{
+    store_int64_avx2<Saturate>(_mm256_round_pd(_mm256_loadu_pd(in), round_mode<R>), out);
+}
+
+template <rounding R, bool Saturate>
+__attribute__((target("avx2"))) inline void step_avx2(const float* in, std::int64_t* out)
+{
+    const __m256 x = _mm256_loadu_ps(in);
+    store_int64_avx2<Saturate>(_mm256_round_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(x)), round_mode<R>), out);
+    store_int64_avx2<Saturate>(_mm256_round_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), round_mode<R>), out + 4);
+}
+
+template <typename From, typename To, rounding R, bool Saturate>
+__attribute__((target("avx2"))) void convert_avx2(const From* in, size_t count, To* out)
+{
+    constexpr size_t lanes = 32 / sizeof(From);
+    size_t i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        step_avx2<R, Saturate>(in + i, out + i);
+    }
+    convert_scalar<From, To, R, Saturate>(in + i, count - i, out + i);
+}
+
+#endif // CPP_CPU_X86
+
+template <typename From, typename To, rounding R, bool Saturate>
+const auto& convert_kernels()
+{
+    static const cpu::implementation<convert_function<From, To>> kernels[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx2", convert_avx2<From, To, R, Saturate>, {cpu::feature::avx, cpu::feature::avx2}},
+        {"sse4.1", convert_sse41<From, To, R, Saturate>, {cpu::feature::sse41}},
+#endif
+        {"scalar", convert_scalar<From, To, R, Saturate>, {}}};
+    return kernels;
+}
+
+template <typename From, typename To, bool Saturate>
+const auto& convert_kernels(rounding mode)
+{
+    switch (mode) {
+    case rounding::truncate: return convert_kernels<From, To, rounding::truncate, Saturate>();
+    case rounding::floor: return convert_kernels<From, To, rounding::floor, Saturate>();
+    default: return convert_kernels<From, To, rounding::nearest, Saturate>();
+    }
+}
+
+// The first of convert_kernels<From, To, R, Saturate>() this CPU supports, chosen on the first call
+template <typename From, typename To, rounding R, bool Saturate>
+convert_function<From, To> best_convert()
+{
+    static const convert_function<From, To> best = cpu::select(convert_kernels<From, To, R, Saturate>()).function;
+    return best;
+}
+
+template <typename From, typename To, bool Saturate>
+convert_function<From, To> best_convert(rounding mode)
+{
+    switch (mode) {
+    case rounding::truncate: return best_convert<From, To, rounding::truncate, Saturate>();
+    case rounding::floor: return best_convert<From, To, rounding::floor, Saturate>();
+    default: return best_convert<From, To, rounding::nearest, Saturate>();
+    }
+}
+
+} // namespace detail
+
+// Kernels converting `From` (float, double) to `To` (std::int32_t, std::int64_t) with the rounding and overflow
+// policy, from the fastest, those compiled for this platform; cpu::select() picks the first one this CPU supports
+template <typename From, typename To>
+const auto& convert_kernels(rounding mode, overflow policy)
+{
+    static_assert(std::is_same<From, float>::value || std::is_same<From, double>::value, "float or double");
+    static_assert(std::is_same<To, std::int32_t>::value || std::is_same<To, std::int64_t>::value, "int32 or int64");
+    return policy == overflow::saturate ? detail::convert_kernels<From, To, true>(mode)
+                                        : detail::convert_kernels<From, To, false>(mode);
+}
+
+// out[i] = in[i] converted to `To` with the rounding and overflow policy, by the best kernel for this CPU
+template <typename To, typename From>
+void convert(const From* in, size_t count, To* out, rounding mode = rounding::nearest, overflow policy = overflow::saturate)
+{
+    static_assert(std::is_same<From, float>::value || std::is_same<From, double>::value, "float or double");
+    static_assert(std::is_same<To, std::int32_t>::value || std::is_same<To, std::int64_t>::value, "int32 or int64");
+    const convert_function<From, To> best = policy == overflow::saturate ? detail::best_convert<From, To, true>(mode)
+                                                                         : detail::best_convert<From, To, false>(mode);
+    best(in, count, out);
+}
+
+template <typename To, typename From>
+std::vector<To> convert(const std::vector<From>& in, rounding mode = rounding::nearest, overflow policy = overflow::saturate)
+{
+    std::vector<To> out(in.size());
+    convert(in.data(), in.size(), out.data(), mode, policy);
+    return out;
+}
+
+} // namespace fp
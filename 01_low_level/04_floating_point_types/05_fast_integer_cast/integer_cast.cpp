@@ -1,5 +1,8 @@
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <string>
 #include <vector>
 #include <cmath>
 
@@ -11,6 +14,8 @@
 
 #include <utilities/bitwise.h>
 #include <utilities/generate.h>
+#include <utilities/benchmark.h>
+#include "fp_convert.h"
 
 /*
  *  It's important to know this technique is outdated by now.
@@ -241,14 +246,195 @@ void test_fast_ftoi()
 }
 
 
+// Bulk conversion of arrays (fp_convert.h): rounding modes, saturation and SIMD kernels
+void demo_bulk_convert()
+{
+    std::cout << "\nBulk conversion, kernel "
+              << cpu::select(fp::convert_kernels<float, std::int32_t>(fp::rounding::nearest, fp::overflow::saturate)).name << '\n';
+    const std::vector<float> samples = {2.5f, -2.5f, 3.7f, -3.7f, -0.5f, 3e9f, -3e9f, NAN};
+    const fp::rounding modes[] = {fp::rounding::truncate, fp::rounding::nearest, fp::rounding::floor};
+    const char* names[] = {"truncate", "nearest ", "floor   "};
+    for (size_t m = 0; m < 3; ++m) {
+        const std::vector<std::int32_t> ints = fp::convert<std::int32_t>(samples, modes[m]);
+        std::cout << names[m] << ':';
+        for (std::int32_t i : ints) {
+            std::cout << ' ' << i;
+        }
+        std::cout << '\n';
+    }
+}
+
+// Values around rounding ties and integer limits, where the kernels may differ
+template <typename From>
+std::vector<From> edge_values()
+{
+    std::vector<From> values = {0.0, -0.0, 0.5, -0.5, 1.5, -1.5, 2.5, -2.5, 0.49999997, -1.0000001,
+                                2147483647.0, 2147483648.0, -2147483648.0, -2147483649.0, 4294967296.0,
+                                2251799813685247.0, 2251799813685248.0, -2251799813685249.0,
+                                9223372036854775807.0, -9223372036854775808.0, 1e30, -1e30,
+                                std::numeric_limits<From>::denorm_min(), std::numeric_limits<From>::infinity(),
+                                -std::numeric_limits<From>::infinity(), std::numeric_limits<From>::quiet_NaN()};
+    RandomReal<From> rr(5);
+    for (From scale : {From(10), From(1e6), From(1e10), From(1e17)}) {
+        const std::vector<From> r = rr.generate(-scale, scale, 1000);
+        values.insert(values.end(), r.begin(), r.end());
+    }
+    return values;
+}
+
+template <typename From, typename To>
+bool check_kernels()
+{
+    const std::vector<From> values = edge_values<From>();
+    std::vector<To> expected(values.size()), out(values.size());
+    bool ok = true;
+    for (fp::rounding mode : {fp::rounding::truncate, fp::rounding::nearest, fp::rounding::floor}) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            // long double holds all these values and both integer types
+            const long double x = values[i];
+            const long double r = mode == fp::rounding::truncate ? std::trunc(x)
+                                : mode == fp::rounding::floor    ? std::floor(x)
+                                                                 : std::nearbyint(x);
+            const long double lo = std::numeric_limits<To>::min(), hi = std::numeric_limits<To>::max();
+            expected[i] = x != x ? 0 : r <= lo ? std::numeric_limits<To>::min() : r >= hi ? std::numeric_limits<To>::max() : static_cast<To>(r);
+        }
+        for (const auto& k : fp::convert_kernels<From, To>(mode, fp::overflow::saturate)) {
+            if (!cpu::detected().contains(k.required)) {
+                continue;
+            }
+            // every offset, so all values pass through vector steps and scalar tails
+            for (size_t first = 0; first < 8; ++first) {
+                k.function(values.data() + first, values.size() - first, out.data());
+                ok = ok && std::equal(out.begin(), out.end() - first, expected.begin() + first);
+            }
+        }
+    }
+    return ok;
+}
+
+void check_bulk_convert()
+{
+    std::cout << "float -> int32 kernels match? " << check_kernels<float, std::int32_t>() << '\n';
+    std::cout << "double -> int32 kernels match? " << check_kernels<double, std::int32_t>() << '\n';
+    std::cout << "float -> int64 kernels match? " << check_kernels<float, std::int64_t>() << '\n';
+    std::cout << "double -> int64 kernels match? " << check_kernels<double, std::int64_t>() << '\n';
+}
+
+// Bulk kernels of all supported kinds for one rounding mode
+template <typename From, typename To>
+void run_kernels(bench::suite& s, const std::vector<From>& in, std::vector<To>& out, fp::rounding mode, const char* mode_name)
+{
+    for (fp::overflow policy : {fp::overflow::saturate, fp::overflow::unchecked}) {
+        for (const auto& k : fp::convert_kernels<From, To>(mode, policy)) {
+            if (!cpu::detected().contains(k.required)) {
+                continue;
+            }
+            const std::string name = std::string("fp::convert ") + mode_name + ", " + k.name +
+                                     (policy == fp::overflow::saturate ? ", saturate" : ", unchecked");
+            s.run(name, [&] {
+                k.function(in.data(), in.size(), out.data());
+                bench::clobber_memory();
+            }, in.size());
+        }
+    }
+}
+
 void benchmark()
 {
-    RandomReal<double> rr;
-    std::vector<double> randoms = rr.generate(0.0, 10.0, 1000000);
+    RandomReal<double> rr(1);
+    std::vector<double> randoms = rr.generate(-1000000.0, 1000000.0, 1000000);
+    std::vector<float> randoms_f(randoms.begin(), randoms.end());
+    std::vector<std::int32_t> ints(randoms.size());
+    std::vector<std::int64_t> longs(randoms.size());
+    bench::options opts;
+    opts.repetitions = 9;
+
+    {
+        bench::suite s("float -> int32", opts);
+        s.run("static_cast (truncate)", [&] {
+            for (size_t i = 0; i < randoms_f.size(); ++i) {
+                ints[i] = static_cast<std::int32_t>(randoms_f[i]);
+            }
+            bench::clobber_memory();
+        }, randoms_f.size());
+        s.run("std::lrint (nearest)", [&] {
+            for (size_t i = 0; i < randoms_f.size(); ++i) {
+                ints[i] = static_cast<std::int32_t>(std::lrint(randoms_f[i]));
+            }
+            bench::clobber_memory();
+        }, randoms_f.size());
+        s.run("std::floor + static_cast", [&] {
+            for (size_t i = 0; i < randoms_f.size(); ++i) {
+                ints[i] = static_cast<std::int32_t>(std::floor(randoms_f[i]));
+            }
+            bench::clobber_memory();
+        }, randoms_f.size());
+        s.run("fast_ftoi magic number (nearest)", [&] {
+            for (size_t i = 0; i < randoms_f.size(); ++i) {
+                ints[i] = fast_ftoi(randoms_f[i]);
+            }
+            bench::clobber_memory();
+        }, randoms_f.size());
+        run_kernels(s, randoms_f, ints, fp::rounding::truncate, "truncate");
+        run_kernels(s, randoms_f, ints, fp::rounding::nearest, "nearest");
+        run_kernels(s, randoms_f, ints, fp::rounding::floor, "floor");
+        s.report(std::cout);
+    }
+    {
+        bench::suite s("double -> int32", opts);
+        s.run("static_cast (truncate)", [&] {
+            for (size_t i = 0; i < randoms.size(); ++i) {
+                ints[i] = static_cast<std::int32_t>(randoms[i]);
+            }
+            bench::clobber_memory();
+        }, randoms.size());
+        s.run("std::lrint (nearest)", [&] {
+            for (size_t i = 0; i < randoms.size(); ++i) {
+                ints[i] = static_cast<std::int32_t>(std::lrint(randoms[i]));
+            }
+            bench::clobber_memory();
+        }, randoms.size());
+        run_kernels(s, randoms, ints, fp::rounding::truncate, "truncate");
+        run_kernels(s, randoms, ints, fp::rounding::nearest, "nearest");
+        s.report(std::cout);
+    }
+    {
+        bench::suite s("double -> int64", opts);
+        s.run("static_cast (truncate)", [&] {
+            for (size_t i = 0; i < randoms.size(); ++i) {
+                longs[i] = static_cast<std::int64_t>(randoms[i]);
+            }
+            bench::clobber_memory();
+        }, randoms.size());
+        s.run("std::llrint (nearest)", [&] {
+            for (size_t i = 0; i < randoms.size(); ++i) {
+                longs[i] = std::llrint(randoms[i]);
+            }
+            bench::clobber_memory();
+        }, randoms.size());
+        s.run("fast_dtoll magic number (nearest)", [&] {
+            for (size_t i = 0; i < randoms.size(); ++i) {
+                longs[i] = fast_dtoll(randoms[i]);
+            }
+            bench::clobber_memory();
+        }, randoms.size());
+        s.run("fast_fpconvert<double> (nearest)", [&] {
+            for (size_t i = 0; i < randoms.size(); ++i) {
+                longs[i] = fast_fpconvert(randoms[i]);
+            }
+            bench::clobber_memory();
+        }, randoms.size());
+        run_kernels(s, randoms, longs, fp::rounding::truncate, "truncate");
+        run_kernels(s, randoms, longs, fp::rounding::nearest, "nearest");
+        s.report(std::cout);
+    }
 }
 
 int main()
 {
     classic_ftol();
+    demo_bulk_convert();
+    check_bulk_convert();
+    benchmark();
     return 0;
 }
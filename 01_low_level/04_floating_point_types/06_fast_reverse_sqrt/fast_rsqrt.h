@@ -0,0 +1,411 @@
+#pragma once
+/*
+fast_rsqrt.h
+Batched 1/sqrt(x), sqrt(x) and 1/x over float arrays with selectable accuracy, and normalization
+of 3D vectors stored as separate x, y, z arrays.
+
+Accuracy, from the fastest:
+  - estimate: hardware RSQRTPS/RCPPS, about 12 bits (relative error < 1.5 * 2^-12)
+  - newton1:  the estimate and one Newton-Raphson step, about 22 bits
+  - newton2:  two steps, close to float precision
+  - magic:    the integer "magic constant" guess of reverse_sqrt() (0x5f3759df, for 1/x 0x7ef311c3)
+              and one Newton step, about 0.2%
+  - exact:    1/std::sqrt(x), std::sqrt(x), 1/x; DIVPS and SQRTPS are correctly rounded
+Newton steps for y ~ 1/sqrt(x): y' = y * (1.5 - 0.5 * x * y * y); for y ~ 1/x: y' = y * (2 - x * y).
+
+Kernels:
+  - portable: scalar; without hardware estimates, estimate/newton1/newton2 start from the magic constant
+  - sse:      4 floats per instruction, the x86-64 baseline
+  - avx2:     8 floats per instruction, Newton steps by FMA
+The estimates are implementation-specific: Intel and AMD return different values, both within the bound.
+Inputs are positive finite floats; sqrt(0) is 0, other results for 0, infinity and NaN are unspecified
+for approximate variants. The best kernel is chosen at run time (utilities/cpu_features.h).
+*/
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <utilities/cpu_features.h>
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+namespace fp
+{
+
+enum class accuracy
+{
+    estimate,
+    newton1,
+    newton2,
+    magic,
+    exact
+};
+
+inline const char* accuracy_name(accuracy a)
+{
+    switch (a) {
+    case accuracy::estimate: return "estimate";
+    case accuracy::newton1: return "estimate + 1 Newton step";
+    case accuracy::newton2: return "estimate + 2 Newton steps";
+    case accuracy::magic: return "magic constant + 1 Newton step";
+    case accuracy::exact: return "exact";
+    }
+    return "";
+}
+
+enum class approx_op
+{
+    rsqrt,
+    sqrt,
+    reciprocal
+};
+
+// out[i] = op(in[i])
+using approx_function = void (*)(const float* in, size_t count, float* out);
+
+// (x[i], y[i], z[i]) /= length, in place
+using normalize_function = void (*)(float* x, float* y, float* z, size_t count);
+
+namespace detail
+{
+
+constexpr std::uint32_t rsqrt_magic = 0x5f3759df;
+constexpr std::uint32_t reciprocal_magic = 0x7ef311c3;
+
+constexpr int newton_steps(accuracy a)
+{
+    return a == accuracy::newton2 ? 2 : a == accuracy::newton1 || a == accuracy::magic ? 1 : 0;
+}
+
+inline float magic_guess(float x, std::uint32_t magic, int shift)
+{
+    std::uint32_t i;
+    std::memcpy(&i, &x, sizeof(i));
+    i = magic - (i >> shift);
+    std::memcpy(&x, &i, sizeof(i));
+    return x;
+}
+
+template <approx_op Op, accuracy A>
+float approx_portable(float x)
+{
+    if constexpr (A == accuracy::exact) {
+        return Op == approx_op::rsqrt ? 1.0f / std::sqrt(x) : Op == approx_op::sqrt ? std::sqrt(x) : 1.0f / x;
+    }
+    else if constexpr (Op == approx_op::reciprocal) {
+        float y = magic_guess(x, reciprocal_magic, 0);
+        for (int i = 0; i < newton_steps(A); ++i) {
+            y = y * (2.0f - x * y);
+        }
+        return y;
+    }
+    else {
+        float y = magic_guess(x, rsqrt_magic, 1);
+        for (int i = 0; i < newton_steps(A); ++i) {
+            y = y * (1.5f - 0.5f * x * y * y);
+        }
+        return Op == approx_op::rsqrt ? y : x * y;
+    }
+}
+
+template <approx_op Op, accuracy A>
+void approx_portable(const float* in, size_t count, float* out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = approx_portable<Op, A>(in[i]);
+    }
+}
+
+template <accuracy A>
+void normalize_portable(float* x, float* y, float* z, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const float r = approx_portable<approx_op::rsqrt, A>(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        x[i] *= r;
+        y[i] *= r;
+        z[i] *= r;
+    }
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+template <approx_op Op, accuracy A>
+__attribute__((target("sse2"))) inline __m128 approx_sse(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    if constexpr (A == accuracy::exact) {
+        return Op == approx_op::rsqrt ? _mm_div_ps(one, _mm_sqrt_ps(x))
+             : Op == approx_op::sqrt  ? _mm_sqrt_ps(x)
+                                      : _mm_div_ps(one, x);
+    }
+    else if constexpr (Op == approx_op::reciprocal) {
+        __m128 y = A == accuracy::magic
+                       ? _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(reciprocal_magic), _mm_castps_si128(x)))
+                       : _mm_rcp_ps(x);
+        for (int i = 0; i < newton_steps(A); ++i) {
+            y = _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(2.0f), _mm_mul_ps(x, y)));
+        }
+        return y;
+    }
+    else {
+        __m128 y = A == accuracy::magic
+                       ? _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(rsqrt_magic), _mm_srli_epi32(_mm_castps_si128(x), 1)))
+                       : _mm_rsqrt_ps(x);
+        const __m128 half_x = _mm_mul_ps(_mm_set1_ps(0.5f), x);
+        for (int i = 0; i < newton_steps(A); ++i) {
+            y = _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(half_x, _mm_mul_ps(y, y))));
+        }
+        if constexpr (Op == approx_op::rsqrt) {
+            return y;
+        }
+        // x * (1/sqrt(x)) is 0 * inf for 0
+        return _mm_and_ps(_mm_mul_ps(x, y), _mm_cmpneq_ps(x, _mm_setzero_ps()));
+    }
+}
+
+template <approx_op Op, accuracy A>
+__attribute__((target("sse2"))) void approx_sse(const float* in, size_t count, float* out)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(out + i, approx_sse<Op, A>(_mm_loadu_ps(in + i)));
+    }
+    if (i < count) {
+        // the tail through a padded vector, so it has the same accuracy
+        float tail[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        std::memcpy(tail, in + i, (count - i) * sizeof(float));
+        _mm_storeu_ps(tail, approx_sse<Op, A>(_mm_loadu_ps(tail)));
+        std::memcpy(out + i, tail, (count - i) * sizeof(float));
+    }
+}
+
+template <accuracy A>
+__attribute__((target("sse2"))) void normalize_sse(float* x, float* y, float* z, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        const __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+        const __m128 r = approx_sse<approx_op::rsqrt, A>(length2);
+        _mm_storeu_ps(x + i, _mm_mul_ps(vx, r));
+        _mm_storeu_ps(y + i, _mm_mul_ps(vy, r));
+        _mm_storeu_ps(z + i, _mm_mul_ps(vz, r));
+    }
+    if (i < count) {
+        float tx[4] = {}, ty[4] = {}, tz[4] = {};
+        const size_t rest = (count - i) * sizeof(float);
+        std::memcpy(tx, x + i, rest);
+        std::memcpy(ty, y + i, rest);
+        std::memcpy(tz, z + i, rest);
+        normalize_sse<A>(tx, ty, tz, 4);
+        std::memcpy(x + i, tx, rest);
+        std::memcpy(y + i, ty, rest);
+        std::memcpy(z + i, tz, rest);
+    }
+}
+
+template <approx_op Op, accuracy A>
+__attribute__((target("avx2,fma"))) inline __m256 approx_avx2(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    if constexpr (A == accuracy::exact) {
+        return Op == approx_op::rsqrt ? _mm256_div_ps(one, _mm256_sqrt_ps(x))
+             : Op == approx_op::sqrt  ? _mm256_sqrt_ps(x)
+                                      : _mm256_div_ps(one, x);
+    }
+    else if constexpr (Op == approx_op::reciprocal) {
+        __m256 y = A == accuracy::magic
+                       ? _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(reciprocal_magic), _mm256_castps_si256(x)))
+                       : _mm256_rcp_ps(x);
+        for (int i = 0; i < newton_steps(A); ++i) {
+            // y + y * (1 - x * y)
+            y = _mm256_fmadd_ps(y, _mm256_fnmadd_ps(x, y, one), y);
+        }
+        return y;
+    }
+    else {
+        __m256 y = A == accuracy::magic
+                       ? _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(rsqrt_magic), _mm256_srli_epi32(_mm256_castps_si256(x), 1)))
+                       : _mm256_rsqrt_ps(x);
+        const __m256 half_x = _mm256_mul_ps(_mm256_set1_ps(0.5f), x);
+        for (int i = 0; i < newton_steps(A); ++i) {
+            // y * (1.5 - half_x * y * y)
+            y = _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(half_x, y), y, _mm256_set1_ps(1.5f)));
+        }
+        if constexpr (Op == approx_op::rsqrt) {
+            return y;
+        }
+        return _mm256_and_ps(_mm256_mul_ps(x, y), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+    }
+}
+
+template <approx_op Op, accuracy A>
+__attribute__((target("avx2,fma"))) void approx_avx2(const float* in, size_t count, float* out)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(out + i, approx_avx2<Op, A>(_mm256_loadu_ps(in + i)));
+    }
+    if (i < count) {
+        // the tail through a padded vector, so it has the same accuracy
+        float tail[8] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+        std::memcpy(tail, in + i, (count - i) * sizeof(float));
+        _mm256_storeu_ps(tail, approx_avx2<Op, A>(_mm256_loadu_ps(tail)));
+        std::memcpy(out + i, tail, (count - i) * sizeof(float));
+    }
+}
+
+template <accuracy A>
+__attribute__((target("avx2,fma"))) void normalize_avx2(float* x, float* y, float* z, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+        const __m256 length2 = _mm256_fmadd_ps(vz, vz, _mm256_fmadd_ps(vy, vy, _mm256_mul_ps(vx, vx)));
+        const __m256 r = approx_avx2<approx_op::rsqrt, A>(length2);
+        _mm256_storeu_ps(x + i, _mm256_mul_ps(vx, r));
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(vy, r));
+        _mm256_storeu_ps(z + i, _mm256_mul_ps(vz, r));
+    }
+    if (i < count) {
+        float tx[8] = {}, ty[8] = {}, tz[8] = {};
+        const size_t rest = (count - i) * sizeof(float);
+        std::memcpy(tx, x + i, rest);
+        std::memcpy(ty, y + i, rest);
+        std::memcpy(tz, z + i, rest);
+        normalize_avx2<A>(tx, ty, tz, 8);
+        std::memcpy(x + i, tx, rest);
+        std::memcpy(y + i, ty, rest);
+        std::memcpy(z + i, tz, rest);
+    }
+}
+
+#endif // CPP_CPU_X86
+
+template <approx_op Op, accuracy A>
+const auto& approx_kernels()
+{
+    static const cpu::implementation<approx_function> kernels[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx2", approx_avx2<Op, A>, {cpu::feature::avx, cpu::feature::avx2, cpu::feature::fma}},
+        {"sse", approx_sse<Op, A>, {cpu::feature::sse2}},
+#endif
+        {"portable", approx_portable<Op, A>, {}}};
+    return kernels;
+}
+
+template <accuracy A>
+const auto& normalize_kernels()
+{
+    static const cpu::implementation<normalize_function> kernels[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx2", normalize_avx2<A>, {cpu::feature::avx, cpu::feature::avx2, cpu::feature::fma}},
+        {"sse", normalize_sse<A>, {cpu::feature::sse2}},
+#endif
+        {"portable", normalize_portable<A>, {}}};
+    return kernels;
+}
+
+template <approx_op Op>
+const auto& approx_kernels(accuracy a)
+{
+    switch (a) {
+    case accuracy::estimate: return approx_kernels<Op, accuracy::estimate>();
+    case accuracy::newton1: return approx_kernels<Op, accuracy::newton1>();
+    case accuracy::newton2: return approx_kernels<Op, accuracy::newton2>();
+    case accuracy::magic: return approx_kernels<Op, accuracy::magic>();
+    default: return approx_kernels<Op, accuracy::exact>();
+    }
+}
+
+// The first kernel this CPU supports, chosen on the first call for each operation and accuracy
+template <approx_op Op, accuracy A>
+approx_function best_approx()
+{
+    static const approx_function best = cpu::select(approx_kernels<Op, A>()).function;
+    return best;
+}
+
+template <approx_op Op>
+approx_function best_approx(accuracy a)
+{
+    switch (a) {
+    case accuracy::estimate: return best_approx<Op, accuracy::estimate>();
+    case accuracy::newton1: return best_approx<Op, accuracy::newton1>();
+    case accuracy::newton2: return best_approx<Op, accuracy::newton2>();
+    case accuracy::magic: return best_approx<Op, accuracy::magic>();
+    default: return best_approx<Op, accuracy::exact>();
+    }
+}
+
+template <accuracy A>
+normalize_function best_normalize()
+{
+    static const normalize_function best = cpu::select(normalize_kernels<A>()).function;
+    return best;
+}
+
+inline normalize_function best_normalize(accuracy a)
+{
+    switch (a) {
+    case accuracy::estimate: return best_normalize<accuracy::estimate>();
+    case accuracy::newton1: return best_normalize<accuracy::newton1>();
+    case accuracy::newton2: return best_normalize<accuracy::newton2>();
+    case accuracy::magic: return best_normalize<accuracy::magic>();
+    default: return best_normalize<accuracy::exact>();
+    }
+}
+
+} // namespace detail
+
+// Kernels of the operation with the accuracy from the fastest, those compiled for this platform,
+// in the same order for all operations; cpu::select() picks the first one this CPU supports
+inline const auto& approx_kernels(approx_op op, accuracy a)
+{
+    switch (op) {
+    case approx_op::rsqrt: return detail::approx_kernels<approx_op::rsqrt>(a);
+    case approx_op::sqrt: return detail::approx_kernels<approx_op::sqrt>(a);
+    default: return detail::approx_kernels<approx_op::reciprocal>(a);
+    }
+}
+
+inline const auto& normalize_kernels(accuracy a)
+{
+    switch (a) {
+    case accuracy::estimate: return detail::normalize_kernels<accuracy::estimate>();
+    case accuracy::newton1: return detail::normalize_kernels<accuracy::newton1>();
+    case accuracy::newton2: return detail::normalize_kernels<accuracy::newton2>();
+    case accuracy::magic: return detail::normalize_kernels<accuracy::magic>();
+    default: return detail::normalize_kernels<accuracy::exact>();
+    }
+}
+
+// out[i] = 1 / sqrt(in[i])
+inline void rsqrt(const float* in, size_t count, float* out, accuracy a = accuracy::newton1)
+{
+    detail::best_approx<approx_op::rsqrt>(a)(in, count, out);
+}
+
+// out[i] = sqrt(in[i])
+inline void sqrt(const float* in, size_t count, float* out, accuracy a = accuracy::newton1)
+{
+    detail::best_approx<approx_op::sqrt>(a)(in, count, out);
+}
+
+// out[i] = 1 / in[i]
+inline void reciprocal(const float* in, size_t count, float* out, accuracy a = accuracy::newton1)
+{
+    detail::best_approx<approx_op::reciprocal>(a)(in, count, out);
+}
+
+// Scale vectors (x[i], y[i], z[i]) to the unit length
+inline void normalize(float* x, float* y, float* z, size_t count, accuracy a = accuracy::newton1)
+{
+    detail::best_normalize(a)(x, y, z, count);
+}
+
+} // namespace fp
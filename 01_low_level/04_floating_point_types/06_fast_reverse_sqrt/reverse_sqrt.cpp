@@ -1,17 +1,22 @@
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <iostream>
+#include <string>
 #include <vector>
 #include <iomanip>
+#include <iterator>
 #include <bitset>
 #include <cmath>
 
 // OsX workaround
 #include <cfloat>
 #include <cstdint>
+#include <cstring>
 
 #include <utilities/bitwise.h>
 #include <utilities/generate.h>
-#include <utilities/elapsed.h>
+#include <utilities/benchmark.h>
+#include "fast_rsqrt.h"
 
 
 // http://en.wikipedia.org/wiki/Fast_inverse_square_root
@@ -36,22 +41,163 @@ float reverse_sqrt(float number)
 }
 
 
+const fp::accuracy all_accuracies[] = {fp::accuracy::estimate, fp::accuracy::newton1, fp::accuracy::newton2,
+                                       fp::accuracy::magic, fp::accuracy::exact};
+
+// Max relative error of every kernel and accuracy, over all floats in [1, 4):
+// errors repeat for every pair of binades, so it's the max over all normal inputs
+void measure_accuracy()
+{
+    const size_t chunk = 1 << 16;
+    const fp::approx_op ops[] = {fp::approx_op::rsqrt, fp::approx_op::sqrt, fp::approx_op::reciprocal};
+    double max_error[3][3][5] = {};
+    double reverse_sqrt_error = 0;
+
+    std::vector<float> in(chunk), out(chunk);
+    std::vector<double> expected(chunk);
+    uint32_t first_bits = 0, last_bits = 0;
+    const float first = 1.0F, last = 4.0F;
+    std::memcpy(&first_bits, &first, sizeof(first));
+    std::memcpy(&last_bits, &last, sizeof(last));
+
+    for (uint32_t bits = first_bits; bits < last_bits; bits += chunk) {
+        for (size_t i = 0; i < chunk; ++i) {
+            const uint32_t b = bits + static_cast<uint32_t>(i);
+            std::memcpy(&in[i], &b, sizeof(b));
+        }
+        for (size_t o = 0; o < 3; ++o) {
+            for (size_t i = 0; i < chunk; ++i) {
+                const double x = in[i];
+                expected[i] = ops[o] == fp::approx_op::rsqrt ? 1.0 / std::sqrt(x) : ops[o] == fp::approx_op::sqrt ? std::sqrt(x) : 1.0 / x;
+            }
+            for (size_t a = 0; a < 5; ++a) {
+                const auto& kernels = fp::approx_kernels(ops[o], all_accuracies[a]);
+                for (size_t k = 0; k < std::size(kernels); ++k) {
+                    if (!cpu::detected().contains(kernels[k].required)) {
+                        continue;
+                    }
+                    kernels[k].function(in.data(), chunk, out.data());
+                    for (size_t i = 0; i < chunk; ++i) {
+                        max_error[o][k][a] = std::max(max_error[o][k][a], std::fabs(out[i] - expected[i]) / expected[i]);
+                    }
+                }
+            }
+            if (ops[o] == fp::approx_op::rsqrt) {
+                for (size_t i = 0; i < chunk; ++i) {
+                    reverse_sqrt_error = std::max(reverse_sqrt_error, std::fabs(reverse_sqrt(in[i]) - expected[i]) / expected[i]);
+                }
+            }
+        }
+    }
+
+    // as relative error and correct bits
+    auto print = [](double e) {
+        std::cout << std::setw(11) << std::setprecision(3) << std::scientific << e << std::defaultfloat
+                  << " (" << std::setw(4) << std::fixed << std::setprecision(1) << -std::log2(e) << std::defaultfloat << ")";
+    };
+    std::cout << "Max relative error (correct bits) over [1, 4)\n";
+    for (size_t o = 0; o < 3; ++o) {
+        std::cout << (o == 0 ? "1/sqrt(x)" : o == 1 ? "sqrt(x)" : "1/x") << '\n';
+        for (size_t a = 0; a < 5; ++a) {
+            std::cout << "  " << std::left << std::setw(32) << fp::accuracy_name(all_accuracies[a]) << std::right;
+            const auto& kernels = fp::approx_kernels(ops[o], all_accuracies[a]);
+            for (size_t k = 0; k < std::size(kernels); ++k) {
+                if (cpu::detected().contains(kernels[k].required)) {
+                    std::cout << "  " << kernels[k].name << ' ';
+                    print(max_error[o][k][a]);
+                }
+            }
+            std::cout << '\n';
+        }
+    }
+    std::cout << "reverse_sqrt(): ";
+    print(reverse_sqrt_error);
+    std::cout << "\n\n";
+}
+
 void benchmark()
 {
-    RandomReal<double> random_real;
-    std::vector<double> randoms;
-    MeasureTime t;
-    randoms = random_real.generate(0.0, 10.0, 10000);
-    long long elapsed = t.elapsed_mcsec();
-    std::cout << "Elapsed time: Create "
-        << randoms.size() << " elements in "
-        << elapsed << " microseconds" << std::endl;
+    RandomReal<float> random_real;
+    std::vector<float> randoms = random_real.generate(0.1F, 100.0F, 100000);
+    std::vector<float> results(randoms.size());
+
+    {
+        bench::suite s("1/sqrt(x)");
+        s.run("1 / std::sqrt", [&] {
+            for (size_t i = 0; i < randoms.size(); ++i) {
+                results[i] = 1.0F / std::sqrt(randoms[i]);
+            }
+            bench::clobber_memory();
+        }, randoms.size());
+        s.run("reverse_sqrt", [&] {
+            for (size_t i = 0; i < randoms.size(); ++i) {
+                results[i] = reverse_sqrt(randoms[i]);
+            }
+            bench::clobber_memory();
+        }, randoms.size());
+        for (fp::accuracy a : all_accuracies) {
+            for (const auto& k : fp::approx_kernels(fp::approx_op::rsqrt, a)) {
+                if (!cpu::detected().contains(k.required)) {
+                    continue;
+                }
+                s.run(std::string(k.name) + ", " + fp::accuracy_name(a), [&] {
+                    k.function(randoms.data(), randoms.size(), results.data());
+                    bench::clobber_memory();
+                }, randoms.size());
+            }
+        }
+        s.report(std::cout);
+    }
+
+    for (fp::approx_op op : {fp::approx_op::sqrt, fp::approx_op::reciprocal}) {
+        bench::suite s(op == fp::approx_op::sqrt ? "sqrt(x)" : "1/x");
+        for (fp::accuracy a : all_accuracies) {
+            for (const auto& k : fp::approx_kernels(op, a)) {
+                if (!cpu::detected().contains(k.required)) {
+                    continue;
+                }
+                s.run(std::string(k.name) + ", " + fp::accuracy_name(a), [&] {
+                    k.function(randoms.data(), randoms.size(), results.data());
+                    bench::clobber_memory();
+                }, randoms.size());
+            }
+        }
+        s.report(std::cout);
+    }
+
+    // Normalization of 3D vectors in x, y, z arrays
+    const size_t n = randoms.size() / 3;
+    std::vector<float> x(randoms.begin(), randoms.begin() + n), y(randoms.begin() + n, randoms.begin() + 2 * n),
+        z(randoms.begin() + 2 * n, randoms.begin() + 3 * n);
+    std::vector<float> nx(n), ny(n), nz(n);
+    bench::suite s("normalize 3D vectors");
+    for (fp::accuracy a : {fp::accuracy::estimate, fp::accuracy::newton1, fp::accuracy::exact}) {
+        for (const auto& k : fp::normalize_kernels(a)) {
+            if (!cpu::detected().contains(k.required)) {
+                continue;
+            }
+            double max_error = 0;
+            s.run(std::string(k.name) + ", " + fp::accuracy_name(a), [&] {
+                std::copy(x.begin(), x.end(), nx.begin());
+                std::copy(y.begin(), y.end(), ny.begin());
+                std::copy(z.begin(), z.end(), nz.begin());
+                k.function(nx.data(), ny.data(), nz.data(), n);
+                bench::clobber_memory();
+            }, n);
+            for (size_t i = 0; i < n; ++i) {
+                const double length = std::sqrt(double(nx[i]) * nx[i] + double(ny[i]) * ny[i] + double(nz[i]) * nz[i]);
+                max_error = std::max(max_error, std::fabs(length - 1.0));
+            }
+            std::cout << "normalize " << k.name << ", " << fp::accuracy_name(a) << ": max |length - 1| = " << max_error << '\n';
+        }
+    }
+    s.report(std::cout);
 }
 
 int main(int argc, char* argv[])
 {
     if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <function>\n";
+        std::cerr << "Usage: " << argv[0] << " reverse_sqrt|accuracy|benchmark\n";
         return 1;
     }
     std::string func = argv[1];
@@ -62,7 +208,11 @@ int main(int argc, char* argv[])
         float rev = reverse_sqrt(4.0);
         std::cout << "1/sqrt(4) = " << rev << '\n';
     }
+    else if (func == "accuracy") {
+        measure_accuracy();
+    }
     else if (func == "benchmark") {
+        measure_accuracy();
         benchmark();
     }
     else {
@@ -0,0 +1,431 @@
+#pragma once
+/*
+reduce.h
+Floating-point sums and dot products, more precise and faster than std::accumulate()
+
+std::accumulate() adds the elements one by one into a single accumulator:
+* the error bound grows as n * eps * sum(|x|): a float sum of 2^25 ones stops at 16777216
+* every addition waits for the previous one (4 cycles latency), most of the FPU is idle
+
+Methods:
+* naive: the std::accumulate() order
+* unrolled: 8 independent accumulators summed at the end, same error bound but no dependency stall
+* pairwise: sum halves recursively down to blocks of 128 (unrolled), the error grows as log2(n) * eps
+* kahan: carry the lost low part of each addition into the next one, the error is ~2 eps regardless of n
+* neumaier: Kahan which also works when the added value is larger than the sum (values of mixed signs)
+
+Dot products use the same methods over a[i] * b[i]; neumaier also adds the rounding error of each product,
+fma(a, b, -a * b) (Ogita, Rump, Oishi "Dot2"), which is as accurate as computing in twice the precision.
+
+Kernels are scalar and AVX2+FMA; parallel_sum()/parallel_dot() split the array between threads.
+Compensated methods need strict IEEE evaluation, -ffast-math removes (t - s) - y as zero
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <utilities/cpu_features.h>
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+namespace fp
+{
+
+enum class summation
+{
+    naive,
+    unrolled,
+    pairwise,
+    kahan,
+    neumaier
+};
+
+inline const char* summation_name(summation m)
+{
+    switch (m) {
+    case summation::naive: return "naive";
+    case summation::unrolled: return "unrolled";
+    case summation::pairwise: return "pairwise";
+    case summation::kahan: return "kahan";
+    case summation::neumaier: return "neumaier";
+    }
+    return "";
+}
+
+namespace detail
+{
+
+constexpr size_t pairwise_block = 128;
+
+// Neumaier: sum + c keeps the low bits lost by sum
+template <typename T>
+struct compensated
+{
+    T sum = 0;
+    T c = 0;
+
+    void add(T x)
+    {
+        const T t = sum + x;
+        c += std::fabs(sum) >= std::fabs(x) ? (sum - t) + x : (x - t) + sum;
+        sum = t;
+    }
+
+    T value() const { return sum + c; }
+};
+
+// Kahan: c is the negated low part of the last addition, subtracted from the next one
+template <typename T>
+struct kahan
+{
+    T sum = 0;
+    T c = 0;
+
+    void add(T x)
+    {
+        const T y = x - c;
+        const T t = sum + y;
+        c = (t - sum) - y;
+        sum = t;
+    }
+
+    T value() const { return sum; }
+};
+
+// Elements of a sum, or products of a dot product; b is nullptr for a sum
+template <typename T>
+struct terms
+{
+    const T* a;
+    const T* b;
+
+    T operator()(size_t i) const { return b ? a[i] * b[i] : a[i]; }
+};
+
+template <typename T>
+T naive_scalar(terms<T> x, size_t first, size_t last)
+{
+    T s = 0;
+    for (size_t i = first; i < last; ++i) {
+        s += x(i);
+    }
+    return s;
+}
+
+template <typename T>
+T unrolled_scalar(terms<T> x, size_t first, size_t last)
+{
+    T acc[8] = {};
+    size_t i = first;
+    for (; i + 8 <= last; i += 8) {
+        for (size_t k = 0; k < 8; ++k) {
+            acc[k] += x(i + k);
+        }
+    }
+    T tail = 0;
+    for (; i < last; ++i) {
+        tail += x(i);
+    }
+    return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7])) + tail;
+}
+
+template <typename T, typename Block>
+T pairwise(Block block, size_t first, size_t last)
+{
+    if (last - first <= pairwise_block) {
+        return block(first, last);
+    }
+    // split at a multiple of the block, so the blocks stay whole
+    const size_t middle = first + (last - first) / 2 / pairwise_block * pairwise_block;
+    return pairwise<T>(block, first, std::max(middle, first + pairwise_block)) +
+           pairwise<T>(block, std::max(middle, first + pairwise_block), last);
+}
+
+template <typename T>
+T kahan_scalar(terms<T> x, size_t first, size_t last)
+{
+    kahan<T> acc;
+    for (size_t i = first; i < last; ++i) {
+        acc.add(x(i));
+    }
+    return acc.value();
+}
+
+template <typename T>
+T neumaier_scalar(terms<T> x, size_t first, size_t last)
+{
+    compensated<T> acc;
+    for (size_t i = first; i < last; ++i) {
+        if (x.b) {
+            const T p = x.a[i] * x.b[i];
+            acc.add(p);
+            acc.c += std::fma(x.a[i], x.b[i], -p);
+        }
+        else {
+            acc.add(x.a[i]);
+        }
+    }
+    return acc.value();
+}
+
+template <typename T>
+T reduce_scalar(terms<T> x, size_t n, summation m)
+{
+    switch (m) {
+    case summation::naive: return naive_scalar(x, 0, n);
+    case summation::unrolled: return unrolled_scalar(x, 0, n);
+    case summation::pairwise:
+        return pairwise<T>([x](size_t first, size_t last) { return unrolled_scalar(x, first, last); }, 0, n);
+    case summation::kahan: return kahan_scalar(x, 0, n);
+    case summation::neumaier: return neumaier_scalar(x, 0, n);
+    }
+    return 0;
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+// 4 doubles or 8 floats, so the AVX2 kernels are written once
+struct avx2_double
+{
+    using fp = double;
+    using vec = __m256d;
+    static constexpr size_t lanes = 4;
+
+    __attribute__((target("avx2,fma"))) static vec load(const fp* p) { return _mm256_loadu_pd(p); }
+    __attribute__((target("avx2,fma"))) static vec zero() { return _mm256_setzero_pd(); }
+    __attribute__((target("avx2,fma"))) static vec add(vec x, vec y) { return _mm256_add_pd(x, y); }
+    __attribute__((target("avx2,fma"))) static vec sub(vec x, vec y) { return _mm256_sub_pd(x, y); }
+    __attribute__((target("avx2,fma"))) static vec mul(vec x, vec y) { return _mm256_mul_pd(x, y); }
+    __attribute__((target("avx2,fma"))) static vec fmadd(vec x, vec y, vec z) { return _mm256_fmadd_pd(x, y, z); }
+    // x * y - p, the rounding error of p = x * y
+    __attribute__((target("avx2,fma"))) static vec fmsub(vec x, vec y, vec p) { return _mm256_fmsub_pd(x, y, p); }
+    __attribute__((target("avx2,fma"))) static vec abs(vec x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+    // mask ? x : y
+    __attribute__((target("avx2,fma"))) static vec select_ge(vec a, vec b, vec x, vec y)
+    {
+        return _mm256_blendv_pd(y, x, _mm256_cmp_pd(a, b, _CMP_GE_OQ));
+    }
+    __attribute__((target("avx2,fma"))) static void store(fp* p, vec x) { _mm256_storeu_pd(p, x); }
+};
+
+struct avx2_float
+{
+    using fp = float;
+    using vec = __m256;
+    static constexpr size_t lanes = 8;
+
+    __attribute__((target("avx2,fma"))) static vec load(const fp* p) { return _mm256_loadu_ps(p); }
+    __attribute__((target("avx2,fma"))) static vec zero() { return _mm256_setzero_ps(); }
+    __attribute__((target("avx2,fma"))) static vec add(vec x, vec y) { return _mm256_add_ps(x, y); }
+    __attribute__((target("avx2,fma"))) static vec sub(vec x, vec y) { return _mm256_sub_ps(x, y); }
+    __attribute__((target("avx2,fma"))) static vec mul(vec x, vec y) { return _mm256_mul_ps(x, y); }
+    __attribute__((target("avx2,fma"))) static vec fmadd(vec x, vec y, vec z) { return _mm256_fmadd_ps(x, y, z); }
+    __attribute__((target("avx2,fma"))) static vec fmsub(vec x, vec y, vec p) { return _mm256_fmsub_ps(x, y, p); }
+    __attribute__((target("avx2,fma"))) static vec abs(vec x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+    __attribute__((target("avx2,fma"))) static vec select_ge(vec a, vec b, vec x, vec y)
+    {
+        return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_GE_OQ));
+    }
+    __attribute__((target("avx2,fma"))) static void store(fp* p, vec x) { _mm256_storeu_ps(p, x); }
+};
+
+template <typename V>
+__attribute__((target("avx2,fma"))) typename V::fp horizontal_sum(typename V::vec x)
+{
+    typename V::fp lane[V::lanes];
+    V::store(lane, x);
+    typename V::fp s = 0;
+    for (size_t k = 0; k < V::lanes; ++k) {
+        s += lane[k];
+    }
+    return s;
+}
+
+// Sum of `Chains` vectors per step: 1 is the naive order per lane, 4 hides the add latency
+template <typename V, size_t Chains>
+__attribute__((target("avx2,fma"))) typename V::fp plain_avx2(terms<typename V::fp> x, size_t first, size_t last)
+{
+    using vec = typename V::vec;
+    constexpr size_t step = V::lanes * Chains;
+    vec acc[Chains];
+    for (size_t k = 0; k < Chains; ++k) {
+        acc[k] = V::zero();
+    }
+    size_t i = first;
+    for (; i + step <= last; i += step) {
+        for (size_t k = 0; k < Chains; ++k) {
+            const size_t j = i + k * V::lanes;
+            acc[k] = x.b ? V::fmadd(V::load(x.a + j), V::load(x.b + j), acc[k]) : V::add(acc[k], V::load(x.a + j));
+        }
+    }
+    for (size_t k = 1; k < Chains; ++k) {
+        acc[0] = V::add(acc[0], acc[k]);
+    }
+    return horizontal_sum<V>(acc[0]) + naive_scalar(x, i, last);
+}
+
+// Kahan or Neumaier per lane, 2 independent vectors; the lanes and the tail are combined with the same
+// method, so the result matches the scalar kernel up to the order of the additions
+template <typename V, bool Neumaier>
+__attribute__((target("avx2,fma"))) typename V::fp compensated_avx2(terms<typename V::fp> x, size_t first, size_t last)
+{
+    using fp = typename V::fp;
+    using vec = typename V::vec;
+    constexpr size_t step = V::lanes * 2;
+    vec s[2] = {V::zero(), V::zero()};
+    vec c[2] = {V::zero(), V::zero()};
+    size_t i = first;
+    for (; i + step <= last; i += step) {
+        for (size_t k = 0; k < 2; ++k) {
+            const size_t j = i + k * V::lanes;
+            const vec a = V::load(x.a + j);
+            const vec b = x.b ? V::load(x.b + j) : V::zero();
+            vec y = x.b ? V::mul(a, b) : a;
+            if constexpr (Neumaier) {
+                const vec t = V::add(s[k], y);
+                vec lost = V::select_ge(V::abs(s[k]), V::abs(y), V::add(V::sub(s[k], t), y), V::add(V::sub(y, t), s[k]));
+                if (x.b) {
+                    // Dot2: the exact rounding error of the product, Kahan doesn't carry it
+                    lost = V::add(lost, V::fmsub(a, b, y));
+                }
+                c[k] = V::add(c[k], lost);
+                s[k] = t;
+            }
+            else {
+                // c is the negated error here
+                y = V::sub(y, c[k]);
+                const vec t = V::add(s[k], y);
+                c[k] = V::sub(V::sub(t, s[k]), y);
+                s[k] = t;
+            }
+        }
+    }
+    fp sum_lanes[step];
+    fp c_lanes[step];
+    V::store(sum_lanes, s[0]);
+    V::store(sum_lanes + V::lanes, s[1]);
+    V::store(c_lanes, c[0]);
+    V::store(c_lanes + V::lanes, c[1]);
+    std::conditional_t<Neumaier, compensated<fp>, kahan<fp>> acc;
+    for (size_t k = 0; k < step; ++k) {
+        acc.add(sum_lanes[k]);
+        acc.add(Neumaier ? c_lanes[k] : -c_lanes[k]);
+    }
+    acc.add(Neumaier ? neumaier_scalar(x, i, last) : kahan_scalar(x, i, last));
+    return acc.value();
+}
+
+template <typename V>
+typename V::fp reduce_avx2(terms<typename V::fp> x, size_t n, summation m)
+{
+    switch (m) {
+    case summation::naive: return plain_avx2<V, 1>(x, 0, n);
+    case summation::unrolled: return plain_avx2<V, 4>(x, 0, n);
+    case summation::pairwise:
+        return pairwise<typename V::fp>([x](size_t first, size_t last) { return plain_avx2<V, 4>(x, first, last); }, 0, n);
+    case summation::kahan: return compensated_avx2<V, false>(x, 0, n);
+    case summation::neumaier: return compensated_avx2<V, true>(x, 0, n);
+    }
+    return 0;
+}
+
+#endif // CPP_CPU_X86
+
+template <typename T>
+using reduce_function = T (*)(terms<T> x, size_t n, summation m);
+
+// Chunks of at least 64K elements, one per thread; the partial sums are added with compensation
+// unless the method itself isn't compensated
+template <typename T>
+T parallel_reduce(terms<T> x, size_t n, summation m, reduce_function<T> k, unsigned threads)
+{
+    const size_t min_chunk = size_t(1) << 16;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const size_t parts = std::max<size_t>(1, std::min<size_t>(threads, n / min_chunk));
+    if (parts == 1) {
+        return k(x, n, m);
+    }
+    const size_t chunk = (n + parts - 1) / parts;
+    std::vector<std::future<T>> partial;
+    for (size_t first = chunk; first < n; first += chunk) {
+        const terms<T> part{x.a + first, x.b ? x.b + first : nullptr};
+        const size_t count = std::min(chunk, n - first);
+        partial.push_back(std::async(std::launch::async, [=] { return k(part, count, m); }));
+    }
+    const bool plain = m == summation::naive || m == summation::unrolled;
+    compensated<T> acc;
+    acc.add(k(x, chunk, m));
+    for (std::future<T>& f : partial) {
+        if (plain) {
+            acc.sum += f.get();
+        }
+        else {
+            acc.add(f.get());
+        }
+    }
+    return acc.value();
+}
+
+} // namespace detail
+
+template <typename T>
+using reduce_function = detail::reduce_function<T>;
+
+// Kernels for T (float or double) from the fastest, those compiled for this platform;
+// cpu::select() picks the first one this CPU supports
+template <typename T>
+const auto& reduce_kernels()
+{
+    static_assert(std::is_same<T, float>::value || std::is_same<T, double>::value, "float or double");
+    static const cpu::implementation<reduce_function<T>> kernels[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx2", detail::reduce_avx2<typename std::conditional<std::is_same<T, float>::value, detail::avx2_float, detail::avx2_double>::type>,
+         {cpu::feature::avx2, cpu::feature::fma}},
+#endif
+        {"scalar", detail::reduce_scalar<T>, {}}};
+    return kernels;
+}
+
+// The first of reduce_kernels<T>() this CPU supports, chosen on the first call
+template <typename T>
+reduce_function<T> best_reduce_kernel()
+{
+    static const reduce_function<T> best = cpu::select(reduce_kernels<T>()).function;
+    return best;
+}
+
+template <typename T>
+T sum(const T* p, size_t n, summation m = summation::pairwise, reduce_function<T> k = best_reduce_kernel<T>())
+{
+    return k(detail::terms<T>{p, nullptr}, n, m);
+}
+
+template <typename T>
+T dot(const T* a, const T* b, size_t n, summation m = summation::pairwise, reduce_function<T> k = best_reduce_kernel<T>())
+{
+    return k(detail::terms<T>{a, b}, n, m);
+}
+
+// threads == 0 is one per hardware thread
+template <typename T>
+T parallel_sum(const T* p, size_t n, summation m = summation::pairwise, reduce_function<T> k = best_reduce_kernel<T>(), unsigned threads = 0)
+{
+    return detail::parallel_reduce(detail::terms<T>{p, nullptr}, n, m, k, threads);
+}
+
+template <typename T>
+T parallel_dot(const T* a, const T* b, size_t n, summation m = summation::pairwise, reduce_function<T> k = best_reduce_kernel<T>(), unsigned threads = 0)
+{
+    return detail::parallel_reduce(detail::terms<T>{a, b}, n, m, k, threads);
+}
+
+} // namespace fp
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <utilities/benchmark.h>
+#include <utilities/generate.h>
+#include "reduce.h"
+
+namespace fp
+{
+
+// Neumaier in long double: 11 more bits than double, the reference for float and double sums
+template <typename T>
+long double reference_reduce(const T* a, const T* b, size_t n)
+{
+    detail::compensated<long double> acc;
+    for (size_t i = 0; i < n; ++i) {
+        acc.add(b ? static_cast<long double>(a[i]) * b[i] : a[i]);
+    }
+    return acc.value();
+}
+
+// Time, GB/s and relative error of every method, kernel and threading of sum() and dot()
+template <typename T>
+void benchmark_reduce(const std::string& title, const std::vector<T>& a, const std::vector<T>& b)
+{
+    const size_t n = a.size();
+    bench::options opts;
+    opts.repetitions = 5;
+
+    for (bool is_dot : {false, true}) {
+        const T* pb = is_dot ? b.data() : nullptr;
+        const long double reference = reference_reduce(a.data(), pb, n);
+        const double bytes = static_cast<double>(n * sizeof(T) * (is_dot ? 2 : 1));
+        std::cout << (is_dot ? "dot(), " : "sum(), ") << title << ", reference " << std::setprecision(17)
+                  << static_cast<double>(reference) << std::setprecision(6) << '\n';
+        std::cout << std::left << std::setw(34) << "method" << std::right << std::setw(10) << "ms" << std::setw(10) << "GB/s"
+                  << std::setw(14) << "rel. error" << '\n';
+
+        auto row = [&](const std::string& name, auto&& f) {
+            T value = 0;
+            const bench::result r = bench::run(name, [&] { value = f(); bench::do_not_optimize(value); }, n, opts);
+            const long double error = std::fabs((static_cast<long double>(value) - reference) / reference);
+            std::cout << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(2) << std::setw(10)
+                 << r.median_ns / 1e6 << std::setw(10) << bytes / r.median_ns << std::scientific << std::setw(14)
+                 << static_cast<double>(error) << std::defaultfloat << std::setprecision(6) << '\n';
+        };
+
+        if (is_dot) {
+            row("std::inner_product", [&] { return std::inner_product(a.begin(), a.end(), b.begin(), T(0)); });
+        }
+        else {
+            row("std::accumulate", [&] { return std::accumulate(a.begin(), a.end(), T(0)); });
+        }
+        for (const auto& k : reduce_kernels<T>()) {
+            if (!cpu::detected().contains(k.required)) {
+                continue;
+            }
+            for (summation m : {summation::naive, summation::unrolled, summation::pairwise, summation::kahan, summation::neumaier}) {
+                for (unsigned threads : {1u, 0u}) {
+                    const std::string name = std::string(k.name) + " " + summation_name(m) + (threads == 1 ? "" : ", all threads");
+                    row(name, [&] { return is_dot ? parallel_dot(a.data(), pb, n, m, k.function, threads) : parallel_sum(a.data(), n, m, k.function, threads); });
+                }
+            }
+        }
+        std::cout << '\n';
+    }
+}
+
+// Every kernel within the error bound of its method, for lengths around the vector widths;
+// compensated methods within a few eps of the sum of |x|, the others within n * eps of it
+template <typename T>
+bool check_kernels()
+{
+    const long double eps = std::numeric_limits<T>::epsilon();
+    bool ok = true;
+    for (size_t n : {0, 1, 7, 8, 15, 16, 17, 31, 33, 100, 1000, 4099, 65537}) {
+        const std::vector<T> a = rng::uniform_vector<T>(n, T(-1), T(1), n + 1);
+        const std::vector<T> b = rng::uniform_vector<T>(n, T(-1), T(1), n + 2);
+        for (bool is_dot : {false, true}) {
+            const T* pb = is_dot ? b.data() : nullptr;
+            const long double reference = reference_reduce(a.data(), pb, n);
+            long double magnitude = 0;
+            for (size_t i = 0; i < n; ++i) {
+                magnitude += std::fabs(is_dot ? static_cast<long double>(a[i]) * b[i] : a[i]);
+            }
+            for (summation m : {summation::naive, summation::unrolled, summation::pairwise, summation::kahan, summation::neumaier}) {
+                const bool compensated = m == summation::kahan || m == summation::neumaier;
+                const long double bound = (compensated ? 4 * eps + n * eps * eps : 2 * n * eps) * magnitude;
+                for (const auto& k : reduce_kernels<T>()) {
+                    if (!cpu::detected().contains(k.required)) {
+                        continue;
+                    }
+                    const T value = is_dot ? dot(a.data(), b.data(), n, m, k.function) : sum(a.data(), n, m, k.function);
+                    ok = ok && std::fabs(value - reference) <= bound;
+                }
+            }
+        }
+    }
+
+    // a sum small enough for one scalar tail: every kernel has the same order, the same result
+    const T big[] = {T(1), T(1e16), T(1), T(-1e16)};
+    for (summation m : {summation::naive, summation::unrolled, summation::pairwise, summation::kahan, summation::neumaier}) {
+        const T expected = sum(big, 4, m, std::end(reduce_kernels<T>())[-1].function);
+        for (const auto& k : reduce_kernels<T>()) {
+            if (cpu::detected().contains(k.required)) {
+                ok = ok && sum(big, 4, m, k.function) == expected;
+            }
+        }
+    }
+    return ok;
+}
+
+} // namespace fp
+
+// Summation and dot products without precision loss
+void show_summation()
+{
+    // float has 24 bits of significand: 2^24 + 1 == 2^24, the naive sum stops growing
+    const size_t n = size_t(1) << 25;
+    std::vector<float> ones(n, 1.0f);
+    const fp::reduce_function<float> scalar = std::end(fp::reduce_kernels<float>())[-1].function;
+    std::cout << "2^25 float ones, accumulate() = " << std::accumulate(ones.begin(), ones.end(), 0.0f) << '\n';
+    for (fp::summation m : {fp::summation::naive, fp::summation::unrolled, fp::summation::pairwise,
+                             fp::summation::kahan, fp::summation::neumaier}) {
+        std::cout << "2^25 float ones, " << fp::summation_name(m) << " = " << fp::sum(ones.data(), n, m, scalar) << '\n';
+    }
+    // 8 AVX2 lanes are 8 accumulators, each one stays below 2^24
+    std::cout << "2^25 float ones, " << cpu::select(fp::reduce_kernels<float>()).name << " naive = " << fp::sum(ones.data(), n, fp::summation::naive) << '\n';
+
+    // another classic: the type of the initial value is the type of the accumulator
+    std::vector<double> halves(10, 0.5);
+    std::cout << "accumulate(halves, 0) = " << std::accumulate(halves.begin(), halves.end(), 0)
+              << ", accumulate(halves, 0.0) = " << std::accumulate(halves.begin(), halves.end(), 0.0) << '\n';
+
+    // 1e16 + 1 - 1e16: Kahan loses the 1 since the next term is larger than the sum, Neumaier doesn't
+    const double big[] = { 1.0, 1e16, 1.0, -1e16 };
+    const fp::reduce_function<double> scalar_double = std::end(fp::reduce_kernels<double>())[-1].function;
+    std::cout << "1 + 1e16 + 1 - 1e16: naive = " << fp::sum(big, 4, fp::summation::naive, scalar_double)
+              << ", kahan = " << fp::sum(big, 4, fp::summation::kahan, scalar_double)
+              << ", neumaier = " << fp::sum(big, 4, fp::summation::neumaier, scalar_double) << '\n';
+    std::cout << "all kernels within the error bound of each method, float? " << fp::check_kernels<float>()
+              << ", double? " << fp::check_kernels<double>() << "\n\n";
+}
+
+void benchmark_summation()
+{
+    const size_t n = size_t(1) << 23;
+    // positive values, and values of mixed signs with cancellation
+    const std::vector<double> positive = rng::uniform_vector<double>(n, 0.0, 1.0, 1);
+    const std::vector<double> mixed = rng::uniform_vector<double>(n, -1.0, 1.0, 2);
+    const std::vector<double> other = rng::uniform_vector<double>(n, -1.0, 1.0, 3);
+
+    fp::benchmark_reduce("2^23 doubles in [0, 1)", positive, other);
+    fp::benchmark_reduce("2^23 doubles in [-1, 1)", mixed, other);
+    fp::benchmark_reduce("2^23 floats in [0, 1)", std::vector<float>(positive.begin(), positive.end()),
+        std::vector<float>(other.begin(), other.end()));
+}
+
+
+int main(int argc, char* argv[])
+{
+    const std::string func = argc > 1 ? argv[1] : "all";
+    if (func == "accuracy" || func == "all") {
+        show_summation();
+    }
+    if (func == "benchmark" || func == "all") {
+        benchmark_summation();
+    }
+    if (func != "accuracy" && func != "benchmark" && func != "all") {
+        std::cerr << "Usage: " << argv[0] << " [accuracy|benchmark]\n";
+        return 1;
+    }
+    return 0;
+}
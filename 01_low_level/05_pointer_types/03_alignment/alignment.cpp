@@ -1,6 +1,8 @@
 // ReSharper disable All
 #include <iostream>
 #include <cstddef> // For offsetof
+#include <cstdint>
+#include <new>
 
 /**
  * For hardware to access data efficiently, the bytes holding it must have proper alignment.
@@ -87,8 +89,37 @@ void show_align()
     std::cout << "offsetof(ColorVector, a): " << offsetof(ColorVector, a) << std::endl; // 48
 }
 
+/**
+ * Alignment stronger than alignof(std::max_align_t) is called new-extended alignment.
+ * Before C++17 `new` ignored it, and objects of such types could be misaligned on the heap.
+ * Since C++17 `new` calls `operator new(size_t, std::align_val_t)` for them.
+ * Custom pools and allocators have to honour alignof(T) by themselves, see 02_oop/02_memory/alignment.
+ */
+void show_aligned_new()
+{
+    std::cout << std::endl;
+    std::cout << "--- aligned new ---" << std::endl;
+
+    // e.g. 256-bit SIMD vector or data of a single CPU core, which should own its cache line
+    struct alignas(64) CacheLine {
+        float v[16];
+    };
+    std::cout << "alignof(std::max_align_t): " << alignof(std::max_align_t) << std::endl;
+    std::cout << "__STDCPP_DEFAULT_NEW_ALIGNMENT__: " << __STDCPP_DEFAULT_NEW_ALIGNMENT__ << std::endl;
+
+    CacheLine* p = new CacheLine();
+    std::cout << "new CacheLine address % 64: " << reinterpret_cast<std::uintptr_t>(p) % 64 << std::endl; // 0
+    delete p;
+
+    // The aligned form can be called directly, it must be paired with the aligned delete
+    void* raw = ::operator new(100, std::align_val_t(4096));
+    std::cout << "operator new(100, align_val_t(4096)) address % 4096: " << reinterpret_cast<std::uintptr_t>(raw) % 4096 << std::endl;
+    ::operator delete(raw, std::align_val_t(4096));
+}
+
 int main()
 {
     show_align();
+    show_aligned_new();
     return 0;
 }
@@ -2,6 +2,9 @@
 bits_popcount_and_scans.cpp
 Deep coverage: Hamming weight (popcount), bit scans, low/high bit extraction,
 Kernighan, SWAR, lookup tables, De Bruijn, and C++20 <bit> equivalents (guarded).
+Popcount of whole buffers: scalar kernels vs POPCNT, AVX2 Harley-Seal and AVX-512 VPOPCNTDQ,
+chosen at run time (popcount_buffer.h); run with a size in MB to benchmark another buffer size.
+Scans by TZCNT/LZCNT/BLSR where utilities/cpu_features.h detects BMI1 and LZCNT, De Bruijn and loops elsewhere.
 
 Build (C++17):
   g++ -std=c++17 -O2 -Wall -Wextra -pedantic bits_popcount_and_scans.cpp -o bits_pop
@@ -17,11 +20,22 @@ Build (C++20) to enable <bit>:
 #include <bitset>
 #include <climits>
 #include <cstdint>
+#include <iomanip>
 #include <iostream>
 #include <limits>
 #include <array>
 #include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <string>
 #include <type_traits>
+#include <vector>
+
+#include <utilities/benchmark.h>
+#include <utilities/cpu_features.h>
+#include <utilities/generate.h>
+#include "popcount_buffer.h"
 
 template <class T>
 using make_unsigned_t = typename std::make_unsigned<T>::type;
@@ -127,6 +141,76 @@ static int clz_loop32(std::uint32_t x)
     return n;
 }
 
+// --- The same scans by BMI1 TZCNT and LZCNT, compiled for these instructions only,
+// so they run only when utilities/cpu_features.h detects them. Both are defined for x==0 (result 32)
+#if defined(CPP_CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("bmi"))) static int ctz_tzcnt32(std::uint32_t x)
+{
+    return static_cast<int>(_tzcnt_u32(x));
+}
+
+__attribute__((target("lzcnt"))) static int clz_lzcnt32(std::uint32_t x)
+{
+    return static_cast<int>(_lzcnt_u32(x));
+}
+#define CPP_HAS_SCAN_INSTRUCTIONS 1
+#endif
+
+static int ctz_portable32(std::uint32_t x)
+{
+    return x == 0 ? 32 : ctz_debruijn32(x);
+}
+
+using scan_function = int (*)(std::uint32_t);
+
+// Chosen once; called through a pointer, so only worth it for the whole loops below, not a single scan
+static const cpu::implementation<scan_function> ctz_implementations[] = {
+#if defined(CPP_HAS_SCAN_INSTRUCTIONS)
+    {"tzcnt", ctz_tzcnt32, {cpu::feature::bmi1}},
+#endif
+    {"de bruijn", ctz_portable32, {}}};
+
+static const cpu::implementation<scan_function> clz_implementations[] = {
+#if defined(CPP_HAS_SCAN_INSTRUCTIONS)
+    {"lzcnt", clz_lzcnt32, {cpu::feature::lzcnt}},
+#endif
+    {"loop", clz_loop32, {}}};
+
+// --- Positions of all set bits of a bitmap (decoding a bitmap index into row numbers):
+// the lowest bit is found by a scan and cleared by x & (x - 1), one iteration per set bit
+using positions_function = std::size_t (*)(const std::uint32_t* words, std::size_t count, std::uint32_t* out);
+
+static std::size_t set_bit_positions_portable(const std::uint32_t* words, std::size_t count, std::uint32_t* out)
+{
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        for (std::uint32_t w = words[i]; w != 0; w &= w - 1)
+            out[n++] = static_cast<std::uint32_t>(i * 32 + ctz_debruijn32(w));
+    }
+    return n;
+}
+
+#if defined(CPP_HAS_SCAN_INSTRUCTIONS)
+// TZCNT and BLSR (x & (x - 1) in one instruction)
+__attribute__((target("bmi"))) static std::size_t set_bit_positions_bmi(const std::uint32_t* words, std::size_t count, std::uint32_t* out)
+{
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        for (std::uint32_t w = words[i]; w != 0; w = _blsr_u32(w))
+            out[n++] = static_cast<std::uint32_t>(i * 32 + _tzcnt_u32(w));
+    }
+    return n;
+}
+#endif
+
+static const cpu::implementation<positions_function> positions_implementations[] = {
+#if defined(CPP_HAS_SCAN_INSTRUCTIONS)
+    {"bmi1", set_bit_positions_bmi, {cpu::feature::bmi1}},
+#endif
+    {"de bruijn", set_bit_positions_portable, {}}};
+
 static void demo_popcount()
 {
     std::cout << "== popcount demos ==\n";
@@ -146,6 +230,137 @@ static void demo_scans()
     std::cout << "isolate_lsb bits=" << bits_u(isolate_lsb(x)) << "\n";
     std::cout << "ctz_debruijn (x!=0) = " << ctz_debruijn32(x) << "\n";
     std::cout << "clz_loop32          = " << clz_loop32(x) << "\n";
+
+    const auto& ctz = cpu::select(ctz_implementations);
+    const auto& clz = cpu::select(clz_implementations);
+    std::cout << "ctz (" << ctz.name << ")" << std::string(11 - std::strlen(ctz.name), ' ') << "= " << ctz.function(x) << "\n";
+    std::cout << "clz (" << clz.name << ")" << std::string(11 - std::strlen(clz.name), ' ') << "= " << clz.function(x) << "\n";
+    std::cout << "ctz(0)=" << ctz.function(0) << " clz(0)=" << clz.function(0) << "\n";
+}
+
+static void demo_cpu_dispatch()
+{
+    std::cout << "\n== CPU features (disable some with CPP_CPU_DISABLE=avx512f,bmi1,...) ==\n";
+    cpu::report(std::cout);
+    std::cout << "\nctz: " << cpu::select(ctz_implementations).name
+              << ", clz: " << cpu::select(clz_implementations).name
+              << ", set bit positions: " << cpu::select(positions_implementations).name
+              << ", buffer popcount: " << cpu::select(bits::popcount_kernels()).name << "\n";
+
+    // every implementation supported here must give the same positions
+    const std::vector<std::uint32_t> bitmap = rng::uniform_vector<std::uint32_t>(1000, 0, 0xFFFFFFFFu, 3);
+    std::vector<std::uint32_t> expected(bitmap.size() * 32), positions(bitmap.size() * 32);
+    const std::size_t n = set_bit_positions_portable(bitmap.data(), bitmap.size(), expected.data());
+    for (const auto& impl : positions_implementations)
+    {
+        if (!cpu::detected().contains(impl.required))
+            continue;
+        const bool same = impl.function(bitmap.data(), bitmap.size(), positions.data()) == n &&
+                          std::equal(expected.begin(), expected.begin() + n, positions.begin());
+        std::cout << "set bit positions (" << impl.name << "): " << (same ? "OK" : "MISMATCH") << "\n";
+    }
+}
+
+// Apply a 32-bit popcount to every word of a buffer, the way the single-word algorithms above scale
+template <class F>
+static std::uint64_t popcount_words32(const std::vector<unsigned char>& buffer, F popcount32)
+{
+    std::uint64_t total = 0;
+    const std::size_t words = buffer.size() / 4;
+    for (std::size_t i = 0; i < words; ++i)
+    {
+        std::uint32_t w;
+        std::memcpy(&w, buffer.data() + i * 4, sizeof(w));
+        total += popcount32(w);
+    }
+    return total;
+}
+
+static void demo_popcount_buffer()
+{
+    std::cout << "\n== buffer popcount demos ==\n";
+
+    // odd size and offset: kernels load unaligned words, the tail is not a whole word
+    const std::vector<unsigned char> buffer = rng::uniform_vector<unsigned char>(100'003, 0, 255, 7);
+    const unsigned char* data = buffer.data() + 1;
+    const std::size_t bytes = buffer.size() - 1;
+
+    std::uint64_t expected = 0;
+    for (std::size_t i = 0; i < bytes; ++i)
+        expected += popcount_swar32(data[i]);
+    std::cout << "bytes=" << bytes << " bits set=" << expected << "\n";
+
+    for (const auto& k : bits::popcount_kernels())
+    {
+        std::cout << k.name << ": ";
+        if (!cpu::detected().contains(k.required))
+        {
+            std::cout << "not supported\n";
+            continue;
+        }
+        std::cout << (bits::popcount(data, bytes, k.function) == expected ? "OK" : "MISMATCH") << "\n";
+    }
+}
+
+// Every popcount variant over a buffer of `bytes` random bytes, in GB/s
+static void benchmark_popcount_buffer(std::size_t bytes)
+{
+    const std::vector<unsigned char> buffer = rng::uniform_vector<unsigned char>(bytes, 0, 255, 42);
+
+    bench::options opts;
+    opts.repetitions = 9;
+    bench::suite s("Popcount of " + std::to_string(bytes / 1024) + " KB", opts);
+
+    s.run("kernighan (32-bit words)", [&] { bench::do_not_optimize(popcount_words32(buffer, popcount_kernighan)); }, bytes);
+    s.run("table32 (32-bit words)", [&] { bench::do_not_optimize(popcount_words32(buffer, popcount_table32)); }, bytes);
+    s.run("swar32 (32-bit words)", [&] { bench::do_not_optimize(popcount_words32(buffer, popcount_swar32)); }, bytes);
+    for (const auto& k : bits::popcount_kernels())
+    {
+        if (cpu::detected().contains(k.required))
+            s.run(k.name, [&] { bench::do_not_optimize(bits::popcount(buffer.data(), bytes, k.function)); }, bytes);
+    }
+    s.run("dispatched", [&] { bench::do_not_optimize(bits::popcount(buffer.data(), bytes)); }, bytes);
+    s.report(std::cout);
+
+    // elements are bytes, so the throughput is bytes per second
+    std::cout << "GB/s:";
+    for (const bench::result& r : s.results())
+        std::cout << "  " << r.name << " " << std::fixed << std::setprecision(2) << r.throughput() / 1e9;
+    std::cout << std::defaultfloat << "\n\n";
+}
+
+// Scan instructions vs De Bruijn multiplication, over bitmaps of different density.
+// The inner loop exit is mispredicted about once per word, which dominates sparse bitmaps
+static void benchmark_set_bit_positions()
+{
+    const std::size_t words = 64 * 1024;
+    std::vector<std::uint32_t> out(words * 32);
+
+    bench::options opts;
+    opts.repetitions = 9;
+    for (std::uint32_t keep_one_of : {1u, 8u})
+    {
+        // keep_one_of == 8: every bit is set with probability 1/16
+        std::vector<std::uint32_t> bitmap = rng::uniform_vector<std::uint32_t>(words, 0, 0xFFFFFFFFu, 11);
+        if (keep_one_of > 1)
+        {
+            const std::vector<std::uint32_t> mask = rng::uniform_vector<std::uint32_t>(words, 0, 0xFFFFFFFFu, 12);
+            const std::vector<std::uint32_t> mask2 = rng::uniform_vector<std::uint32_t>(words, 0, 0xFFFFFFFFu, 13);
+            const std::vector<std::uint32_t> mask3 = rng::uniform_vector<std::uint32_t>(words, 0, 0xFFFFFFFFu, 14);
+            for (std::size_t i = 0; i < words; ++i)
+                bitmap[i] &= mask[i] & mask2[i] & mask3[i];
+        }
+        const std::size_t set_bits = set_bit_positions_portable(bitmap.data(), words, out.data());
+
+        bench::suite s("Set bit positions, " + std::to_string(set_bits) + " of " + std::to_string(words * 32) + " bits set", opts);
+        for (const auto& impl : positions_implementations)
+        {
+            if (cpu::detected().contains(impl.required))
+                s.run(impl.name, [&] { bench::do_not_optimize(impl.function(bitmap.data(), words, out.data())); }, set_bits);
+        }
+        s.report(std::cout);
+        std::cout << "\n";
+    }
 }
 
 #if __cplusplus >= 202002L
@@ -164,10 +379,12 @@ static void demo_scans()
   #endif
 #endif
 
-int main()
+int main(int argc, char* argv[])
 {
     demo_popcount();
     demo_scans();
+    demo_cpu_dispatch();
+    demo_popcount_buffer();
 
 #if __cplusplus >= 202002L
   #if __has_include(<bit>)
@@ -179,6 +396,14 @@ int main()
     std::cout << "\n(Compile with -std=c++20 to enable <bit> demos)\n";
 #endif
 
+    // a buffer fitting in L2 shows the compute limit of kernels, a large one the memory bandwidth
+    std::cout << "\n";
+    benchmark_set_bit_positions();
+    benchmark_popcount_buffer(64 * 1024);
+    const std::size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16;
+    if (megabytes > 0)
+        benchmark_popcount_buffer(megabytes * 1024 * 1024);
+
     std::cout << "\n(bits_popcount_and_scans.cpp) OK\n";
     return 0;
 }
@@ -0,0 +1,232 @@
+#pragma once
+/*
+popcount_buffer.h
+Hamming weight of a whole buffer, e.g. the cardinality of a large bitmap.
+
+Kernels, from the slowest:
+  - swar:      64-bit SWAR (bit-parallel additions inside a register), portable
+  - builtin:   __builtin_popcountll compiled for the baseline x86-64, which has no POPCNT instruction,
+               so it's a library call
+  - popcnt:    the same builtin compiled with the POPCNT instruction, 1 instruction per 64 bits
+  - avx2:      Harley-Seal carry-save adder over 16 vectors of 256 bits (Mula, Kurz, Lemire,
+               "Faster Population Counts Using AVX2 Instructions"): bits of 16 vectors are summed
+               by bitwise full adders, and only one vector of "sixteens" is counted per iteration
+               by the nibble lookup (vpshufb) + vpsadbw
+  - avx512:    VPOPCNTQ counts 8 words per instruction (Ice Lake and later, Zen 4)
+
+The best kernel supported by the CPU is chosen at run time, so the binary stays compatible with any x86-64:
+x86 kernels are compiled with `__attribute__((target(...)))` and called only if utilities/cpu_features.h
+detects their features.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <utilities/cpu_features.h>
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+namespace bits
+{
+
+// Kernels count bits of `words` 64-bit words at `data`, which doesn't have to be aligned
+using popcount_function = std::uint64_t (*)(const unsigned char* data, size_t words);
+
+namespace detail
+{
+
+inline std::uint64_t load64(const unsigned char* p)
+{
+    std::uint64_t w;
+    std::memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+inline std::uint64_t popcount64_swar(std::uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    // sum of 8 bytes in the highest byte
+    return (x * 0x0101010101010101ULL) >> 56;
+}
+
+inline std::uint64_t popcount_swar(const unsigned char* data, size_t words)
+{
+    std::uint64_t total = 0;
+    for (size_t i = 0; i < words; ++i) {
+        total += popcount64_swar(load64(data + i * 8));
+    }
+    return total;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+inline std::uint64_t popcount_builtin(const unsigned char* data, size_t words)
+{
+    std::uint64_t total = 0;
+    for (size_t i = 0; i < words; ++i) {
+        total += static_cast<std::uint64_t>(__builtin_popcountll(load64(data + i * 8)));
+    }
+    return total;
+}
+#else
+inline std::uint64_t popcount_builtin(const unsigned char* data, size_t words)
+{
+    return popcount_swar(data, words);
+}
+#endif
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+__attribute__((target("popcnt"))) inline std::uint64_t popcount_popcnt(const unsigned char* data, size_t words)
+{
+    // independent accumulators, POPCNT has 3 cycles latency but 1 per cycle throughput
+    std::uint64_t t0 = 0, t1 = 0, t2 = 0, t3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        t0 += static_cast<std::uint64_t>(__builtin_popcountll(load64(data + i * 8)));
+        t1 += static_cast<std::uint64_t>(__builtin_popcountll(load64(data + i * 8 + 8)));
+        t2 += static_cast<std::uint64_t>(__builtin_popcountll(load64(data + i * 8 + 16)));
+        t3 += static_cast<std::uint64_t>(__builtin_popcountll(load64(data + i * 8 + 24)));
+    }
+    for (; i < words; ++i) {
+        t0 += static_cast<std::uint64_t>(__builtin_popcountll(load64(data + i * 8)));
+    }
+    return t0 + t1 + t2 + t3;
+}
+
+// Bit counts of 4 64-bit lanes: popcount of every nibble by lookup, then horizontal sums of bytes
+__attribute__((target("avx2"))) inline __m256i popcount256(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    const __m256i low = _mm256_and_si256(v, low_mask);
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    const __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) inline __m256i load256(const unsigned char* data, size_t i)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data) + i);
+}
+
+// Carry-save adder: a + b + c = 2 * high + low, bitwise
+__attribute__((target("avx2"))) inline void csa(__m256i& high, __m256i& low, __m256i a, __m256i b, __m256i c)
+{
+    const __m256i u = _mm256_xor_si256(a, b);
+    high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    low = _mm256_xor_si256(u, c);
+}
+
+__attribute__((target("avx2,popcnt"))) inline std::uint64_t popcount_avx2(const unsigned char* data, size_t words)
+{
+    const size_t vectors = words / 4;
+
+    __m256i total = _mm256_setzero_si256();
+    __m256i ones = _mm256_setzero_si256();
+    __m256i twos = _mm256_setzero_si256();
+    __m256i fours = _mm256_setzero_si256();
+    __m256i eights = _mm256_setzero_si256();
+    __m256i sixteens, twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;
+
+    size_t i = 0;
+    for (; i + 16 <= vectors; i += 16) {
+        csa(twos_a, ones, ones, load256(data, i), load256(data, i + 1));
+        csa(twos_b, ones, ones, load256(data, i + 2), load256(data, i + 3));
+        csa(fours_a, twos, twos, twos_a, twos_b);
+        csa(twos_a, ones, ones, load256(data, i + 4), load256(data, i + 5));
+        csa(twos_b, ones, ones, load256(data, i + 6), load256(data, i + 7));
+        csa(fours_b, twos, twos, twos_a, twos_b);
+        csa(eights_a, fours, fours, fours_a, fours_b);
+        csa(twos_a, ones, ones, load256(data, i + 8), load256(data, i + 9));
+        csa(twos_b, ones, ones, load256(data, i + 10), load256(data, i + 11));
+        csa(fours_a, twos, twos, twos_a, twos_b);
+        csa(twos_a, ones, ones, load256(data, i + 12), load256(data, i + 13));
+        csa(twos_b, ones, ones, load256(data, i + 14), load256(data, i + 15));
+        csa(fours_b, twos, twos, twos_a, twos_b);
+        csa(eights_b, fours, fours, fours_a, fours_b);
+        csa(sixteens, eights, eights, eights_a, eights_b);
+        total = _mm256_add_epi64(total, popcount256(sixteens));
+    }
+
+    total = _mm256_slli_epi64(total, 4);
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(eights), 3));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(fours), 2));
+    total = _mm256_add_epi64(total, _mm256_slli_epi64(popcount256(twos), 1));
+    total = _mm256_add_epi64(total, popcount256(ones));
+    for (; i < vectors; ++i) {
+        total = _mm256_add_epi64(total, popcount256(load256(data, i)));
+    }
+
+    alignas(32) std::uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcount_popcnt(data + vectors * 32, words % 4);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq"))) inline std::uint64_t popcount_avx512(const unsigned char* data, size_t words)
+{
+    __m512i total0 = _mm512_setzero_si512();
+    __m512i total1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 16 <= words; i += 16) {
+        total0 = _mm512_add_epi64(total0, _mm512_popcnt_epi64(_mm512_loadu_si512(data + i * 8)));
+        total1 = _mm512_add_epi64(total1, _mm512_popcnt_epi64(_mm512_loadu_si512(data + i * 8 + 64)));
+    }
+    for (; i < words; i += 8) {
+        // masked load of the last 1..8 words, masked out lanes are zeros
+        const size_t rest = words - i < 8 ? words - i : 8;
+        const __mmask8 mask = static_cast<__mmask8>((1u << rest) - 1);
+        total0 = _mm512_add_epi64(total0, _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64(mask, data + i * 8)));
+    }
+    // _mm512_reduce_add_epi64() is the same, but trips -Wuninitialized in GCC 12 headers
+    alignas(64) std::uint64_t lanes[8];
+    _mm512_store_si512(lanes, _mm512_add_epi64(total0, total1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+#endif // CPP_CPU_X86
+
+} // namespace detail
+
+// Kernels from the fastest, those compiled for this platform; cpu::select() picks the first one this CPU supports
+inline const auto& popcount_kernels()
+{
+    static const cpu::implementation<popcount_function> kernels[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx512 vpopcntdq", detail::popcount_avx512, {cpu::feature::avx512f, cpu::feature::avx512vpopcntdq}},
+        {"avx2 harley-seal", detail::popcount_avx2, {cpu::feature::avx2, cpu::feature::popcnt}},
+        {"popcnt", detail::popcount_popcnt, {cpu::feature::popcnt}},
+#endif
+        {"builtin", detail::popcount_builtin, {}},
+        {"swar", detail::popcount_swar, {}}};
+    return kernels;
+}
+
+// Number of set bits in `bytes` bytes at `data` by the given kernel
+inline std::uint64_t popcount(const void* data, size_t bytes, popcount_function kernel)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const size_t words = bytes / 8;
+    std::uint64_t total = kernel(p, words);
+    if (bytes % 8) {
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, p + words * 8, bytes % 8);
+        total += detail::popcount64_swar(tail);
+    }
+    return total;
+}
+
+// Number of set bits in `bytes` bytes at `data` by the best kernel for this CPU, chosen on the first call
+inline std::uint64_t popcount(const void* data, size_t bytes)
+{
+    static const popcount_function best = cpu::select(popcount_kernels()).function;
+    return popcount(data, bytes, best);
+}
+
+} // namespace bits
@@ -0,0 +1,213 @@
+#pragma once
+/*
+flags.h
+Type-safe set of enum class bit flags, and its atomic version.
+
+masks_and_flags.cpp writes |, &, ^, ~, |=, &= and has() by hand for one enum, and ~ needs masking by All.
+flags<E> does it once for any enum declared with CPP_FLAGS:
+
+    enum class open_mode : std::uint8_t { read = 1, write = 2, append = 4, all = read | write | append };
+    CPP_FLAGS(open_mode, open_mode::all)
+
+    bits::flags<open_mode> m = open_mode::read | open_mode::write;   // E | E is flags<E>
+    m.has(open_mode::write);  (~m).has(open_mode::append);            // ~ keeps declared bits only
+
+Declared bits are validated: constructing flags from a value outside `all` is a compile error in a constant
+expression and throws std::invalid_argument at run time; from_raw() drops unknown bits of external input.
+
+atomic_flags<E> keeps flags in std::atomic of the underlying type; set(), clear(), toggle() are a single
+lock-free fetch_or/fetch_and/fetch_xor and return previous flags, so concurrent updates of different bits
+are never lost, and test_and_set() tells which thread set the bit first.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+namespace bits
+{
+
+template <class E>
+class flags
+{
+    static_assert(std::is_enum<E>::value, "flags<E> requires an enum");
+
+public:
+    using enum_type = E;
+    using underlying_type = std::make_unsigned_t<std::underlying_type_t<E>>;
+
+    // All declared bits, `declared_flags(E)` is found by ADL in the namespace of E (see CPP_FLAGS)
+    static constexpr underlying_type all_bits = static_cast<underlying_type>(declared_flags(E{}));
+    static_assert(all_bits != 0, "CPP_FLAGS: declared flags must not be empty");
+
+    constexpr flags() noexcept = default;
+
+    constexpr flags(E e) : value(checked(static_cast<underlying_type>(e)))
+    {
+    }
+
+    static constexpr flags all() noexcept
+    {
+        return from_bits(all_bits);
+    }
+
+    // External input (files, network), unknown bits are dropped
+    static constexpr flags from_raw(underlying_type raw) noexcept
+    {
+        return from_bits(raw & all_bits);
+    }
+
+    // True if `raw` has declared bits only
+    static constexpr bool is_valid(underlying_type raw) noexcept
+    {
+        return (raw & ~all_bits) == 0;
+    }
+
+    constexpr underlying_type raw() const noexcept { return value; }
+
+    constexpr bool has(flags f) const noexcept { return f.value != 0 && (value & f.value) == f.value; }
+    constexpr bool has_any(flags f) const noexcept { return (value & f.value) != 0; }
+    constexpr bool any() const noexcept { return value != 0; }
+    constexpr bool none() const noexcept { return value == 0; }
+    constexpr explicit operator bool() const noexcept { return value != 0; }
+
+    constexpr size_t count() const noexcept
+    {
+        size_t n = 0;
+        for (underlying_type v = value; v != 0; v &= static_cast<underlying_type>(v - 1)) {
+            ++n;
+        }
+        return n;
+    }
+
+    constexpr flags& set(flags f) noexcept { value |= f.value; return *this; }
+    constexpr flags& reset(flags f) noexcept { value &= static_cast<underlying_type>(~f.value); return *this; }
+    constexpr flags& toggle(flags f) noexcept { value ^= f.value; return *this; }
+    constexpr flags& set(flags f, bool on) noexcept { return on ? set(f) : reset(f); }
+
+    // Call f(E) for every set bit, from the lowest one
+    template <class F>
+    void for_each(F f) const
+    {
+        for (underlying_type v = value; v != 0; v &= static_cast<underlying_type>(v - 1)) {
+            f(static_cast<E>(v & static_cast<underlying_type>(0u - v)));
+        }
+    }
+
+    constexpr flags& operator|=(flags f) noexcept { value |= f.value; return *this; }
+    constexpr flags& operator&=(flags f) noexcept { value &= f.value; return *this; }
+    constexpr flags& operator^=(flags f) noexcept { value ^= f.value; return *this; }
+
+    friend constexpr flags operator|(flags a, flags b) noexcept { return from_bits(a.value | b.value); }
+    friend constexpr flags operator&(flags a, flags b) noexcept { return from_bits(a.value & b.value); }
+    friend constexpr flags operator^(flags a, flags b) noexcept { return from_bits(a.value ^ b.value); }
+
+    // Complement within declared bits, not all bits of the underlying type
+    friend constexpr flags operator~(flags a) noexcept { return from_bits(~a.value & all_bits); }
+
+    friend constexpr bool operator==(flags a, flags b) noexcept { return a.value == b.value; }
+    friend constexpr bool operator!=(flags a, flags b) noexcept { return a.value != b.value; }
+
+private:
+    static constexpr flags from_bits(underlying_type v) noexcept
+    {
+        flags f;
+        f.value = static_cast<underlying_type>(v);
+        return f;
+    }
+
+    static constexpr underlying_type checked(underlying_type v)
+    {
+        // a throw expression makes constant evaluation fail, i.e. a compile error
+        return is_valid(v) ? v : throw std::invalid_argument("flags: value has undeclared bits");
+    }
+
+    underlying_type value = 0;
+};
+
+template <class E>
+class atomic_flags
+{
+public:
+    using value_type = flags<E>;
+    using underlying_type = typename flags<E>::underlying_type;
+
+    static_assert(std::atomic<underlying_type>::is_always_lock_free, "atomic_flags must be lock-free");
+
+    constexpr atomic_flags() noexcept = default;
+    constexpr atomic_flags(flags<E> initial) noexcept : value(initial.raw())
+    {
+    }
+
+    atomic_flags(const atomic_flags&) = delete;
+    atomic_flags& operator=(const atomic_flags&) = delete;
+
+    flags<E> load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+    {
+        return flags<E>::from_raw(value.load(order));
+    }
+
+    void store(flags<E> f, std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        value.store(f.raw(), order);
+    }
+
+    // Set bits of `f`, returns flags before the change
+    flags<E> set(flags<E> f, std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        return flags<E>::from_raw(value.fetch_or(f.raw(), order));
+    }
+
+    // Clear bits of `f`, returns flags before the change
+    flags<E> clear(flags<E> f, std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        return flags<E>::from_raw(value.fetch_and(static_cast<underlying_type>(~f.raw()), order));
+    }
+
+    flags<E> toggle(flags<E> f, std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        return flags<E>::from_raw(value.fetch_xor(f.raw(), order));
+    }
+
+    bool test(flags<E> f, std::memory_order order = std::memory_order_seq_cst) const noexcept
+    {
+        return load(order).has(f);
+    }
+
+    // Set bits of `f`, true if all of them were already set, e.g. only one caller gets false
+    bool test_and_set(flags<E> f, std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        return set(f, order).has(f);
+    }
+
+    // Clear bits of `f`, true if all of them were set before
+    bool test_and_clear(flags<E> f, std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        return clear(f, order).has(f);
+    }
+
+    // Replace `expected` with `desired` atomically, e.g. a state transition depending on several bits;
+    // on failure `expected` receives the current flags
+    bool compare_exchange(flags<E>& expected, flags<E> desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        underlying_type raw = expected.raw();
+        const bool done = value.compare_exchange_strong(raw, desired.raw(), order);
+        expected = flags<E>::from_raw(raw);
+        return done;
+    }
+
+private:
+    std::atomic<underlying_type> value{0};
+};
+
+} // namespace bits
+
+// Declare the enum E as flags with all declared bits ALL, at namespace scope next to the enum,
+// so E | E, E & E, E ^ E and ~E are found by ADL and produce bits::flags<E>
+#define CPP_FLAGS(E, ALL)                                                                                        \
+    constexpr E declared_flags(E) noexcept { return ALL; }                                                       \
+    constexpr ::bits::flags<E> operator|(E lhs, E rhs) { return ::bits::flags<E>(lhs) | ::bits::flags<E>(rhs); } \
+    constexpr ::bits::flags<E> operator&(E lhs, E rhs) { return ::bits::flags<E>(lhs) & ::bits::flags<E>(rhs); } \
+    constexpr ::bits::flags<E> operator^(E lhs, E rhs) { return ::bits::flags<E>(lhs) ^ ::bits::flags<E>(rhs); } \
+    constexpr ::bits::flags<E> operator~(E value) { return ~::bits::flags<E>(value); }
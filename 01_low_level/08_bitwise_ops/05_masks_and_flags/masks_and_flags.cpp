@@ -2,9 +2,11 @@
 bits_masks_and_flags.cpp
 Deep coverage: robust bitmask/flag design in C++ using enum class, operators,
 masking pitfalls (~), and best practices for APIs and serialization.
+The operators written here for Perm are generalized by bits::flags<E> (flags.h),
+and bits::atomic_flags<E> shares flags between threads without a mutex.
 
 Build (C++17):
-  g++ -std=c++17 -O2 -Wall -Wextra -pedantic bits_masks_and_flags.cpp -o bits_flags
+  g++ -std=c++17 -O2 -Wall -Wextra -pedantic -I../../.. masks_and_flags.cpp -pthread -o bits_flags
 */
 
 // Common helper: print bits of unsigned integers in binary (no external deps).
@@ -16,9 +18,15 @@ Build (C++17):
 #include <cstdint>
 #include <iostream>
 #include <limits>
-#include <cstdint>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <vector>
+
+#include <utilities/benchmark.h>
+#include "flags.h"
 
 template <class T>
 using make_unsigned_t = typename std::make_unsigned<T>::type;
@@ -130,10 +138,181 @@ static void api_boundary_hint()
     std::cout << "incoming masked => " << to_string(safe) << "\n";
 }
 
+// The same permissions with bits::flags, operators come from CPP_FLAGS
+namespace fs
+{
+enum class access : std::uint32_t
+{
+    read  = 1u << 0,
+    write = 1u << 1,
+    exec  = 1u << 2,
+    all   = read | write | exec
+};
+CPP_FLAGS(access, access::all)
+} // namespace fs
+
+// Compile-time checks: ~ is masked, has() needs all bits
+static_assert((~fs::access::read).raw() == 6, "~ keeps declared bits only");
+static_assert((fs::access::read | fs::access::exec).has(fs::access::exec), "has a flag");
+static_assert(!(fs::access::read | fs::access::exec).has(fs::access::read | fs::access::write), "has all flags");
+static_assert(bits::flags<fs::access>::from_raw(0xFFu).raw() == 7, "unknown bits are dropped");
+// constexpr bits::flags<fs::access> bad = static_cast<fs::access>(8);   // error: undeclared bit
+
+static std::string to_string(bits::flags<fs::access> p)
+{
+    std::string s;
+    p.for_each([&](fs::access a) {
+        s += a == fs::access::read ? "R" : a == fs::access::write ? "W" : "X";
+    });
+    return s.empty() ? "None" : s;
+}
+
+static void demo_flags_template()
+{
+    std::cout << "\n== bits::flags<E> ==\n";
+    bits::flags<fs::access> p;
+    p |= fs::access::read;
+    p.set(fs::access::write);
+    std::cout << "p=" << to_string(p) << " raw=" << p.raw() << " count=" << p.count() << "\n";
+    std::cout << "~p=" << to_string(~p) << " (masked by declared bits)\n";
+    std::cout << "p ^ (read | exec)=" << to_string(p ^ (fs::access::read | fs::access::exec)) << "\n";
+    std::cout << "incoming 0xFFFFFFFF => " << to_string(bits::flags<fs::access>::from_raw(0xFFFF'FFFFu))
+              << ", valid? " << bits::flags<fs::access>::is_valid(0xFFFF'FFFFu) << "\n";
+    try
+    {
+        const bits::flags<fs::access> bad = static_cast<fs::access>(0x10);
+        std::cout << "undeclared bit accepted: " << bad.raw() << "\n";
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cout << "undeclared bit at run time: " << e.what() << "\n";
+    }
+}
+
+// Connection state bits updated by several threads
+enum class conn : std::uint32_t
+{
+    open          = 1u << 0,
+    authenticated = 1u << 1,
+    closing       = 1u << 2,
+    dirty         = 1u << 3,
+    all           = open | authenticated | closing | dirty
+};
+CPP_FLAGS(conn, conn::all)
+
+static void demo_atomic_flags()
+{
+    std::cout << "\n== bits::atomic_flags<E> ==\n";
+    bits::atomic_flags<conn> state(conn::open);
+
+    // Every thread sets and clears its own bit, a read-modify-write of a plain integer
+    // would lose updates of the other threads
+    const conn own[] = {conn::authenticated, conn::closing, conn::dirty};
+    std::vector<std::thread> threads;
+    for (conn bit : own)
+    {
+        threads.emplace_back([&state, bit] {
+            for (int i = 0; i < 100000; ++i)
+            {
+                state.set(bit, std::memory_order_relaxed);
+                state.clear(bit, std::memory_order_relaxed);
+            }
+            state.set(bit, std::memory_order_release);
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    std::cout << "all bits set after concurrent updates? " << (state.load() == bits::flags<conn>::all()) << "\n";
+
+    // Only one thread wins test_and_set(), e.g. the one that closes the connection
+    state.clear(conn::closing);
+    std::atomic<int> winners{0};
+    threads.clear();
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&] {
+            if (!state.test_and_set(conn::closing))
+                winners.fetch_add(1);
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    std::cout << "threads that set 'closing' first: " << winners.load() << "\n";
+
+    // A transition depending on several bits: only open and authenticated -> closing
+    state.store(conn::open | conn::authenticated);
+    for (int i = 0; i < 2; ++i)
+    {
+        bits::flags<conn> expected = conn::open | conn::authenticated;
+        const bool done = state.compare_exchange(expected, conn::closing);
+        std::cout << "compare_exchange(open|authenticated -> closing) done=" << done << ", state was "
+                  << expected.raw() << "\n";
+    }
+}
+
+static void benchmark_atomic_flags()
+{
+    const std::size_t thread_count = 4, ops = 250000;
+    const conn own[thread_count] = {conn::open, conn::authenticated, conn::closing, conn::dirty};
+    bench::options opts;
+    opts.repetitions = 7;
+    bench::suite s("4 threads setting and clearing their own flag", opts);
+
+    auto run_threads = [&](auto&& body) {
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < thread_count; ++t)
+            threads.emplace_back([&, t] { body(own[t]); });
+        for (std::thread& t : threads)
+            t.join();
+    };
+
+    bits::atomic_flags<conn> atomic_state;
+    s.run("atomic_flags, relaxed", [&] {
+        run_threads([&](conn bit) {
+            for (std::size_t i = 0; i < ops; ++i)
+            {
+                atomic_state.set(bit, std::memory_order_relaxed);
+                atomic_state.clear(bit, std::memory_order_relaxed);
+            }
+        });
+    }, thread_count * ops * 2);
+    s.run("atomic_flags, seq_cst", [&] {
+        run_threads([&](conn bit) {
+            for (std::size_t i = 0; i < ops; ++i)
+            {
+                atomic_state.set(bit);
+                atomic_state.clear(bit);
+            }
+        });
+    }, thread_count * ops * 2);
+
+    std::mutex mutex;
+    bits::flags<conn> locked_state;
+    s.run("std::mutex + flags", [&] {
+        run_threads([&](conn bit) {
+            for (std::size_t i = 0; i < ops; ++i)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    locked_state.set(bit);
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                locked_state.reset(bit);
+            }
+        });
+    }, thread_count * ops * 2);
+    s.report(std::cout);
+    std::cout << "(" << std::thread::hardware_concurrency() << " hardware threads)\n";
+}
+
 int main()
 {
     demo_flags();
     api_boundary_hint();
+    demo_flags_template();
+    demo_atomic_flags();
+    std::cout << "\n";
+    benchmark_atomic_flags();
     std::cout << "\n(bits_masks_and_flags.cpp) OK\n";
     return 0;
 }
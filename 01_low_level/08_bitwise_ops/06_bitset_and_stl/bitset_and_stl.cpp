@@ -2,6 +2,8 @@
 bits_bitset_and_std_types.cpp
 Deep coverage: std::bitset, std::byte, and the infamous std::vector<bool>.
 Also shows bridging between raw integers and bitset, and common pitfalls.
+A run-time sized bitset with word operations (dynamic_bitset.h) and its benchmark
+against std::vector<bool> and std::bitset; run with a size in bits to benchmark another size.
 
 Build (C++17):
   g++ -std=c++17 -O2 -Wall -Wextra -pedantic bits_bitset_and_std_types.cpp -o bits_std
@@ -19,8 +21,14 @@ Build (C++17):
 #include <string>
 #include <vector>
 #include <iostream>
+#include <memory>
+#include <cstdlib>
 #include <type_traits>
 
+#include <utilities/benchmark.h>
+#include <utilities/generate.h>
+#include "dynamic_bitset.h"
+
 template <class T>
 using make_unsigned_t = typename std::make_unsigned<T>::type;
 
@@ -100,12 +108,193 @@ static void vector_bool_trap()
     // If you need a real container of bools, use std::vector<unsigned char> or std::vector<std::uint8_t>.
 }
 
-int main()
+static void dynamic_bitset_basics()
+{
+    std::cout << "\n== dynamic_bitset (size chosen at run time) ==\n";
+    bits::dynamic_bitset a(100);
+    bits::dynamic_bitset b(100);
+    for (std::size_t i = 0; i < 100; i += 3) a.set(i);
+    for (std::size_t i = 0; i < 100; i += 5) b.set(i);
+    std::cout << "a: multiples of 3, count=" << a.count() << "\n";
+    std::cout << "b: multiples of 5, count=" << b.count() << "\n";
+    std::cout << "intersection_count(a, b)=" << intersection_count(a, b) << " (multiples of 15)\n";
+    std::cout << "(a | b).count()=" << (a | b).count() << ", (a ^ b).count()=" << (a ^ b).count()
+              << ", (a - b).count()=" << (a - b).count() << "\n";
+
+    std::cout << "a & b, by find_next:";
+    const bits::dynamic_bitset both = a & b;
+    for (std::size_t i = both.find_first(); i != bits::dynamic_bitset::npos; i = both.find_next(i))
+        std::cout << " " << i;
+    std::cout << "\n~a: count=" << (~a).count() << " (unused bits of the last word stay zero)\n";
+
+    a.resize(130, true);
+    std::cout << "a.resize(130, true): count=" << a.count() << ", a[99]=" << a[99] << " a[100]=" << a[100] << "\n";
+}
+
+// Random operations on dynamic_bitset and std::vector<bool> side by side, odd size for a partial last word
+static void check_dynamic_bitset()
+{
+    const std::size_t n = 10'007;
+    const std::vector<std::uint32_t> r1 = rng::uniform_vector<std::uint32_t>(n, 0, 3, 5);
+    const std::vector<std::uint32_t> r2 = rng::uniform_vector<std::uint32_t>(n, 0, 1, 6);
+
+    bits::dynamic_bitset a(n), b(n);
+    std::vector<bool> va(n), vb(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        a.set(i, r1[i] == 0);
+        va[i] = r1[i] == 0;
+        b.set(i, r2[i] == 0);
+        vb[i] = r2[i] == 0;
+    }
+
+    auto same = [&](const bits::dynamic_bitset& d, const std::vector<bool>& v) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (d[i] != v[i]) return false;
+            count += v[i];
+        }
+        std::vector<std::size_t> listed;
+        d.for_each_set([&](std::size_t i) { listed.push_back(i); });
+        std::size_t found = 0;
+        for (std::size_t i = d.find_first(); i != bits::dynamic_bitset::npos; i = d.find_next(i)) ++found;
+        return d.count() == count && listed.size() == count && found == count;
+    };
+
+    std::vector<bool> v_and(n), v_or(n), v_xor(n), v_sub(n);
+    std::size_t common = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        v_and[i] = va[i] && vb[i];
+        v_or[i] = va[i] || vb[i];
+        v_xor[i] = va[i] != vb[i];
+        v_sub[i] = va[i] && !vb[i];
+        common += v_and[i];
+    }
+    const bool ok = same(a, va) && same(a & b, v_and) && same(a | b, v_or) && same(a ^ b, v_xor) &&
+                    same(a - b, v_sub) && intersection_count(a, b) == common && (~a).count() == n - a.count();
+    std::cout << "dynamic_bitset matches std::vector<bool>? " << ok << "\n";
+}
+
+constexpr std::size_t fixed_bits = std::size_t(1) << 24;
+
+// dynamic_bitset vs std::vector<bool> and std::bitset<fixed_bits>, half of the bits set at random
+static void benchmark_bitsets(std::size_t n)
+{
+    const std::vector<std::uint32_t> r1 = rng::uniform_vector<std::uint32_t>(n, 0, 1, 21);
+    const std::vector<std::uint32_t> r2 = rng::uniform_vector<std::uint32_t>(n, 0, 1, 22);
+
+    bits::dynamic_bitset da(n), db(n);
+    std::vector<bool> va(n), vb(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        da.set(i, r1[i] != 0);
+        va[i] = r1[i] != 0;
+        db.set(i, r2[i] != 0);
+        vb[i] = r2[i] != 0;
+    }
+    // std::bitset has a compile-time size, and 2 MB objects go to the heap, not to the stack
+    const bool with_bitset = n == fixed_bits;
+    std::unique_ptr<std::bitset<fixed_bits>> ba, bb;
+    if (with_bitset)
+    {
+        ba = std::make_unique<std::bitset<fixed_bits>>();
+        bb = std::make_unique<std::bitset<fixed_bits>>();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            (*ba)[i] = r1[i] != 0;
+            (*bb)[i] = r2[i] != 0;
+        }
+    }
+
+    bench::options opts;
+    opts.repetitions = 7;
+    const std::string size = std::to_string(n) + " bits";
+
+    {
+        bench::suite s("a &= b, " + size, opts);
+        s.run("vector<bool>", [&] {
+            std::vector<bool> r = va;
+            for (std::size_t i = 0; i < n; ++i) r[i] = r[i] && vb[i];
+            bench::do_not_optimize(r);
+        }, n);
+        if (with_bitset)
+        {
+            auto r = std::make_unique<std::bitset<fixed_bits>>();
+            s.run("std::bitset", [&] { *r = *ba; *r &= *bb; bench::do_not_optimize(*r); }, n);
+        }
+        bits::dynamic_bitset r;
+        s.run("dynamic_bitset", [&] { r = da; r &= db; bench::do_not_optimize(r); }, n);
+        s.report(std::cout);
+    }
+    {
+        bench::suite s("count(), " + size, opts);
+        s.run("vector<bool> std::count", [&] { bench::do_not_optimize(std::count(va.begin(), va.end(), true)); }, n);
+        if (with_bitset)
+            s.run("std::bitset", [&] { bench::do_not_optimize(ba->count()); }, n);
+        s.run("dynamic_bitset", [&] { bench::do_not_optimize(da.count()); }, n);
+        s.report(std::cout);
+    }
+    {
+        bench::suite s("(a & b).count(), " + size, opts);
+        s.run("vector<bool>", [&] {
+            std::size_t c = 0;
+            for (std::size_t i = 0; i < n; ++i) c += va[i] && vb[i];
+            bench::do_not_optimize(c);
+        }, n);
+        if (with_bitset)
+            s.run("std::bitset temporary", [&] { bench::do_not_optimize((*ba & *bb).count()); }, n);
+        s.run("dynamic_bitset temporary", [&] { bench::do_not_optimize((da & db).count()); }, n);
+        s.run("intersection_count", [&] { bench::do_not_optimize(intersection_count(da, db)); }, n);
+        s.report(std::cout);
+    }
+    {
+        bench::suite s("Visit set bits, " + size, opts);
+        s.run("vector<bool>", [&] {
+            std::size_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                if (va[i]) sum += i;
+            bench::do_not_optimize(sum);
+        }, n);
+        if (with_bitset)
+            s.run("std::bitset test()", [&] {
+                std::size_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i)
+                    if ((*ba)[i]) sum += i;
+                bench::do_not_optimize(sum);
+            }, n);
+        // every find_next() waits for the previous result, for_each_set() has no such dependency chain
+        s.run("dynamic_bitset find_next", [&] {
+            std::size_t sum = 0;
+            for (std::size_t i = da.find_first(); i != bits::dynamic_bitset::npos; i = da.find_next(i)) sum += i;
+            bench::do_not_optimize(sum);
+        }, n);
+        s.run("dynamic_bitset for_each_set", [&] {
+            std::size_t sum = 0;
+            da.for_each_set([&](std::size_t i) { sum += i; });
+            bench::do_not_optimize(sum);
+        }, n);
+        s.report(std::cout);
+    }
+}
+
+int main(int argc, char* argv[])
 {
     bitset_basics();
     bitset_as_mask_tool();
     std_byte_basics();
     vector_bool_trap();
+    dynamic_bitset_basics();
+    check_dynamic_bitset();
+
+    // std::bitset takes part only in the default size, which is its template argument
+    const std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : fixed_bits;
+    if (n > 0)
+    {
+        std::cout << "\n";
+        benchmark_bitsets(n);
+    }
 
     std::cout << "\n(bits_bitset_and_std_types.cpp) OK\n";
     return 0;
@@ -0,0 +1,494 @@
+#pragma once
+/*
+dynamic_bitset.h
+Bitset with the size chosen at run time, for sets of row numbers, visited flags, filters.
+
+std::bitset<N> has a compile-time size; std::vector<bool> has a run-time size, but hides its words:
+every operation goes bit by bit through proxy references, there is no AND of two vectors, no count(),
+no "find next set bit". Here bits are stored in 64-bit words, the lowest bit of word 0 is bit 0,
+and whole-set operations work on words:
+  - AND, OR, XOR, AND NOT of equal-sized sets: AVX-512, AVX2 or scalar loop, chosen at run time
+  - count(): the dispatched buffer popcount from popcount_buffer.h
+  - intersection_count(a, b): popcount of a & b without materializing a & b (one pass, no temporary)
+  - find_first()/find_next(): skip zero words, then count trailing zeros of the first non-zero word
+  - for_each_set(f): clear the lowest bit of a word until it's zero, one iteration per set bit
+
+Invariant: bits of the last word beyond size() are always zero, so word operations need no masking.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <utilities/cpu_features.h>
+#include <01_low_level/08_bitwise_ops/04_popcount_and_scans/popcount_buffer.h>
+
+namespace bits
+{
+
+namespace detail
+{
+
+inline unsigned ctz64(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#else
+    unsigned n = 0;
+    while ((x & 1) == 0) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Word operations; each one has a scalar form and, on x86, vector forms compiled for AVX2 and AVX-512
+struct op_and
+{
+    static std::uint64_t scalar(std::uint64_t a, std::uint64_t b) { return a & b; }
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+    __attribute__((target("avx2"))) static __m256i avx2(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+    __attribute__((target("avx512f"))) static __m512i avx512(__m512i a, __m512i b) { return _mm512_and_si512(a, b); }
+#endif
+};
+
+struct op_or
+{
+    static std::uint64_t scalar(std::uint64_t a, std::uint64_t b) { return a | b; }
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+    __attribute__((target("avx2"))) static __m256i avx2(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+    __attribute__((target("avx512f"))) static __m512i avx512(__m512i a, __m512i b) { return _mm512_or_si512(a, b); }
+#endif
+};
+
+struct op_xor
+{
+    static std::uint64_t scalar(std::uint64_t a, std::uint64_t b) { return a ^ b; }
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+    __attribute__((target("avx2"))) static __m256i avx2(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+    __attribute__((target("avx512f"))) static __m512i avx512(__m512i a, __m512i b) { return _mm512_xor_si512(a, b); }
+#endif
+};
+
+// a & ~b
+struct op_and_not
+{
+    static std::uint64_t scalar(std::uint64_t a, std::uint64_t b) { return a & ~b; }
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+    // andnot intrinsics negate the first operand
+    __attribute__((target("avx2"))) static __m256i avx2(__m256i a, __m256i b) { return _mm256_andnot_si256(b, a); }
+    // the compiler still emits vpandnq; _mm512_andnot_si512() trips -Wmaybe-uninitialized in GCC 12 headers
+    __attribute__((target("avx512f"))) static __m512i avx512(__m512i a, __m512i b)
+    {
+        return _mm512_and_si512(a, _mm512_xor_si512(b, _mm512_set1_epi64(-1)));
+    }
+#endif
+};
+
+// dst[i] = op(dst[i], src[i]) for `words` words
+using bitwise_function = void (*)(std::uint64_t* dst, const std::uint64_t* src, size_t words);
+
+template <class Op>
+void bitwise_scalar(std::uint64_t* dst, const std::uint64_t* src, size_t words)
+{
+    for (size_t i = 0; i < words; ++i) {
+        dst[i] = Op::scalar(dst[i], src[i]);
+    }
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+template <class Op>
+__attribute__((target("avx2"))) void bitwise_avx2(std::uint64_t* dst, const std::uint64_t* src, size_t words)
+{
+    size_t i = 0;
+    for (; i + 8 <= words; i += 8) {
+        __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+        const __m256i* s = reinterpret_cast<const __m256i*>(src + i);
+        const __m256i r0 = Op::avx2(_mm256_loadu_si256(d), _mm256_loadu_si256(s));
+        const __m256i r1 = Op::avx2(_mm256_loadu_si256(d + 1), _mm256_loadu_si256(s + 1));
+        _mm256_storeu_si256(d, r0);
+        _mm256_storeu_si256(d + 1, r1);
+    }
+    for (; i < words; ++i) {
+        dst[i] = Op::scalar(dst[i], src[i]);
+    }
+}
+
+template <class Op>
+__attribute__((target("avx512f"))) void bitwise_avx512(std::uint64_t* dst, const std::uint64_t* src, size_t words)
+{
+    size_t i = 0;
+    for (; i + 8 <= words; i += 8) {
+        _mm512_storeu_si512(dst + i, Op::avx512(_mm512_loadu_si512(dst + i), _mm512_loadu_si512(src + i)));
+    }
+    if (i < words) {
+        // the tail by masked loads and a masked store
+        const __mmask8 mask = static_cast<__mmask8>((1u << (words - i)) - 1);
+        const __m512i r = Op::avx512(_mm512_maskz_loadu_epi64(mask, dst + i), _mm512_maskz_loadu_epi64(mask, src + i));
+        _mm512_mask_storeu_epi64(dst + i, mask, r);
+    }
+}
+
+#endif // CPP_CPU_X86
+
+template <class Op>
+bitwise_function select_bitwise()
+{
+    static const cpu::implementation<bitwise_function> implementations[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx512", bitwise_avx512<Op>, {cpu::feature::avx512f}},
+        {"avx2", bitwise_avx2<Op>, {cpu::feature::avx2}},
+#endif
+        {"scalar", bitwise_scalar<Op>, {}}};
+    return cpu::select(implementations).function;
+}
+
+// Cached per operation, resolved on the first use
+template <class Op>
+void bitwise(std::uint64_t* dst, const std::uint64_t* src, size_t words)
+{
+    static const bitwise_function f = select_bitwise<Op>();
+    f(dst, src, words);
+}
+
+// popcount(a[i] & b[i]) summed over `words` words
+using and_count_function = std::uint64_t (*)(const std::uint64_t* a, const std::uint64_t* b, size_t words);
+
+inline std::uint64_t and_count_scalar(const std::uint64_t* a, const std::uint64_t* b, size_t words)
+{
+    std::uint64_t total = 0;
+    for (size_t i = 0; i < words; ++i) {
+        total += popcount64_swar(a[i] & b[i]);
+    }
+    return total;
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+__attribute__((target("popcnt"))) inline std::uint64_t and_count_popcnt(const std::uint64_t* a, const std::uint64_t* b, size_t words)
+{
+    std::uint64_t t0 = 0, t1 = 0;
+    size_t i = 0;
+    for (; i + 2 <= words; i += 2) {
+        t0 += static_cast<std::uint64_t>(__builtin_popcountll(a[i] & b[i]));
+        t1 += static_cast<std::uint64_t>(__builtin_popcountll(a[i + 1] & b[i + 1]));
+    }
+    if (i < words) {
+        t0 += static_cast<std::uint64_t>(__builtin_popcountll(a[i] & b[i]));
+    }
+    return t0 + t1;
+}
+
+__attribute__((target("avx2,popcnt"))) inline std::uint64_t and_count_avx2(const std::uint64_t* a, const std::uint64_t* b, size_t words)
+{
+    // the nibble lookup of every vector, popcount_avx2() Harley-Seal would need 16 ANDed vectors in registers
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        const __m256i x = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        total = _mm256_add_epi64(total, popcount256(x));
+    }
+    alignas(32) std::uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + and_count_popcnt(a + i, b + i, words - i);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq"))) inline std::uint64_t and_count_avx512(const std::uint64_t* a, const std::uint64_t* b, size_t words)
+{
+    __m512i total = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= words; i += 8) {
+        total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i))));
+    }
+    if (i < words) {
+        const __mmask8 mask = static_cast<__mmask8>((1u << (words - i)) - 1);
+        const __m512i x = _mm512_and_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i));
+        total = _mm512_add_epi64(total, _mm512_popcnt_epi64(x));
+    }
+    alignas(64) std::uint64_t lanes[8];
+    _mm512_store_si512(lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+#endif // CPP_CPU_X86
+
+inline std::uint64_t and_count(const std::uint64_t* a, const std::uint64_t* b, size_t words)
+{
+    static const cpu::implementation<and_count_function> implementations[] = {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        {"avx512 vpopcntdq", and_count_avx512, {cpu::feature::avx512f, cpu::feature::avx512vpopcntdq}},
+        {"avx2", and_count_avx2, {cpu::feature::avx2, cpu::feature::popcnt}},
+        {"popcnt", and_count_popcnt, {cpu::feature::popcnt}},
+#endif
+        {"swar", and_count_scalar, {}}};
+    static const and_count_function f = cpu::select(implementations).function;
+    return f(a, b, words);
+}
+
+} // namespace detail
+
+class dynamic_bitset
+{
+public:
+    using word_type = std::uint64_t;
+    static constexpr size_t bits_per_word = 64;
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    dynamic_bitset() = default;
+
+    explicit dynamic_bitset(size_t size, bool value = false)
+        : length(size)
+        , words(word_count_for(size), value ? ~word_type(0) : word_type(0))
+    {
+        clear_unused_bits();
+    }
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    // Raw words, e.g. to serialize or to pass to word kernels
+    size_t word_count() const { return words.size(); }
+    const word_type* data() const { return words.data(); }
+
+    void resize(size_t size, bool value = false)
+    {
+        const size_t old_size = length;
+        words.resize(word_count_for(size), value ? ~word_type(0) : word_type(0));
+        length = size;
+        if (value && size > old_size && old_size % bits_per_word != 0) {
+            // the tail of the old last word was zero by the invariant
+            words[old_size / bits_per_word] |= ~word_type(0) << (old_size % bits_per_word);
+        }
+        clear_unused_bits();
+    }
+
+    void clear()
+    {
+        words.clear();
+        length = 0;
+    }
+
+    bool test(size_t pos) const
+    {
+        return (words[pos / bits_per_word] >> (pos % bits_per_word)) & 1;
+    }
+
+    bool operator[](size_t pos) const
+    {
+        return test(pos);
+    }
+
+    dynamic_bitset& set(size_t pos)
+    {
+        words[pos / bits_per_word] |= word_type(1) << (pos % bits_per_word);
+        return *this;
+    }
+
+    dynamic_bitset& set(size_t pos, bool value)
+    {
+        // branchless: clear the bit, then OR the value in
+        const size_t shift = pos % bits_per_word;
+        word_type& w = words[pos / bits_per_word];
+        w = (w & ~(word_type(1) << shift)) | (word_type(value) << shift);
+        return *this;
+    }
+
+    dynamic_bitset& reset(size_t pos)
+    {
+        words[pos / bits_per_word] &= ~(word_type(1) << (pos % bits_per_word));
+        return *this;
+    }
+
+    dynamic_bitset& flip(size_t pos)
+    {
+        words[pos / bits_per_word] ^= word_type(1) << (pos % bits_per_word);
+        return *this;
+    }
+
+    dynamic_bitset& set()
+    {
+        std::fill(words.begin(), words.end(), ~word_type(0));
+        clear_unused_bits();
+        return *this;
+    }
+
+    dynamic_bitset& reset()
+    {
+        std::fill(words.begin(), words.end(), word_type(0));
+        return *this;
+    }
+
+    dynamic_bitset& flip()
+    {
+        for (word_type& w : words) {
+            w = ~w;
+        }
+        clear_unused_bits();
+        return *this;
+    }
+
+    size_t count() const
+    {
+        return static_cast<size_t>(popcount(words.data(), words.size() * sizeof(word_type)));
+    }
+
+    bool any() const
+    {
+        return std::any_of(words.begin(), words.end(), [](word_type w) { return w != 0; });
+    }
+
+    bool none() const
+    {
+        return !any();
+    }
+
+    bool all() const
+    {
+        return count() == length;
+    }
+
+    // Index of the first set bit, npos if none
+    size_t find_first() const
+    {
+        return find_from_word(0);
+    }
+
+    // Index of the first set bit after `pos`, npos if none
+    size_t find_next(size_t pos) const
+    {
+        ++pos;
+        if (pos >= length) {
+            return npos;
+        }
+        const size_t index = pos / bits_per_word;
+        const word_type w = words[index] & (~word_type(0) << (pos % bits_per_word));
+        if (w != 0) {
+            return index * bits_per_word + detail::ctz64(w);
+        }
+        return find_from_word(index + 1);
+    }
+
+    // Call f(index) for every set bit in increasing order
+    template <class F>
+    void for_each_set(F f) const
+    {
+        for (size_t i = 0; i < words.size(); ++i) {
+            for (word_type w = words[i]; w != 0; w &= w - 1) {
+                f(i * bits_per_word + detail::ctz64(w));
+            }
+        }
+    }
+
+    dynamic_bitset& operator&=(const dynamic_bitset& other)
+    {
+        return apply<detail::op_and>(other);
+    }
+
+    dynamic_bitset& operator|=(const dynamic_bitset& other)
+    {
+        return apply<detail::op_or>(other);
+    }
+
+    dynamic_bitset& operator^=(const dynamic_bitset& other)
+    {
+        return apply<detail::op_xor>(other);
+    }
+
+    // Remove bits set in `other`: *this &= ~other, without a temporary
+    dynamic_bitset& operator-=(const dynamic_bitset& other)
+    {
+        return apply<detail::op_and_not>(other);
+    }
+
+    dynamic_bitset operator~() const
+    {
+        dynamic_bitset result(*this);
+        result.flip();
+        return result;
+    }
+
+    friend bool operator==(const dynamic_bitset& a, const dynamic_bitset& b)
+    {
+        return a.length == b.length && a.words == b.words;
+    }
+
+    friend bool operator!=(const dynamic_bitset& a, const dynamic_bitset& b)
+    {
+        return !(a == b);
+    }
+
+    // Number of bits set in both, i.e. (a & b).count() in a single pass without a temporary bitset
+    friend size_t intersection_count(const dynamic_bitset& a, const dynamic_bitset& b)
+    {
+        check_sizes(a, b);
+        return static_cast<size_t>(detail::and_count(a.words.data(), b.words.data(), a.words.size()));
+    }
+
+private:
+    static size_t word_count_for(size_t size)
+    {
+        return (size + bits_per_word - 1) / bits_per_word;
+    }
+
+    static void check_sizes(const dynamic_bitset& a, const dynamic_bitset& b)
+    {
+        if (a.length != b.length) {
+            throw std::invalid_argument("dynamic_bitset: sizes of operands differ");
+        }
+    }
+
+    void clear_unused_bits()
+    {
+        if (length % bits_per_word != 0) {
+            words.back() &= ~(~word_type(0) << (length % bits_per_word));
+        }
+    }
+
+    size_t find_from_word(size_t index) const
+    {
+        for (; index < words.size(); ++index) {
+            if (words[index] != 0) {
+                return index * bits_per_word + detail::ctz64(words[index]);
+            }
+        }
+        return npos;
+    }
+
+    template <class Op>
+    dynamic_bitset& apply(const dynamic_bitset& other)
+    {
+        check_sizes(*this, other);
+        detail::bitwise<Op>(words.data(), other.words.data(), words.size());
+        return *this;
+    }
+
+    size_t length = 0;
+    std::vector<word_type> words;
+};
+
+inline dynamic_bitset operator&(dynamic_bitset a, const dynamic_bitset& b)
+{
+    return a &= b;
+}
+
+inline dynamic_bitset operator|(dynamic_bitset a, const dynamic_bitset& b)
+{
+    return a |= b;
+}
+
+inline dynamic_bitset operator^(dynamic_bitset a, const dynamic_bitset& b)
+{
+    return a ^= b;
+}
+
+inline dynamic_bitset operator-(dynamic_bitset a, const dynamic_bitset& b)
+{
+    return a -= b;
+}
+
+} // namespace bits
@@ -5,6 +5,14 @@ counting histograms, and why this is "bitwise-friendly" (no comparisons).
 
 Fixes the prior radix_sort.cpp: avoids pow/div, uses shifts & masks, and is stable.
 
+string_sort.h sorts variable-length keys (std::string, std::string_view) by in-place MSD radix sort.
+
+radix_sort.h generalizes radix_sort_u32 below: any key width, signed and floating point keys,
+key-plus-payload, configurable digit width and parallel passes.
+The benchmark compares it with std::sort; sizes are taken from the command line:
+  ./07_radix_and_layout 1000000 100000000 1000000000
+(1B 32-bit keys need ~12 GB: the input, the working copy and the radix buffer)
+
 Build (C++17):
   g++ -std=c++17 -O2 -Wall -Wextra -pedantic bits_radix_and_data_layout.cpp -o bits_radix
 */
@@ -22,6 +30,14 @@ Build (C++17):
 #include <vector>
 #include <algorithm>
 #include <type_traits>
+#include <cmath>
+#include <string>
+#include <utility>
+
+#include <utilities/benchmark.h>
+#include <utilities/generate.h>
+#include "radix_sort.h"
+#include "string_sort.h"
 
 template <class T>
 using make_unsigned_t = typename std::make_unsigned<T>::type;
@@ -101,9 +117,269 @@ static void demo_radix_sort()
         std::cout << "v[" << i << "]=" << v[i] << " bits=" << bits_u(v[i]) << "\n";
 }
 
-int main()
+template <class T>
+static void print_all(const char* title, const std::vector<T>& v)
+{
+    std::cout << title << ":";
+    for (const T& x : v) std::cout << " " << x;
+    std::cout << "\n";
+}
+
+template <class K>
+static void check_radix_sort(const char* name, const std::vector<K>& input, unsigned digit_bits, unsigned threads)
+{
+    std::vector<K> v = input;
+    std::vector<K> ref = input;
+    radix::options opts;
+    opts.digit_bits = digit_bits;
+    opts.threads = threads;
+    opts.min_elements_per_thread = 1024;
+    opts.min_combining_bytes = 0;
+    radix::sort(v, opts);
+    std::sort(ref.begin(), ref.end());
+    std::cout << name << ", " << digit_bits << "-bit digits, " << threads << " threads: matches std::sort? " << (v == ref) << "\n";
+}
+
+static void demo_radix_engine()
+{
+    std::cout << "\n== radix sort engine ==\n";
+
+    // Signed keys: the sign bit is flipped, so negative numbers go first
+    std::vector<int> ints = {5, -3, 0, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), -1, 42};
+    radix::sort(ints);
+    print_all("int", ints);
+
+    // Floats: negative numbers are flipped entirely, -0.0 goes before +0.0
+    std::vector<float> floats = {3.5f, -0.0f, 0.0f, -1e30f, INFINITY, -INFINITY, 1e-40f, -2.5f};
+    radix::sort(floats);
+    print_all("float", floats);
+
+    // Key + payload, stable: equal keys keep the original order of names
+    std::vector<std::uint8_t> ages = {30, 25, 30, 25, 40};
+    std::vector<std::string> names = {"Ann", "Bob", "Cid", "Dan", "Eve"};
+    radix::sort_by_key(ages, names);
+    for (std::size_t i = 0; i < ages.size(); ++i) std::cout << int(ages[i]) << ":" << names[i] << " ";
+    std::cout << "\n";
+
+    constexpr std::size_t n = 100'000;
+    check_radix_sort("u8", rng::uniform_vector<std::uint8_t>(n, 0, 255, 1), 8, 1);
+    check_radix_sort("u16", rng::uniform_vector<std::uint16_t>(n, 0, 0xFFFF, 2), 11, 1);
+    check_radix_sort("u64", rng::uniform_vector<std::uint64_t>(n, 0, ~std::uint64_t(0), 3), 16, 4);
+    check_radix_sort("i64", rng::uniform_vector<std::int64_t>(n, std::numeric_limits<std::int64_t>::min(), std::numeric_limits<std::int64_t>::max(), 4), 8, 3);
+    check_radix_sort("double", rng::uniform_vector<double>(n, -1e300, 1e300, 5), 11, 2);
+    check_radix_sort("float", rng::uniform_vector<float>(n, -1.0f, 1.0f, 6), 5, 1);
+    check_radix_sort("u32 < 2^16", rng::uniform_vector<std::uint32_t>(n, 0, 0xFFFF, 7), 8, 3);
+    check_radix_sort("i16 in [-5,5]", rng::uniform_vector<std::int16_t>(n, -5, 5, 8), 4, 2);
+}
+
+// Every repetition copies the unsorted input first, the copy is the same for all competitors
+template <class K>
+static void benchmark_sort(const char* type, std::size_t n, K lo, K hi)
+{
+    const std::vector<K> input = rng::uniform_vector<K>(n, lo, hi, 42);
+    std::vector<K> work;
+
+    bench::options opts;
+    opts.warmup = 1;
+    opts.repetitions = n >= 100'000'000 ? 3 : 7;
+    bench::suite s("Sort " + std::to_string(n) + " " + type, opts);
+
+    s.run("std::sort", [&] { work = input; std::sort(work.begin(), work.end()); }, n);
+    if constexpr (std::is_same_v<K, std::uint32_t>)
+        s.run("radix_sort_u32", [&] { work = input; radix_sort_u32(work); }, n);
+
+    // The same passes without the single histogram read, skipping trivial passes and write-combining
+    radix::options plain;
+    plain.single_histogram_pass = false;
+    plain.skip_trivial_passes = false;
+    plain.write_combining = false;
+    s.run("radix 8-bit, plain passes", [&] { work = input; radix::sort(work, plain); }, n);
+
+    const unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned digit_bits : {8u, 11u, 16u})
+    {
+        radix::options ro;
+        ro.digit_bits = digit_bits;
+        s.run("radix " + std::to_string(digit_bits) + "-bit", [&] { work = input; radix::sort(work, ro); }, n);
+    }
+    if (hardware_threads > 1)
+    {
+        radix::options ro;
+        ro.threads = hardware_threads;
+        s.run("radix 8-bit " + std::to_string(hardware_threads) + " threads", [&] { work = input; radix::sort(work, ro); }, n);
+    }
+    s.report(std::cout);
+}
+
+// Sorting records by a key: std::sort moves whole pairs, radix moves keys and payloads in two arrays
+static void benchmark_sort_by_key(std::size_t n)
+{
+    const std::vector<std::uint32_t> keys = rng::uniform_vector<std::uint32_t>(n, 0, 0xFFFF'FFFFu, 7);
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> records(n);
+    std::vector<std::uint32_t> work_keys;
+    std::vector<std::uint32_t> work_values(n);
+
+    bench::options opts;
+    opts.warmup = 1;
+    opts.repetitions = n >= 100'000'000 ? 3 : 7;
+    bench::suite s("Sort " + std::to_string(n) + " u32 keys with u32 payload", opts);
+    s.run("std::sort pairs by key", [&]
+        {
+            for (std::size_t i = 0; i < n; ++i) records[i] = {keys[i], static_cast<std::uint32_t>(i)};
+            std::sort(records.begin(), records.end(), [](const auto& a, const auto& b) { return a.first < b.first; }); }, n);
+    s.run("std::stable_sort pairs", [&]
+        {
+            for (std::size_t i = 0; i < n; ++i) records[i] = {keys[i], static_cast<std::uint32_t>(i)};
+            std::stable_sort(records.begin(), records.end(), [](const auto& a, const auto& b) { return a.first < b.first; }); }, n);
+    s.run("radix::sort_by_key", [&]
+        {
+            work_keys = keys;
+            for (std::size_t i = 0; i < n; ++i) work_values[i] = static_cast<std::uint32_t>(i);
+            radix::sort_by_key(work_keys, work_values); }, n);
+    s.report(std::cout);
+}
+
+// Every step of pass optimizations separately, see "Memory traffic" in radix_sort.h.
+// Keys below 2^16 have two constant high bytes, so two of four passes are skipped
+static void benchmark_radix_passes(std::size_t n)
 {
+    bench::options opts;
+    opts.warmup = 1;
+    opts.repetitions = n >= 100'000'000 ? 3 : 7;
+
+    for (const std::uint32_t max_key : {0xFFFF'FFFFu, 0xFFFFu})
+    {
+        const std::vector<std::uint32_t> input = rng::uniform_vector<std::uint32_t>(n, 0, max_key, 11);
+        std::vector<std::uint32_t> work;
+        bench::suite s("Radix passes, " + std::to_string(n) + " u32 keys in [0," + std::to_string(max_key) + "]", opts);
+
+        radix::options ro;
+        ro.single_histogram_pass = false;
+        ro.skip_trivial_passes = false;
+        ro.write_combining = false;
+        s.run("histogram per pass", [&] { work = input; radix::sort(work, ro); }, n);
+        ro.single_histogram_pass = true;
+        s.run("+ single histogram read", [&] { work = input; radix::sort(work, ro); }, n);
+        ro.skip_trivial_passes = true;
+        s.run("+ skip trivial passes", [&] { work = input; radix::sort(work, ro); }, n);
+        // forced for any size, to see that it only pays off for arrays larger than the cache
+        ro.write_combining = true;
+        ro.min_combining_bytes = 0;
+        s.run("+ write-combining", [&] { work = input; radix::sort(work, ro); }, n);
+        s.report(std::cout);
+    }
+}
+
+enum class key_kind { identifiers, prefixed, urls };
+
+// Realistic keys: random identifiers, keys with a common prefix, URLs sharing hosts and paths
+static std::vector<std::string> make_string_keys(key_kind kind, std::size_t n, std::uint64_t seed)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    static const char* const hosts[] = {"example.com", "shop.example.com", "api.example.org", "cdn.example.net"};
+    static const char* const sections[] = {"users", "orders", "products", "search", "images", "static/js", "blog", "help"};
+
+    rng::xoshiro256ss gen(seed);
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        std::string key;
+        switch (kind)
+        {
+        case key_kind::identifiers:
+        {
+            const std::size_t length = 8 + rng::bounded(gen, 17);
+            for (std::size_t c = 0; c < length; ++c) key += alphabet[rng::bounded(gen, sizeof(alphabet) - 1)];
+            break;
+        }
+        case key_kind::prefixed:
+        {
+            std::string number = std::to_string(rng::bounded(gen, 1'000'000'000));
+            key = "customer:" + std::string(9 - number.size(), '0') + number;
+            break;
+        }
+        case key_kind::urls:
+            key = std::string("https://") + hosts[rng::bounded(gen, 4)] + "/" + sections[rng::bounded(gen, 8)] + "/" +
+                  std::to_string(rng::bounded(gen, 10'000'000)) + ".html";
+            break;
+        }
+        keys.push_back(std::move(key));
+    }
+    return keys;
+}
+
+static void demo_string_sort()
+{
+    std::cout << "\n== MSD radix sort of strings ==\n";
+    std::vector<std::string> words = {"banana", "", "apple", "app", "b", "\xff", "apple", "application", "Zebra", "ban"};
+    radix::sort_strings(words);
+    for (const std::string& w : words) std::cout << "'" << w << "' ";
+    std::cout << "\n";
+
+    for (key_kind kind : {key_kind::identifiers, key_kind::prefixed, key_kind::urls})
+    {
+        const std::vector<std::string> source = make_string_keys(kind, 50'000, 1);
+        // views refer to `source`, sorting `keys` swaps contents of short strings
+        std::vector<std::string> keys = source;
+        std::vector<std::string_view> views(source.begin(), source.end());
+        std::vector<std::string> ref = source;
+        std::sort(ref.begin(), ref.end());
+        radix::sort_strings(keys);
+        radix::sort_strings(views);
+        const bool views_match = std::equal(views.begin(), views.end(), ref.begin(), ref.end());
+        std::cout << "string keys " << static_cast<int>(kind) << ": matches std::sort? " << (keys == ref) << ", string_view: " << views_match << "\n";
+    }
+}
+
+static void benchmark_string_sort(std::size_t n)
+{
+    bench::options opts;
+    opts.warmup = 1;
+    opts.repetitions = 5;
+
+    const char* names[] = {"random identifiers", "\"customer:\" + 9 digits", "URLs"};
+    for (key_kind kind : {key_kind::identifiers, key_kind::prefixed, key_kind::urls})
+    {
+        const std::vector<std::string> keys = make_string_keys(kind, n, 42);
+        const std::vector<std::string_view> views(keys.begin(), keys.end());
+        std::vector<std::string> work;
+        std::vector<std::string_view> work_views;
+
+        bench::suite s("Sort " + std::to_string(n) + " strings, " + names[static_cast<int>(kind)], opts);
+        s.run("std::sort string", [&] { work = keys; std::sort(work.begin(), work.end()); }, n);
+        s.run("radix string", [&] { work = keys; radix::sort_strings(work); }, n);
+        s.run("std::sort string_view", [&] { work_views = views; std::sort(work_views.begin(), work_views.end()); }, n);
+        s.run("radix string_view", [&] { work_views = views; radix::sort_strings(work_views); }, n);
+        s.report(std::cout);
+    }
+}
+
+static void benchmark_radix_sort(const std::vector<std::size_t>& sizes)
+{
+    std::cout << "\n== radix sort benchmark ==\n";
+    for (std::size_t n : sizes)
+    {
+        benchmark_sort<std::uint32_t>("u32", n, 0, 0xFFFF'FFFFu);
+        benchmark_sort<std::uint64_t>("u64", n, 0, ~std::uint64_t(0));
+        benchmark_sort<float>("float", n, -1e6f, 1e6f);
+        benchmark_sort_by_key(n);
+        benchmark_radix_passes(n);
+    }
+    // strings take ~40 bytes each, the first size only
+    benchmark_string_sort(sizes.front());
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::stoull(argv[i]));
+    if (sizes.empty()) sizes = {1'000'000, 10'000'000};
+
     demo_radix_sort();
+    demo_radix_engine();
+    demo_string_sort();
+    benchmark_radix_sort(sizes);
     std::cout << "\n(bits_radix_and_data_layout.cpp) OK\n";
     return 0;
 }
@@ -0,0 +1,434 @@
+#pragma once
+/*
+radix_sort.h
+Reusable LSD radix sort: any integer width, signed integers and IEEE floats, key-plus-payload,
+configurable digit width, and parallel passes with per-thread histograms.
+
+Every pass is a stable counting sort by one digit (digit_bits bits), from the least significant digit.
+A pass is 3 steps:
+  1. histogram: every thread counts digits in its contiguous part of the input
+  2. prefix sum: the output position of (digit d, thread t) is
+     the number of elements with smaller digits plus the number of elements with digit d in threads before t.
+     Threads compute it in parallel, every thread for its own range of digits
+  3. scatter: every thread moves its elements to their positions.
+     Threads write to disjoint positions, and within a thread the order is preserved, so the sort is stable
+
+Non-unsigned keys are mapped to unsigned "bits" with the same order (key flipping):
+  - signed integers: flip the sign bit, so negative numbers go before positive
+  - IEEE floats: flip the sign bit of positive numbers and all bits of negative numbers
+    (negative numbers are stored as sign + magnitude, so bigger magnitude must give a smaller key).
+    The order is total: -NaN < -inf < ... < -0.0 < +0.0 < ... < +inf < +NaN
+Keys are flipped on the fly when the digit is extracted, the input is never modified.
+
+Memory traffic: a naive pass reads the data twice (histogram, scatter) and writes it once, and every scattered
+store first reads its cache line (read for ownership), so 4 passes over 32-bit keys take 16 sweeps of the array.
+  - histograms of all digits are counted in a single read before the first pass: 13 sweeps. Alone it saves
+    only a quarter of the plain reads and writes (9 instead of 12), the histogram is 1 of 3 of them in a pass
+  - the scatter writes through write-combining buffers with non-temporal stores (SSE2), see scatter_combining():
+    no reads for ownership, 9 sweeps, together 44% less than 16, the one third is reached with both of them
+  - a pass where all keys have the same digit (e.g. high bytes of small numbers) would copy the array as is,
+    and it's skipped: 2 sweeps less per skipped pass
+*/
+
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace radix
+{
+
+// Unsigned "bits" of a key, ordered as the keys
+template <class T, class = void>
+struct key_traits;
+
+template <class T>
+struct key_traits<T, std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T> && !std::is_same_v<T, bool>>>
+{
+    using bits_type = T;
+    static bits_type to_bits(T key) { return key; }
+};
+
+template <class T>
+struct key_traits<T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>>>
+{
+    using bits_type = std::make_unsigned_t<T>;
+    static constexpr bits_type sign_bit = bits_type(bits_type(1) << (sizeof(T) * CHAR_BIT - 1));
+
+    static bits_type to_bits(T key)
+    {
+        return static_cast<bits_type>(static_cast<bits_type>(key) ^ sign_bit);
+    }
+};
+
+template <class T>
+struct key_traits<T, std::enable_if_t<std::is_floating_point_v<T>>>
+{
+    static_assert(std::numeric_limits<T>::is_iec559 && (sizeof(T) == 4 || sizeof(T) == 8), "IEEE float or double expected");
+    using bits_type = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+    static constexpr unsigned width = sizeof(T) * CHAR_BIT;
+    static constexpr bits_type sign_bit = bits_type(1) << (width - 1);
+
+    static bits_type to_bits(T key)
+    {
+        bits_type b;
+        std::memcpy(&b, &key, sizeof(b));
+        // all ones for negative numbers, only the sign bit for positive ones
+        const bits_type mask = static_cast<bits_type>(0 - (b >> (width - 1))) | sign_bit;
+        return b ^ mask;
+    }
+};
+
+struct options
+{
+    // bits per pass, 1..16. 8 bits = 256 counters per thread, fit L1 easily;
+    // 11 bits = 3 passes instead of 4 for 32-bit keys, but 2048 counters and scattering to 2048 places
+    unsigned digit_bits = 8;
+
+    // 0 means std::thread::hardware_concurrency()
+    unsigned threads = 1;
+
+    // don't start a thread for less elements
+    size_t min_elements_per_thread = 64 * 1024;
+
+    // count digits of all passes in a single read of the input, instead of a read per pass
+    bool single_histogram_pass = true;
+
+    // skip passes where all keys have the same digit, e.g. small numbers in wide keys (needs single_histogram_pass)
+    bool skip_trivial_passes = true;
+
+    // scatter through cache-line buffers per digit, used up to max_combining_radix digits
+    // and for arrays of at least min_combining_bytes
+    bool write_combining = true;
+    size_t min_combining_bytes = 8 * 1024 * 1024;
+};
+
+// 1024 buffers of 64 bytes (and as many for payloads) still fit L1/L2
+constexpr size_t max_combining_radix = 1024;
+
+namespace detail
+{
+
+// Threads wait until all of them arrive, then go on together. Reusable
+class barrier
+{
+public:
+    explicit barrier(unsigned threads) : threads(threads)
+    {
+    }
+
+    void arrive_and_wait()
+    {
+        if (threads == 1) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        const size_t current = generation;
+        if (++arrived == threads) {
+            arrived = 0;
+            ++generation;
+            lock.unlock();
+            released.notify_all();
+            return;
+        }
+        released.wait(lock, [&] { return generation != current; });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    const unsigned threads;
+    unsigned arrived = 0;
+    size_t generation = 0;
+};
+
+// Placeholder payload for sorting keys only
+struct no_payload
+{
+};
+
+// Scatter [begin, end) of `src` by digits to positions `pos`, advancing them
+template <class K, class V, class Digit>
+void scatter(const K* src, V* value_src, K* dst, V* value_dst, size_t begin, size_t end, size_t* pos, Digit digit)
+{
+    constexpr bool has_payload = !std::is_same_v<V, no_payload>;
+    for (size_t i = begin; i < end; ++i) {
+        const size_t to = pos[digit(src[i])]++;
+        dst[to] = src[i];
+        if constexpr (has_payload) {
+            value_dst[to] = std::move(value_src[i]);
+        }
+    }
+}
+
+// Scatter through software write-combining buffers.
+// Consecutive elements go to up to `radix` different places, and every single store touches a different cache line,
+// which has to be read first (read for ownership) and is often evicted before the next store to it.
+// Instead elements are collected in a small buffer per digit, and a buffer is flushed to the output
+// when it fills a whole cache line, so every output line is written at once, bypassing the cache.
+// The first flush of a digit is shorter, to align the following flushes with cache lines
+template <class K, class V, class Digit>
+void scatter_combining(const K* src, V* value_src, K* dst, V* value_dst, size_t begin, size_t end, size_t* pos,
+    size_t radix, Digit digit)
+{
+    constexpr bool has_payload = !std::is_same_v<V, no_payload>;
+    constexpr size_t line = 64;
+    constexpr size_t per_line = line / sizeof(K);
+
+    std::vector<K> key_lines(radix * per_line);
+    std::vector<V> value_lines(has_payload ? radix * per_line : 0);
+    std::vector<std::uint8_t> filled(radix, 0);
+    std::vector<std::uint8_t> limit(radix);
+    for (size_t d = 0; d < radix; ++d) {
+        const size_t misalignment = reinterpret_cast<std::uintptr_t>(dst + pos[d]) % line / sizeof(K);
+        limit[d] = static_cast<std::uint8_t>(per_line - misalignment);
+    }
+
+    auto flush = [&](size_t d) {
+        const size_t count = filled[d];
+        if (count == per_line) {
+#if defined(__SSE2__)
+            // the line is aligned: non-temporal stores write it to memory without reading it into the cache first
+            const __m128i* from = reinterpret_cast<const __m128i*>(&key_lines[d * per_line]);
+            __m128i* to = reinterpret_cast<__m128i*>(dst + pos[d]);
+            _mm_stream_si128(to, _mm_loadu_si128(from));
+            _mm_stream_si128(to + 1, _mm_loadu_si128(from + 1));
+            _mm_stream_si128(to + 2, _mm_loadu_si128(from + 2));
+            _mm_stream_si128(to + 3, _mm_loadu_si128(from + 3));
+#else
+            std::memcpy(dst + pos[d], &key_lines[d * per_line], line);
+#endif
+        }
+        else {
+            std::memcpy(dst + pos[d], &key_lines[d * per_line], count * sizeof(K));
+        }
+        if constexpr (has_payload) {
+            std::move(&value_lines[d * per_line], &value_lines[d * per_line] + count, value_dst + pos[d]);
+        }
+        pos[d] += count;
+        filled[d] = 0;
+        limit[d] = static_cast<std::uint8_t>(per_line);
+    };
+
+    for (size_t i = begin; i < end; ++i) {
+        const size_t d = digit(src[i]);
+        const size_t slot = d * per_line + filled[d];
+        key_lines[slot] = src[i];
+        if constexpr (has_payload) {
+            value_lines[slot] = std::move(value_src[i]);
+        }
+        if (++filled[d] == limit[d]) {
+            flush(d);
+        }
+    }
+    for (size_t d = 0; d < radix; ++d) {
+        if (filled[d]) {
+            flush(d);
+        }
+    }
+#if defined(__SSE2__)
+    // non-temporal stores are weakly ordered, make them visible before other threads read the output
+    _mm_sfence();
+#endif
+}
+
+template <class K, class V>
+void lsd_sort(K* keys, V* values, size_t n, const options& opts)
+{
+    using traits = key_traits<K>;
+    using bits_type = typename traits::bits_type;
+    constexpr bool has_payload = !std::is_same_v<V, no_payload>;
+    constexpr unsigned key_bits = sizeof(bits_type) * CHAR_BIT;
+
+    if (n < 2) {
+        return;
+    }
+
+    const unsigned digit_bits = std::min(std::clamp(opts.digit_bits, 1u, 16u), key_bits);
+    const size_t radix = size_t(1) << digit_bits;
+    const bits_type mask = static_cast<bits_type>(radix - 1);
+    const unsigned passes = (key_bits + digit_bits - 1) / digit_bits;
+
+    unsigned threads = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(1, n / std::max<size_t>(1, opts.min_elements_per_thread))));
+
+    // while the array fits the cache, buffering only adds work
+    const bool combining = opts.write_combining && radix <= max_combining_radix && n * sizeof(K) >= opts.min_combining_bytes &&
+        std::is_trivially_copyable_v<K> && 64 % sizeof(K) == 0 && sizeof(K) <= 16;
+
+    std::vector<K> key_buffer(n);
+    std::vector<V> value_buffer(has_payload ? n : 0);
+
+    // histograms of all passes of a thread, the next thread starts at a separate cache line
+    const size_t stride = radix * passes + 64 / sizeof(size_t);
+    std::vector<size_t> counts(threads * stride);
+    std::vector<size_t> digit_sums(threads);
+    barrier sync(threads);
+
+    auto worker = [&](unsigned t) {
+        const size_t begin = n * t / threads;
+        const size_t end = n * (t + 1) / threads;
+        const size_t first_digit = radix * t / threads;
+        const size_t last_digit = radix * (t + 1) / threads;
+        size_t* own = &counts[t * stride];
+
+        auto digit_of = [&](const K& key, unsigned pass) {
+            return static_cast<size_t>((traits::to_bits(key) >> (pass * digit_bits)) & mask);
+        };
+
+        // Histograms of all digits in a single read of the input.
+        // Total counts don't depend on the order of elements, so they are valid for every pass,
+        // and a pass with all elements in one bucket doesn't move anything and is skipped
+        if (opts.single_histogram_pass) {
+            std::fill(own, own + radix * passes, size_t(0));
+            for (size_t i = begin; i < end; ++i) {
+                const bits_type bits = traits::to_bits(keys[i]);
+                for (unsigned pass = 0; pass < passes; ++pass) {
+                    ++own[pass * radix + static_cast<size_t>((bits >> (pass * digit_bits)) & mask)];
+                }
+            }
+        }
+        sync.arrive_and_wait();
+
+        std::vector<bool> trivial(passes, false);
+        if (opts.single_histogram_pass && opts.skip_trivial_passes) {
+            for (unsigned pass = 0; pass < passes; ++pass) {
+                for (size_t d = 0; d < radix && !trivial[pass]; ++d) {
+                    size_t total = 0;
+                    for (unsigned other = 0; other < threads; ++other) {
+                        total += counts[other * stride + pass * radix + d];
+                    }
+                    trivial[pass] = total == n;
+                }
+            }
+        }
+        // every thread has decided, now histograms may be modified
+        sync.arrive_and_wait();
+
+        K* src = keys;
+        K* dst = key_buffer.data();
+        V* value_src = values;
+        V* value_dst = value_buffer.data();
+        bool moved = false;
+
+        for (unsigned pass = 0; pass < passes; ++pass) {
+            if (trivial[pass]) {
+                continue;
+            }
+            size_t* count = own + pass * radix;
+            auto digit = [&](const K& key) {
+                return digit_of(key, pass);
+            };
+
+            // 1. histogram of own part. Precomputed histograms of the parts are valid only before
+            //    elements move between threads; a single thread sorts the whole array, so its histograms are always valid
+            if (!opts.single_histogram_pass || (moved && threads > 1)) {
+                std::fill(count, count + radix, size_t(0));
+                for (size_t i = begin; i < end; ++i) {
+                    ++count[digit(src[i])];
+                }
+                sync.arrive_and_wait();
+            }
+
+            // 2. prefix sum in (digit, thread) order; own digits first, then shift by digits of previous threads
+            size_t sum = 0;
+            for (size_t d = first_digit; d < last_digit; ++d) {
+                for (unsigned other = 0; other < threads; ++other) {
+                    sum += counts[other * stride + pass * radix + d];
+                }
+            }
+            digit_sums[t] = sum;
+            sync.arrive_and_wait();
+
+            size_t position = 0;
+            for (unsigned other = 0; other < t; ++other) {
+                position += digit_sums[other];
+            }
+            for (size_t d = first_digit; d < last_digit; ++d) {
+                for (unsigned other = 0; other < threads; ++other) {
+                    size_t& c = counts[other * stride + pass * radix + d];
+                    const size_t elements = c;
+                    c = position;
+                    position += elements;
+                }
+            }
+            sync.arrive_and_wait();
+
+            // 3. scatter own part, stable
+            if (combining) {
+                scatter_combining(src, value_src, dst, value_dst, begin, end, count, radix, digit);
+            }
+            else {
+                scatter(src, value_src, dst, value_dst, begin, end, count, digit);
+            }
+            sync.arrive_and_wait();
+
+            std::swap(src, dst);
+            std::swap(value_src, value_dst);
+            moved = true;
+        }
+
+        // odd number of passes, the result is in the buffer
+        if (src != keys) {
+            std::copy(src + begin, src + end, keys + begin);
+            if constexpr (has_payload) {
+                std::move(value_src + begin, value_src + end, values + begin);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& w : workers) {
+        w.join();
+    }
+}
+
+} // namespace detail
+
+// Sort keys [first, last) in ascending order
+template <class K>
+void sort(K* first, K* last, const options& opts = options())
+{
+    detail::lsd_sort<K, detail::no_payload>(first, nullptr, static_cast<size_t>(last - first), opts);
+}
+
+template <class K>
+void sort(std::vector<K>& keys, const options& opts = options())
+{
+    sort(keys.data(), keys.data() + keys.size(), opts);
+}
+
+// Sort keys [first, last) and apply the same permutation to values starting at `values`.
+// Stable: values with equal keys keep their order
+template <class K, class V>
+void sort_by_key(K* first, K* last, V* values, const options& opts = options())
+{
+    detail::lsd_sort<K, V>(first, values, static_cast<size_t>(last - first), opts);
+}
+
+template <class K, class V>
+void sort_by_key(std::vector<K>& keys, std::vector<V>& values, const options& opts = options())
+{
+    if (keys.size() != values.size()) {
+        throw std::invalid_argument("radix::sort_by_key: keys and values differ in size");
+    }
+    sort_by_key(keys.data(), keys.data() + keys.size(), values.data(), opts);
+}
+
+} // namespace radix
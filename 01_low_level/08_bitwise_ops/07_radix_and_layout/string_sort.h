@@ -0,0 +1,178 @@
+#pragma once
+/*
+string_sort.h
+MSD radix sort of strings, American flag variant (McIlroy, Bostic, McIlroy, "Engineering Radix Sort").
+
+Strings have different lengths, so LSD passes over "all digits" don't work; MSD sort goes from the first byte:
+  1. count strings by the byte at position `depth` (bucket 0 for strings ending before it, so they go first)
+  2. permute strings in place into their buckets: take a string, swap it into the next free place of its bucket,
+     repeat with the string found there, until the current place gets a string of its own bucket
+     (no second array as in LSD sort, the memory is not doubled)
+  3. sort every bucket by the next byte, strings of bucket 0 are equal and done
+
+Small buckets are sorted by insertion sort comparing only the bytes after `depth`,
+counting 257 buckets for a handful of strings costs more than sorting them.
+A byte common for all strings of the range is not permuted, the whole common prefix is skipped at once.
+
+Compared with std::sort, every byte of a key is inspected about once instead of comparing
+common prefixes again and again, O(log n) times per string.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace radix
+{
+
+namespace detail
+{
+
+// Ranges smaller than this are sorted by insertion sort
+constexpr size_t string_insertion_threshold = 32;
+
+// Bucket of the byte at `depth`: 0 for strings ending before it, byte + 1 otherwise
+template <class S>
+inline size_t string_digit(const S& s, size_t depth)
+{
+    return depth < s.size() ? static_cast<unsigned char>(s[depth]) + size_t(1) : 0;
+}
+
+// Strings of the range are equal up to `depth`, compare the rest only
+template <class S>
+void string_insertion_sort(S* first, S* last, size_t depth)
+{
+    for (S* i = first + 1; i < last; ++i) {
+        const std::string_view key = std::string_view(*i).substr(depth);
+        if (!(key < std::string_view(*(i - 1)).substr(depth))) {
+            continue;
+        }
+        S value = std::move(*i);
+        S* j = i;
+        do {
+            *j = std::move(*(j - 1));
+            --j;
+        } while (j > first && std::string_view(value).substr(depth) < std::string_view(*(j - 1)).substr(depth));
+        *j = std::move(value);
+    }
+}
+
+template <class S>
+void american_flag_sort(S* first, S* last)
+{
+    struct range
+    {
+        S* first;
+        S* last;
+        size_t depth;
+    };
+
+    constexpr size_t buckets = 257;
+    // the explicit stack instead of recursion, ranges are pushed as long as their keys have common prefixes
+    std::vector<range> stack;
+    stack.push_back({first, last, 0});
+
+    // the byte of every string at the current depth, read once by the histogram step:
+    // reading it from the string is a cache miss, its characters are somewhere in the heap
+    std::vector<std::uint16_t> digits(static_cast<size_t>(last - first));
+
+    size_t count[buckets];
+    size_t next[buckets];
+    size_t end[buckets];
+
+    while (!stack.empty()) {
+        range r = stack.back();
+        stack.pop_back();
+
+        const size_t n = static_cast<size_t>(r.last - r.first);
+        if (n < string_insertion_threshold) {
+            string_insertion_sort(r.first, r.last, r.depth);
+            continue;
+        }
+
+        // 1. histogram
+        S* strings = r.first;
+        std::uint16_t* digit = digits.data() + (r.first - first);
+        std::fill(count, count + buckets, size_t(0));
+        for (size_t i = 0; i < n; ++i) {
+            digit[i] = static_cast<std::uint16_t>(string_digit(strings[i], r.depth));
+            ++count[digit[i]];
+        }
+
+        // all strings have the same byte here, no permutation is needed.
+        // Such bytes usually start a longer common prefix ("https://www."), find all of it in a single scan
+        // instead of a scan per byte
+        const size_t common = digit[0];
+        if (count[common] == n) {
+            if (common != 0) {
+                const std::string_view pivot(strings[0]);
+                size_t prefix = pivot.size();
+                for (size_t i = 1; i < n && prefix > r.depth + 1; ++i) {
+                    const std::string_view s(strings[i]);
+                    const size_t limit = std::min(prefix, s.size());
+                    size_t k = r.depth + 1;
+                    while (k < limit && s[k] == pivot[k]) {
+                        ++k;
+                    }
+                    prefix = k;
+                }
+                stack.push_back({r.first, r.last, std::max(prefix, r.depth + 1)});
+            }
+            continue;
+        }
+
+        // 2. in-place permutation, cached digits move along with their strings
+        size_t offset = 0;
+        for (size_t b = 0; b < buckets; ++b) {
+            next[b] = offset;
+            offset += count[b];
+            end[b] = offset;
+        }
+        for (size_t b = 0; b < buckets; ++b) {
+            while (next[b] < end[b]) {
+                const size_t i = next[b];
+                size_t d = digit[i];
+                while (d != b) {
+                    const size_t j = next[d]++;
+                    using std::swap;
+                    swap(strings[i], strings[j]);
+                    std::swap(digit[i], digit[j]);
+                    d = digit[i];
+                }
+                ++next[b];
+            }
+        }
+
+        // 3. buckets by the next byte, bucket 0 holds equal strings
+        S* position = r.first + count[0];
+        for (size_t b = 1; b < buckets; ++b) {
+            if (count[b] > 1) {
+                stack.push_back({position, position + count[b], r.depth + 1});
+            }
+            position += count[b];
+        }
+    }
+}
+
+} // namespace detail
+
+// Sort std::string or std::string_view [first, last) in lexicographical order of bytes, as std::sort does
+template <class S>
+void sort_strings(S* first, S* last)
+{
+    if (last - first > 1) {
+        detail::american_flag_sort(first, last);
+    }
+}
+
+template <class S>
+void sort_strings(std::vector<S>& strings)
+{
+    sort_strings(strings.data(), strings.data() + strings.size());
+}
+
+} // namespace radix
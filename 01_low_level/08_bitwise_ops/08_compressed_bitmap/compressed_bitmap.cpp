@@ -0,0 +1,342 @@
+/*
+compressed_bitmap.cpp
+Roaring-style compressed bitmap (roaring_bitmap.h): array, bitmap and run containers per 64K chunk,
+union and intersection by container pairs, rank/select, and a flat serialized form
+queried in place by roaring_view, here over a memory-mapped file.
+
+The benchmark compares size and speed with the uncompressed dynamic_bitset on sparse, dense
+and clustered sets; the universe size is taken from the command line:
+  ./08_compressed_bitmap 16777216
+
+Build (C++17):
+  g++ -std=c++17 -O2 -Wall -Wextra -pedantic -I../../.. compressed_bitmap.cpp -o compressed_bitmap
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <utilities/benchmark.h>
+#include <utilities/generate.h>
+#include "roaring_bitmap.h"
+
+enum class density
+{
+    sparse,
+    dense,
+    clustered
+};
+
+static const char* density_name(density d)
+{
+    switch (d)
+    {
+    case density::sparse: return "sparse (1/200)";
+    case density::dense: return "dense (1/2)";
+    case density::clustered: return "clustered runs";
+    }
+    return "";
+}
+
+// Sorted distinct values in [0, universe)
+static std::vector<std::uint32_t> make_values(density d, std::uint32_t universe, std::uint64_t seed)
+{
+    std::vector<std::uint32_t> values;
+    if (d == density::clustered)
+    {
+        // intervals of 1..4000 values separated by gaps of 1..8000
+        rng::xoshiro256ss engine(seed);
+        std::uint64_t v = rng::bounded(engine, 8000);
+        while (v < universe)
+        {
+            const std::uint64_t end = std::min<std::uint64_t>(universe, v + 1 + rng::bounded(engine, 4000));
+            for (; v < end; ++v)
+                values.push_back(static_cast<std::uint32_t>(v));
+            v += 1 + rng::bounded(engine, 8000);
+        }
+        return values;
+    }
+    const std::uint32_t keep_one_of = d == density::sparse ? 200 : 2;
+    const std::vector<std::uint32_t> r = rng::uniform_vector<std::uint32_t>(universe, 0, keep_one_of - 1, seed);
+    for (std::uint32_t i = 0; i < universe; ++i)
+    {
+        if (r[i] == 0)
+            values.push_back(i);
+    }
+    return values;
+}
+
+static void demo_roaring()
+{
+    std::cout << "== roaring bitmap ==\n";
+    bits::roaring_bitmap a = {1, 2, 3, 1000, 70000, 70001};
+    for (std::uint32_t v = 200000; v < 210000; ++v)
+        a.add(v);
+    auto counts = a.container_counts();
+    std::cout << "cardinality=" << a.cardinality() << ", containers array/bitmap/run: "
+              << counts[0] << "/" << counts[1] << "/" << counts[2] << ", " << a.size_in_bytes() << " bytes\n";
+    a.run_optimize();
+    counts = a.container_counts();
+    std::cout << "after run_optimize(): array/bitmap/run " << counts[0] << "/" << counts[1] << "/" << counts[2]
+              << ", " << a.size_in_bytes() << " bytes\n";
+
+    std::cout << "contains(1000)=" << a.contains(1000) << " contains(1001)=" << a.contains(1001)
+              << " contains(205000)=" << a.contains(205000) << "\n";
+    std::cout << "rank(70000)=" << a.rank(70000) << " (values <= 70000), select(5)=" << a.select(5) << "\n";
+
+    const bits::roaring_bitmap b = {3, 4, 70001, 205000, 300000};
+    std::cout << "a & {3, 4, 70001, 205000, 300000} =";
+    (a & b).for_each([](std::uint32_t v) { std::cout << " " << v; });
+    std::cout << "\n(a | b).cardinality()=" << (a | b).cardinality() << "\n";
+}
+
+static bool same_values(const bits::roaring_bitmap& r, const std::vector<std::uint32_t>& v)
+{
+    return r.cardinality() == v.size() && r.to_vector() == v;
+}
+
+// Every operation against sorted vectors, for all pairs of densities, with and without run containers
+static void check_roaring()
+{
+    const std::uint32_t universe = 1u << 20;
+    bool ok = true;
+    for (density da : {density::sparse, density::dense, density::clustered})
+    {
+        for (density db : {density::sparse, density::dense, density::clustered})
+        {
+            const std::vector<std::uint32_t> va = make_values(da, universe, 1);
+            const std::vector<std::uint32_t> vb = make_values(db, universe, 2);
+            std::vector<std::uint32_t> v_and, v_or;
+            std::set_intersection(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(v_and));
+            std::set_union(va.begin(), va.end(), vb.begin(), vb.end(), std::back_inserter(v_or));
+
+            for (bool runs : {false, true})
+            {
+                bits::roaring_bitmap a, b;
+                a.add_many(va.begin(), va.end());
+                b.add_many(vb.begin(), vb.end());
+                if (runs)
+                {
+                    a.run_optimize();
+                    b.run_optimize();
+                }
+                ok = ok && same_values(a, va) && same_values(a & b, v_and) && same_values(a | b, v_or);
+
+                // rank/select at a few points
+                for (std::size_t k = 0; k < va.size(); k += va.size() / 7 + 1)
+                    ok = ok && a.select(k) == va[k] && a.rank(va[k]) == k + 1;
+
+                const std::vector<unsigned char> buffer = a.serialize();
+                const bits::roaring_view view(buffer.data(), buffer.size());
+                ok = ok && bits::roaring_bitmap::deserialize(buffer.data(), buffer.size()) == a;
+                for (std::uint32_t x = 0; x < universe; x += 997)
+                    ok = ok && view.contains(x) == std::binary_search(va.begin(), va.end(), x) && a.contains(x) == view.contains(x);
+            }
+        }
+    }
+
+    // removing values converts bitmaps back to arrays and drops empty containers
+    bits::roaring_bitmap r;
+    std::vector<std::uint32_t> v = make_values(density::dense, 1u << 17, 3);
+    r.add_many(v.begin(), v.end());
+    std::vector<std::uint32_t> kept;
+    for (std::uint32_t x : v)
+    {
+        if (x % 16 != 0)
+            r.remove(x);
+        else
+            kept.push_back(x);
+    }
+    ok = ok && same_values(r, kept) && r.container_counts()[1] == 0;
+
+    std::cout << "roaring bitmap matches sorted vectors? " << ok << "\n";
+}
+
+// roaring_view rejects buffers whose payloads don't match their descriptors or the header
+static void check_corrupted_roaring()
+{
+    bits::roaring_bitmap r{1, 5, 9, (1u << 16) + 3};
+    for (std::uint32_t x = (2u << 16) + 10; x < (2u << 16) + 110; ++x)
+        r.add(x);
+    r.run_optimize();
+    const std::vector<unsigned char> good = r.serialize();
+
+    auto descriptor = [](const std::vector<unsigned char>& buffer, std::size_t i) {
+        bits::roaring::descriptor d;
+        std::memcpy(&d, buffer.data() + bits::roaring::header_size + i * bits::roaring::descriptor_size, sizeof(d));
+        return d;
+    };
+    auto rejected = [&](auto corrupt) {
+        std::vector<unsigned char> buffer = good;
+        corrupt(buffer);
+        try
+        {
+            const bits::roaring_view view(buffer.data(), buffer.size());
+            return false;
+        }
+        catch (const std::invalid_argument&)
+        {
+            return true;
+        }
+    };
+
+    bool ok = !rejected([](std::vector<unsigned char>&) {});
+    // header total
+    ok = ok && rejected([](std::vector<unsigned char>& b) { ++b[8]; });
+    // cardinality of the first array, and the total, one more than its values
+    ok = ok && rejected([&](std::vector<unsigned char>& b) {
+        bits::roaring::descriptor d = descriptor(b, 0);
+        ++d.cardinality;
+        std::memcpy(b.data() + bits::roaring::header_size, &d, sizeof(d));
+        ++b[8];
+    });
+    // array values out of order
+    ok = ok && rejected([&](std::vector<unsigned char>& b) { std::swap(b[descriptor(b, 0).offset], b[descriptor(b, 0).offset + 2]); });
+    // a run past the end of the chunk
+    ok = ok && rejected([&](std::vector<unsigned char>& b) {
+        const std::uint16_t length = 0xFFFF;
+        std::memcpy(b.data() + descriptor(b, 2).offset + 2, &length, sizeof(length));
+    });
+    std::cout << "roaring_view rejects corrupted buffers? " << ok << "\n";
+}
+
+// Serialize to a file, map it and query it in place
+static void demo_memory_mapped()
+{
+    std::cout << "\n== memory-mapped roaring_view ==\n";
+    bits::roaring_bitmap r;
+    const std::vector<std::uint32_t> v = make_values(density::clustered, 1u << 22, 4);
+    r.add_many(v.begin(), v.end());
+    r.run_optimize();
+    const std::vector<unsigned char> buffer = r.serialize();
+
+#if defined(__unix__) || defined(__APPLE__)
+    std::FILE* file = std::tmpfile();
+    if (nullptr == file || std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size() || std::fflush(file) != 0)
+    {
+        std::cout << "can't write a temporary file\n";
+        return;
+    }
+    void* mapped = mmap(nullptr, buffer.size(), PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (mapped == MAP_FAILED)
+    {
+        std::cout << "mmap failed\n";
+        std::fclose(file);
+        return;
+    }
+    const bits::roaring_view view(mapped, buffer.size());
+    std::cout << "mapped " << buffer.size() << " bytes, " << view.container_count() << " containers, cardinality "
+              << view.cardinality() << "\n";
+    std::cout << "view.contains(v[1000])=" << view.contains(v[1000]) << ", matches the bitmap? "
+              << (bits::roaring_bitmap::deserialize(mapped, buffer.size()) == r) << "\n";
+    munmap(mapped, buffer.size());
+    std::fclose(file);
+#else
+    const bits::roaring_view view(buffer.data(), buffer.size());
+    std::cout << buffer.size() << " bytes, cardinality " << view.cardinality() << " (mmap is not available here)\n";
+#endif
+}
+
+static bits::dynamic_bitset to_bitset(const std::vector<std::uint32_t>& values, std::uint32_t universe)
+{
+    bits::dynamic_bitset b(universe);
+    for (std::uint32_t v : values)
+        b.set(v);
+    return b;
+}
+
+static void benchmark_roaring(std::uint32_t universe)
+{
+    bench::options opts;
+    opts.repetitions = 7;
+    const std::vector<std::uint32_t> queries = rng::uniform_vector<std::uint32_t>(1'000'000, 0, universe - 1, 99);
+
+    for (density d : {density::sparse, density::dense, density::clustered})
+    {
+        const std::vector<std::uint32_t> va = make_values(d, universe, 11);
+        const std::vector<std::uint32_t> vb = make_values(d, universe, 12);
+        bits::roaring_bitmap ra, rb;
+        ra.add_many(va.begin(), va.end());
+        rb.add_many(vb.begin(), vb.end());
+        bits::roaring_bitmap ra_runs = ra, rb_runs = rb;
+        ra_runs.run_optimize();
+        rb_runs.run_optimize();
+        const bits::dynamic_bitset ba = to_bitset(va, universe), bb = to_bitset(vb, universe);
+        const std::vector<unsigned char> serialized = ra_runs.serialize();
+        const bits::roaring_view view(serialized.data(), serialized.size());
+
+        const auto counts = ra_runs.container_counts();
+        std::cout << density_name(d) << ", " << va.size() << " of " << universe << " values\n"
+                  << "  bytes: dynamic_bitset " << ba.word_count() * 8 << ", sorted vector " << va.size() * 4
+                  << ", roaring " << ra.size_in_bytes() << ", roaring with runs " << ra_runs.size_in_bytes()
+                  << " (array/bitmap/run containers " << counts[0] << "/" << counts[1] << "/" << counts[2] << ")\n";
+
+        const std::string title = std::string(density_name(d)) + ", universe " + std::to_string(universe);
+        {
+            bench::suite s("a & b, " + title, opts);
+            bits::dynamic_bitset r;
+            s.run("dynamic_bitset", [&] { r = ba; r &= bb; bench::do_not_optimize(r); }, universe);
+            s.run("roaring", [&] { bench::do_not_optimize(ra & rb); }, universe);
+            s.run("roaring with runs", [&] { bench::do_not_optimize(ra_runs & rb_runs); }, universe);
+            s.report(std::cout);
+        }
+        {
+            bench::suite s("a | b, " + title, opts);
+            bits::dynamic_bitset r;
+            s.run("dynamic_bitset", [&] { r = ba; r |= bb; bench::do_not_optimize(r); }, universe);
+            s.run("roaring", [&] { bench::do_not_optimize(ra | rb); }, universe);
+            s.run("roaring with runs", [&] { bench::do_not_optimize(ra_runs | rb_runs); }, universe);
+            s.report(std::cout);
+        }
+        {
+            bench::suite s("1M random contains(), " + title, opts);
+            auto probe = [&](const auto& set) {
+                std::size_t found = 0;
+                for (std::uint32_t q : queries)
+                    found += set.contains(q);
+                bench::do_not_optimize(found);
+            };
+            s.run("dynamic_bitset", [&] {
+                std::size_t found = 0;
+                for (std::uint32_t q : queries)
+                    found += ba.test(q);
+                bench::do_not_optimize(found);
+            }, queries.size());
+            s.run("roaring", [&] { probe(ra); }, queries.size());
+            s.run("roaring with runs", [&] { probe(ra_runs); }, queries.size());
+            s.run("roaring_view", [&] { probe(view); }, queries.size());
+            s.report(std::cout);
+        }
+        std::cout << "\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    demo_roaring();
+    check_roaring();
+    check_corrupted_roaring();
+    demo_memory_mapped();
+
+    const std::uint32_t universe = argc > 1 ? static_cast<std::uint32_t>(std::strtoul(argv[1], nullptr, 10)) : (1u << 24);
+    if (universe > 0)
+    {
+        std::cout << "\n";
+        benchmark_roaring(universe);
+    }
+
+    std::cout << "(compressed_bitmap.cpp) OK\n";
+    return 0;
+}
@@ -0,0 +1,989 @@
+#pragma once
+/*
+roaring_bitmap.h
+Compressed bitmap of 32-bit integers in the Roaring layout (Chambi, Lemire, Kaser, Godin,
+"Better bitmap performance with Roaring bitmaps").
+
+A plain bitset of 2^32 bits takes 512 MB whatever it holds, a sorted vector takes 4 bytes per value
+and intersects by slow merges. Roaring splits values into chunks by the high 16 bits,
+and stores the low 16 bits of every chunk in the smallest of three containers:
+  - array:  sorted uint16 values, up to 4096 of them (8 KB at most)
+  - bitmap: 65536 bits in 1024 words (always 8 KB), for more than 4096 values
+  - run:    sorted (start, length - 1) pairs, for long intervals of consecutive values,
+            chosen by run_optimize() when it's smaller than both other forms
+Set operations go chunk by chunk, and every pair of containers has its own algorithm:
+merging arrays, probing an array against a bitmap, ANDing bitmaps word by word with dispatched SIMD kernels
+of dynamic_bitset.h, intersecting intervals of runs.
+
+Serialized form is flat, so a file can be memory-mapped and queried by roaring_view without parsing
+(the view validates every container once, when it's constructed):
+    header       magic "RBM1", u32 number of containers, u64 cardinality
+    descriptors  u16 key, u8 type, u8 reserved, u32 cardinality, u32 payload elements, u32 payload offset
+    payloads     uint16 values, uint16 run pairs or uint64 words, every payload starts at a multiple of 8
+Numbers are stored in the byte order of the host (little-endian on every platform we build for).
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <01_low_level/08_bitwise_ops/06_bitset_and_stl/dynamic_bitset.h>
+
+namespace bits
+{
+
+namespace roaring
+{
+
+enum class container_type : std::uint8_t
+{
+    array = 1,
+    bitmap = 2,
+    run = 3
+};
+
+// The largest array; a bitmap is 8 KB, 4096 uint16 values take the same
+constexpr size_t array_max = 4096;
+constexpr size_t bitmap_words = 65536 / 64;
+
+struct container
+{
+    container_type type = container_type::array;
+    std::uint32_t cardinality = 0;
+    // array: sorted values; run: pairs (start, length - 1)
+    std::vector<std::uint16_t> values;
+    // bitmap: bitmap_words words
+    std::vector<std::uint64_t> words;
+};
+
+// Index of the first element not less than the key, `less(i)` compares the element `i` with the key.
+// Branchless binary search: the number of steps depends only on `size`, and the half is chosen
+// by a conditional move; std::lower_bound mispredicts about half of its steps on random queries
+template <class Less>
+inline size_t lower_bound_by(size_t size, Less less)
+{
+    if (size == 0) {
+        return 0;
+    }
+    size_t base = 0;
+    while (size > 1) {
+        const size_t half = size / 2;
+        base = less(base + half) ? base + half : base;
+        size -= half;
+    }
+    return base + (less(base) ? 1 : 0);
+}
+
+// Queries over raw payloads, shared by containers in memory and by roaring_view over a mapped buffer
+
+inline bool array_contains(const std::uint16_t* values, size_t count, std::uint16_t low)
+{
+    const size_t i = lower_bound_by(count, [=](size_t k) { return values[k] < low; });
+    return i < count && values[i] == low;
+}
+
+inline bool bitmap_contains(const std::uint64_t* words, std::uint16_t low)
+{
+    return (words[low / 64] >> (low % 64)) & 1;
+}
+
+inline bool run_contains(const std::uint16_t* runs, size_t count, std::uint16_t low)
+{
+    // the first run starting after `low`, then check the one before it
+    const size_t first = lower_bound_by(count, [=](size_t k) { return runs[2 * k] <= low; });
+    return first > 0 && low - runs[2 * (first - 1)] <= runs[2 * (first - 1) + 1];
+}
+
+template <class F>
+void for_each_in_payload(container_type type, const std::uint16_t* values, const std::uint64_t* words, size_t count, std::uint32_t base, F&& f)
+{
+    switch (type) {
+    case container_type::array:
+        for (size_t i = 0; i < count; ++i) {
+            f(base | values[i]);
+        }
+        break;
+    case container_type::bitmap:
+        for (size_t i = 0; i < bitmap_words; ++i) {
+            for (std::uint64_t w = words[i]; w != 0; w &= w - 1) {
+                f(base | static_cast<std::uint32_t>(i * 64 + detail::ctz64(w)));
+            }
+        }
+        break;
+    case container_type::run:
+        for (size_t i = 0; i < count; ++i) {
+            const std::uint32_t start = values[2 * i];
+            const std::uint32_t end = start + values[2 * i + 1];
+            for (std::uint32_t v = start; v <= end; ++v) {
+                f(base | v);
+            }
+        }
+        break;
+    }
+}
+
+// Number of payload elements: values, runs or words
+inline size_t payload_count(const container& c)
+{
+    switch (c.type) {
+    case container_type::array: return c.values.size();
+    case container_type::run: return c.values.size() / 2;
+    case container_type::bitmap: return c.words.size();
+    }
+    return 0;
+}
+
+inline bool contains(const container& c, std::uint16_t low)
+{
+    switch (c.type) {
+    case container_type::array: return array_contains(c.values.data(), c.values.size(), low);
+    case container_type::bitmap: return bitmap_contains(c.words.data(), low);
+    case container_type::run: return run_contains(c.values.data(), c.values.size() / 2, low);
+    }
+    return false;
+}
+
+template <class F>
+void for_each(const container& c, std::uint32_t base, F&& f)
+{
+    for_each_in_payload(c.type, c.values.data(), c.words.data(), payload_count(c), base, f);
+}
+
+inline void set_range(std::uint64_t* words, std::uint32_t start, std::uint32_t end)
+{
+    // bits [start, end], whole words in the middle
+    const std::uint32_t first = start / 64, last = end / 64;
+    const std::uint64_t first_mask = ~std::uint64_t(0) << (start % 64);
+    const std::uint64_t last_mask = ~std::uint64_t(0) >> (63 - end % 64);
+    if (first == last) {
+        words[first] |= first_mask & last_mask;
+        return;
+    }
+    words[first] |= first_mask;
+    std::fill(words + first + 1, words + last, ~std::uint64_t(0));
+    words[last] |= last_mask;
+}
+
+inline std::vector<std::uint64_t> to_words(const container& c)
+{
+    if (c.type == container_type::bitmap) {
+        return c.words;
+    }
+    std::vector<std::uint64_t> words(bitmap_words, 0);
+    if (c.type == container_type::array) {
+        for (std::uint16_t v : c.values) {
+            words[v / 64] |= std::uint64_t(1) << (v % 64);
+        }
+    }
+    else {
+        for (size_t i = 0; i < c.values.size(); i += 2) {
+            set_range(words.data(), c.values[i], std::uint32_t(c.values[i]) + c.values[i + 1]);
+        }
+    }
+    return words;
+}
+
+inline std::vector<std::uint16_t> to_values(const container& c)
+{
+    if (c.type == container_type::array) {
+        return c.values;
+    }
+    std::vector<std::uint16_t> values;
+    values.reserve(c.cardinality);
+    for_each(c, 0, [&](std::uint32_t v) { values.push_back(static_cast<std::uint16_t>(v)); });
+    return values;
+}
+
+inline container make_array(std::vector<std::uint16_t> values)
+{
+    container c;
+    c.type = container_type::array;
+    c.cardinality = static_cast<std::uint32_t>(values.size());
+    c.values = std::move(values);
+    return c;
+}
+
+// Bitmap, or an array if `cardinality` values fit into it
+inline container from_words(std::vector<std::uint64_t> words, std::uint32_t cardinality)
+{
+    container c;
+    c.cardinality = cardinality;
+    if (cardinality <= array_max) {
+        c.type = container_type::array;
+        c.values.reserve(cardinality);
+        for (size_t i = 0; i < bitmap_words; ++i) {
+            for (std::uint64_t w = words[i]; w != 0; w &= w - 1) {
+                c.values.push_back(static_cast<std::uint16_t>(i * 64 + detail::ctz64(w)));
+            }
+        }
+    }
+    else {
+        c.type = container_type::bitmap;
+        c.words = std::move(words);
+    }
+    return c;
+}
+
+inline std::uint32_t count_words(const std::vector<std::uint64_t>& words)
+{
+    return static_cast<std::uint32_t>(popcount(words.data(), words.size() * sizeof(std::uint64_t)));
+}
+
+// Array or bitmap of the same values, e.g. before modifying a run container
+inline void materialize(container& c)
+{
+    if (c.type == container_type::run) {
+        c = c.cardinality <= array_max ? make_array(to_values(c)) : from_words(to_words(c), c.cardinality);
+    }
+}
+
+inline bool add(container& c, std::uint16_t low)
+{
+    materialize(c);
+    if (c.type == container_type::bitmap) {
+        std::uint64_t& w = c.words[low / 64];
+        const std::uint64_t bit = std::uint64_t(1) << (low % 64);
+        if (w & bit) {
+            return false;
+        }
+        w |= bit;
+        ++c.cardinality;
+        return true;
+    }
+    // appending in increasing order is the common case of bulk loading
+    if (c.values.empty() || c.values.back() < low) {
+        c.values.push_back(low);
+    }
+    else {
+        auto position = std::lower_bound(c.values.begin(), c.values.end(), low);
+        if (*position == low) {
+            return false;
+        }
+        c.values.insert(position, low);
+    }
+    if (++c.cardinality > array_max) {
+        c = from_words(to_words(c), c.cardinality);
+    }
+    return true;
+}
+
+inline bool remove(container& c, std::uint16_t low)
+{
+    materialize(c);
+    if (c.type == container_type::bitmap) {
+        std::uint64_t& w = c.words[low / 64];
+        const std::uint64_t bit = std::uint64_t(1) << (low % 64);
+        if (!(w & bit)) {
+            return false;
+        }
+        w &= ~bit;
+        if (--c.cardinality <= array_max) {
+            c = from_words(std::move(c.words), c.cardinality);
+        }
+        return true;
+    }
+    auto position = std::lower_bound(c.values.begin(), c.values.end(), low);
+    if (position == c.values.end() || *position != low) {
+        return false;
+    }
+    c.values.erase(position);
+    --c.cardinality;
+    return true;
+}
+
+// Number of values <= low
+inline std::uint32_t rank(const container& c, std::uint16_t low)
+{
+    switch (c.type) {
+    case container_type::array:
+        return static_cast<std::uint32_t>(std::upper_bound(c.values.begin(), c.values.end(), low) - c.values.begin());
+    case container_type::bitmap: {
+        const size_t word = low / 64;
+        // bits up to `low` inclusive of its word
+        const std::uint64_t mask = ~std::uint64_t(0) >> (63 - low % 64);
+        return static_cast<std::uint32_t>(popcount(c.words.data(), word * sizeof(std::uint64_t)) + detail::popcount64_swar(c.words[word] & mask));
+    }
+    case container_type::run: {
+        std::uint32_t result = 0;
+        for (size_t i = 0; i < c.values.size() && c.values[i] <= low; i += 2) {
+            result += std::min<std::uint32_t>(low, std::uint32_t(c.values[i]) + c.values[i + 1]) - c.values[i] + 1;
+        }
+        return result;
+    }
+    }
+    return 0;
+}
+
+// The value number `k` (from 0), k < cardinality
+inline std::uint16_t select(const container& c, std::uint32_t k)
+{
+    switch (c.type) {
+    case container_type::array:
+        return c.values[k];
+    case container_type::bitmap:
+        for (size_t i = 0;; ++i) {
+            const std::uint32_t ones = static_cast<std::uint32_t>(detail::popcount64_swar(c.words[i]));
+            if (k < ones) {
+                // drop the k lowest set bits of the word
+                std::uint64_t w = c.words[i];
+                for (; k > 0; --k) {
+                    w &= w - 1;
+                }
+                return static_cast<std::uint16_t>(i * 64 + detail::ctz64(w));
+            }
+            k -= ones;
+        }
+    case container_type::run:
+        for (size_t i = 0;; i += 2) {
+            const std::uint32_t length = std::uint32_t(c.values[i + 1]) + 1;
+            if (k < length) {
+                return static_cast<std::uint16_t>(c.values[i] + k);
+            }
+            k -= length;
+        }
+    }
+    return 0;
+}
+
+// Runs of consecutive values; for a bitmap a run starts at every 1 bit preceded by a 0 bit
+inline size_t count_runs(const container& c)
+{
+    switch (c.type) {
+    case container_type::array: {
+        size_t runs = c.values.empty() ? 0 : 1;
+        for (size_t i = 1; i < c.values.size(); ++i) {
+            runs += c.values[i] != c.values[i - 1] + 1;
+        }
+        return runs;
+    }
+    case container_type::bitmap: {
+        size_t runs = 0;
+        std::uint64_t carry = 0;
+        for (std::uint64_t w : c.words) {
+            runs += static_cast<size_t>(detail::popcount64_swar(w & ~((w << 1) | carry)));
+            carry = w >> 63;
+        }
+        return runs;
+    }
+    case container_type::run:
+        return c.values.size() / 2;
+    }
+    return 0;
+}
+
+inline size_t payload_bytes(container_type type, size_t count)
+{
+    switch (type) {
+    case container_type::array: return count * sizeof(std::uint16_t);
+    case container_type::run: return count * 2 * sizeof(std::uint16_t);
+    case container_type::bitmap: return count * sizeof(std::uint64_t);
+    }
+    return 0;
+}
+
+// Number of values in a payload read from a buffer, 0 if it breaks the container rules:
+// at most array_max strictly increasing array values, runs in increasing order without overlaps
+// and within the chunk
+inline std::uint32_t payload_cardinality(container_type type, const std::uint16_t* values, const std::uint64_t* words, size_t count)
+{
+    switch (type) {
+    case container_type::array:
+        if (count > array_max) {
+            return 0;
+        }
+        for (size_t i = 1; i < count; ++i) {
+            if (values[i - 1] >= values[i]) {
+                return 0;
+            }
+        }
+        return static_cast<std::uint32_t>(count);
+    case container_type::bitmap: return static_cast<std::uint32_t>(popcount(words, count * sizeof(std::uint64_t)));
+    case container_type::run: {
+        std::uint32_t cardinality = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const std::uint32_t start = values[2 * i];
+            const std::uint32_t end = start + values[2 * i + 1];
+            if (end > 0xFFFF || (i > 0 && start <= std::uint32_t(values[2 * i - 2]) + values[2 * i - 1])) {
+                return 0;
+            }
+            cardinality += end - start + 1;
+        }
+        return cardinality;
+    }
+    }
+    return 0;
+}
+
+// Convert to runs if they take less space than the array or the bitmap, returns true if converted
+inline bool run_optimize(container& c)
+{
+    if (c.type == container_type::run) {
+        return false;
+    }
+    const size_t runs = count_runs(c);
+    if (payload_bytes(container_type::run, runs) >= payload_bytes(c.type, payload_count(c))) {
+        return false;
+    }
+    std::vector<std::uint16_t> pairs;
+    pairs.reserve(runs * 2);
+    for_each(c, 0, [&](std::uint32_t v) {
+        if (!pairs.empty() && std::uint32_t(pairs[pairs.size() - 2]) + pairs.back() + 1 == v) {
+            ++pairs.back();
+        }
+        else {
+            pairs.push_back(static_cast<std::uint16_t>(v));
+            pairs.push_back(0);
+        }
+    });
+    c.type = container_type::run;
+    c.values = std::move(pairs);
+    c.words.clear();
+    c.words.shrink_to_fit();
+    return true;
+}
+
+// Intervals of both run containers, [start, end] pairs in increasing order
+inline container intersect_runs(const container& a, const container& b)
+{
+    container c;
+    c.type = container_type::run;
+    size_t i = 0, j = 0;
+    while (i < a.values.size() && j < b.values.size()) {
+        const std::uint32_t a_end = std::uint32_t(a.values[i]) + a.values[i + 1];
+        const std::uint32_t b_end = std::uint32_t(b.values[j]) + b.values[j + 1];
+        const std::uint32_t start = std::max(a.values[i], b.values[j]);
+        const std::uint32_t end = std::min(a_end, b_end);
+        if (start <= end) {
+            c.values.push_back(static_cast<std::uint16_t>(start));
+            c.values.push_back(static_cast<std::uint16_t>(end - start));
+            c.cardinality += end - start + 1;
+        }
+        // advance the interval ending first
+        if (a_end < b_end) {
+            i += 2;
+        }
+        else {
+            j += 2;
+        }
+    }
+    return c;
+}
+
+inline container unite_runs(const container& a, const container& b)
+{
+    container c;
+    c.type = container_type::run;
+    size_t i = 0, j = 0;
+    auto append = [&c](std::uint32_t start, std::uint32_t end) {
+        const size_t n = c.values.size();
+        if (n > 0 && std::uint32_t(c.values[n - 2]) + c.values[n - 1] + 1 >= start) {
+            // overlaps or touches the last interval
+            const std::uint32_t last_end = std::uint32_t(c.values[n - 2]) + c.values[n - 1];
+            if (end > last_end) {
+                c.values[n - 1] = static_cast<std::uint16_t>(end - c.values[n - 2]);
+            }
+        }
+        else {
+            c.values.push_back(static_cast<std::uint16_t>(start));
+            c.values.push_back(static_cast<std::uint16_t>(end - start));
+        }
+    };
+    while (i < a.values.size() || j < b.values.size()) {
+        const bool take_a = j >= b.values.size() || (i < a.values.size() && a.values[i] <= b.values[j]);
+        const container& from = take_a ? a : b;
+        size_t& k = take_a ? i : j;
+        append(from.values[k], std::uint32_t(from.values[k]) + from.values[k + 1]);
+        k += 2;
+    }
+    for (size_t k = 0; k < c.values.size(); k += 2) {
+        c.cardinality += std::uint32_t(c.values[k + 1]) + 1;
+    }
+    return c;
+}
+
+inline container intersect(const container& a, const container& b)
+{
+    if (a.type == container_type::run && b.type == container_type::run) {
+        return intersect_runs(a, b);
+    }
+    // an array, even a small one, is the result of intersection with an array: keep values of `small` found in the other
+    if (a.type == container_type::array || b.type == container_type::array) {
+        const container& small = a.type == container_type::array ? a : b;
+        const container& other = a.type == container_type::array ? b : a;
+        std::vector<std::uint16_t> values;
+        if (other.type == container_type::array) {
+            values.reserve(std::min(small.values.size(), other.values.size()));
+            std::set_intersection(small.values.begin(), small.values.end(), other.values.begin(), other.values.end(),
+                                  std::back_inserter(values));
+        }
+        else {
+            values.reserve(small.values.size());
+            for (std::uint16_t v : small.values) {
+                if (contains(other, v)) {
+                    values.push_back(v);
+                }
+            }
+        }
+        return make_array(std::move(values));
+    }
+    // bitmaps, or a bitmap and runs
+    std::vector<std::uint64_t> words = to_words(a);
+    if (b.type == container_type::bitmap) {
+        detail::bitwise<detail::op_and>(words.data(), b.words.data(), bitmap_words);
+    }
+    else {
+        const std::vector<std::uint64_t> other = to_words(b);
+        detail::bitwise<detail::op_and>(words.data(), other.data(), bitmap_words);
+    }
+    const std::uint32_t cardinality = count_words(words);
+    return from_words(std::move(words), cardinality);
+}
+
+inline container unite(const container& a, const container& b)
+{
+    if (a.type == container_type::run && b.type == container_type::run) {
+        return unite_runs(a, b);
+    }
+    if (a.type == container_type::array && b.type == container_type::array && a.cardinality + b.cardinality <= array_max) {
+        std::vector<std::uint16_t> values;
+        values.reserve(a.values.size() + b.values.size());
+        std::set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), std::back_inserter(values));
+        return make_array(std::move(values));
+    }
+    // OR into the words of a bitmap operand, or of the first one
+    const bool b_first = b.type == container_type::bitmap && a.type != container_type::bitmap;
+    const container& first = b_first ? b : a;
+    const container& second = b_first ? a : b;
+    std::vector<std::uint64_t> words = to_words(first);
+    switch (second.type) {
+    case container_type::bitmap:
+        detail::bitwise<detail::op_or>(words.data(), second.words.data(), bitmap_words);
+        break;
+    case container_type::array:
+        for (std::uint16_t v : second.values) {
+            words[v / 64] |= std::uint64_t(1) << (v % 64);
+        }
+        break;
+    case container_type::run:
+        for (size_t i = 0; i < second.values.size(); i += 2) {
+            set_range(words.data(), second.values[i], std::uint32_t(second.values[i]) + second.values[i + 1]);
+        }
+        break;
+    }
+    const std::uint32_t cardinality = count_words(words);
+    return from_words(std::move(words), cardinality);
+}
+
+// Layout of the serialized form
+constexpr char magic[4] = {'R', 'B', 'M', '1'};
+constexpr size_t header_size = 16;
+constexpr size_t descriptor_size = 16;
+
+struct descriptor
+{
+    std::uint16_t key;
+    std::uint8_t type;
+    std::uint8_t reserved;
+    std::uint32_t cardinality;
+    std::uint32_t count;
+    std::uint32_t offset;
+};
+static_assert(sizeof(descriptor) == descriptor_size, "descriptor must have no padding");
+
+inline size_t align8(size_t n)
+{
+    return (n + 7) & ~size_t(7);
+}
+
+} // namespace roaring
+
+class roaring_bitmap
+{
+public:
+    roaring_bitmap() = default;
+
+    // Values don't have to be sorted, but sorted ones are appended without searching
+    roaring_bitmap(std::initializer_list<std::uint32_t> values)
+    {
+        add_many(values.begin(), values.end());
+    }
+
+    template <class It>
+    void add_many(It first, It last)
+    {
+        for (; first != last; ++first) {
+            add(*first);
+        }
+    }
+
+    bool add(std::uint32_t x)
+    {
+        if (!roaring::add(container_for(high(x)), low(x))) {
+            return false;
+        }
+        ++total;
+        return true;
+    }
+
+    bool remove(std::uint32_t x)
+    {
+        const size_t i = find(high(x));
+        if (i == npos || !roaring::remove(containers[i], low(x))) {
+            return false;
+        }
+        --total;
+        if (containers[i].cardinality == 0) {
+            keys.erase(keys.begin() + static_cast<std::ptrdiff_t>(i));
+            containers.erase(containers.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        return true;
+    }
+
+    bool contains(std::uint32_t x) const
+    {
+        const size_t i = find(high(x));
+        return i != npos && roaring::contains(containers[i], low(x));
+    }
+
+    std::uint64_t cardinality() const { return total; }
+    bool empty() const { return total == 0; }
+
+    // Number of values <= x
+    std::uint64_t rank(std::uint32_t x) const
+    {
+        std::uint64_t result = 0;
+        const std::uint16_t key = high(x);
+        for (size_t i = 0; i < keys.size() && keys[i] <= key; ++i) {
+            result += keys[i] < key ? containers[i].cardinality : roaring::rank(containers[i], low(x));
+        }
+        return result;
+    }
+
+    // The value number `k` in increasing order (from 0)
+    std::uint32_t select(std::uint64_t k) const
+    {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (k < containers[i].cardinality) {
+                return (std::uint32_t(keys[i]) << 16) | roaring::select(containers[i], static_cast<std::uint32_t>(k));
+            }
+            k -= containers[i].cardinality;
+        }
+        throw std::out_of_range("roaring_bitmap::select: k >= cardinality");
+    }
+
+    // Call f(value) for every value in increasing order
+    template <class F>
+    void for_each(F f) const
+    {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            roaring::for_each(containers[i], std::uint32_t(keys[i]) << 16, f);
+        }
+    }
+
+    std::vector<std::uint32_t> to_vector() const
+    {
+        std::vector<std::uint32_t> values;
+        values.reserve(total);
+        for_each([&](std::uint32_t v) { values.push_back(v); });
+        return values;
+    }
+
+    // Use run containers where they are smaller, returns true if anything changed
+    bool run_optimize()
+    {
+        bool changed = false;
+        for (roaring::container& c : containers) {
+            changed = roaring::run_optimize(c) || changed;
+        }
+        return changed;
+    }
+
+    // Containers of each type: array, bitmap, run
+    std::array<size_t, 3> container_counts() const
+    {
+        std::array<size_t, 3> counts{};
+        for (const roaring::container& c : containers) {
+            ++counts[static_cast<size_t>(c.type) - 1];
+        }
+        return counts;
+    }
+
+    // Size of the serialized form, which is also close to the memory taken by payloads
+    size_t size_in_bytes() const
+    {
+        size_t size = roaring::header_size + containers.size() * roaring::descriptor_size;
+        for (const roaring::container& c : containers) {
+            size += roaring::align8(roaring::payload_bytes(c.type, roaring::payload_count(c)));
+        }
+        return size;
+    }
+
+    std::vector<unsigned char> serialize() const
+    {
+        std::vector<unsigned char> buffer(size_in_bytes());
+        unsigned char* out = buffer.data();
+        const std::uint32_t count = static_cast<std::uint32_t>(containers.size());
+        std::memcpy(out, roaring::magic, 4);
+        std::memcpy(out + 4, &count, 4);
+        std::memcpy(out + 8, &total, 8);
+
+        size_t offset = roaring::header_size + containers.size() * roaring::descriptor_size;
+        for (size_t i = 0; i < containers.size(); ++i) {
+            const roaring::container& c = containers[i];
+            const size_t elements = roaring::payload_count(c);
+            const roaring::descriptor d{keys[i], static_cast<std::uint8_t>(c.type), 0, c.cardinality,
+                                        static_cast<std::uint32_t>(elements), static_cast<std::uint32_t>(offset)};
+            std::memcpy(out + roaring::header_size + i * roaring::descriptor_size, &d, sizeof(d));
+            const size_t bytes = roaring::payload_bytes(c.type, elements);
+            if (bytes > 0) {
+                std::memcpy(out + offset, c.type == roaring::container_type::bitmap ? static_cast<const void*>(c.words.data())
+                                                                                    : static_cast<const void*>(c.values.data()), bytes);
+            }
+            offset += roaring::align8(bytes);
+        }
+        return buffer;
+    }
+
+    static roaring_bitmap deserialize(const void* data, size_t size);
+
+    friend roaring_bitmap operator&(const roaring_bitmap& a, const roaring_bitmap& b)
+    {
+        roaring_bitmap result;
+        size_t i = 0, j = 0;
+        while (i < a.keys.size() && j < b.keys.size()) {
+            if (a.keys[i] < b.keys[j]) {
+                ++i;
+            }
+            else if (b.keys[j] < a.keys[i]) {
+                ++j;
+            }
+            else {
+                roaring::container c = roaring::intersect(a.containers[i], b.containers[j]);
+                if (c.cardinality > 0) {
+                    result.append(a.keys[i], std::move(c));
+                }
+                ++i;
+                ++j;
+            }
+        }
+        return result;
+    }
+
+    friend roaring_bitmap operator|(const roaring_bitmap& a, const roaring_bitmap& b)
+    {
+        roaring_bitmap result;
+        size_t i = 0, j = 0;
+        while (i < a.keys.size() || j < b.keys.size()) {
+            if (j == b.keys.size() || (i < a.keys.size() && a.keys[i] < b.keys[j])) {
+                result.append(a.keys[i], a.containers[i]);
+                ++i;
+            }
+            else if (i == a.keys.size() || b.keys[j] < a.keys[i]) {
+                result.append(b.keys[j], b.containers[j]);
+                ++j;
+            }
+            else {
+                result.append(a.keys[i], roaring::unite(a.containers[i], b.containers[j]));
+                ++i;
+                ++j;
+            }
+        }
+        return result;
+    }
+
+    // Same values, whatever containers hold them
+    friend bool operator==(const roaring_bitmap& a, const roaring_bitmap& b)
+    {
+        if (a.total != b.total || a.keys != b.keys) {
+            return false;
+        }
+        for (size_t i = 0; i < a.containers.size(); ++i) {
+            if (roaring::to_values(a.containers[i]) != roaring::to_values(b.containers[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(const roaring_bitmap& a, const roaring_bitmap& b)
+    {
+        return !(a == b);
+    }
+
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    static std::uint16_t high(std::uint32_t x) { return static_cast<std::uint16_t>(x >> 16); }
+    static std::uint16_t low(std::uint32_t x) { return static_cast<std::uint16_t>(x & 0xFFFF); }
+
+    size_t find(std::uint16_t key) const
+    {
+        const std::uint16_t* k = keys.data();
+        const size_t i = roaring::lower_bound_by(keys.size(), [=](size_t j) { return k[j] < key; });
+        return i < keys.size() && k[i] == key ? i : npos;
+    }
+
+    roaring::container& container_for(std::uint16_t key)
+    {
+        // the last container first, values are usually added in increasing order
+        if (!keys.empty() && keys.back() == key) {
+            return containers.back();
+        }
+        auto it = std::lower_bound(keys.begin(), keys.end(), key);
+        const size_t i = static_cast<size_t>(it - keys.begin());
+        if (it == keys.end() || *it != key) {
+            keys.insert(it, key);
+            containers.insert(containers.begin() + static_cast<std::ptrdiff_t>(i), roaring::container{});
+        }
+        return containers[i];
+    }
+
+    // Keys are appended in increasing order
+    void append(std::uint16_t key, roaring::container c)
+    {
+        total += c.cardinality;
+        keys.push_back(key);
+        containers.push_back(std::move(c));
+    }
+
+    friend class roaring_view;
+
+    std::vector<std::uint16_t> keys;
+    std::vector<roaring::container> containers;
+    std::uint64_t total = 0;
+};
+
+// Read-only bitmap over a serialized buffer, e.g. a memory-mapped file; the buffer must outlive the view.
+// Queries read payloads in place, nothing is copied
+class roaring_view
+{
+public:
+    // Validates the layout and every payload against its descriptor and the header, so queries and deserialize()
+    // can trust them; the buffer must be 8-byte aligned, as mmap() and operator new buffers are
+    roaring_view(const void* data, size_t size)
+        : bytes(static_cast<const unsigned char*>(data))
+    {
+        if (reinterpret_cast<std::uintptr_t>(data) % 8 != 0) {
+            throw std::invalid_argument("roaring_view: buffer must be 8-byte aligned");
+        }
+        if (size < roaring::header_size || std::memcmp(bytes, roaring::magic, 4) != 0) {
+            throw std::invalid_argument("roaring_view: not a serialized roaring bitmap");
+        }
+        std::memcpy(&count, bytes + 4, 4);
+        std::memcpy(&total, bytes + 8, 8);
+        if (size < roaring::header_size + size_t(count) * roaring::descriptor_size) {
+            throw std::invalid_argument("roaring_view: truncated descriptors");
+        }
+        int previous_key = -1;
+        std::uint64_t sum = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const roaring::descriptor d = descriptor_at(i);
+            const roaring::container_type type = static_cast<roaring::container_type>(d.type);
+            if (d.type < 1 || d.type > 3 || d.key <= previous_key || d.offset % 8 != 0 ||
+                (type == roaring::container_type::bitmap && d.count != roaring::bitmap_words) ||
+                d.offset > size || roaring::payload_bytes(type, d.count) > size - d.offset) {
+                throw std::invalid_argument("roaring_view: corrupted container " + std::to_string(i));
+            }
+            if (d.cardinality == 0 || roaring::payload_cardinality(type, values_at(d), words_at(d), d.count) != d.cardinality) {
+                throw std::invalid_argument("roaring_view: corrupted payload of container " + std::to_string(i));
+            }
+            previous_key = d.key;
+            sum += d.cardinality;
+        }
+        if (sum != total) {
+            throw std::invalid_argument("roaring_view: cardinality doesn't match the containers");
+        }
+    }
+
+    std::uint64_t cardinality() const { return total; }
+    size_t container_count() const { return count; }
+
+    bool contains(std::uint32_t x) const
+    {
+        const std::uint16_t key = static_cast<std::uint16_t>(x >> 16);
+        const std::uint16_t low = static_cast<std::uint16_t>(x & 0xFFFF);
+        const size_t i = roaring::lower_bound_by(count, [this, key](size_t j) { return key_at(j) < key; });
+        if (i == count || key_at(i) != key) {
+            return false;
+        }
+        const roaring::descriptor d = descriptor_at(i);
+        switch (static_cast<roaring::container_type>(d.type)) {
+        case roaring::container_type::array: return roaring::array_contains(values_at(d), d.count, low);
+        case roaring::container_type::bitmap: return roaring::bitmap_contains(words_at(d), low);
+        case roaring::container_type::run: return roaring::run_contains(values_at(d), d.count, low);
+        }
+        return false;
+    }
+
+    template <class F>
+    void for_each(F f) const
+    {
+        for (size_t i = 0; i < count; ++i) {
+            const roaring::descriptor d = descriptor_at(i);
+            roaring::for_each_in_payload(static_cast<roaring::container_type>(d.type), values_at(d), words_at(d), d.count,
+                                         std::uint32_t(d.key) << 16, f);
+        }
+    }
+
+private:
+    // the key is the first field of a descriptor
+    std::uint16_t key_at(size_t i) const
+    {
+        std::uint16_t key;
+        std::memcpy(&key, bytes + roaring::header_size + i * roaring::descriptor_size, sizeof(key));
+        return key;
+    }
+
+    roaring::descriptor descriptor_at(size_t i) const
+    {
+        roaring::descriptor d;
+        std::memcpy(&d, bytes + roaring::header_size + i * roaring::descriptor_size, sizeof(d));
+        return d;
+    }
+
+    const std::uint16_t* values_at(const roaring::descriptor& d) const
+    {
+        return reinterpret_cast<const std::uint16_t*>(bytes + d.offset);
+    }
+
+    const std::uint64_t* words_at(const roaring::descriptor& d) const
+    {
+        return reinterpret_cast<const std::uint64_t*>(bytes + d.offset);
+    }
+
+    friend class roaring_bitmap;
+
+    const unsigned char* bytes = nullptr;
+    std::uint32_t count = 0;
+    std::uint64_t total = 0;
+};
+
+inline roaring_bitmap roaring_bitmap::deserialize(const void* data, size_t size)
+{
+    const roaring_view view(data, size);
+    roaring_bitmap result;
+    for (size_t i = 0; i < view.count; ++i) {
+        const roaring::descriptor d = view.descriptor_at(i);
+        roaring::container c;
+        c.type = static_cast<roaring::container_type>(d.type);
+        c.cardinality = d.cardinality;
+        if (c.type == roaring::container_type::bitmap) {
+            c.words.assign(view.words_at(d), view.words_at(d) + d.count);
+        }
+        else {
+            const size_t elements = c.type == roaring::container_type::run ? 2 * size_t(d.count) : d.count;
+            c.values.assign(view.values_at(d), view.values_at(d) + elements);
+        }
+        result.append(d.key, std::move(c));
+    }
+    return result;
+}
+
+} // namespace bits
@@ -0,0 +1,298 @@
+/*
+rank_select.cpp
+Succinct rank/select over large bit-vectors (rank_select.h): O(1) queries with a 3.5% directory,
+extending the single-word popcount and scans of 04_popcount_and_scans to billions of bits.
+
+Benchmarks compare the BMI2 (POPCNT + PDEP) and portable (SWAR + broadword) kernels,
+and a sorted vector of positions, which answers select by indexing and rank by binary search
+but takes 32 bits per one. The size in bits is taken from the command line:
+  ./09_rank_select 1073741824
+
+Build (C++17):
+  g++ -std=c++17 -O2 -Wall -Wextra -pedantic -I../../.. rank_select.cpp -o rank_select
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <utilities/benchmark.h>
+#include <utilities/generate.h>
+#include "rank_select.h"
+
+// Random bits with probability 1 / one_of, and an empty stretch in the middle,
+// so select has to cross superblocks without ones
+static std::vector<std::uint64_t> make_bits(std::size_t bits, std::uint32_t one_of, std::uint64_t seed)
+{
+    std::vector<std::uint64_t> words((bits + 63) / 64, 0);
+    const std::vector<std::uint32_t> r = rng::uniform_vector<std::uint32_t>(bits, 0, one_of - 1, seed);
+    for (std::size_t i = 0; i < bits; ++i)
+    {
+        if (r[i] == 0)
+            words[i / 64] |= std::uint64_t(1) << (i % 64);
+    }
+    const std::size_t gap_first = words.size() / 3, gap_last = words.size() / 3 + words.size() / 10;
+    std::fill(words.begin() + static_cast<std::ptrdiff_t>(gap_first), words.begin() + static_cast<std::ptrdiff_t>(gap_last), 0);
+    return words;
+}
+
+static void demo_rank_select()
+{
+    std::cout << "== rank/select ==\n";
+    bits::dynamic_bitset rows(20);
+    for (std::size_t row : {2, 3, 5, 7, 11, 13, 17, 19})
+        rows.set(row);
+    const bits::rank_select rs(rows);
+    std::cout << "rows 2 3 5 7 11 13 17 19 of 20, count=" << rs.count() << "\n";
+    std::cout << "rank1(11)=" << rs.rank1(11) << " (selected rows before 11), rank0(11)=" << rs.rank0(11) << "\n";
+    std::cout << "select1(4)=" << rs.select1(4) << " (the 5th selected row)\n";
+    std::cout << "kernel: " << (bits::rank_select::best_kernel() == bits::rank_select_kernel::bmi2 ? "bmi2" : "portable") << "\n";
+}
+
+static void check_select_in_word()
+{
+    bool ok = true;
+    rng::xoshiro256ss engine(1);
+    for (int i = 0; i < 100000 && ok; ++i)
+    {
+        // various densities: AND of 0..3 random words
+        std::uint64_t w = engine();
+        for (int k = i % 4; k > 0; --k)
+            w &= engine();
+        std::uint64_t rest = w;
+        for (unsigned k = 0; rest != 0; ++k, rest &= rest - 1)
+        {
+            const unsigned expected = bits::detail::ctz64(rest);
+            ok = ok && bits::detail::portable_word::select(w, k) == expected;
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+            if (bits::rank_select::best_kernel() == bits::rank_select_kernel::bmi2)
+                ok = ok && bits::detail::bmi2_word::select(w, k) == expected;
+#endif
+        }
+    }
+    std::cout << "select in word matches the bit loop? " << ok << "\n";
+}
+
+// All ranks and selects against a running count, for both kernels and sizes around block boundaries
+static void check_rank_select()
+{
+    bool ok = true;
+    for (std::size_t bits : {std::size_t(1), std::size_t(511), std::size_t(2048), std::size_t(100'003), std::size_t(1) << 20})
+    {
+        for (std::uint32_t one_of : {1u, 2u, 50u})
+        {
+            const std::vector<std::uint64_t> words = make_bits(bits, one_of, bits + one_of);
+            for (bits::rank_select_kernel kernel : {bits::rank_select_kernel::portable, bits::rank_select::best_kernel()})
+            {
+                const bits::rank_select rs(words, bits, kernel);
+                std::uint64_t rank = 0;
+                for (std::size_t pos = 0; pos < bits && ok; ++pos)
+                {
+                    ok = ok && rs.rank1(pos) == rank;
+                    if (rs[pos])
+                    {
+                        ok = ok && rs.select1(rank) == pos;
+                        ++rank;
+                    }
+                }
+                ok = ok && rs.rank1(bits) == rank && rs.count() == rank;
+            }
+        }
+    }
+    std::cout << "rank/select match a running count? " << ok << "\n";
+}
+
+// A sparse vector just over 2^32 bits, dense around 2^32: ranks and selects on both sides of the first
+// level-0 entry, against the sorted positions of the ones. Needs 512 MB for the bits
+static void check_rank_select_l0()
+{
+    const std::size_t l0 = bits::detail::l0_bits;
+    const std::size_t bits = l0 + 100'000;
+    std::vector<std::size_t> ones;
+    for (std::size_t pos = 12'345; pos < bits; pos += 1'000'003)
+        ones.push_back(pos);
+    for (std::size_t pos = l0 - 20'000; pos < l0 + 20'000; pos += 3)
+        ones.push_back(pos);
+    std::sort(ones.begin(), ones.end());
+    ones.erase(std::unique(ones.begin(), ones.end()), ones.end());
+
+    std::vector<std::size_t> queries = rng::uniform_vector<std::size_t>(100'000, 0, bits, 3);
+    for (std::size_t pos = l0 - 30'000; pos <= l0 + 30'000; ++pos)
+        queries.push_back(pos);
+    queries.push_back(bits);
+
+    bool ok = true;
+    try
+    {
+        std::vector<std::uint64_t> words((bits + 63) / 64, 0);
+        for (std::size_t pos : ones)
+            words[pos / 64] |= std::uint64_t(1) << (pos % 64);
+        bits::rank_select rs(std::move(words), bits);
+        for (bits::rank_select_kernel kernel : {bits::rank_select_kernel::portable, bits::rank_select::best_kernel()})
+        {
+            rs.use(kernel);
+            for (std::size_t pos : queries)
+            {
+                const std::size_t rank = static_cast<std::size_t>(std::lower_bound(ones.begin(), ones.end(), pos) - ones.begin());
+                ok = ok && rs.rank1(pos) == rank;
+            }
+            for (std::size_t k = 0; k < ones.size(); ++k)
+                ok = ok && rs.select1(k) == ones[k];
+        }
+        ok = ok && rs.count() == ones.size();
+    }
+    catch (const std::bad_alloc&)
+    {
+        std::cout << "rank/select across 2^32 bits: skipped, not enough memory\n";
+        return;
+    }
+    std::cout << "rank/select across 2^32 bits match the positions? " << ok << "\n";
+}
+
+static void benchmark_select_in_word()
+{
+    const std::size_t n = 1 << 16;
+    std::vector<std::uint64_t> words = rng::uniform_vector<std::uint64_t>(n, 1, ~std::uint64_t(0), 5);
+    std::vector<unsigned> ks(n);
+    for (std::size_t i = 0; i < n; ++i)
+        ks[i] = static_cast<unsigned>(words[i] % bits::detail::popcount64_swar(words[i]));
+
+    bench::options opts;
+    opts.repetitions = 9;
+    bench::suite s("Select in a random word", opts);
+    s.run("clear k lowest bits + ctz", [&] {
+        unsigned sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            std::uint64_t w = words[i];
+            for (unsigned k = ks[i]; k > 0; --k)
+                w &= w - 1;
+            sum += bits::detail::ctz64(w);
+        }
+        bench::do_not_optimize(sum);
+    }, n);
+    s.run("broadword", [&] {
+        unsigned sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += bits::detail::portable_word::select(words[i], ks[i]);
+        bench::do_not_optimize(sum);
+    }, n);
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+    if (bits::rank_select::best_kernel() == bits::rank_select_kernel::bmi2)
+    {
+        s.run("pdep + tzcnt", [&] {
+            unsigned sum = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                sum += bits::detail::bmi2_word::select(words[i], ks[i]);
+            bench::do_not_optimize(sum);
+        }, n);
+    }
+#endif
+    s.report(std::cout);
+    std::cout << "\n";
+}
+
+static void benchmark_rank_select(std::size_t bits)
+{
+    const std::size_t queries_count = 1'000'000;
+    bench::options opts;
+    opts.repetitions = 7;
+
+    for (std::uint32_t one_of : {2u, 100u})
+    {
+        const std::vector<std::uint64_t> words = make_bits(bits, one_of, 7);
+        bits::rank_select rs(words, bits);
+        std::vector<std::uint32_t> positions;
+        if (bits <= (std::size_t(1) << 32))
+        {
+            positions.reserve(rs.count());
+            for (std::size_t i = 0; i < bits; ++i)
+                if (rs[i])
+                    positions.push_back(static_cast<std::uint32_t>(i));
+        }
+
+        const std::vector<std::uint64_t> pos_queries = rng::uniform_vector<std::uint64_t>(queries_count, 0, bits, 8);
+        // no ones, no valid select1() arguments
+        const std::vector<std::uint64_t> k_queries =
+            rs.count() == 0 ? std::vector<std::uint64_t>() : rng::uniform_vector<std::uint64_t>(queries_count, 0, rs.count() - 1, 9);
+
+        const double bits_mb = static_cast<double>(bits) / 8 / 1024 / 1024;
+        std::cout << bits << " bits, one of " << one_of << " set: " << rs.count() << " ones; bits " << bits_mb
+                  << " MB, directory " << static_cast<double>(rs.directory_bytes()) / 1024 / 1024 << " MB ("
+                  << 100.0 * static_cast<double>(rs.directory_bytes()) / (static_cast<double>(bits) / 8)
+                  << "%), sorted positions " << static_cast<double>(positions.size()) * 4 / 1024 / 1024 << " MB\n";
+
+        const std::string title = std::to_string(bits) + " bits, 1/" + std::to_string(one_of) + " set";
+        {
+            bench::suite s("1M random rank1(), " + title, opts);
+            for (bits::rank_select_kernel kernel : {bits::rank_select_kernel::portable, bits::rank_select::best_kernel()})
+            {
+                rs.use(kernel);
+                s.run(kernel == bits::rank_select_kernel::bmi2 ? "rank_select bmi2" : "rank_select portable", [&] {
+                    std::uint64_t sum = 0;
+                    for (std::uint64_t p : pos_queries)
+                        sum += rs.rank1(static_cast<std::size_t>(p));
+                    bench::do_not_optimize(sum);
+                }, queries_count);
+            }
+            if (!positions.empty())
+            {
+                s.run("sorted positions, lower_bound", [&] {
+                    std::uint64_t sum = 0;
+                    for (std::uint64_t p : pos_queries)
+                        sum += static_cast<std::uint64_t>(std::lower_bound(positions.begin(), positions.end(), p) - positions.begin());
+                    bench::do_not_optimize(sum);
+                }, queries_count);
+            }
+            s.report(std::cout);
+        }
+        if (!k_queries.empty())
+        {
+            bench::suite s("1M random select1(), " + title, opts);
+            for (bits::rank_select_kernel kernel : {bits::rank_select_kernel::portable, bits::rank_select::best_kernel()})
+            {
+                rs.use(kernel);
+                s.run(kernel == bits::rank_select_kernel::bmi2 ? "rank_select bmi2" : "rank_select portable", [&] {
+                    std::uint64_t sum = 0;
+                    for (std::uint64_t k : k_queries)
+                        sum += rs.select1(k);
+                    bench::do_not_optimize(sum);
+                }, queries_count);
+            }
+            if (!positions.empty())
+            {
+                s.run("sorted positions, index", [&] {
+                    std::uint64_t sum = 0;
+                    for (std::uint64_t k : k_queries)
+                        sum += positions[static_cast<std::size_t>(k)];
+                    bench::do_not_optimize(sum);
+                }, queries_count);
+            }
+            s.report(std::cout);
+        }
+        std::cout << "\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    demo_rank_select();
+    check_select_in_word();
+    check_rank_select();
+    check_rank_select_l0();
+
+    const std::size_t bits = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : (std::size_t(1) << 28);
+    if (bits > 0)
+    {
+        std::cout << "\n";
+        benchmark_select_in_word();
+        benchmark_rank_select(bits);
+    }
+
+    std::cout << "(rank_select.cpp) OK\n";
+    return 0;
+}
@@ -0,0 +1,378 @@
+#pragma once
+/*
+rank_select.h
+Succinct rank/select directory over a large bit-vector (the layout of Zhou, Andersen, Kaminsky,
+"Space-Efficient, High-Performance Rank & Select Structures on Uncompressed Bit Sequences").
+
+  rank1(pos)   number of ones in [0, pos)
+  select1(k)   position of the one number k (from 0)
+
+They turn a bit-vector into an index: rank maps a row to its number among selected rows,
+select maps the number back to the row. Both are O(1) with a small directory:
+  - L0: absolute count of ones before every 2^32 bits
+  - L1L2: one 64-bit entry per superblock of 2048 bits: ones before the superblock (relative to L0),
+    and three 10-bit counts of its first three 512-bit blocks; a block is 8 words, one cache line
+  - select samples: the superblock of every 8192-th one
+rank1() reads one directory entry and popcounts at most 8 words of one cache line;
+select1() starts from a sample, finds the superblock and the block by counts, the word by popcounts,
+and the bit inside the word by PDEP (deposit 1 << k into the set bits of the word, then count trailing zeros)
+or, without BMI2, by the broadword "byte counts + broadcast comparison" method (Vigna).
+The directory takes 64 bits per 2048 (3.1%) plus at most 32 bits per 8192 ones (0.4%).
+
+Queries are compiled twice: with POPCNT/BMI2 and portable; the CPU picks one on construction.
+PDEP is microcoded (slow) on AMD before Zen 3, where the portable select is faster.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <utilities/cpu_features.h>
+#include <01_low_level/08_bitwise_ops/06_bitset_and_stl/dynamic_bitset.h>
+
+namespace bits
+{
+
+namespace detail
+{
+
+constexpr std::uint64_t ones_step8 = 0x0101010101010101ULL;
+constexpr std::uint64_t msbs_step8 = 0x8080808080808080ULL;
+
+struct select_in_byte_table
+{
+    // position of the one number r in byte b: table[b * 8 + r], 8 if there is no such one
+    std::uint8_t table[256 * 8];
+
+    constexpr select_in_byte_table() : table()
+    {
+        for (unsigned b = 0; b < 256; ++b) {
+            unsigned r = 0;
+            for (unsigned i = 0; i < 8; ++i) {
+                table[b * 8 + i] = 8;
+            }
+            for (unsigned i = 0; i < 8; ++i) {
+                if ((b >> i) & 1) {
+                    table[b * 8 + r++] = static_cast<std::uint8_t>(i);
+                }
+            }
+        }
+    }
+};
+
+inline constexpr select_in_byte_table select_in_byte{};
+
+// Word operations without special instructions
+struct portable_word
+{
+    static unsigned popcount(std::uint64_t w)
+    {
+        return static_cast<unsigned>(popcount64_swar(w));
+    }
+
+    // Position of the one number k of w, k < popcount(w)
+    static unsigned select(std::uint64_t w, unsigned k)
+    {
+        // cumulative byte counts: byte i holds the number of ones in bytes 0..i
+        std::uint64_t s = w - ((w >> 1) & 0x5555555555555555ULL);
+        s = (s & 0x3333333333333333ULL) + ((s >> 2) & 0x3333333333333333ULL);
+        s = (s + (s >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        const std::uint64_t byte_sums = s * ones_step8;
+
+        // k broadcast to all bytes and compared with all counts at once: counts are < 128,
+        // so (k | 0x80) - count doesn't borrow from the next byte, and its top bit is set if count <= k
+        const std::uint64_t k_step8 = k * ones_step8;
+        const std::uint64_t not_greater = ((k_step8 | msbs_step8) - byte_sums) & msbs_step8;
+        // the number of bytes with count <= k is the byte holding the one
+        const unsigned place = static_cast<unsigned>(((not_greater >> 7) * ones_step8) >> 56) * 8;
+        const unsigned byte_rank = k - static_cast<unsigned>(((byte_sums << 8) >> place) & 0xFF);
+        return place + select_in_byte.table[((w >> place) & 0xFF) * 8 + byte_rank];
+    }
+};
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+struct bmi2_word
+{
+    __attribute__((target("popcnt"))) static unsigned popcount(std::uint64_t w)
+    {
+        return static_cast<unsigned>(__builtin_popcountll(w));
+    }
+
+    __attribute__((target("bmi,bmi2"))) static unsigned select(std::uint64_t w, unsigned k)
+    {
+        return static_cast<unsigned>(_tzcnt_u64(_pdep_u64(std::uint64_t(1) << k, w)));
+    }
+};
+#endif
+
+// Directory layout constants
+constexpr size_t block_bits = 512;
+constexpr size_t block_words = block_bits / 64;
+constexpr size_t superblock_bits = 2048;
+constexpr size_t superblock_words = superblock_bits / 64;
+constexpr size_t l0_bits = size_t(1) << 32;
+constexpr size_t superblocks_per_l0 = l0_bits / superblock_bits;
+constexpr size_t select_sample_rate = 8192;
+
+// Arrays of a built directory, queries read them only
+struct rank_select_index
+{
+    const std::uint64_t* words = nullptr;
+    size_t bits = 0;
+    size_t ones = 0;
+    const std::uint64_t* l0 = nullptr;
+    const std::uint64_t* l12 = nullptr;
+    size_t superblocks = 0;
+    const std::uint32_t* samples = nullptr;
+    size_t sample_count = 0;
+};
+
+// Ones before superblock `sb`
+inline std::uint64_t superblock_rank(const rank_select_index& index, size_t sb)
+{
+    return index.l0[sb / superblocks_per_l0] + (index.l12[sb] & 0xFFFFFFFFu);
+}
+
+template <class Word>
+std::uint64_t rank_kernel(const rank_select_index& index, size_t pos)
+{
+    const size_t sb = pos / superblock_bits;
+    const std::uint64_t entry = index.l12[sb];
+    std::uint64_t rank = index.l0[sb / superblocks_per_l0] + (entry & 0xFFFFFFFFu);
+
+    // counts of blocks before the one holding `pos`, without branches
+    const size_t block = (pos / block_bits) % 4;
+    const std::uint64_t c0 = (entry >> 32) & 0x3FF, c1 = (entry >> 42) & 0x3FF, c2 = (entry >> 52) & 0x3FF;
+    rank += (block > 0 ? c0 : 0) + (block > 1 ? c1 : 0) + (block > 2 ? c2 : 0);
+
+    // whole words of the block before `pos`, then the bits of its word below `pos`
+    const size_t word = pos / 64;
+    for (size_t i = word & ~(block_words - 1); i < word; ++i) {
+        rank += Word::popcount(index.words[i]);
+    }
+    if (pos % 64 != 0) {
+        rank += Word::popcount(index.words[word] & (~std::uint64_t(0) >> (64 - pos % 64)));
+    }
+    return rank;
+}
+
+template <class Word>
+size_t select_kernel(const rank_select_index& index, std::uint64_t k)
+{
+    // the superblock holding the one: the last one with superblock_rank <= k,
+    // between the samples of k and of the next sampled one
+    const size_t sample = static_cast<size_t>(k / select_sample_rate);
+    size_t first = index.samples[sample];
+    size_t count = (sample + 1 < index.sample_count ? index.samples[sample + 1] + 1 : index.superblocks) - first;
+    while (count > 1) {
+        const size_t half = count / 2;
+        first = superblock_rank(index, first + half) <= k ? first + half : first;
+        count -= half;
+    }
+    const size_t sb = first;
+    unsigned rest = static_cast<unsigned>(k - superblock_rank(index, sb));
+
+    // the block by its counts
+    const std::uint64_t entry = index.l12[sb];
+    const unsigned c0 = (entry >> 32) & 0x3FF, c1 = (entry >> 42) & 0x3FF, c2 = (entry >> 52) & 0x3FF;
+    size_t block = 0;
+    if (rest >= c0) {
+        rest -= c0;
+        ++block;
+        if (rest >= c1) {
+            rest -= c1;
+            ++block;
+            if (rest >= c2) {
+                rest -= c2;
+                ++block;
+            }
+        }
+    }
+
+    // the word, then the bit
+    size_t word = sb * superblock_words + block * block_words;
+    for (;; ++word) {
+        const unsigned ones = Word::popcount(index.words[word]);
+        if (rest < ones) {
+            break;
+        }
+        rest -= ones;
+    }
+    return word * 64 + Word::select(index.words[word], rest);
+}
+
+using rank_function = std::uint64_t (*)(const rank_select_index&, size_t);
+using select_function = size_t (*)(const rank_select_index&, std::uint64_t);
+
+inline std::uint64_t rank_portable(const rank_select_index& index, size_t pos)
+{
+    return rank_kernel<portable_word>(index, pos);
+}
+
+inline size_t select_portable(const rank_select_index& index, std::uint64_t k)
+{
+    return select_kernel<portable_word>(index, k);
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+// flatten inlines the kernels here, and they are compiled for this target too
+__attribute__((target("popcnt,bmi,bmi2"), flatten)) inline std::uint64_t rank_bmi2(const rank_select_index& index, size_t pos)
+{
+    return rank_kernel<bmi2_word>(index, pos);
+}
+
+__attribute__((target("popcnt,bmi,bmi2"), flatten)) inline size_t select_bmi2(const rank_select_index& index, std::uint64_t k)
+{
+    return select_kernel<bmi2_word>(index, k);
+}
+#endif
+
+} // namespace detail
+
+enum class rank_select_kernel
+{
+    portable,
+    bmi2
+};
+
+class rank_select
+{
+public:
+    rank_select(std::vector<std::uint64_t> words, size_t bits, rank_select_kernel kernel = best_kernel())
+        : data(std::move(words))
+    {
+        if (data.size() * 64 < bits) {
+            throw std::invalid_argument("rank_select: fewer words than bits");
+        }
+        data.resize((bits + 63) / 64);
+        if (bits % 64 != 0) {
+            data.back() &= ~std::uint64_t(0) >> (64 - bits % 64);
+        }
+        // complete superblocks, so kernels never read past the end
+        data.resize((bits + detail::superblock_bits - 1) / detail::superblock_bits * detail::superblock_words, 0);
+        index.bits = bits;
+        build();
+        use(kernel);
+    }
+
+    explicit rank_select(const dynamic_bitset& set, rank_select_kernel kernel = best_kernel())
+        : rank_select(std::vector<std::uint64_t>(set.data(), set.data() + set.word_count()), set.size(), kernel)
+    {
+    }
+
+    // The index points into own vectors: moving keeps their buffers, copying would not
+    rank_select(const rank_select&) = delete;
+    rank_select& operator=(const rank_select&) = delete;
+    rank_select(rank_select&&) = default;
+    rank_select& operator=(rank_select&&) = default;
+
+    // BMI2 if the CPU has it
+    static rank_select_kernel best_kernel()
+    {
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        if (cpu::detected().contains({cpu::feature::popcnt, cpu::feature::bmi1, cpu::feature::bmi2})) {
+            return rank_select_kernel::bmi2;
+        }
+#endif
+        return rank_select_kernel::portable;
+    }
+
+    void use(rank_select_kernel kernel)
+    {
+        rank_query = detail::rank_portable;
+        select_query = detail::select_portable;
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+        if (kernel == rank_select_kernel::bmi2) {
+            rank_query = detail::rank_bmi2;
+            select_query = detail::select_bmi2;
+        }
+#else
+        (void)kernel;
+#endif
+    }
+
+    size_t size() const { return index.bits; }
+    size_t count() const { return index.ones; }
+
+    bool operator[](size_t pos) const
+    {
+        return (data[pos / 64] >> (pos % 64)) & 1;
+    }
+
+    // Ones in [0, pos), pos <= size()
+    std::uint64_t rank1(size_t pos) const
+    {
+        return rank_query(index, pos);
+    }
+
+    // Zeros in [0, pos)
+    std::uint64_t rank0(size_t pos) const
+    {
+        return pos - rank1(pos);
+    }
+
+    // Position of the one number k (from 0), k < count()
+    size_t select1(std::uint64_t k) const
+    {
+        return select_query(index, k);
+    }
+
+    // Bytes of the directory, without the bits themselves
+    size_t directory_bytes() const
+    {
+        return (l0.size() + l12.size()) * sizeof(std::uint64_t) + samples.size() * sizeof(std::uint32_t);
+    }
+
+private:
+    void build()
+    {
+        const size_t superblocks = data.size() / detail::superblock_words;
+        l12.assign(superblocks + 1, 0);
+        l0.assign(superblocks / detail::superblocks_per_l0 + 1, 0);
+
+        std::uint64_t total = 0;
+        for (size_t sb = 0; sb <= superblocks; ++sb) {
+            if (sb % detail::superblocks_per_l0 == 0) {
+                l0[sb / detail::superblocks_per_l0] = total;
+            }
+            const std::uint64_t relative = total - l0[sb / detail::superblocks_per_l0];
+            std::uint64_t entry = relative;
+            if (sb < superblocks) {
+                for (size_t block = 0; block < 4; ++block) {
+                    const std::uint64_t* w = data.data() + sb * detail::superblock_words + block * detail::block_words;
+                    const std::uint64_t ones = popcount(w, detail::block_words * sizeof(std::uint64_t));
+                    if (block < 3) {
+                        entry |= ones << (32 + 10 * block);
+                    }
+                    // the sample of every select_sample_rate-th one falling into this block
+                    while (samples.size() * detail::select_sample_rate < total + ones) {
+                        samples.push_back(static_cast<std::uint32_t>(sb));
+                    }
+                    total += ones;
+                }
+            }
+            l12[sb] = entry;
+        }
+
+        index.words = data.data();
+        index.ones = total;
+        index.l0 = l0.data();
+        index.l12 = l12.data();
+        index.superblocks = superblocks;
+        index.samples = samples.data();
+        index.sample_count = samples.size();
+    }
+
+    std::vector<std::uint64_t> data;
+    // the entry after the last superblock holds the total, so the binary search of select1() can read it
+    std::vector<std::uint64_t> l12;
+    std::vector<std::uint64_t> l0;
+    std::vector<std::uint32_t> samples;
+    detail::rank_select_index index;
+    detail::rank_function rank_query = nullptr;
+    detail::select_function select_query = nullptr;
+};
+
+} // namespace bits
@@ -0,0 +1,266 @@
+/*
+bit_packing.cpp
+Bit-packed integer arrays (packed_array.h): the shifts and masks of 02_shifts and 05_masks_and_flags
+applied to storage, with scalar and AVX2 bulk pack/unpack kernels, and frame-of-reference/delta blocks.
+
+Benchmarks compare memory and speed with std::vector<std::uint32_t> for 5, 12 and 20-bit values;
+the number of values is taken from the command line:
+  ./10_bit_packing 33554432
+
+Build (C++17):
+  g++ -std=c++17 -O2 -Wall -Wextra -pedantic -I../../.. bit_packing.cpp -o bit_packing
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <utilities/benchmark.h>
+#include <utilities/generate.h>
+#include "packed_array.h"
+
+static void demo_packed_array()
+{
+    std::cout << "== packed_array ==\n";
+    bits::packed_array<5> codes;
+    for (std::uint32_t v : {3u, 31u, 0u, 17u, 8u, 30u, 1u, 12u, 25u})
+        codes.push_back(v);
+    std::cout << codes.size() << " values of " << codes.bits << " bits (max " << codes.max_value << "):";
+    for (std::size_t i = 0; i < codes.size(); ++i)
+        std::cout << " " << codes[i];
+    codes.set(2, 33);
+    std::cout << "\nset(2, 33) keeps the low 5 bits: " << codes[2] << "\n";
+
+    std::cout << "kernels for 5 bits: " << cpu::select(bits::packing_kernels<5>()).name
+              << ", for 30 bits: " << cpu::select(bits::packing_kernels<30>()).name << "\n";
+
+    // sorted ids with small gaps
+    std::vector<std::uint32_t> ids;
+    for (std::uint32_t id = 1000000, i = 0; i < 1000; ++i, id += 1 + i % 7)
+        ids.push_back(id);
+    const bits::packed_sequence by_reference(ids.data(), ids.size());
+    const bits::packed_sequence by_delta(ids.data(), ids.size(), bits::packed_mode::delta);
+    std::cout << "1000 sorted ids: " << ids.size() * 4 << " bytes as uint32, " << by_reference.byte_size()
+              << " frame of reference, " << by_delta.byte_size() << " delta; ids[500]=" << by_delta[500] << "\n";
+}
+
+template <unsigned Bits>
+static bool check_width()
+{
+    const std::size_t n = 1000;
+    std::vector<std::uint32_t> values = rng::uniform_vector<std::uint32_t>(n, 0, ~0u, Bits);
+    std::vector<std::uint32_t> expected(n), out(n);
+    for (std::size_t i = 0; i < n; ++i)
+        expected[i] = values[i] & bits::packed_array<Bits>::max_value;
+
+    bool ok = true;
+    for (const auto& packer : bits::packing_kernels<Bits>())
+    {
+        for (const auto& unpacker : bits::packing_kernels<Bits>())
+        {
+            if (!cpu::detected().contains(packer.required) || !cpu::detected().contains(unpacker.required))
+                continue;
+            // whole array, then a range inside values set one by one, which must keep its neighbours
+            bits::packed_array<Bits> a(n);
+            a.pack(0, values.data(), n, packer.function.pack);
+            a.unpack(0, n, out.data(), unpacker.function.unpack);
+            ok = ok && out == expected;
+
+            bits::packed_array<Bits> b(n);
+            for (std::size_t i = 0; i < n; ++i)
+                b.set(i, values[n - 1 - i]);
+            for (std::size_t first : {std::size_t(0), std::size_t(3), std::size_t(8), std::size_t(13)})
+            {
+                for (std::size_t count : {std::size_t(0), std::size_t(5), std::size_t(64), std::size_t(501)})
+                {
+                    bits::packed_array<Bits> c(n);
+                    for (std::size_t i = 0; i < n; ++i)
+                        c.set(i, values[n - 1 - i]);
+                    c.pack(first, values.data(), count, packer.function.pack);
+                    for (std::size_t i = 0; i < n; ++i)
+                        ok = ok && c[i] == (i >= first && i < first + count ? expected[i - first] : b[i]);
+                    c.unpack(first, count, out.data(), unpacker.function.unpack);
+                    ok = ok && std::equal(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(count), expected.begin());
+                }
+            }
+        }
+    }
+
+    // shrinking clears values past the end
+    bits::packed_array<Bits> r(n, bits::packed_array<Bits>::max_value);
+    r.resize(n / 3);
+    r.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+        ok = ok && r[i] == (i < n / 3 ? bits::packed_array<Bits>::max_value : 0);
+    return ok;
+}
+
+template <std::size_t... I>
+static bool check_widths(std::index_sequence<I...>)
+{
+    return (check_width<I + 1>() && ...);
+}
+
+static void check_packed_sequence()
+{
+    bool ok = true;
+    for (bits::packed_mode mode : {bits::packed_mode::frame_of_reference, bits::packed_mode::delta})
+    {
+        for (std::size_t n : {std::size_t(0), std::size_t(1), std::size_t(128), std::size_t(1000)})
+        {
+            // random, sorted, constant and full-range values
+            for (int kind = 0; kind < 4; ++kind)
+            {
+                std::vector<std::uint32_t> v = rng::uniform_vector<std::uint32_t>(n, 0, kind == 3 ? ~0u : 100000, n + 7);
+                if (kind == 1)
+                    std::sort(v.begin(), v.end());
+                if (kind == 2)
+                    std::fill(v.begin(), v.end(), 42u);
+                const bits::packed_sequence s(v.data(), v.size(), mode);
+                std::vector<std::uint32_t> out(n);
+                s.decode(out.data());
+                ok = ok && out == v && s.size() == n;
+                for (std::size_t i = 0; i < n; i += 7)
+                    ok = ok && s[i] == v[i];
+            }
+        }
+    }
+    std::cout << "packed_sequence decodes the input? " << ok << "\n";
+}
+
+template <unsigned Bits>
+static void benchmark_width(std::size_t n)
+{
+    const std::vector<std::uint32_t> values = rng::uniform_vector<std::uint32_t>(n, 0, bits::packed_array<Bits>::max_value, Bits);
+    const std::vector<std::uint32_t> queries = rng::uniform_vector<std::uint32_t>(1'000'000, 0, static_cast<std::uint32_t>(n - 1), 3);
+    std::vector<std::uint32_t> out(n);
+    bits::packed_array<Bits> a(n);
+    a.pack(0, values.data(), n);
+
+    std::cout << n << " values of " << Bits << " bits: std::vector<std::uint32_t> " << n * 4 / 1024 / 1024
+              << " MB, packed_array " << a.byte_size() / 1024 / 1024 << " MB\n";
+
+    bench::options opts;
+    opts.repetitions = 7;
+    const std::string title = std::to_string(n) + " values of " + std::to_string(Bits) + " bits";
+    {
+        bench::suite s("Decode to uint32, " + title, opts);
+        s.run("vector<uint32_t> copy", [&] {
+            std::memcpy(out.data(), values.data(), n * 4);
+            bench::do_not_optimize(out.data());
+        }, n);
+        s.run("packed_array get()", [&] {
+            for (std::size_t i = 0; i < n; ++i)
+                out[i] = a[i];
+            bench::do_not_optimize(out.data());
+        }, n);
+        for (const auto& k : bits::packing_kernels<Bits>())
+        {
+            if (!cpu::detected().contains(k.required))
+                continue;
+            s.run(std::string("packed_array unpack ") + k.name, [&] {
+                a.unpack(0, n, out.data(), k.function.unpack);
+                bench::do_not_optimize(out.data());
+            }, n);
+        }
+        s.report(std::cout);
+    }
+    {
+        bench::suite s("Encode from uint32, " + title, opts);
+        bits::packed_array<Bits> b(n);
+        s.run("vector<uint32_t> copy", [&] {
+            std::memcpy(out.data(), values.data(), n * 4);
+            bench::do_not_optimize(out.data());
+        }, n);
+        s.run("packed_array set()", [&] {
+            for (std::size_t i = 0; i < n; ++i)
+                b.set(i, values[i]);
+            bench::do_not_optimize(b);
+        }, n);
+        for (const auto& k : bits::packing_kernels<Bits>())
+        {
+            if (!cpu::detected().contains(k.required))
+                continue;
+            s.run(std::string("packed_array pack ") + k.name, [&] {
+                b.pack(0, values.data(), n, k.function.pack);
+                bench::do_not_optimize(b);
+            }, n);
+        }
+        s.report(std::cout);
+    }
+    {
+        bench::suite s("1M random reads, " + title, opts);
+        s.run("vector<uint32_t>", [&] {
+            std::uint64_t sum = 0;
+            for (std::uint32_t q : queries)
+                sum += values[q];
+            bench::do_not_optimize(sum);
+        }, queries.size());
+        s.run("packed_array", [&] {
+            std::uint64_t sum = 0;
+            for (std::uint32_t q : queries)
+                sum += a[q];
+            bench::do_not_optimize(sum);
+        }, queries.size());
+        s.report(std::cout);
+    }
+    std::cout << "\n";
+}
+
+// Sorted 32-bit ids with gaps of 0..63: too wide for a fixed small width, but with small differences
+static void benchmark_packed_sequence(std::size_t n)
+{
+    std::vector<std::uint32_t> ids = rng::uniform_vector<std::uint32_t>(n, 0, 63, 4);
+    std::uint32_t id = 1u << 30;
+    for (std::uint32_t& v : ids)
+        v = id += v;
+    std::vector<std::uint32_t> out(n);
+    const bits::packed_sequence by_reference(ids.data(), n);
+    const bits::packed_sequence by_delta(ids.data(), n, bits::packed_mode::delta);
+
+    std::cout << n << " sorted ids: std::vector<std::uint32_t> " << n * 4 / 1024 / 1024 << " MB, frame of reference "
+              << by_reference.byte_size() / 1024 / 1024 << " MB, delta " << by_delta.byte_size() / 1024 / 1024 << " MB\n";
+
+    bench::options opts;
+    opts.repetitions = 7;
+    bench::suite s("Decode " + std::to_string(n) + " sorted ids", opts);
+    s.run("vector<uint32_t> copy", [&] {
+        std::memcpy(out.data(), ids.data(), n * 4);
+        bench::do_not_optimize(out.data());
+    }, n);
+    s.run("frame of reference", [&] {
+        by_reference.decode(out.data());
+        bench::do_not_optimize(out.data());
+    }, n);
+    s.run("delta", [&] {
+        by_delta.decode(out.data());
+        bench::do_not_optimize(out.data());
+    }, n);
+    s.report(std::cout);
+    std::cout << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+    demo_packed_array();
+    std::cout << "packed_array matches uint32 values for 1..32 bits? " << check_widths(std::make_index_sequence<32>()) << "\n";
+    check_packed_sequence();
+
+    const std::size_t n = argc > 1 ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : (std::size_t(1) << 25);
+    if (n > 0)
+    {
+        std::cout << "\n";
+        benchmark_width<5>(n);
+        benchmark_width<12>(n);
+        benchmark_width<20>(n);
+        benchmark_packed_sequence(n);
+    }
+
+    std::cout << "(bit_packing.cpp) OK\n";
+    return 0;
+}
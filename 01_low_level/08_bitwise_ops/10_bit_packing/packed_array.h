@@ -0,0 +1,575 @@
+#pragma once
+/*
+packed_array.h
+Arrays of small unsigned integers stored with exactly `Bits` bits per value, e.g. 5-bit codes
+take 5/32 of std::vector<std::uint32_t>.
+
+Layout: a little-endian bit stream, value i takes bits [i * Bits, (i + 1) * Bits).
+A group of 8 values takes exactly Bits bytes, so every group starts at a byte boundary.
+
+  - get/set: one unaligned 64-bit load (and store) at byte i * Bits / 8, a shift and a mask;
+    the buffer has `packing_padding` bytes after the data, so loads never go past it
+  - bulk pack/unpack kernels, for streaming encode and decode:
+      scalar: unpack 8 values per group with compile-time shifts, pack by a 64-bit bit-stream writer
+      avx2:   8 values per iteration (Bits <= 25); unpack loads two 16-byte halves of a group,
+              moves 4 bytes of every value into its 32-bit lane by vpshufb, shifts each lane by its own
+              count (vpsrlvd) and masks; pack is the reverse: vpsllvd, then vpshufb passes, one per set
+              of lanes that don't share bytes, OR-ed together
+    the best kernel for the CPU is chosen at run time (utilities/cpu_features.h)
+  - packed_sequence: blocks of 128 values, each packed with its own width
+      frame_of_reference: values minus the minimum of the block, e.g. timestamps, prices
+      delta:              differences of neighbours, e.g. sorted ids; decoding adds a prefix sum
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <utilities/cpu_features.h>
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+namespace bits
+{
+
+// Bytes readable after packed data: unaligned loads of get() and kernels may touch them
+constexpr size_t packing_padding = 32;
+
+// Bytes of `count` values of `bits` bits
+constexpr size_t packed_bytes(size_t count, unsigned bits)
+{
+    return (count * bits + 7) / 8;
+}
+
+// Values are masked to their bits; `out` receives exactly packed_bytes(count, Bits) bytes
+using pack_function = void (*)(const std::uint32_t* values, size_t count, unsigned char* out);
+
+// `in` starts at a byte boundary and is readable for packing_padding bytes after the data
+using unpack_function = void (*)(const unsigned char* in, size_t count, std::uint32_t* values);
+
+namespace detail
+{
+
+inline std::uint64_t load_le64(const unsigned char* p)
+{
+    std::uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    return x;
+}
+
+inline void store_le64(unsigned char* p, std::uint64_t x)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    std::memcpy(p, &x, sizeof(x));
+}
+
+constexpr std::uint64_t low_mask(unsigned bits)
+{
+    return bits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << bits) - 1;
+}
+
+// Value number `index` of the stream at `in`
+inline std::uint32_t extract(const unsigned char* in, size_t index, unsigned bits)
+{
+    const size_t bit = index * bits;
+    return static_cast<std::uint32_t>((load_le64(in + bit / 8) >> (bit % 8)) & low_mask(bits));
+}
+
+inline void deposit(unsigned char* out, size_t index, unsigned bits, std::uint32_t value)
+{
+    const size_t bit = index * bits;
+    const std::uint64_t mask = low_mask(bits) << (bit % 8);
+    const std::uint64_t w = load_le64(out + bit / 8);
+    store_le64(out + bit / 8, (w & ~mask) | ((static_cast<std::uint64_t>(value) << (bit % 8)) & mask));
+}
+
+template <unsigned Bits>
+void unpack_scalar(const unsigned char* in, size_t count, std::uint32_t* values)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8, in += Bits) {
+        // offsets are compile-time constants after unrolling
+        for (unsigned j = 0; j < 8; ++j) {
+            values[i + j] = extract(in, j, Bits);
+        }
+    }
+    const size_t tail = count - i;
+    for (size_t j = 0; j < tail; ++j) {
+        values[i + j] = extract(in, j, Bits);
+    }
+}
+
+template <unsigned Bits>
+void pack_scalar(const std::uint32_t* values, size_t count, unsigned char* out)
+{
+    std::uint64_t acc = 0;
+    unsigned filled = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const std::uint64_t v = values[i] & low_mask(Bits);
+        acc |= v << filled;
+        filled += Bits;
+        if (filled >= 64) {
+            store_le64(out, acc);
+            out += 8;
+            filled -= 64;
+            acc = filled > 0 ? v >> (Bits - filled) : 0;
+        }
+    }
+    for (; filled > 0; filled = filled > 8 ? filled - 8 : 0) {
+        *out++ = static_cast<unsigned char>(acc);
+        acc >>= 8;
+    }
+}
+
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+
+// Widest values whose bytes fit one 32-bit lane after a shift of up to 7 bits
+constexpr unsigned avx2_max_bits = 25;
+
+// Shuffles and shifts of a group of 8 values, lanes 0-3 in the low half (loaded from byte 0 of the group),
+// lanes 4-7 in the high half (loaded from byte high_offset)
+template <unsigned Bits>
+struct group_layout
+{
+    static constexpr unsigned high_offset = Bits / 2;
+
+    alignas(32) unsigned char unpack_shuffle[32];
+    alignas(32) unsigned char pack_shuffle[4][32];
+    alignas(32) std::uint32_t shifts[8];
+    unsigned passes;
+};
+
+template <unsigned Bits>
+constexpr group_layout<Bits> make_group_layout()
+{
+    group_layout<Bits> g{};
+    unsigned first_byte[8] = {}, byte_count[8] = {};
+    for (unsigned j = 0; j < 8; ++j) {
+        const unsigned bit = j * Bits - (j < 4 ? 0 : 8 * group_layout<Bits>::high_offset);
+        first_byte[j] = bit / 8;
+        byte_count[j] = (bit % 8 + Bits + 7) / 8;
+        g.shifts[j] = bit % 8;
+        for (unsigned k = 0; k < 4; ++k) {
+            g.unpack_shuffle[j * 4 + k] = static_cast<unsigned char>(first_byte[j] + k);
+        }
+    }
+
+    // lanes j and j + passes of one half must not share a byte
+    g.passes = 1;
+    for (bool shared = true; shared && g.passes < 4;) {
+        shared = false;
+        for (unsigned j = 0; j + g.passes < 8; ++j) {
+            const bool same_half = (j < 4) == (j + g.passes < 4);
+            shared = shared || (same_half && first_byte[j + g.passes] < first_byte[j] + byte_count[j]);
+        }
+        g.passes += shared ? 1 : 0;
+    }
+
+    for (unsigned p = 0; p < 4; ++p) {
+        for (unsigned b = 0; b < 32; ++b) {
+            g.pack_shuffle[p][b] = 0x80; // zero
+            for (unsigned j = b < 16 ? 0 : 4; j < (b < 16 ? 4u : 8u); ++j) {
+                const unsigned local = b % 16;
+                if (j % g.passes == p && first_byte[j] <= local && local < first_byte[j] + byte_count[j]) {
+                    g.pack_shuffle[p][b] = static_cast<unsigned char>((j % 4) * 4 + local - first_byte[j]);
+                }
+            }
+        }
+    }
+    return g;
+}
+
+template <unsigned Bits>
+constexpr group_layout<Bits> layout = make_group_layout<Bits>();
+
+template <unsigned Bits>
+__attribute__((target("avx2"))) void unpack_avx2(const unsigned char* in, size_t count, std::uint32_t* values)
+{
+    constexpr const group_layout<Bits>& g = layout<Bits>;
+    const __m256i shuffle = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.unpack_shuffle));
+    const __m256i shifts = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.shifts));
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(low_mask(Bits)));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8, in += Bits) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + g.high_offset));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        v = _mm256_shuffle_epi8(v, shuffle);
+        v = _mm256_and_si256(_mm256_srlv_epi32(v, shifts), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), v);
+    }
+    unpack_scalar<Bits>(in, count - i, values + i);
+}
+
+template <unsigned Bits>
+__attribute__((target("avx2"))) void pack_avx2(const std::uint32_t* values, size_t count, unsigned char* out)
+{
+    constexpr const group_layout<Bits>& g = layout<Bits>;
+    __m256i shuffle[4];
+    for (unsigned p = 0; p < 4; ++p) {
+        shuffle[p] = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.pack_shuffle[p]));
+    }
+    const __m256i shifts = _mm256_load_si256(reinterpret_cast<const __m256i*>(g.shifts));
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(low_mask(Bits)));
+
+    // 16-byte stores write zeros up to 16 bytes past the group, the next groups overwrite them;
+    // the last groups are written by the scalar kernel, which writes only its own bytes
+    size_t i = 0;
+    for (; (count - i) * Bits >= 8 * Bits + 128; i += 8, out += Bits) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        v = _mm256_sllv_epi32(_mm256_and_si256(v, mask), shifts);
+        __m256i r = _mm256_shuffle_epi8(v, shuffle[0]);
+        for (unsigned p = 1; p < g.passes; ++p) {
+            r = _mm256_or_si256(r, _mm256_shuffle_epi8(v, shuffle[p]));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(r));
+        // the first byte of the high half may hold the last bits of the low half
+        const __m128i hi = _mm_or_si128(_mm256_extracti128_si256(r, 1), _mm_cvtsi32_si128(out[g.high_offset]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + g.high_offset), hi);
+    }
+    pack_scalar<Bits>(values + i, count - i, out);
+}
+
+#endif // CPP_CPU_X86
+
+inline void unpack_zero(const unsigned char*, size_t count, std::uint32_t* values)
+{
+    std::fill(values, values + count, 0u);
+}
+
+inline void pack_zero(const std::uint32_t*, size_t, unsigned char*)
+{
+}
+
+} // namespace detail
+
+// A kernel packs and unpacks values of the same width
+struct packing_functions
+{
+    pack_function pack;
+    unpack_function unpack;
+};
+
+// Kernels for `Bits`-bit values from the fastest, those compiled for this platform and this width;
+// cpu::select() picks the first one this CPU supports
+template <unsigned Bits>
+const auto& packing_kernels()
+{
+    static_assert(Bits >= 1 && Bits <= 32, "1 to 32 bits per value");
+#if defined(CPP_CPU_X86) && defined(__GNUC__)
+    if constexpr (Bits <= detail::avx2_max_bits) {
+        static const cpu::implementation<packing_functions> kernels[] = {
+            {"avx2", {detail::pack_avx2<Bits>, detail::unpack_avx2<Bits>}, {cpu::feature::avx2}},
+            {"scalar", {detail::pack_scalar<Bits>, detail::unpack_scalar<Bits>}, {}}};
+        return kernels;
+    }
+    else
+#endif
+    {
+        static const cpu::implementation<packing_functions> kernels[] = {
+            {"scalar", {detail::pack_scalar<Bits>, detail::unpack_scalar<Bits>}, {}}};
+        return kernels;
+    }
+}
+
+// Pack `count` values to `Bits` bits each by the best kernel for this CPU, chosen on the first call
+template <unsigned Bits>
+void pack_bits(const std::uint32_t* values, size_t count, unsigned char* out)
+{
+    static const pack_function best = cpu::select(packing_kernels<Bits>()).function.pack;
+    best(values, count, out);
+}
+
+template <unsigned Bits>
+void unpack_bits(const unsigned char* in, size_t count, std::uint32_t* values)
+{
+    static const unpack_function best = cpu::select(packing_kernels<Bits>()).function.unpack;
+    best(in, count, values);
+}
+
+namespace detail
+{
+
+template <size_t... I>
+std::array<pack_function, 33> pack_table(std::index_sequence<I...>)
+{
+    return {{pack_zero, cpu::select(packing_kernels<I + 1>()).function.pack...}};
+}
+
+template <size_t... I>
+std::array<unpack_function, 33> unpack_table(std::index_sequence<I...>)
+{
+    return {{unpack_zero, cpu::select(packing_kernels<I + 1>()).function.unpack...}};
+}
+
+} // namespace detail
+
+// The same with the width known at run time, 0 to 32 bits (0: all values are zero, nothing is stored)
+inline void pack_bits(unsigned bits, const std::uint32_t* values, size_t count, unsigned char* out)
+{
+    static const std::array<pack_function, 33> kernels = detail::pack_table(std::make_index_sequence<32>());
+    kernels[bits](values, count, out);
+}
+
+inline void unpack_bits(unsigned bits, const unsigned char* in, size_t count, std::uint32_t* values)
+{
+    static const std::array<unpack_function, 33> kernels = detail::unpack_table(std::make_index_sequence<32>());
+    kernels[bits](in, count, values);
+}
+
+// Number of bits needed for `x`, 0 for 0
+constexpr unsigned bit_width(std::uint32_t x)
+{
+    unsigned n = 0;
+    for (; x != 0; x >>= 1) {
+        ++n;
+    }
+    return n;
+}
+
+template <unsigned Bits>
+class packed_array
+{
+    static_assert(Bits >= 1 && Bits <= 32, "1 to 32 bits per value");
+
+public:
+    using value_type = std::uint32_t;
+    static constexpr unsigned bits = Bits;
+    static constexpr value_type max_value = static_cast<value_type>(detail::low_mask(Bits));
+
+    packed_array() : bytes(packing_padding, 0)
+    {
+    }
+
+    explicit packed_array(size_t size, value_type value = 0) : packed_array()
+    {
+        resize(size, value);
+    }
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    // Allocated bytes, including the padding
+    size_t byte_size() const { return bytes.size(); }
+
+    const unsigned char* data() const { return bytes.data(); }
+
+    value_type get(size_t i) const
+    {
+        return detail::extract(bytes.data(), i, Bits);
+    }
+
+    value_type operator[](size_t i) const
+    {
+        return get(i);
+    }
+
+    // Bits above max_value are dropped
+    void set(size_t i, value_type value)
+    {
+        detail::deposit(bytes.data(), i, Bits, value);
+    }
+
+    void push_back(value_type value)
+    {
+        resize(length + 1);
+        set(length - 1, value);
+    }
+
+    void resize(size_t size, value_type value = 0)
+    {
+        const size_t old = length;
+        if (size < old) {
+            // clear the bits past the end, so growing again gives zeros
+            for (size_t i = size; i < old && i % 8 != 0; ++i) {
+                set(i, 0);
+            }
+            std::fill(bytes.begin() + static_cast<std::ptrdiff_t>(packed_bytes((size + 7) / 8 * 8, Bits)), bytes.end(), 0);
+        }
+        bytes.resize(packed_bytes(size, Bits) + packing_padding, 0);
+        length = size;
+        for (size_t i = old; i < size && value != 0; ++i) {
+            set(i, value);
+        }
+    }
+
+    void clear()
+    {
+        resize(0);
+    }
+
+    // Values [first, first + count) from `values`; whole groups of 8 are packed by a bulk kernel
+    void pack(size_t first, const value_type* values, size_t count)
+    {
+        pack(first, values, count, cpu::select(packing_kernels<Bits>()).function.pack);
+    }
+
+    void pack(size_t first, const value_type* values, size_t count, pack_function kernel)
+    {
+        check_range(first, count);
+        size_t i = 0;
+        for (; i < count && (first + i) % 8 != 0; ++i) {
+            set(first + i, values[i]);
+        }
+        const size_t groups = (count - i) / 8 * 8;
+        kernel(values + i, groups, bytes.data() + (first + i) / 8 * Bits);
+        for (i += groups; i < count; ++i) {
+            set(first + i, values[i]);
+        }
+    }
+
+    // Values [first, first + count) to `values`
+    void unpack(size_t first, size_t count, value_type* values) const
+    {
+        unpack(first, count, values, cpu::select(packing_kernels<Bits>()).function.unpack);
+    }
+
+    void unpack(size_t first, size_t count, value_type* values, unpack_function kernel) const
+    {
+        check_range(first, count);
+        size_t i = 0;
+        for (; i < count && (first + i) % 8 != 0; ++i) {
+            values[i] = get(first + i);
+        }
+        kernel(bytes.data() + (first + i) / 8 * Bits, count - i, values + i);
+    }
+
+private:
+    void check_range(size_t first, size_t count) const
+    {
+        if (first > length || count > length - first) {
+            throw std::out_of_range("packed_array: range is out of the array");
+        }
+    }
+
+    std::vector<unsigned char> bytes;
+    size_t length = 0;
+};
+
+enum class packed_mode
+{
+    frame_of_reference,
+    delta
+};
+
+// Immutable sequence of 32-bit values in blocks of 128, each block packed with the smallest width
+// for its offsets from the minimum (frame_of_reference) or differences of neighbours (delta)
+class packed_sequence
+{
+public:
+    static constexpr size_t block_size = 128;
+
+    packed_sequence() = default;
+
+    packed_sequence(const std::uint32_t* values, size_t count, packed_mode mode = packed_mode::frame_of_reference)
+        : encoding(mode), length(count)
+    {
+        std::uint32_t offsets[block_size];
+        blocks.reserve((count + block_size - 1) / block_size);
+        size_t offset = 0;
+        for (size_t first = 0; first < count; first += block_size) {
+            const size_t n = std::min(block_size, count - first);
+            const std::uint32_t* v = values + first;
+            block b{offset, v[0], 0};
+            if (mode == packed_mode::frame_of_reference) {
+                b.reference = *std::min_element(v, v + n);
+                for (size_t i = 0; i < n; ++i) {
+                    offsets[i] = v[i] - b.reference;
+                }
+            }
+            else {
+                offsets[0] = 0;
+                for (size_t i = 1; i < n; ++i) {
+                    offsets[i] = v[i] - v[i - 1];
+                }
+            }
+            std::uint32_t any = 0;
+            for (size_t i = 0; i < n; ++i) {
+                any |= offsets[i];
+            }
+            b.width = bit_width(any);
+            payload.resize(offset + packed_bytes(n, b.width) + packing_padding);
+            pack_bits(b.width, offsets, n, payload.data() + offset);
+            offset += packed_bytes(n, b.width);
+            blocks.push_back(b);
+        }
+        payload.resize(offset + packing_padding, 0);
+        payload.shrink_to_fit();
+    }
+
+    packed_mode mode() const { return encoding; }
+    size_t size() const { return length; }
+
+    // Payload and block headers
+    size_t byte_size() const { return payload.size() + blocks.size() * sizeof(block); }
+
+    // O(1) for frame_of_reference, decodes the block up to `i` for delta
+    std::uint32_t operator[](size_t i) const
+    {
+        const block& b = blocks[i / block_size];
+        const unsigned char* p = payload.data() + b.offset;
+        if (encoding == packed_mode::frame_of_reference) {
+            return b.reference + detail::extract(p, i % block_size, b.width);
+        }
+        std::uint32_t v = b.reference;
+        for (size_t k = 1; k <= i % block_size; ++k) {
+            v += detail::extract(p, k, b.width);
+        }
+        return v;
+    }
+
+    // All values to `values`
+    void decode(std::uint32_t* values) const
+    {
+        for (size_t first = 0; first < length; first += block_size) {
+            decode_block(first / block_size, values + first);
+        }
+    }
+
+    // Block number `index` to `values` (up to block_size values)
+    void decode_block(size_t index, std::uint32_t* values) const
+    {
+        const block& b = blocks[index];
+        const size_t n = std::min(block_size, length - index * block_size);
+        unpack_bits(b.width, payload.data() + b.offset, n, values);
+        if (encoding == packed_mode::frame_of_reference) {
+            for (size_t i = 0; i < n; ++i) {
+                values[i] += b.reference;
+            }
+        }
+        else {
+            std::uint32_t sum = b.reference;
+            for (size_t i = 0; i < n; ++i) {
+                sum += values[i];
+                values[i] = sum;
+            }
+        }
+    }
+
+private:
+    struct block
+    {
+        size_t offset;
+        std::uint32_t reference;
+        unsigned width;
+    };
+
+    packed_mode encoding = packed_mode::frame_of_reference;
+    size_t length = 0;
+    std::vector<block> blocks;
+    std::vector<unsigned char> payload;
+};
+
+} // namespace bits
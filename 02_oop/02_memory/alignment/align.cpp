@@ -1,4 +1,19 @@
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <list>
+
+#include <utilities/elapsed.h>
+#include <02_oop/02_memory/memory_pool/memory_pool.h>
+#include <02_oop/02_memory/concurrent_memory_pool/concurrent_memory_pool.h>
+#include <02_oop/02_memory/memory_resource/memory_resources.h>
+#include <04_stl/custom_allocator/custom_allocator.h>
+#include <04_stl/custom_allocator/arena_allocator.h>
 
 // Alignment
 struct S { char c; int i; };
@@ -6,8 +21,132 @@ struct S { char c; int i; };
 // Wrong compare
 bool is_equal(S a, S b) { return 0 == memcmp(&a, &b, sizeof(S)); }
 
+// Types with alignment stronger than alignof(std::max_align_t) (new-extended alignment).
+// Since C++17 `new` passes the alignment to `operator new(size_t, std::align_val_t)`,
+// but every custom pool or allocator has to take care of it by itself
+
+// 8 floats for a 256-bit SIMD register, aligned loads require 32-byte alignment
+struct alignas(32) vec8
+{
+    float v[8];
+};
+
+// Per-core data, should not share a cache line with another core's data
+struct alignas(cache_line_size) per_core_stats
+{
+    std::uint64_t requests;
+    std::uint64_t bytes;
+};
+
+template <typename T>
+const char* aligned(const T* p)
+{
+    return reinterpret_cast<std::uintptr_t>(p) % alignof(T) == 0 ? "aligned" : "MISALIGNED";
+}
+
+void show_aligned_allocation()
+{
+    std::cout << "alignof(std::max_align_t) = " << alignof(std::max_align_t)
+              << ", alignof(vec8) = " << alignof(vec8)
+              << ", alignof(per_core_stats) = " << alignof(per_core_stats) << '\n';
+
+    // global new, aligned form is called implicitly
+    vec8* p = new vec8();
+    std::cout << "new vec8                      : " << aligned(p) << '\n';
+    delete p;
+
+    memory_pool<vec8> pool;
+    void* v[3];
+    for (void*& block : v) {
+        block = pool.alloc(sizeof(vec8));
+    }
+    std::cout << "memory_pool<vec8>             : " << aligned(static_cast<vec8*>(v[0]))
+              << ", " << aligned(static_cast<vec8*>(v[1])) << ", " << aligned(static_cast<vec8*>(v[2])) << '\n';
+    for (void* block : v) {
+        pool.free(block, sizeof(vec8));
+    }
+
+    memory_pool<per_core_stats> stats_pool;
+    void* s = stats_pool.alloc(sizeof(per_core_stats));
+    std::cout << "memory_pool<per_core_stats>   : " << aligned(static_cast<per_core_stats*>(s)) << '\n';
+    stats_pool.free(s, sizeof(per_core_stats));
+
+    using concurrent_pool = concurrent_memory_pool<per_core_stats>;
+    void* c = concurrent_pool::instance().alloc(sizeof(per_core_stats));
+    std::cout << "concurrent_memory_pool        : " << aligned(static_cast<per_core_stats*>(c)) << '\n';
+    concurrent_pool::instance().free(c, sizeof(per_core_stats));
+
+    std::vector<vec8, std::custom_allocator<vec8>> custom(5);
+    std::cout << "vector<vec8, custom_allocator>: " << aligned(custom.data()) << '\n';
+
+    // arena is shared by differently aligned objects, so it aligns every allocation
+    monotonic_arena arena;
+    std::list<char, arena_allocator<char>> chars(3, 'x', arena_allocator<char>(arena));
+    std::vector<vec8, arena_allocator<vec8>> arena_vector(5, vec8(), arena_allocator<vec8>(arena));
+    std::cout << "vector<vec8, arena_allocator> : " << aligned(arena_vector.data()) << '\n';
+
+    pool_resource resource;
+    std::pmr::vector<per_core_stats> pmr_vector(3, per_core_stats(), &resource);
+    std::cout << "pmr::vector on pool_resource  : " << aligned(pmr_vector.data()) << '\n';
+}
+
+// Counter for a single thread, 8 bytes
+struct counter
+{
+    std::atomic<std::uint64_t> value{0};
+};
+
+// Every thread increments its own counter allocated from the pool.
+// In the packed pool 8 counters share a cache line, and every increment
+// invalidates the line in caches of other cores (false sharing)
+template <slot_layout Layout>
+long long bench_counters(size_t threads, size_t increments)
+{
+    memory_pool<counter, Layout> pool;
+    std::vector<counter*> counters;
+    for (size_t t = 0; t < threads; ++t) {
+        counters.push_back(new (pool.alloc(sizeof(counter))) counter());
+    }
+
+    std::vector<std::thread> workers;
+    MeasureTime timer;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([c = counters[t], increments] {
+            for (size_t i = 0; i < increments; ++i) {
+                c->value.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    long long elapsed = timer.elapsed_mcsec();
+
+    for (counter* c : counters) {
+        c->~counter();
+        pool.free(c, sizeof(counter));
+    }
+    return elapsed;
+}
+
+void benchmark_false_sharing()
+{
+    const size_t threads = std::max(2u, std::thread::hardware_concurrency());
+    constexpr size_t increments = 10'000'000;
+
+    std::cout << "\n" << threads << " threads, " << increments << " increments of own counter (usec, lower is better)\n";
+    std::cout << "  packed slots            (" << std::setw(2) << sizeof(counter) << " bytes): "
+              << bench_counters<slot_layout::packed>(threads, increments) << '\n';
+    std::cout << "  cache line padded slots (" << std::setw(2) << cache_line_size << " bytes): "
+              << bench_counters<slot_layout::cache_line_padded>(threads, increments) << '\n';
+    if (std::thread::hardware_concurrency() < 2) {
+        std::cout << "  (single hardware thread: no false sharing is possible)\n";
+    }
+}
+
 int main()
 {
+    show_aligned_allocation();
+    benchmark_false_sharing();
     return 0;
 }
-
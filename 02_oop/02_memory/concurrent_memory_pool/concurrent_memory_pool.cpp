@@ -0,0 +1,171 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+
+#include <utilities/elapsed.h>
+#include <02_oop/02_memory/memory_pool/memory_pool.h>
+#include "concurrent_memory_pool.h"
+
+// The memory_pool from the previous example has no synchronization,
+// so objects using it can't be created and deleted by different threads.
+// A pool guarded by a single mutex is correct, but all threads contend on the lock.
+// The concurrent pool keeps free blocks in per-thread magazines,
+// and touches the shared lock-free depot only once per magazine.
+
+class shared_pool_item
+{
+public:
+    explicit shared_pool_item(int v) : value(v) {}
+
+    // new/delete overload for using the per-thread cached pool
+    static void* operator new(size_t s)
+    {
+        return concurrent_memory_pool<shared_pool_item>::instance().alloc(s);
+    }
+
+    static void operator delete(void* p, size_t s)
+    {
+        concurrent_memory_pool<shared_pool_item>::instance().free(p, s);
+    }
+
+    int get() const { return value; }
+
+private:
+    int value;
+    int padding[3] = {};
+};
+
+// Objects created in one thread and deleted in another
+void show_cross_thread_free()
+{
+    std::vector<shared_pool_item*> items;
+    for (int i = 0; i < 1000; ++i) {
+        items.push_back(new shared_pool_item(i));
+    }
+
+    // a worker frees what the main thread has allocated;
+    // blocks go to the worker's magazines, and on the worker exit to the depot
+    long long sum = 0;
+    std::thread worker([&] {
+        for (shared_pool_item* item : items) {
+            sum += item->get();
+            delete item;
+        }
+    });
+    worker.join();
+
+    // main thread picks the blocks up again through the depot
+    for (int i = 0; i < 1000; ++i) {
+        items[i] = new shared_pool_item(i);
+    }
+    for (shared_pool_item* item : items) {
+        delete item;
+    }
+
+    const auto& pool = concurrent_memory_pool<shared_pool_item>::instance();
+    std::cout << "Cross-thread free: sum = " << sum
+              << ", pool capacity = " << pool.capacity()
+              << " blocks in " << pool.chunk_count() << " chunks\n";
+}
+
+// Small object for the benchmark
+struct bench_item
+{
+    std::uint64_t payload[4];
+};
+
+// Single pool shared by threads under a global mutex
+class locked_pool
+{
+public:
+    void* alloc(size_t s)
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        return pool.alloc(s);
+    }
+
+    void free(void* p, size_t s)
+    {
+        std::lock_guard<std::mutex> lock(guard);
+        pool.free(p, s);
+    }
+
+private:
+    std::mutex guard;
+    memory_pool<bench_item> pool;
+};
+
+// Every thread allocates a batch of blocks and frees it, `rounds` times.
+// Returns elapsed time in microseconds for all threads
+template <typename Alloc, typename Free>
+long long bench_threads(size_t threads, size_t rounds, Alloc alloc, Free release)
+{
+    constexpr size_t batch = 256;
+    std::vector<std::thread> workers;
+    MeasureTime timer;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            std::vector<void*> blocks(batch);
+            for (size_t r = 0; r < rounds; ++r) {
+                for (void*& p : blocks) {
+                    p = alloc();
+                    static_cast<bench_item*>(p)->payload[0] = r;
+                }
+                for (void* p : blocks) {
+                    release(p);
+                }
+            }
+        });
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    return timer.elapsed_mcsec();
+}
+
+void benchmark_concurrent_pool()
+{
+    const size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+    constexpr size_t rounds = 4000;
+    using pool_type = concurrent_memory_pool<bench_item>;
+
+    std::cout << "\nEach thread allocates and frees " << rounds << " x 256 blocks of "
+              << sizeof(bench_item) << " bytes (Mops/s, higher is better)\n";
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "magazines"
+              << std::setw(14) << "mutex pool" << std::setw(14) << "malloc" << '\n';
+
+    locked_pool locked;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        const double ops = 2.0 * threads * rounds * 256;
+
+        long long pool_us = bench_threads(threads, rounds,
+            [] { return pool_type::instance().alloc(sizeof(bench_item)); },
+            [](void* p) { pool_type::instance().free(p, sizeof(bench_item)); });
+
+        long long locked_us = bench_threads(threads, rounds,
+            [&] { return locked.alloc(sizeof(bench_item)); },
+            [&](void* p) { locked.free(p, sizeof(bench_item)); });
+
+        long long malloc_us = bench_threads(threads, rounds,
+            [] { return std::malloc(sizeof(bench_item)); },
+            [](void* p) { std::free(p); });
+
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(1)
+                  << std::setw(14) << ops / pool_us
+                  << std::setw(14) << ops / locked_us
+                  << std::setw(14) << ops / malloc_us << '\n';
+    }
+    std::cout << "(hardware threads: " << std::thread::hardware_concurrency() << ")\n";
+}
+
+int main()
+{
+    show_cross_thread_free();
+    benchmark_concurrent_pool();
+    return 0;
+}
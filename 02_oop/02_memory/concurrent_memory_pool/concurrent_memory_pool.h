@@ -0,0 +1,265 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Thread-safe fixed-size pool with per-thread caches (magazine allocator)
+//
+// Every thread keeps two magazines, short lists of free blocks, in thread-local storage:
+// `loaded` serves alloc() and free(), `previous` is either full or empty.
+// While a thread allocates and frees blocks from its own magazines, no synchronization at all is needed.
+// When both magazines are empty (or full), the thread exchanges a whole magazine
+// with the central depot, a lock-free stack of full magazines.
+// So the shared state is touched once per MagazineSize operations at most.
+//
+// Blocks are interchangeable, so a block may be freed by any thread:
+// it just goes to the magazine of the freeing thread and eventually returns to the depot.
+// On thread exit its magazines are returned to the depot as well.
+//
+// Thread-local caches are shared by all users of the type T,
+// so the pool is a single per-type object available through instance()
+// Blocks honour `alignof(T)`, chunks are allocated by the aligned `operator new()`
+template <typename T, size_t MagazineSize = 64>
+class concurrent_memory_pool
+{
+public:
+    static concurrent_memory_pool& instance()
+    {
+        static concurrent_memory_pool pool;
+        return pool;
+    }
+
+    concurrent_memory_pool(const concurrent_memory_pool&) = delete;
+    concurrent_memory_pool& operator=(const concurrent_memory_pool&) = delete;
+
+    void* alloc(size_t s)
+    {
+        // `operator new()` is inherited by derived classes,
+        // and a derived object may not fit into the pool slot
+        if (s > sizeof(T)) {
+            return ::operator new(s, std::align_val_t(alignof(T)));
+        }
+
+        thread_cache& cache = local_cache();
+        if (0 == cache.loaded.count) {
+            if (cache.previous.count > 0) {
+                swap_magazines(cache);
+            }
+            else {
+                cache.loaded = depot_pop();
+                if (0 == cache.loaded.count) {
+                    cache.loaded = grow();
+                }
+            }
+        }
+
+        block* b = cache.loaded.head;
+        cache.loaded.head = b->link.next;
+        --cache.loaded.count;
+        return b;
+    }
+
+    void free(void* p, size_t s)
+    {
+        if (nullptr == p) {
+            return;
+        }
+        if (s > sizeof(T)) {
+            ::operator delete(p, std::align_val_t(alignof(T)));
+            return;
+        }
+
+        thread_cache& cache = local_cache();
+        if (MagazineSize == cache.loaded.count) {
+            if (0 == cache.previous.count) {
+                swap_magazines(cache);
+            }
+            else {
+                depot_push(cache.previous);
+                cache.previous = cache.loaded;
+                cache.loaded = magazine();
+            }
+        }
+
+        block* b = static_cast<block*>(p);
+        b->link.next = cache.loaded.head;
+        cache.loaded.head = b;
+        ++cache.loaded.count;
+    }
+
+    // Number of blocks in all chunks
+    size_t capacity() const
+    {
+        return total_blocks.load(std::memory_order_relaxed);
+    }
+
+    size_t chunk_count() const
+    {
+        return chunk_number.load(std::memory_order_relaxed);
+    }
+
+    static constexpr size_t magazine_size = MagazineSize;
+
+    // Number of magazines carved from a single chunk
+    static constexpr size_t chunk_magazines = 16;
+
+private:
+    // A free block. The first block of a magazine also stores the magazine size
+    // and a link to the next magazine in the depot
+    union block
+    {
+        struct
+        {
+            block* next;
+            block* next_magazine;
+            size_t count;
+        } link;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct magazine
+    {
+        block* head = nullptr;
+        size_t count = 0;
+    };
+
+    struct chunk_header
+    {
+        chunk_header* next;
+    };
+
+    // Per-thread cache, returns its blocks to the depot on thread exit
+    struct thread_cache
+    {
+        magazine loaded;
+        magazine previous;
+
+        ~thread_cache()
+        {
+            concurrent_memory_pool& pool = instance();
+            if (loaded.count > 0) {
+                pool.depot_push(loaded);
+            }
+            if (previous.count > 0) {
+                pool.depot_push(previous);
+            }
+        }
+    };
+
+    concurrent_memory_pool() = default;
+
+    ~concurrent_memory_pool()
+    {
+        chunk_header* chunk = chunks.load(std::memory_order_acquire);
+        while (chunk) {
+            chunk_header* next = chunk->next;
+            ::operator delete(chunk, std::align_val_t(alignof(block)));
+            chunk = next;
+        }
+    }
+
+    static thread_cache& local_cache()
+    {
+        // make sure the pool outlives caches of all threads, including the main one
+        instance();
+        static thread_local thread_cache cache;
+        return cache;
+    }
+
+    static void swap_magazines(thread_cache& cache)
+    {
+        magazine tmp = cache.loaded;
+        cache.loaded = cache.previous;
+        cache.previous = tmp;
+    }
+
+    // Depot head is a pointer with the modification counter in the upper bits,
+    // protecting the stack from the ABA problem: between reading `top` and CAS
+    // another thread may pop `top`, use it and push it back with a different `next_magazine`.
+    // User-space addresses fit in 48 bits on x86-64 and AArch64
+    static constexpr unsigned pointer_bits = sizeof(void*) == 8 ? 48 : 32;
+    static constexpr std::uint64_t pointer_mask = (std::uint64_t(1) << pointer_bits) - 1;
+
+    static block* head_pointer(std::uint64_t head)
+    {
+        return reinterpret_cast<block*>(static_cast<std::uintptr_t>(head & pointer_mask));
+    }
+
+    static std::uint64_t make_head(block* p, std::uint64_t old_head)
+    {
+        const std::uint64_t tag = (old_head >> pointer_bits) + 1;
+        return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(p)) | (tag << pointer_bits);
+    }
+
+    void depot_push(magazine m)
+    {
+        m.head->link.count = m.count;
+        std::uint64_t old_head = depot.load(std::memory_order_relaxed);
+        do {
+            m.head->link.next_magazine = head_pointer(old_head);
+        } while (!depot.compare_exchange_weak(old_head, make_head(m.head, old_head),
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    magazine depot_pop()
+    {
+        std::uint64_t old_head = depot.load(std::memory_order_acquire);
+        while (block* top = head_pointer(old_head)) {
+            // `top` may be already popped and reused by another thread, so the value could be garbage.
+            // That's fine, the memory is never returned to the system while the pool is alive,
+            // and CAS fails because the tag has changed
+            block* next = top->link.next_magazine;
+            if (depot.compare_exchange_weak(old_head, make_head(next, old_head),
+                    std::memory_order_acquire, std::memory_order_acquire)) {
+                magazine m;
+                m.head = top;
+                m.count = top->link.count;
+                return m;
+            }
+        }
+        return magazine();
+    }
+
+    // Allocate a new chunk, return one magazine from it and push the rest to the depot
+    magazine grow()
+    {
+        constexpr size_t header = (sizeof(chunk_header) + alignof(block) - 1) / alignof(block) * alignof(block);
+        constexpr size_t blocks = chunk_magazines * MagazineSize;
+        unsigned char* raw = static_cast<unsigned char*>(::operator new(header + blocks * sizeof(block), std::align_val_t(alignof(block))));
+
+        // chunks are only pushed here and released in the destructor, so no ABA
+        chunk_header* chunk = reinterpret_cast<chunk_header*>(raw);
+        chunk->next = chunks.load(std::memory_order_relaxed);
+        while (!chunks.compare_exchange_weak(chunk->next, chunk, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        total_blocks.fetch_add(blocks, std::memory_order_relaxed);
+        chunk_number.fetch_add(1, std::memory_order_relaxed);
+
+        block* first = reinterpret_cast<block*>(raw + header);
+        magazine result;
+        for (size_t m = 0; m < chunk_magazines; ++m) {
+            block* mag = first + m * MagazineSize;
+            for (size_t i = 0; i + 1 < MagazineSize; ++i) {
+                mag[i].link.next = &mag[i + 1];
+            }
+            mag[MagazineSize - 1].link.next = nullptr;
+
+            magazine current;
+            current.head = mag;
+            current.count = MagazineSize;
+            if (0 == m) {
+                result = current;
+            }
+            else {
+                depot_push(current);
+            }
+        }
+        return result;
+    }
+
+    std::atomic<std::uint64_t> depot{0};
+    std::atomic<chunk_header*> chunks{nullptr};
+    std::atomic<size_t> total_blocks{0};
+    std::atomic<size_t> chunk_number{0};
+};
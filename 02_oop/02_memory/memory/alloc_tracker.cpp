@@ -0,0 +1,556 @@
+#include "alloc_tracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+
+#if defined(__has_include)
+#if __has_include(<dlfcn.h>)
+#include <dlfcn.h>
+#define CPP_HAS_DLADDR 1
+#endif
+#endif
+
+namespace alloc_tracker
+{
+
+namespace
+{
+
+// Header in front of every tracked block
+struct block_header
+{
+    void* raw;
+    size_t size;
+};
+
+// Header size keeps the default alignment of the user block
+constexpr size_t header_size = sizeof(block_header) > alignof(std::max_align_t) ? sizeof(block_header) : alignof(std::max_align_t);
+
+constexpr size_t max_threads = 256;
+
+// Counters of a single thread.
+// Only the owner thread writes them, so increments are plain load + store (no lock prefix),
+// relaxed atomics just make concurrent reads by collect() well-defined.
+// The type is trivial, so a thread_local instance is zero-initialized without any dynamic initialization
+struct thread_counters
+{
+    std::atomic<std::uint64_t> allocations[size_classes];
+    std::atomic<std::uint64_t> deallocations[size_classes];
+    std::atomic<std::uint64_t> bytes[size_classes];
+
+    // bytes in use, not published to global_in_use yet
+    std::atomic<std::int64_t> unpublished;
+    bool registered;
+    bool retired;
+};
+
+struct call_site_entry
+{
+    std::atomic<const void*> address;
+    std::atomic<std::uint64_t> allocations;
+    std::atomic<std::uint64_t> bytes;
+};
+
+// All globals are constant-initialized, as `operator new()` may be called before dynamic initialization
+std::atomic<int> current_mode{static_cast<int>(mode::counters)};
+std::atomic<std::int64_t> global_in_use{0};
+std::atomic<std::int64_t> global_peak{0};
+
+// Counters of exited threads and threads not fitting the registry, updated atomically
+thread_counters retired_counters;
+
+std::mutex registry_guard;
+thread_counters* registry[max_threads];
+
+call_site_entry call_sites[max_call_sites];
+
+thread_local thread_counters local;
+
+void bump(std::atomic<std::uint64_t>& counter, std::uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void publish(std::int64_t delta)
+{
+    const std::int64_t now = global_in_use.fetch_add(delta, std::memory_order_relaxed) + delta;
+    std::int64_t peak = global_peak.load(std::memory_order_relaxed);
+    while (now > peak && !global_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+void merge(thread_counters& to, const thread_counters& from)
+{
+    for (size_t k = 0; k < size_classes; ++k) {
+        to.allocations[k].fetch_add(from.allocations[k].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.deallocations[k].fetch_add(from.deallocations[k].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.bytes[k].fetch_add(from.bytes[k].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+// Unregisters counters of the thread on exit and moves them to the retired ones
+struct thread_registrar
+{
+    thread_registrar()
+    {
+        std::lock_guard<std::mutex> lock(registry_guard);
+        for (thread_counters*& slot : registry) {
+            if (nullptr == slot) {
+                slot = &local;
+                return;
+            }
+        }
+        local.retired = true;
+    }
+
+    ~thread_registrar()
+    {
+        std::lock_guard<std::mutex> lock(registry_guard);
+        if (local.retired) {
+            return;
+        }
+        for (thread_counters*& slot : registry) {
+            if (&local == slot) {
+                slot = nullptr;
+            }
+        }
+        merge(retired_counters, local);
+        publish(local.unpublished.exchange(0, std::memory_order_relaxed));
+        local.retired = true;
+    }
+};
+
+thread_counters& this_thread_counters()
+{
+    if (!local.registered) {
+        local.registered = true;
+        static thread_local thread_registrar registrar;
+    }
+    return local;
+}
+
+size_t size_class_of(size_t size)
+{
+    size_t k = 0;
+    for (size_t limit = 16; size > limit && k + 1 < size_classes; limit *= 2) {
+        ++k;
+    }
+    return k;
+}
+
+void record_call_site(const void* site, size_t size)
+{
+    size_t index = (reinterpret_cast<std::uintptr_t>(site) >> 4) * 0x9E3779B97F4A7C15ull % max_call_sites;
+    for (size_t probe = 0; probe < 16; ++probe, index = (index + 1) % max_call_sites) {
+        call_site_entry& e = call_sites[index];
+        const void* address = e.address.load(std::memory_order_relaxed);
+        if (nullptr == address && e.address.compare_exchange_strong(address, site, std::memory_order_relaxed)) {
+            address = site;
+        }
+        if (address == site) {
+            e.allocations.fetch_add(1, std::memory_order_relaxed);
+            e.bytes.fetch_add(size, std::memory_order_relaxed);
+            return;
+        }
+    }
+    // table is full, the call site is not recorded
+}
+
+void record_allocation(size_t size, const void* site)
+{
+    const mode m = static_cast<mode>(current_mode.load(std::memory_order_relaxed));
+    if (mode::off == m) {
+        return;
+    }
+
+    const size_t k = size_class_of(size);
+    thread_counters& c = this_thread_counters();
+    if (c.retired) {
+        retired_counters.allocations[k].fetch_add(1, std::memory_order_relaxed);
+        retired_counters.bytes[k].fetch_add(size, std::memory_order_relaxed);
+        publish(static_cast<std::int64_t>(size));
+    }
+    else {
+        bump(c.allocations[k], 1);
+        bump(c.bytes[k], size);
+        const std::int64_t unpublished = c.unpublished.load(std::memory_order_relaxed) + static_cast<std::int64_t>(size);
+        if (mode::counters != m || unpublished >= static_cast<std::int64_t>(batch_bytes)) {
+            c.unpublished.store(0, std::memory_order_relaxed);
+            publish(unpublished);
+        }
+        else {
+            c.unpublished.store(unpublished, std::memory_order_relaxed);
+        }
+    }
+
+    if (mode::call_sites == m && site) {
+        record_call_site(site, size);
+    }
+}
+
+void record_deallocation(size_t size)
+{
+    const mode m = static_cast<mode>(current_mode.load(std::memory_order_relaxed));
+    if (mode::off == m) {
+        return;
+    }
+
+    const size_t k = size_class_of(size);
+    thread_counters& c = this_thread_counters();
+    if (c.retired) {
+        retired_counters.deallocations[k].fetch_add(1, std::memory_order_relaxed);
+        publish(-static_cast<std::int64_t>(size));
+    }
+    else {
+        bump(c.deallocations[k], 1);
+        const std::int64_t unpublished = c.unpublished.load(std::memory_order_relaxed) - static_cast<std::int64_t>(size);
+        if (mode::counters != m || unpublished <= -static_cast<std::int64_t>(batch_bytes)) {
+            c.unpublished.store(0, std::memory_order_relaxed);
+            publish(unpublished);
+        }
+        else {
+            c.unpublished.store(unpublished, std::memory_order_relaxed);
+        }
+    }
+}
+
+void add_counters(snapshot& s, const thread_counters& c)
+{
+    for (size_t k = 0; k < size_classes; ++k) {
+        s.classes[k].allocations += c.allocations[k].load(std::memory_order_relaxed);
+        s.classes[k].deallocations += c.deallocations[k].load(std::memory_order_relaxed);
+        s.classes[k].bytes += c.bytes[k].load(std::memory_order_relaxed);
+    }
+    s.bytes_in_use += c.unpublished.load(std::memory_order_relaxed);
+}
+
+void reset_counters(thread_counters& c)
+{
+    for (size_t k = 0; k < size_classes; ++k) {
+        c.allocations[k].store(0, std::memory_order_relaxed);
+        c.deallocations[k].store(0, std::memory_order_relaxed);
+        c.bytes[k].store(0, std::memory_order_relaxed);
+    }
+    c.unpublished.store(0, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void set_mode(mode m)
+{
+    current_mode.store(static_cast<int>(m), std::memory_order_relaxed);
+}
+
+mode get_mode()
+{
+    return static_cast<mode>(current_mode.load(std::memory_order_relaxed));
+}
+
+size_t size_class_limit(size_t size_class)
+{
+    return size_class + 1 < size_classes ? size_t(16) << size_class : 0;
+}
+
+void* tracked_malloc(size_t size, size_t alignment, const void* call_site)
+{
+    if (alignment < alignof(std::max_align_t)) {
+        alignment = alignof(std::max_align_t);
+    }
+
+    // over-aligned blocks need room to move the block forward
+    const size_t extra = header_size + (alignment > alignof(std::max_align_t) ? alignment : 0);
+    if (size > SIZE_MAX - extra) {
+        return nullptr;
+    }
+    void* raw = std::malloc(size + extra);
+    if (nullptr == raw) {
+        return nullptr;
+    }
+
+    const std::uintptr_t user = (reinterpret_cast<std::uintptr_t>(raw) + header_size + alignment - 1) & ~(std::uintptr_t(alignment) - 1);
+    block_header* header = reinterpret_cast<block_header*>(user) - 1;
+    header->raw = raw;
+    header->size = size;
+
+    record_allocation(size, call_site);
+    return reinterpret_cast<void*>(user);
+}
+
+void tracked_free(void* p)
+{
+    if (nullptr == p) {
+        return;
+    }
+    block_header* header = static_cast<block_header*>(p) - 1;
+    record_deallocation(header->size);
+    std::free(header->raw);
+}
+
+size_t tracked_size(const void* p)
+{
+    return (static_cast<const block_header*>(p) - 1)->size;
+}
+
+snapshot collect()
+{
+    snapshot s;
+    {
+        std::lock_guard<std::mutex> lock(registry_guard);
+        for (thread_counters* c : registry) {
+            if (c) {
+                add_counters(s, *c);
+            }
+        }
+        add_counters(s, retired_counters);
+    }
+
+    for (const size_class_counters& k : s.classes) {
+        s.allocations += k.allocations;
+        s.deallocations += k.deallocations;
+        s.bytes_allocated += k.bytes;
+    }
+    s.bytes_in_use += global_in_use.load(std::memory_order_relaxed);
+    s.peak_bytes_in_use = std::max(global_peak.load(std::memory_order_relaxed), s.bytes_in_use);
+    return s;
+}
+
+void reset()
+{
+    std::lock_guard<std::mutex> lock(registry_guard);
+    for (thread_counters* c : registry) {
+        if (c) {
+            reset_counters(*c);
+        }
+    }
+    reset_counters(retired_counters);
+    global_in_use.store(0, std::memory_order_relaxed);
+    global_peak.store(0, std::memory_order_relaxed);
+    for (call_site_entry& e : call_sites) {
+        e.address.store(nullptr, std::memory_order_relaxed);
+        e.allocations.store(0, std::memory_order_relaxed);
+        e.bytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t top_call_sites(call_site_counters* out, size_t count)
+{
+    size_t found = 0;
+    for (const call_site_entry& e : call_sites) {
+        call_site_counters site;
+        site.address = e.address.load(std::memory_order_relaxed);
+        if (nullptr == site.address) {
+            continue;
+        }
+        site.allocations = e.allocations.load(std::memory_order_relaxed);
+        site.bytes = e.bytes.load(std::memory_order_relaxed);
+
+        // insertion into the sorted top
+        size_t i = found < count ? found++ : count;
+        while (i > 0 && out[i - 1].allocations < site.allocations) {
+            if (i < count) {
+                out[i] = out[i - 1];
+            }
+            --i;
+        }
+        if (i < count) {
+            out[i] = site;
+        }
+    }
+    return found;
+}
+
+void report(std::ostream& os, size_t call_site_count)
+{
+    // take the numbers first, as the output itself may allocate
+    const snapshot s = collect();
+    call_site_counters sites[32];
+    const size_t site_number = top_call_sites(sites, std::min(call_site_count, size_t(32)));
+
+    os << "Allocations: " << s.allocations << ", deallocations: " << s.deallocations
+       << ", bytes allocated: " << s.bytes_allocated << '\n'
+       << "Bytes in use: " << s.bytes_in_use << ", high-water mark: " << s.peak_bytes_in_use << '\n';
+
+    os << std::setw(12) << "size <=" << std::setw(14) << "allocations"
+       << std::setw(14) << "deallocations" << std::setw(16) << "bytes" << '\n';
+    for (size_t k = 0; k < size_classes; ++k) {
+        const size_class_counters& c = s.classes[k];
+        if (0 == c.allocations && 0 == c.deallocations) {
+            continue;
+        }
+        if (size_class_limit(k)) {
+            os << std::setw(12) << size_class_limit(k);
+        }
+        else {
+            os << std::setw(12) << "larger";
+        }
+        os << std::setw(14) << c.allocations << std::setw(14) << c.deallocations << std::setw(16) << c.bytes << '\n';
+    }
+
+    if (site_number > 0) {
+        os << "Top call sites:\n";
+    }
+    for (size_t i = 0; i < site_number; ++i) {
+        os << "  " << std::setw(10) << sites[i].allocations << " allocations, "
+           << std::setw(12) << sites[i].bytes << " bytes at " << sites[i].address;
+#if defined(CPP_HAS_DLADDR)
+        // module offset can be resolved to a line by `addr2line -e <module> <offset>`
+        Dl_info info;
+        if (dladdr(sites[i].address, &info) && info.dli_fname) {
+            os << " (" << info.dli_fname << "+0x" << std::hex
+               << (reinterpret_cast<std::uintptr_t>(sites[i].address) - reinterpret_cast<std::uintptr_t>(info.dli_fbase))
+               << std::dec;
+            if (info.dli_sname) {
+                os << ", " << info.dli_sname;
+            }
+            os << ")";
+        }
+#endif
+        os << '\n';
+    }
+}
+
+} // namespace alloc_tracker
+
+#if defined(CPP_TRACK_ALLOCATIONS)
+
+// Replacement of the global `operator new()`/`operator delete()` family (C++17 forms).
+// Replacement functions must be defined in exactly one translation unit of the program
+
+namespace
+{
+
+void* tracked_new(size_t size, size_t alignment, const void* call_site)
+{
+    if (0 == size) {
+        size = 1;
+    }
+    while (true) {
+        void* p = alloc_tracker::tracked_malloc(size, alignment, call_site);
+        if (p) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (nullptr == handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* tracked_new_nothrow(size_t size, size_t alignment, const void* call_site) noexcept
+{
+    try {
+        return tracked_new(size, alignment, call_site);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    return tracked_new(size, alignof(std::max_align_t), CPP_RETURN_ADDRESS());
+}
+
+void* operator new[](size_t size)
+{
+    return tracked_new(size, alignof(std::max_align_t), CPP_RETURN_ADDRESS());
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return tracked_new_nothrow(size, alignof(std::max_align_t), CPP_RETURN_ADDRESS());
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return tracked_new_nothrow(size, alignof(std::max_align_t), CPP_RETURN_ADDRESS());
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return tracked_new(size, static_cast<size_t>(alignment), CPP_RETURN_ADDRESS());
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return tracked_new(size, static_cast<size_t>(alignment), CPP_RETURN_ADDRESS());
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return tracked_new_nothrow(size, static_cast<size_t>(alignment), CPP_RETURN_ADDRESS());
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return tracked_new_nothrow(size, static_cast<size_t>(alignment), CPP_RETURN_ADDRESS());
+}
+
+void operator delete(void* p) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    alloc_tracker::tracked_free(p);
+}
+
+#endif // CPP_TRACK_ALLOCATIONS
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Allocation tracker
+//
+// Counts allocations and bytes per size class, keeps the high-water mark of bytes in use,
+// and optionally counts allocations per call site (return address of `operator new()`).
+// Every tracked block is preceded by a small header with the requested size,
+// so deallocation knows the size even for the unsized `operator delete(void*)`.
+//
+// The global `operator new()`/`operator delete()` family is replaced only if
+// CPP_TRACK_ALLOCATIONS is defined (CMake option with the same name), see alloc_tracker.cpp.
+// Class-level allocation in user_alloc is tracked through the same functions.
+//
+// In the default `counters` mode every thread updates its own counters without atomic operations,
+// and bytes in use are published to the global counter in batches of batch_bytes,
+// so the high-water mark is precise up to batch_bytes per thread.
+// The `precise` mode publishes every allocation, `call_sites` additionally records call sites.
+namespace alloc_tracker
+{
+
+enum class mode
+{
+    off,
+    counters,
+    precise,
+    call_sites
+};
+
+// Size class k holds blocks of (2^(k+3), 2^(k+4)] bytes, class 0 holds blocks up to 16 bytes,
+// the last class holds everything larger than 1 MiB
+constexpr size_t size_classes = 18;
+constexpr size_t batch_bytes = 64 * 1024;
+constexpr size_t max_call_sites = 1024;
+
+struct size_class_counters
+{
+    std::uint64_t allocations = 0;
+    std::uint64_t deallocations = 0;
+    std::uint64_t bytes = 0;
+};
+
+struct call_site_counters
+{
+    const void* address = nullptr;
+    std::uint64_t allocations = 0;
+    std::uint64_t bytes = 0;
+};
+
+struct snapshot
+{
+    size_class_counters classes[size_classes];
+    std::uint64_t allocations = 0;
+    std::uint64_t deallocations = 0;
+    std::uint64_t bytes_allocated = 0;
+    std::int64_t bytes_in_use = 0;
+    std::int64_t peak_bytes_in_use = 0;
+};
+
+void set_mode(mode m);
+mode get_mode();
+
+// Upper bound of the size class in bytes, 0 for the last (unbounded) class
+size_t size_class_limit(size_t size_class);
+
+// malloc-like functions adding the tracking header; return nullptr on failure.
+// `alignment` may be larger than alignof(std::max_align_t)
+void* tracked_malloc(size_t size, size_t alignment = alignof(std::max_align_t), const void* call_site = nullptr);
+void tracked_free(void* p);
+
+// Requested size of a block returned by tracked_malloc()
+size_t tracked_size(const void* p);
+
+// Sum of counters of all threads
+snapshot collect();
+
+// Forget all counters, e.g. after the program start-up
+void reset();
+
+// Top call sites by the number of allocations, returns the number of entries written
+size_t top_call_sites(call_site_counters* out, size_t count);
+
+// Human-readable report
+void report(std::ostream& os, size_t call_sites = 10);
+
+} // namespace alloc_tracker
+
+// Return address of the current function, i.e. the call site
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CPP_RETURN_ADDRESS() _ReturnAddress()
+#elif defined(__GNUC__)
+#define CPP_RETURN_ADDRESS() __builtin_return_address(0)
+#else
+#define CPP_RETURN_ADDRESS() nullptr
+#endif
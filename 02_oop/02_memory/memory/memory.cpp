@@ -1,7 +1,12 @@
 #include <iostream>
 #include <new>
+#include <map>
+#include <string>
+#include <vector>
 
+#include <utilities/elapsed.h>
 #include "user_allooc.h"
+#include "alloc_tracker.h"
 #include "new_handler_mixture.h"
 
 using std::new_handler;
@@ -117,10 +122,58 @@ void show_new_handler()
     }
 }
 
+// Allocation tracker counts allocations of user_alloc objects, and,
+// if built with CPP_TRACK_ALLOCATIONS, all allocations in the program
+void show_alloc_tracker()
+{
+#if !defined(CPP_TRACK_ALLOCATIONS)
+    std::cout << "Global new/delete is not replaced, only user_alloc is tracked "
+                 "(configure with -DCPP_TRACK_ALLOCATIONS=ON)\n";
+#endif
+
+    alloc_tracker::reset();
+    alloc_tracker::set_mode(alloc_tracker::mode::call_sites);
+    {
+        std::vector<std::string> names;
+        std::map<int, std::string> by_id;
+        for (int i = 0; i < 1000; ++i) {
+            names.push_back("a name long enough to be on the heap #" + std::to_string(i));
+            by_id[i] = names.back();
+        }
+
+        std::vector<user_alloc*> objects;
+        for (int i = 0; i < 10; ++i) {
+            objects.push_back(new user_alloc[3]);
+        }
+        for (user_alloc* object : objects) {
+            delete[] object;
+        }
+    }
+    alloc_tracker::report(std::cout);
+
+    // Overhead of the tracking modes on small allocations
+    constexpr int count = 1000000;
+    const alloc_tracker::mode modes[] = {
+        alloc_tracker::mode::off, alloc_tracker::mode::counters,
+        alloc_tracker::mode::precise, alloc_tracker::mode::call_sites};
+    const char* names[] = {"off", "counters", "precise", "call_sites"};
+    std::cout << count << " tracked allocations of 32 bytes:\n";
+    for (size_t i = 0; i < 4; ++i) {
+        alloc_tracker::set_mode(modes[i]);
+        MeasureTime timer;
+        for (int j = 0; j < count; ++j) {
+            void* p = alloc_tracker::tracked_malloc(32, alignof(std::max_align_t), CPP_RETURN_ADDRESS());
+            alloc_tracker::tracked_free(p);
+        }
+        std::cout << "  " << names[i] << ": " << timer.elapsed_mcsec() << " usec\n";
+    }
+    alloc_tracker::set_mode(alloc_tracker::mode::counters);
+}
 
 int main()
 {
     show_user_alloc();
+    show_alloc_tracker();
     return 0;
 }
 
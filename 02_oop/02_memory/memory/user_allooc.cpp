@@ -1,4 +1,5 @@
 #include "user_allooc.h"
+#include "alloc_tracker.h"
 //#include "construct.h"
 
 #include <cstdio>
@@ -44,8 +45,9 @@ void* user_alloc::universal_allocate(size_t s, new_handler handler/* = 0*/)
         oldHandler = std::set_new_handler(handler);
 
     // 2. Handling a lack of memory situation
+    // Memory comes through the allocation tracker, which counts it by size classes
     while (true) {
-        p = malloc(s);
+        p = alloc_tracker::tracked_malloc(s, alignof(std::max_align_t), CPP_RETURN_ADDRESS());
         if (p) {
             break;
         }
@@ -78,7 +80,7 @@ void user_alloc::universal_free(void* p)
     // operator delete() olso must guarantee a check for nullptr
     if (0 == p)
         return;
-    free(p);
+    alloc_tracker::tracked_free(p);
 }
 
 void* user_alloc::operator new(size_t s)
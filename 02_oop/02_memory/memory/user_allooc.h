@@ -47,6 +47,8 @@ protected:
     static void* universal_allocate(size_t s, new_handler handler = 0);
 
     // Same for memory release
+    // Both functions are a single choke point for the class-level allocation,
+    // so it's the natural place for instrumentation, see alloc_tracker.h
     static void universal_free(void* p);
 
 private:
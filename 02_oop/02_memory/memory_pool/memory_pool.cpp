@@ -1,22 +1,35 @@
 #include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdint>
 
 #include <new>
 #include <cstring>
 
-// Memory pool class desinged for saving not more than N object 
-// with size not more than M in a fixed size pre-allocated memory pool
+#include <utilities/benchmark.h>
+#include <utilities/elapsed.h>
+#include "memory_pool.h"
+
+// Memory pool with the linear search of a free slot, kept for comparison.
+// Designed for saving not more than N object with size not more than M
+// in a fixed size pre-allocated memory pool.
+// Each allocation scans the buffer from the beginning, so it's O(N),
+// and a live object which first byte is 0 is considered a free slot.
+// See memory_pool.h for the free-list pool, which has none of these problems
 template <typename T>
-class memory_pool
+class scan_memory_pool
 {
 public:
-    memory_pool() :
+    scan_memory_pool() :
         block_size(sizeof(T)),
         head(::operator new(block_size* pool_size))
     {
         ::memset(head, 0x0, block_size * pool_size);
     }
 
-    ~memory_pool()
+    ~scan_memory_pool()
     {
         ::operator delete(head);
     }
@@ -46,6 +59,7 @@ public:
         // so as alloc, free it works only for blocks smaller than pool slot
         if (s > sizeof(T)) {
             ::operator delete(p);
+            return;
         }
 
         // first byte of block again 0, block is available
@@ -61,7 +75,7 @@ private:
 
 // static 
 template <typename T>
-size_t memory_pool<T>::pool_size = 512;
+size_t scan_memory_pool<T>::pool_size = 512;
 
 class memory_pool_item
 {
@@ -128,16 +142,104 @@ void show_memory_pool()
     delete mpi1;
     delete mpi2;
 
-    // allocated from pool again, should again addr = 0x003789d0
-    // (block 0 free again)
+    // allocated from pool again, should again addr = 0x003789d8
+    // (free list is LIFO, the block released last is reused first)
     memory_pool_item* mpi3 = new memory_pool_item();
     mpi3->test();
     delete mpi3;
 }
 
 
+
+// Small object for the benchmark, no output in c-tor/d-tor
+struct bench_item
+{
+    std::uint64_t payload[2];
+};
+
+// Allocate a batch of blocks, then release them in the order given by `order`;
+// repeat until `total` allocations are made. Returns elapsed time in microseconds
+template <typename Alloc, typename Free>
+long long bench_alloc_free(Alloc alloc, Free release, const std::vector<size_t>& order, size_t total)
+{
+    std::vector<void*> blocks(order.size());
+    std::uintptr_t checksum = 0;
+    MeasureTime timer;
+    for (size_t done = 0; done < total; done += blocks.size()) {
+        for (void*& p : blocks) {
+            p = alloc();
+            // a live object, the first byte is not 0
+            *static_cast<unsigned char*>(p) = 1;
+            checksum += reinterpret_cast<std::uintptr_t>(p);
+        }
+        for (size_t i : order) {
+            release(blocks[i]);
+        }
+    }
+    long long elapsed = timer.elapsed_mcsec();
+
+    // so that the optimizer does not remove the loops
+    bench::do_not_optimize(checksum);
+    return elapsed;
+}
+
+void benchmark_memory_pool()
+{
+    // batch fits into the 512-slot buffer of the scan pool
+    constexpr size_t batch = 500;
+    constexpr size_t total = 2'000'000;
+
+    std::vector<size_t> lifo(batch);
+    for (size_t i = 0; i < batch; ++i) {
+        lifo[i] = batch - i - 1;
+    }
+    std::vector<size_t> shuffled(lifo);
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(42));
+
+    std::cout << "Allocate/free " << total << " blocks of " << sizeof(bench_item)
+              << " bytes in batches of " << batch << " (usec, lower is better)\n";
+    std::cout << std::setw(16) << "order" << std::setw(12) << "scan pool"
+              << std::setw(12) << "slab pool" << std::setw(12) << "new" << '\n';
+
+    for (const auto* order : {&lifo, &shuffled}) {
+        scan_memory_pool<bench_item> scan;
+        long long scan_us = bench_alloc_free(
+            [&] { return scan.alloc(sizeof(bench_item)); },
+            [&](void* p) { scan.free(p, sizeof(bench_item)); },
+            *order, total);
+
+        memory_pool<bench_item> slab;
+        long long slab_us = bench_alloc_free(
+            [&] { return slab.alloc(sizeof(bench_item)); },
+            [&](void* p) { slab.free(p, sizeof(bench_item)); },
+            *order, total);
+
+        long long new_us = bench_alloc_free(
+            [] { return ::operator new(sizeof(bench_item)); },
+            [](void* p) { ::operator delete(p); },
+            *order, total);
+
+        std::cout << std::setw(16) << (order == &lifo ? "reverse" : "shuffled")
+                  << std::setw(12) << scan_us << std::setw(12) << slab_us
+                  << std::setw(12) << new_us << '\n';
+    }
+
+    // pool grows by chunks instead of falling back to the standard new
+    memory_pool<bench_item> growing;
+    std::vector<void*> many(5000);
+    for (void*& p : many) {
+        p = growing.alloc(sizeof(bench_item));
+    }
+    std::cout << "5000 blocks in use: capacity = " << growing.blocks().capacity()
+              << ", chunks = " << growing.blocks().chunk_count() << '\n';
+    for (void* p : many) {
+        growing.free(p, sizeof(bench_item));
+    }
+}
+
 int main()
 {
     show_memory_pool();
+    benchmark_memory_pool();
     return 0;
 }
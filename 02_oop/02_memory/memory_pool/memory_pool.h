@@ -0,0 +1,224 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <memory_resource>
+
+// Cache line size. C++17 names it `std::hardware_destructive_interference_size`,
+// but not every standard library provides it
+constexpr size_t cache_line_size = 64;
+constexpr size_t page_size = 4096;
+
+// Fixed-size block pool (slab allocator)
+//
+// Every free block stores a pointer to the next free block in its own first bytes
+// (intrusive free list), so alloc() and free() are O(1) and need no per-block bookkeeping.
+// Free blocks are not marked by their content, so a live object may contain any bytes.
+// When the free list is empty, the pool requests a new chunk from the upstream resource
+// (the system by default); every next chunk is twice as large as the previous one, up to max_chunk_blocks.
+// Chunks are returned upstream only when the pool is destroyed.
+//
+// Blocks may be over-aligned (e.g. by the cache line for SIMD types), chunks are requested upstream
+// with the block alignment. With `chunk_align` set (e.g. to page_size) chunks are also aligned
+// and sized by multiples of `chunk_align`, so the pool takes whole pages from the system.
+class fixed_block_pool
+{
+public:
+    // `block_align` and `chunk_align` must be powers of 2
+    fixed_block_pool(size_t block_size, size_t block_align = alignof(std::max_align_t), size_t first_chunk_blocks = 512,
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource(), size_t chunk_align = 0)
+        : stride(round_up(block_size < sizeof(free_block) ? sizeof(free_block) : block_size,
+              block_align < alignof(free_block) ? alignof(free_block) : block_align))
+        , align(block_align < alignof(free_block) ? alignof(free_block) : block_align)
+        , next_chunk_blocks(first_chunk_blocks ? first_chunk_blocks : 1)
+        , upstream(upstream)
+        , chunk_align(chunk_align)
+    {
+    }
+
+    ~fixed_block_pool()
+    {
+        while (chunks) {
+            chunk_header* next = chunks->next;
+            upstream->deallocate(chunks, chunks->size, chunk_alignment());
+            chunks = next;
+        }
+    }
+
+    fixed_block_pool(const fixed_block_pool&) = delete;
+    fixed_block_pool& operator=(const fixed_block_pool&) = delete;
+
+    void* alloc()
+    {
+        if (nullptr == free_list) {
+            grow();
+        }
+        free_block* b = free_list;
+        free_list = b->next;
+        ++used;
+        return b;
+    }
+
+    void free(void* p)
+    {
+        // the block becomes a head of the free list
+        free_block* b = static_cast<free_block*>(p);
+        b->next = free_list;
+        free_list = b;
+        --used;
+    }
+
+    // Size of the block including padding up to the block alignment
+    size_t block_size() const { return stride; }
+
+    size_t block_alignment() const { return align; }
+
+    // Number of blocks in all chunks
+    size_t capacity() const { return total_blocks; }
+
+    // Number of blocks given out and not returned yet
+    size_t in_use() const { return used; }
+
+    size_t chunk_count() const { return chunk_number; }
+
+    std::pmr::memory_resource* upstream_resource() const { return upstream; }
+
+    static constexpr size_t max_chunk_blocks = 64 * 1024;
+
+private:
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    struct chunk_header
+    {
+        chunk_header* next;
+        size_t size;
+    };
+
+    static size_t round_up(size_t n, size_t a)
+    {
+        return (n + a - 1) / a * a;
+    }
+
+    size_t chunk_alignment() const
+    {
+        size_t a = align < alignof(chunk_header) ? alignof(chunk_header) : align;
+        return a < chunk_align ? chunk_align : a;
+    }
+
+    // Allocate a new chunk and thread all its blocks into the free list
+    void grow()
+    {
+        const size_t offset = round_up(sizeof(chunk_header), align);
+        const size_t size = round_up(offset + next_chunk_blocks * stride, chunk_alignment());
+
+        // the tail left after rounding the chunk size up is used for blocks too
+        const size_t blocks = (size - offset) / stride;
+        chunk_header* chunk = static_cast<chunk_header*>(upstream->allocate(size, chunk_alignment()));
+        chunk->next = chunks;
+        chunk->size = size;
+        chunks = chunk;
+
+        // link blocks in address order, so consequent allocations go forward in memory
+        unsigned char* first = reinterpret_cast<unsigned char*>(chunk) + offset;
+        for (size_t i = 0; i < blocks; ++i) {
+            free_block* b = reinterpret_cast<free_block*>(first + i * stride);
+            b->next = (i + 1 < blocks) ? reinterpret_cast<free_block*>(first + (i + 1) * stride) : free_list;
+        }
+        free_list = reinterpret_cast<free_block*>(first);
+
+        total_blocks += blocks;
+        ++chunk_number;
+        if (next_chunk_blocks < max_chunk_blocks) {
+            next_chunk_blocks *= 2;
+        }
+    }
+
+    const size_t stride;
+    const size_t align;
+    size_t next_chunk_blocks;
+    std::pmr::memory_resource* const upstream;
+    const size_t chunk_align;
+    free_block* free_list = nullptr;
+    chunk_header* chunks = nullptr;
+    size_t total_blocks = 0;
+    size_t used = 0;
+    size_t chunk_number = 0;
+};
+
+// Slot layout of memory_pool
+enum class slot_layout
+{
+    // slots are placed next to each other
+    packed,
+
+    // every slot starts at a cache line boundary and occupies whole cache lines,
+    // so objects used by different threads never share a cache line (no false sharing);
+    // chunks are taken by whole pages
+    cache_line_padded
+};
+
+// Memory pool class designed for objects of type T.
+// Intended to be used from the class-level `operator new()` and `operator delete()`
+// Slots honour `alignof(T)`, including alignment stronger than `alignof(std::max_align_t)`
+template <typename T, slot_layout Layout = slot_layout::packed>
+class memory_pool
+{
+public:
+    static constexpr size_t slot_alignment =
+        Layout == slot_layout::cache_line_padded && alignof(T) < cache_line_size ? cache_line_size : alignof(T);
+
+    memory_pool()
+        : pool(sizeof(T), slot_alignment, pool_size, std::pmr::new_delete_resource(),
+              Layout == slot_layout::cache_line_padded ? page_size : 0)
+    {
+    }
+
+    void* alloc(size_t s)
+    {
+        // `operator new()` is inherited by derived classes,
+        // and a derived object may not fit into the pool slot
+        if (s > sizeof(T)) {
+            return over_aligned ? ::operator new(s, std::align_val_t(alignof(T))) : ::operator new(s);
+        }
+        return pool.alloc();
+    }
+
+    void free(void* p, size_t s)
+    {
+        if (nullptr == p) {
+            return;
+        }
+
+        // so as alloc, blocks larger than the pool slot were allocated by the standard new
+        if (s > sizeof(T)) {
+            if (over_aligned) {
+                ::operator delete(p, std::align_val_t(alignof(T)));
+            }
+            else {
+                ::operator delete(p);
+            }
+            return;
+        }
+        pool.free(p);
+    }
+
+    const fixed_block_pool& blocks() const
+    {
+        return pool;
+    }
+
+private:
+    // the standard `operator new()` guarantees only __STDCPP_DEFAULT_NEW_ALIGNMENT__
+    static constexpr bool over_aligned = alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    fixed_block_pool pool;
+
+    // number of slots in the first chunk
+    static size_t pool_size;
+};
+
+// static
+template <typename T, slot_layout Layout>
+size_t memory_pool<T, Layout>::pool_size = 512;
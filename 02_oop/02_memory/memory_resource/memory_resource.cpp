@@ -0,0 +1,126 @@
+#include <iostream>
+#include <iomanip>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+#include <utilities/benchmark.h>
+#include <utilities/elapsed.h>
+#include "memory_resources.h"
+
+// Resources are chained: the pool takes chunks from the counting resource,
+// which passes them to the default (new/delete) resource and counts them
+void show_memory_resources()
+{
+    counting_resource upstream(std::pmr::new_delete_resource());
+    {
+        pool_resource pool(&upstream);
+        std::pmr::vector<int> v(&pool);
+        std::pmr::unordered_map<int, int> m(&pool);
+        for (int i = 0; i < 1000; ++i) {
+            v.push_back(i);
+            m[i] = i;
+        }
+        std::cout << "pool resource : " << pool.statistics() << '\n';
+        std::cout << "  upstream    : " << upstream.statistics() << '\n';
+    }
+
+    // Request-scoped arena starting in a buffer on the stack
+    unsigned char buffer[16 * 1024];
+    arena_resource arena(buffer, sizeof(buffer), &upstream);
+    {
+        std::pmr::vector<std::pmr::string> names(&arena);
+        for (int i = 0; i < 100; ++i) {
+            // strings use the allocator of the container
+            names.emplace_back("a long enough string to avoid SSO, number " + std::to_string(i));
+        }
+    }
+    std::cout << "arena resource: " << arena.statistics() << ", "
+              << arena.bytes_reserved() << " bytes reserved upstream\n";
+    arena.release();
+}
+
+template <typename Workload>
+long long bench_resource(std::pmr::memory_resource* resource, size_t rounds, Workload workload)
+{
+    size_t checksum = 0;
+    MeasureTime timer;
+    for (size_t r = 0; r < rounds; ++r) {
+        checksum += workload(resource);
+    }
+    bench::do_not_optimize(checksum);
+    return timer.elapsed_mcsec();
+}
+
+size_t vector_workload(std::pmr::memory_resource* resource)
+{
+    // many short vectors growing one by one
+    size_t size = 0;
+    for (int i = 0; i < 100; ++i) {
+        std::pmr::vector<int> v(resource);
+        for (int j = 0; j < 100; ++j) {
+            v.push_back(j);
+        }
+        size += v.size();
+    }
+    return size;
+}
+
+size_t map_workload(std::pmr::memory_resource* resource)
+{
+    std::pmr::unordered_map<int, int> m(resource);
+    for (int i = 0; i < 10000; ++i) {
+        m[i * 7] = i;
+    }
+    for (int i = 0; i < 10000; i += 2) {
+        m.erase(i * 7);
+    }
+    return m.size();
+}
+
+void benchmark_memory_resources()
+{
+    constexpr size_t rounds = 200;
+
+    std::cout << "\n" << rounds << " rounds of a workload (usec, lower is better)\n";
+    std::cout << std::setw(24) << "resource" << std::setw(12) << "vector" << std::setw(16) << "unordered_map" << '\n';
+
+    auto report = [](const char* name, std::pmr::memory_resource* resource, auto reset) {
+        long long vector_us = bench_resource(resource, rounds, [&](std::pmr::memory_resource* r) {
+            size_t size = vector_workload(r);
+            reset();
+            return size;
+        });
+        long long map_us = bench_resource(resource, rounds, [&](std::pmr::memory_resource* r) {
+            size_t size = map_workload(r);
+            reset();
+            return size;
+        });
+        std::cout << std::setw(24) << name << std::setw(12) << vector_us << std::setw(16) << map_us << '\n';
+    };
+
+    report("default (new/delete)", std::pmr::get_default_resource(), [] {});
+
+    std::pmr::unsynchronized_pool_resource std_pool;
+    report("std unsynchronized pool", &std_pool, [] {});
+
+    counting_resource pool_upstream;
+    pool_resource pool(&pool_upstream);
+    report("pool_resource", &pool, [] {});
+
+    counting_resource arena_upstream;
+    arena_resource arena(&arena_upstream);
+    report("arena_resource", &arena, [&] { arena.release(); });
+
+    std::cout << "pool_resource          : " << pool.statistics() << '\n';
+    std::cout << "  upstream             : " << pool_upstream.statistics() << '\n';
+    std::cout << "arena_resource upstream: " << arena_upstream.statistics() << '\n';
+}
+
+int main()
+{
+    show_memory_resources();
+    benchmark_memory_resources();
+    return 0;
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <ostream>
+
+#include <02_oop/02_memory/memory_pool/memory_pool.h>
+#include <04_stl/custom_allocator/arena_allocator.h>
+
+// `std::pmr::memory_resource` is a polymorphic allocator interface (C++17).
+// Containers from `std::pmr` take a pointer to the resource instead of an allocator type,
+// so one container type works with any allocation strategy.
+// Resources can be chained: a resource requests large blocks from its upstream resource
+// and carves them into small ones.
+
+// Counters collected by a memory resource
+struct resource_statistics
+{
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t bytes_allocated = 0;
+    size_t bytes_in_use = 0;
+    size_t peak_bytes_in_use = 0;
+
+    void on_allocate(size_t bytes)
+    {
+        ++allocations;
+        bytes_allocated += bytes;
+        bytes_in_use += bytes;
+        if (bytes_in_use > peak_bytes_in_use) {
+            peak_bytes_in_use = bytes_in_use;
+        }
+    }
+
+    void on_deallocate(size_t bytes)
+    {
+        ++deallocations;
+        bytes_in_use -= bytes;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const resource_statistics& s)
+{
+    return os << s.allocations << " allocations, " << s.deallocations << " deallocations, "
+              << s.bytes_allocated << " bytes allocated, peak " << s.peak_bytes_in_use << " bytes in use";
+}
+
+// Pass-through resource which only counts requests to the upstream.
+// Put it between a resource and its upstream to see how often the upstream is called
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+    explicit counting_resource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : upstream(upstream)
+    {
+    }
+
+    const resource_statistics& statistics() const { return stats; }
+
+    std::pmr::memory_resource* upstream_resource() const { return upstream; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        void* p = upstream->allocate(bytes, alignment);
+        stats.on_allocate(bytes);
+        return p;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+        upstream->deallocate(p, bytes, alignment);
+        stats.on_deallocate(bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* const upstream;
+    resource_statistics stats;
+};
+
+// Memory resource on top of fixed-size pools, one pool per power-of-2 size class
+// from min_block_size to max_block_size. Blocks of a size class are aligned by their size.
+// Larger or stronger aligned requests go directly to the upstream.
+// Not thread-safe, like std::pmr::unsynchronized_pool_resource
+class pool_resource : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t min_block_size = 16;
+    static constexpr size_t max_block_size = 512;
+    static constexpr size_t size_classes = 6;
+
+    explicit pool_resource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : upstream(upstream)
+        , pools{
+              {16, 16, chunk_blocks, upstream},
+              {32, 32, chunk_blocks, upstream},
+              {64, 64, chunk_blocks, upstream},
+              {128, 128, chunk_blocks, upstream},
+              {256, 256, chunk_blocks, upstream},
+              {512, 512, chunk_blocks, upstream}}
+    {
+    }
+
+    const resource_statistics& statistics() const { return stats; }
+
+    std::pmr::memory_resource* upstream_resource() const { return upstream; }
+
+    const fixed_block_pool& pool(size_t size_class) const { return pools[size_class]; }
+
+private:
+    static constexpr size_t chunk_blocks = 64;
+
+    // Index of the smallest size class fitting both size and alignment, or size_classes
+    static size_t size_class(size_t bytes, size_t alignment)
+    {
+        size_t need = bytes > alignment ? bytes : alignment;
+        size_t index = 0;
+        for (size_t block = min_block_size; block < need; block *= 2) {
+            ++index;
+        }
+        return index;
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        const size_t index = size_class(bytes, alignment);
+        void* p = index < size_classes ? pools[index].alloc() : upstream->allocate(bytes, alignment);
+        stats.on_allocate(bytes);
+        return p;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+        const size_t index = size_class(bytes, alignment);
+        if (index < size_classes) {
+            pools[index].free(p);
+        }
+        else {
+            upstream->deallocate(p, bytes, alignment);
+        }
+        stats.on_deallocate(bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* const upstream;
+    fixed_block_pool pools[size_classes];
+    resource_statistics stats;
+};
+
+// Memory resource on top of monotonic_arena.
+// Deallocation does nothing, memory is released all at once by release() or in the destructor
+class arena_resource : public std::pmr::memory_resource
+{
+public:
+    explicit arena_resource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : arena(64 * 1024, upstream)
+    {
+    }
+
+    // Start with the user-provided buffer, see monotonic_arena
+    arena_resource(void* buffer, size_t buffer_size, std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : arena(buffer, buffer_size, upstream)
+    {
+    }
+
+    void release()
+    {
+        arena.release();
+        stats.bytes_in_use = 0;
+    }
+
+    const resource_statistics& statistics() const { return stats; }
+
+    std::pmr::memory_resource* upstream_resource() const { return arena.upstream_resource(); }
+
+    size_t bytes_reserved() const { return arena.bytes_reserved(); }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        void* p = arena.allocate(bytes, alignment);
+        stats.on_allocate(bytes);
+        return p;
+    }
+
+    void do_deallocate(void*, size_t bytes, size_t) override
+    {
+        stats.on_deallocate(bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    monotonic_arena arena;
+    resource_statistics stats;
+};
@@ -0,0 +1,186 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+// Monotonic (bump-pointer) arena
+//
+// Allocation just moves a pointer forward inside the current chunk,
+// individual deallocation does nothing, and all memory is released at once by release().
+// That fits request-scoped data: containers are built, used and dropped together.
+// When the current chunk is exhausted, a new one twice as large is requested
+// from the upstream resource (the system by default).
+class monotonic_arena
+{
+public:
+    explicit monotonic_arena(size_t chunk_size = 64 * 1024, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : first_chunk_size(chunk_size < min_chunk_size ? min_chunk_size : chunk_size)
+        , next_chunk_size(first_chunk_size)
+        , upstream(upstream)
+    {
+    }
+
+    // Start with the user-provided buffer (e.g. on the stack), and request chunks upstream after it's full.
+    // The buffer is not owned by the arena and is used again after release()
+    monotonic_arena(void* buffer, size_t buffer_size, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : first_chunk_size(buffer_size < min_chunk_size ? min_chunk_size : buffer_size)
+        , next_chunk_size(first_chunk_size)
+        , upstream(upstream)
+        , initial_buffer(static_cast<unsigned char*>(buffer))
+        , initial_buffer_size(buffer_size)
+        , current(initial_buffer)
+        , end(initial_buffer + buffer_size)
+    {
+    }
+
+    ~monotonic_arena()
+    {
+        release();
+    }
+
+    monotonic_arena(const monotonic_arena&) = delete;
+    monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+    // `align` must be a power of 2
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+    {
+        std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(current) + align - 1) & ~(std::uintptr_t(align) - 1);
+        if (nullptr == current || p + bytes > reinterpret_cast<std::uintptr_t>(end)) {
+            grow(bytes + align);
+            p = (reinterpret_cast<std::uintptr_t>(current) + align - 1) & ~(std::uintptr_t(align) - 1);
+        }
+        current = reinterpret_cast<unsigned char*>(p + bytes);
+        allocated += bytes;
+        return reinterpret_cast<void*>(p);
+    }
+
+    // Bulk release of all memory. Objects placed in the arena must be already destroyed
+    void release() noexcept
+    {
+        while (chunks) {
+            chunk_header* next = chunks->next;
+            upstream->deallocate(chunks, chunks->size, alignof(std::max_align_t));
+            chunks = next;
+        }
+        current = initial_buffer;
+        end = initial_buffer + initial_buffer_size;
+        allocated = 0;
+        reserved = 0;
+        next_chunk_size = first_chunk_size;
+    }
+
+    // Bytes given out since the last release()
+    size_t bytes_allocated() const { return allocated; }
+
+    // Bytes requested from upstream since the last release()
+    size_t bytes_reserved() const { return reserved; }
+
+    std::pmr::memory_resource* upstream_resource() const { return upstream; }
+
+    static constexpr size_t min_chunk_size = 1024;
+
+private:
+    struct chunk_header
+    {
+        chunk_header* next;
+        size_t size;
+    };
+
+    void grow(size_t at_least)
+    {
+        size_t size = next_chunk_size;
+        while (size - sizeof(chunk_header) < at_least) {
+            size *= 2;
+        }
+        chunk_header* chunk = static_cast<chunk_header*>(upstream->allocate(size, alignof(std::max_align_t)));
+        chunk->next = chunks;
+        chunk->size = size;
+        chunks = chunk;
+
+        current = reinterpret_cast<unsigned char*>(chunk + 1);
+        end = reinterpret_cast<unsigned char*>(chunk) + size;
+        reserved += size;
+        next_chunk_size = size * 2;
+    }
+
+    const size_t first_chunk_size;
+    size_t next_chunk_size;
+    std::pmr::memory_resource* const upstream;
+    unsigned char* const initial_buffer = nullptr;
+    const size_t initial_buffer_size = 0;
+    chunk_header* chunks = nullptr;
+    unsigned char* current = nullptr;
+    unsigned char* end = nullptr;
+    size_t allocated = 0;
+    size_t reserved = 0;
+};
+
+// Stateful allocator placing container elements in a monotonic_arena
+//
+// It follows the C++17 allocator model: the minimal interface is `value_type`,
+// `allocate()`, `deallocate()`, converting constructor and comparison,
+// everything else is provided by `std::allocator_traits`.
+// Allocators are equal only if they share the same arena,
+// as memory from one arena can't be released through another
+template <typename T>
+class arena_allocator
+{
+public:
+    using value_type = T;
+
+    // Containers take the arena along on assignment and swap,
+    // so that elements are never released through the allocator of another arena
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    explicit arena_allocator(monotonic_arena& a) noexcept : arena(&a)
+    {
+    }
+
+    // Constructor for service types, e.g. list or map nodes
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& other) noexcept : arena(other.arena)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // Memory is released by the arena all at once
+    void deallocate(T*, size_t) noexcept
+    {
+    }
+
+    monotonic_arena& resource() const noexcept
+    {
+        return *arena;
+    }
+
+private:
+    template <typename U>
+    friend class arena_allocator;
+
+    monotonic_arena* arena;
+};
+
+template <typename T1, typename T2>
+bool operator==(const arena_allocator<T1>& a, const arena_allocator<T2>& b) noexcept
+{
+    return &a.resource() == &b.resource();
+}
+
+template <typename T1, typename T2>
+bool operator!=(const arena_allocator<T1>& a, const arena_allocator<T2>& b) noexcept
+{
+    return !(a == b);
+}
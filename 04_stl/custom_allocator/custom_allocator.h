@@ -1,6 +1,7 @@
 #pragma once
-#include <typeinfo>
+#include <cstddef>
 #include <limits>
+#include <new>
 namespace std
 {
 
@@ -30,12 +31,9 @@ public:
     };
 
     // Allocator has no state, so constructors and destructor are trivial
-    custom_allocator() throw()
-    {
-        cout << "Type: " << typeid(T).name() << endl;
-        cout << "Ref: " << typeid(reference).name() << endl;
-        cout << "Ptr: " << typeid(pointer).name() << endl;
-    }
+    // Containers may create allocator copies on every operation,
+    // so constructor must be cheap: no output, no type info
+    custom_allocator() throw() {}
     custom_allocator(const custom_allocator&) throw() {}
     ~custom_allocator() throw() {}
 
@@ -65,8 +63,12 @@ public:
     // Note, elements are not being constructed here
     // the meaning of `hint` depends on the implementation
     // can be used when overloading `operator new()`, as a pointer to the previous memory block
-    pointer allocate(size_type num, typename custom_allocator<T>::const_pointer hint = nullptr)
+    // Over-aligned types (e.g. SIMD vectors) need the aligned form of `operator new()` (C++17)
+    pointer allocate(size_type num, typename custom_allocator<T>::const_pointer /*hint*/ = nullptr)
     {
+        if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return reinterpret_cast<pointer>(::operator new(num * sizeof(T), align_val_t(alignof(T))));
+        }
         return reinterpret_cast<pointer>(::operator new(num * sizeof(T)));
     }
 
@@ -88,6 +90,10 @@ public:
     void deallocate(pointer p, size_type)
     {
         // in general case, `deallocate` does not give guarantees when passing nullptr
+        if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(reinterpret_cast<void*>(p), align_val_t(alignof(T)));
+            return;
+        }
         ::operator delete(reinterpret_cast<void*>(p));
     }
 private:
@@ -1,11 +1,17 @@
 #include <iostream>
+#include <iomanip>
 #include <list>
+#include <map>
 #include <set>
 #include <vector>
 #include <cstdlib>
 #include <iterator>
 #include <memory>
+#include <typeinfo>
+#include <utilities/benchmark.h>
+#include <utilities/elapsed.h>
 #include "custom_allocator.h"
+#include "arena_allocator.h"
 
 
 // 1.
@@ -34,7 +40,7 @@ void print_map(const std::map<Key, Val>& m)
         std::cout << p.first << '=' << p.second;
     }
 
-    std::cout << typeid(m);
+    std::cout << typeid(m).name();
     // TODO: print pair type
     //std::cout << typeid(std::map<Key, Val>);
 
@@ -66,23 +72,25 @@ void show_custom_allocator()
 
     // initialization of RAM by value
     int arr[10] = {};
-    uninitialized_fill(arr, arr + sizeof(arr) / sizeof(int), 1);
+    std::uninitialized_fill(arr, arr + sizeof(arr) / sizeof(int), 1);
 
     // initialize n elements by a value
-    uninitialized_fill_n(arr, 5, 2);
+    std::uninitialized_fill_n(arr, 5, 2);
 
     // copying the interval into RAM
     int arr2[10] = {};
-    uninitialized_copy(arr, arr + sizeof(arr) / sizeof(int), arr2);
+    std::uninitialized_copy(arr, arr + sizeof(arr) / sizeof(int), arr2);
 
     // there is `raw_storage_iterator` iterator for iterating uninitialized memory
-    // for short-term memory usage:
-    pair<int*, ptrdiff_t>p = get_temporary_buffer<int>(10);
+    // for short-term memory usage (deprecated in C++17, removed in C++20):
+#if __cplusplus < 202002L
+    std::pair<int*, std::ptrdiff_t> p = std::get_temporary_buffer<int>(10);
     // it returns a pair, pointer to the beginning and the size
 
     // deallocation has no check for 0
     if (p.first != 0)
-        return_temporary_buffer(p.first);
+        std::return_temporary_buffer(p.first);
+#endif
 }
 
 void show_c_memory()
@@ -114,7 +122,89 @@ void show_c_memory()
     // memcmp(), memset()
 }
 
+void show_arena_allocator()
+{
+    // All containers of a "request" share one arena
+    monotonic_arena arena;
+    arena_allocator<int> alloc(arena);
+
+    std::vector<int, arena_allocator<int>> v(alloc);
+    std::list<int, arena_allocator<int>> l(alloc);
+    std::map<int, int, std::less<int>, arena_allocator<std::pair<const int, int>>> m(alloc);
+    for (int i = 0; i < 100; ++i) {
+        v.push_back(i);
+        l.push_back(i);
+        m[i] = i;
+    }
+
+    // rebound allocators (e.g. for list nodes) still share the arena
+    std::cout << "allocators equal: " << (l.get_allocator() == m.get_allocator()) << '\n';
+
+    monotonic_arena other_arena;
+    std::cout << "allocators of different arenas equal: "
+              << (alloc == arena_allocator<int>(other_arena)) << '\n';
+    std::cout << "arena: " << arena.bytes_allocated() << " bytes allocated, "
+              << arena.bytes_reserved() << " bytes reserved\n";
+
+    // containers must be destroyed before the bulk release
+}
+
+// Build request-scoped containers `requests` times. Returns elapsed time in microseconds
+template <typename Build>
+long long bench_requests(size_t requests, Build build)
+{
+    size_t checksum = 0;
+    MeasureTime timer;
+    for (size_t r = 0; r < requests; ++r) {
+        checksum += build();
+    }
+    long long elapsed = timer.elapsed_mcsec();
+    bench::do_not_optimize(checksum);
+    return elapsed;
+}
+
+template <template <typename> class Alloc>
+size_t build_containers(const Alloc<int>& alloc, size_t n)
+{
+    std::vector<int, Alloc<int>> v(alloc);
+    std::list<int, Alloc<int>> l(alloc);
+    std::map<int, int, std::less<int>, Alloc<std::pair<const int, int>>> m(alloc);
+    for (size_t i = 0; i < n; ++i) {
+        const int key = static_cast<int>((i * 7919) % n);
+        v.push_back(key);
+        l.push_back(key);
+        m.emplace(key, key);
+    }
+    return v.size() + l.size() + m.size();
+}
+
+void benchmark_arena_allocator()
+{
+    constexpr size_t requests = 200;
+    constexpr size_t n = 10000;
+
+    long long std_us = bench_requests(requests, [] {
+        return build_containers<std::allocator>(std::allocator<int>(), n);
+    });
+
+    // one arena reused by all requests, all memory is released at the end of a request
+    monotonic_arena arena;
+    long long arena_us = bench_requests(requests, [&] {
+        size_t size = build_containers<arena_allocator>(arena_allocator<int>(arena), n);
+        arena.release();
+        return size;
+    });
+
+    std::cout << requests << " requests building vector, list and map of " << n
+              << " ints (usec, lower is better)\n";
+    std::cout << std::setw(16) << "std::allocator" << std::setw(12) << std_us << '\n';
+    std::cout << std::setw(16) << "arena_allocator" << std::setw(12) << arena_us << '\n';
+}
+
 int main()
 {
+    show_custom_allocator();
+    show_arena_allocator();
+    benchmark_arena_allocator();
     return 0;
 }
@@ -0,0 +1,504 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "perf_counters.h"
+
+// Micro-benchmark harness
+//
+// A benchmark is a callable performing one batch of work over `elements` items.
+// It is called `warmup` times without measuring (caches, branch predictors, page faults, CPU frequency),
+// then `repetitions` times, and every repetition is measured separately.
+// Instead of a single total time the result keeps a statistical summary:
+// the median is stable against outliers (interrupts, context switches), p99 and stddev show the noise.
+// With `hardware_counters` enabled (or CPP_BENCH_COUNTERS=1) measured repetitions are also counted
+// by CPU performance counters, see perf_counters.h, and IPC and misses per element are reported.
+//
+// Usage:
+//     bench::suite s("sqrt");
+//     s.run("std::sqrt", [&] { for (float x : in) out.push_back(std::sqrt(x)); }, in.size());
+//     s.report(std::cout);    // table, or JSON/CSV if CPP_BENCH_FORMAT=json|csv
+namespace bench
+{
+
+/// @brief Prevent the optimizer from removing computation of `value`
+/// The value is "used" by an empty assembly statement, it must be computed in a register or in memory
+template <typename T>
+inline void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    // Fallback: a volatile read of the object address is an observable side effect
+    static volatile const void* volatile escape;
+    escape = &value;
+#endif
+}
+
+/// @brief Force the compiler to assume all memory is read and written, e.g. after writing an output buffer
+inline void clobber_memory()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#elif defined(_MSC_VER)
+    _ReadWriteBarrier();
+#endif
+}
+
+/// @brief True if cycles() reads the CPU timestamp counter
+constexpr bool has_cycle_counter()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// @brief CPU timestamp counter, or nanoseconds of the steady clock if there is no such counter
+/// Notice TSC on modern x86 ticks with the constant (nominal) frequency,
+/// so under turbo boost or power saving it's not exactly the number of core cycles
+inline std::uint64_t cycles()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    // don't let earlier instructions be executed after reading the counter
+    _mm_lfence();
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/// @brief True if the environment variable CPP_BENCH_COUNTERS is set to a non-zero value
+inline bool counters_from_environment()
+{
+    const char* value = std::getenv("CPP_BENCH_COUNTERS");
+    return value != nullptr && std::string(value) != "0";
+}
+
+struct options
+{
+    size_t warmup = 2;
+    size_t repetitions = 15;
+    bool hardware_counters = counters_from_environment();
+};
+
+struct result
+{
+    std::string name;
+    size_t elements = 1;
+    size_t repetitions = 0;
+
+    // nanoseconds of a single repetition
+    double min_ns = 0;
+    double median_ns = 0;
+    double mean_ns = 0;
+    double p99_ns = 0;
+    double max_ns = 0;
+    double stddev_ns = 0;
+
+    // median of timestamp counter ticks of a single repetition
+    double median_cycles = 0;
+
+    // hardware counters summed over all measured repetitions, if enabled and available
+    counter_values counters;
+
+    double counter_per_element(hw_counter c) const
+    {
+        return counters.per_element(c, elements * std::max<size_t>(repetitions, 1));
+    }
+
+    double ns_per_element() const
+    {
+        return median_ns / static_cast<double>(elements);
+    }
+
+    double cycles_per_element() const
+    {
+        return median_cycles / static_cast<double>(elements);
+    }
+
+    // elements per second, based on the median
+    double throughput() const
+    {
+        return median_ns > 0 ? static_cast<double>(elements) * 1e9 / median_ns : 0;
+    }
+};
+
+/// @brief Value at percentile `p` (0..100) of sorted samples, nearest-rank method
+inline double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+inline double median(std::vector<double> samples)
+{
+    if (samples.empty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t middle = samples.size() / 2;
+    return samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+}
+
+/// @brief Statistical summary of measured repetitions
+inline result summarize(std::string name, size_t elements, std::vector<double> ns, const std::vector<double>& ticks)
+{
+    result r;
+    r.name = std::move(name);
+    r.elements = std::max<size_t>(elements, 1);
+    r.repetitions = ns.size();
+    if (ns.empty()) {
+        return r;
+    }
+
+    std::sort(ns.begin(), ns.end());
+    double sum = 0;
+    for (double t : ns) {
+        sum += t;
+    }
+    r.mean_ns = sum / static_cast<double>(ns.size());
+
+    double squares = 0;
+    for (double t : ns) {
+        squares += (t - r.mean_ns) * (t - r.mean_ns);
+    }
+    r.stddev_ns = ns.size() > 1 ? std::sqrt(squares / static_cast<double>(ns.size() - 1)) : 0;
+
+    r.min_ns = ns.front();
+    r.max_ns = ns.back();
+    r.median_ns = median(ns);
+    r.p99_ns = percentile(ns, 99);
+    r.median_cycles = median(ticks);
+    return r;
+}
+
+/// @brief Measure `f` processing `elements` items per call
+/// If `f` returns a value, it's passed to do_not_optimize()
+template <typename F>
+result run(std::string name, F&& f, size_t elements = 1, const options& opts = options())
+{
+    auto call = [&f] {
+        if constexpr (std::is_void_v<decltype(f())>) {
+            f();
+        }
+        else {
+            do_not_optimize(f());
+        }
+    };
+
+    for (size_t i = 0; i < opts.warmup; ++i) {
+        call();
+    }
+
+    // counters are opened once, and started out of the timed region
+    std::unique_ptr<perf_counters> hw;
+    if (opts.hardware_counters) {
+        hw = std::make_unique<perf_counters>();
+    }
+    const bool count = hw && hw->available();
+    counter_values counted;
+
+    std::vector<double> ns;
+    std::vector<double> ticks;
+    ns.reserve(opts.repetitions);
+    ticks.reserve(opts.repetitions);
+    for (size_t i = 0; i < opts.repetitions; ++i) {
+        if (count) {
+            hw->start();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const std::uint64_t start_cycles = cycles();
+        call();
+        const std::uint64_t stop_cycles = cycles();
+        const auto stop = std::chrono::steady_clock::now();
+        if (count) {
+            counted += hw->stop();
+        }
+
+        ns.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+        ticks.push_back(static_cast<double>(stop_cycles - start_cycles));
+    }
+    result r = summarize(std::move(name), elements, std::move(ns), ticks);
+    r.counters = counted;
+    return r;
+}
+
+enum class format
+{
+    table,
+    json,
+    csv
+};
+
+/// @brief Output format set by the environment variable CPP_BENCH_FORMAT (table, json or csv)
+inline format format_from_environment()
+{
+    const char* value = std::getenv("CPP_BENCH_FORMAT");
+    if (nullptr == value) {
+        return format::table;
+    }
+    const std::string name(value);
+    if (name == "json") {
+        return format::json;
+    }
+    if (name == "csv") {
+        return format::csv;
+    }
+    return format::table;
+}
+
+inline std::string json_escape(const std::string& s)
+{
+    std::string escaped;
+    escaped.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Named group of benchmarks with common options, printed together
+class suite
+{
+public:
+    explicit suite(std::string title, options opts = options()) : title(std::move(title)), opts(opts)
+    {
+    }
+
+    template <typename F>
+    const result& run(std::string name, F&& f, size_t elements = 1)
+    {
+        measured.push_back(bench::run(std::move(name), std::forward<F>(f), elements, opts));
+        return measured.back();
+    }
+
+    void add(result r)
+    {
+        measured.push_back(std::move(r));
+    }
+
+    const std::vector<result>& results() const
+    {
+        return measured;
+    }
+
+    const std::string& name() const
+    {
+        return title;
+    }
+
+    // Ratio of the median time of the benchmark `baseline` to the median time of `r`, i.e. speedup of `r`
+    double speedup(const result& r, size_t baseline = 0) const
+    {
+        if (baseline >= measured.size() || r.median_ns <= 0) {
+            return 0;
+        }
+        return measured[baseline].median_ns / r.median_ns;
+    }
+
+    void report(std::ostream& os) const
+    {
+        report(os, format_from_environment());
+    }
+
+    void report(std::ostream& os, format f) const
+    {
+        switch (f) {
+        case format::json:
+            write_json(os);
+            break;
+        case format::csv:
+            write_csv(os);
+            break;
+        default:
+            write_table(os);
+        }
+    }
+
+    // Human-readable table, times per element, speedup relative to the first benchmark
+    void write_table(std::ostream& os) const
+    {
+        size_t width = 10;
+        for (const result& r : measured) {
+            width = std::max(width, r.name.size() + 2);
+        }
+
+        std::ios_base::fmtflags flags = os.flags();
+        std::streamsize precision = os.precision();
+        os << title << " (" << opts.repetitions << " repetitions, "
+           << (measured.empty() ? 0 : measured.front().elements) << " elements)\n";
+        os << std::left << std::setw(static_cast<int>(width)) << "benchmark" << std::right
+           << std::setw(12) << "median ns" << std::setw(12) << "p99 ns" << std::setw(10) << "stddev%"
+           << std::setw(11) << "ns/elem" << std::setw(12) << (has_cycle_counter() ? "cycles/elem" : "ticks/elem")
+           << std::setw(9) << "speedup" << '\n';
+
+        os << std::fixed;
+        for (const result& r : measured) {
+            const double noise = r.mean_ns > 0 ? 100.0 * r.stddev_ns / r.mean_ns : 0;
+            os << std::left << std::setw(static_cast<int>(width)) << r.name << std::right << std::setprecision(0)
+               << std::setw(12) << r.median_ns << std::setw(12) << r.p99_ns
+               << std::setprecision(1) << std::setw(10) << noise
+               << std::setprecision(3) << std::setw(11) << r.ns_per_element() << std::setw(12) << r.cycles_per_element()
+               << std::setprecision(2) << std::setw(8) << speedup(r) << "x\n";
+        }
+
+        if (opts.hardware_counters) {
+            write_counters_table(os, width);
+        }
+        os.flags(flags);
+        os.precision(precision);
+    }
+
+    // Hardware counters per element, `-` for counters not supported by this CPU
+    void write_counters_table(std::ostream& os, size_t width) const
+    {
+        bool any = false;
+        for (const result& r : measured) {
+            any = any || r.counters.any();
+        }
+        if (!any) {
+            os << "hardware counters are not available (no PMU in a VM, or restricted by /proc/sys/kernel/perf_event_paranoid)\n";
+            return;
+        }
+
+        const hw_counter per_element[] = {
+            hw_counter::instructions, hw_counter::branch_misses,
+            hw_counter::l1d_misses, hw_counter::llc_misses, hw_counter::dtlb_misses};
+        os << std::left << std::setw(static_cast<int>(width)) << "per element" << std::right << std::setw(8) << "IPC";
+        for (hw_counter c : per_element) {
+            os << std::setw(15) << counter_name(c);
+        }
+        os << '\n';
+        for (const result& r : measured) {
+            os << std::left << std::setw(static_cast<int>(width)) << r.name << std::right << std::setprecision(2)
+               << std::setw(8) << r.counters.ipc() << std::setprecision(4);
+            for (hw_counter c : per_element) {
+                if (r.counters.has(c)) {
+                    os << std::setw(15) << r.counter_per_element(c);
+                }
+                else {
+                    os << std::setw(15) << '-';
+                }
+            }
+            os << '\n';
+        }
+    }
+
+    void write_json(std::ostream& os) const
+    {
+        std::streamsize precision = os.precision(10);
+        os << "{\"suite\": \"" << json_escape(title) << "\", \"results\": [";
+        for (size_t i = 0; i < measured.size(); ++i) {
+            const result& r = measured[i];
+            os << (i ? ",\n  " : "\n  ")
+               << "{\"name\": \"" << json_escape(r.name) << "\""
+               << ", \"elements\": " << r.elements
+               << ", \"repetitions\": " << r.repetitions
+               << ", \"min_ns\": " << r.min_ns
+               << ", \"median_ns\": " << r.median_ns
+               << ", \"mean_ns\": " << r.mean_ns
+               << ", \"p99_ns\": " << r.p99_ns
+               << ", \"max_ns\": " << r.max_ns
+               << ", \"stddev_ns\": " << r.stddev_ns
+               << ", \"ns_per_element\": " << r.ns_per_element()
+               << ", \"cycles_per_element\": " << r.cycles_per_element();
+            if (r.counters.any()) {
+                os << ", \"ipc\": " << r.counters.ipc();
+                for (size_t c = 0; c < hw_counter_count; ++c) {
+                    if (r.counters.available[c]) {
+                        os << ", \"hw_" << counter_name(static_cast<hw_counter>(c)) << "_per_element\": "
+                           << r.counter_per_element(static_cast<hw_counter>(c));
+                    }
+                }
+            }
+            os << "}";
+        }
+        os << "\n]}\n";
+        os.precision(precision);
+    }
+
+    // One line per benchmark, the suite name in the first column to concatenate outputs of several suites
+    void write_csv(std::ostream& os, bool header = true) const
+    {
+        std::streamsize precision = os.precision(10);
+        if (header) {
+            os << "suite,name,elements,repetitions,min_ns,median_ns,mean_ns,p99_ns,max_ns,stddev_ns,"
+                  "ns_per_element,cycles_per_element,ipc";
+            for (size_t c = 0; c < hw_counter_count; ++c) {
+                os << ",hw_" << counter_name(static_cast<hw_counter>(c)) << "_per_element";
+            }
+            os << '\n';
+        }
+        for (const result& r : measured) {
+            os << csv_field(title) << ',' << csv_field(r.name) << ',' << r.elements << ',' << r.repetitions << ','
+               << r.min_ns << ',' << r.median_ns << ',' << r.mean_ns << ',' << r.p99_ns << ',' << r.max_ns << ','
+               << r.stddev_ns << ',' << r.ns_per_element() << ',' << r.cycles_per_element() << ',';
+            if (r.counters.any()) {
+                os << r.counters.ipc();
+            }
+            // empty fields for counters which are not available
+            for (size_t c = 0; c < hw_counter_count; ++c) {
+                os << ',';
+                if (r.counters.available[c]) {
+                    os << r.counter_per_element(static_cast<hw_counter>(c));
+                }
+            }
+            os << '\n';
+        }
+        os.precision(precision);
+    }
+
+private:
+    static std::string csv_field(const std::string& s)
+    {
+        if (s.find_first_of(",\"\n") == std::string::npos) {
+            return s;
+        }
+        std::string quoted = "\"";
+        for (char c : s) {
+            if (c == '"') {
+                quoted += '"';
+            }
+            quoted += c;
+        }
+        return quoted + '"';
+    }
+
+    std::string title;
+    options opts;
+    std::vector<result> measured;
+};
+
+} // namespace bench
@@ -0,0 +1,299 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPP_CPU_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPP_CPU_X86 1
+#endif
+
+// Runtime CPU feature detection and kernel dispatch
+//
+// A binary compiled for the baseline x86-64 (SSE2) runs on every host, but leaves POPCNT, BMI and AVX unused.
+// Compiling with -march=native is fast on the build machine and crashes with SIGILL on an older one.
+// The middle way: compile a few versions of a kernel, each with its own __attribute__((target(...))),
+// detect the CPU once, and call the best version through a function pointer.
+//
+// CPUID reports what the CPU can do; AVX and AVX-512 also need the OS to save their registers
+// on context switches, which is checked in XCR0 by XGETBV.
+// Features can be disabled by the environment variable CPP_CPU_DISABLE (e.g. "avx512f,avx2"),
+// to test fallback kernels on a modern machine.
+//
+// GCC ifunc resolvers and target_clones do the same selection in the dynamic loader,
+// but only on ELF platforms with glibc; a function pointer works everywhere.
+//
+// Usage:
+//     using kernel = uint64_t (*)(const uint64_t*, size_t);
+//     static const cpu::implementation<kernel> kernels[] = {
+//         {"avx2", count_avx2, {cpu::feature::avx2}},
+//         {"scalar", count_scalar, {}}};
+//     static const kernel best = cpu::select(kernels).function;
+namespace cpu
+{
+
+enum class feature
+{
+    sse2,
+    sse3,
+    ssse3,
+    sse41,
+    sse42,
+    popcnt,
+    lzcnt,
+    bmi1,
+    bmi2,
+    fma,
+    avx,
+    avx2,
+    avx512f,
+    avx512dq,
+    avx512bw,
+    avx512vl,
+    avx512vpopcntdq,
+    count
+};
+
+constexpr size_t feature_count = static_cast<size_t>(feature::count);
+
+inline const char* feature_name(feature f)
+{
+    static const char* const names[feature_count] = {
+        "sse2", "sse3", "ssse3", "sse4.1", "sse4.2", "popcnt", "lzcnt", "bmi1", "bmi2", "fma",
+        "avx", "avx2", "avx512f", "avx512dq", "avx512bw", "avx512vl", "avx512vpopcntdq"};
+    const size_t index = static_cast<size_t>(f);
+    return index < feature_count ? names[index] : "unknown";
+}
+
+/// @brief Set of CPU features as a bit mask
+class feature_set
+{
+public:
+    constexpr feature_set() = default;
+
+    constexpr feature_set(std::initializer_list<feature> features)
+    {
+        for (feature f : features) {
+            set(f);
+        }
+    }
+
+    constexpr void set(feature f)
+    {
+        bits |= bit(f);
+    }
+
+    constexpr void reset(feature f)
+    {
+        bits &= ~bit(f);
+    }
+
+    constexpr bool has(feature f) const
+    {
+        return (bits & bit(f)) != 0;
+    }
+
+    /// @brief True if all features of `required` are in this set
+    constexpr bool contains(feature_set required) const
+    {
+        return (bits & required.bits) == required.bits;
+    }
+
+    constexpr std::uint32_t mask() const
+    {
+        return bits;
+    }
+
+private:
+    static constexpr std::uint32_t bit(feature f)
+    {
+        return std::uint32_t(1) << static_cast<unsigned>(f);
+    }
+
+    std::uint32_t bits = 0;
+};
+
+namespace detail
+{
+
+#if defined(CPP_CPU_X86)
+
+struct cpuid_registers
+{
+    std::uint32_t eax = 0;
+    std::uint32_t ebx = 0;
+    std::uint32_t ecx = 0;
+    std::uint32_t edx = 0;
+};
+
+inline cpuid_registers cpuid(std::uint32_t leaf, std::uint32_t subleaf = 0)
+{
+    cpuid_registers r;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+    r.eax = static_cast<std::uint32_t>(regs[0]);
+    r.ebx = static_cast<std::uint32_t>(regs[1]);
+    r.ecx = static_cast<std::uint32_t>(regs[2]);
+    r.edx = static_cast<std::uint32_t>(regs[3]);
+#else
+    // returns 0 and leaves registers unchanged if the leaf is above the maximum supported one
+    __get_cpuid_count(leaf, subleaf, &r.eax, &r.ebx, &r.ecx, &r.edx);
+#endif
+    return r;
+}
+
+// Register state enabled by the OS, call only if CPUID reports OSXSAVE
+inline std::uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    // the instruction instead of _xgetbv(), which requires compiling with -mxsave
+    std::uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+inline feature_set query()
+{
+    feature_set s;
+    const cpuid_registers leaf0 = cpuid(0);
+    if (leaf0.eax < 1) {
+        return s;
+    }
+
+    const cpuid_registers leaf1 = cpuid(1);
+    auto bit = [](std::uint32_t reg, unsigned n) { return ((reg >> n) & 1u) != 0; };
+    if (bit(leaf1.edx, 26)) s.set(feature::sse2);
+    if (bit(leaf1.ecx, 0)) s.set(feature::sse3);
+    if (bit(leaf1.ecx, 9)) s.set(feature::ssse3);
+    if (bit(leaf1.ecx, 19)) s.set(feature::sse41);
+    if (bit(leaf1.ecx, 20)) s.set(feature::sse42);
+    if (bit(leaf1.ecx, 23)) s.set(feature::popcnt);
+
+    // XCR0: bits 1-2 are SSE and AVX state, bits 5-7 are AVX-512 opmask and upper ZMM registers
+    const bool osxsave = bit(leaf1.ecx, 27);
+    const std::uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+    const bool os_avx = (xcr0 & 0x06) == 0x06;
+    const bool os_avx512 = os_avx && (xcr0 & 0xE0) == 0xE0;
+
+    if (os_avx && bit(leaf1.ecx, 28)) s.set(feature::avx);
+    if (os_avx && bit(leaf1.ecx, 12)) s.set(feature::fma);
+
+    if (leaf0.eax >= 7) {
+        const cpuid_registers leaf7 = cpuid(7, 0);
+        if (bit(leaf7.ebx, 3)) s.set(feature::bmi1);
+        if (bit(leaf7.ebx, 8)) s.set(feature::bmi2);
+        if (os_avx && bit(leaf7.ebx, 5)) s.set(feature::avx2);
+        if (os_avx512 && bit(leaf7.ebx, 16)) s.set(feature::avx512f);
+        if (os_avx512 && bit(leaf7.ebx, 17)) s.set(feature::avx512dq);
+        if (os_avx512 && bit(leaf7.ebx, 30)) s.set(feature::avx512bw);
+        if (os_avx512 && bit(leaf7.ebx, 31)) s.set(feature::avx512vl);
+        if (os_avx512 && bit(leaf7.ecx, 14)) s.set(feature::avx512vpopcntdq);
+    }
+
+    if (cpuid(0x80000000).eax >= 0x80000001) {
+        if (bit(cpuid(0x80000001).ecx, 5)) s.set(feature::lzcnt);
+    }
+    return s;
+}
+
+#else
+
+inline feature_set query()
+{
+    return {};
+}
+
+#endif // CPP_CPU_X86
+
+// Remove features listed in CPP_CPU_DISABLE, separated by commas or spaces
+inline void disable_from_environment(feature_set& s)
+{
+    const char* value = std::getenv("CPP_CPU_DISABLE");
+    if (nullptr == value) {
+        return;
+    }
+    const std::string list(value);
+    size_t begin = 0;
+    while (begin < list.size()) {
+        size_t end = list.find_first_of(", ", begin);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string name = list.substr(begin, end - begin);
+        for (size_t i = 0; i < feature_count; ++i) {
+            if (name == feature_name(static_cast<feature>(i))) {
+                s.reset(static_cast<feature>(i));
+            }
+        }
+        begin = end + 1;
+    }
+}
+
+} // namespace detail
+
+/// @brief Features of this CPU, detected on the first call
+inline const feature_set& detected()
+{
+    static const feature_set features = [] {
+        feature_set s = detail::query();
+        detail::disable_from_environment(s);
+        return s;
+    }();
+    return features;
+}
+
+inline bool has(feature f)
+{
+    return detected().has(f);
+}
+
+/// @brief Print names of detected features separated by spaces
+inline void report(std::ostream& os)
+{
+    const feature_set& s = detected();
+    bool first = true;
+    for (size_t i = 0; i < feature_count; ++i) {
+        if (s.has(static_cast<feature>(i))) {
+            os << (first ? "" : " ") << feature_name(static_cast<feature>(i));
+            first = false;
+        }
+    }
+    if (first) {
+        os << "(none detected)";
+    }
+}
+
+/// @brief A version of a kernel and the features it's compiled for
+template <typename Function>
+struct implementation
+{
+    const char* name;
+    Function function;
+    feature_set required;
+};
+
+/// @brief First implementation supported by `available` features.
+/// Implementations are listed from the best one, the last one must require nothing
+template <typename Function, size_t N>
+const implementation<Function>& select(const implementation<Function> (&implementations)[N], const feature_set& available = detected())
+{
+    static_assert(N > 0, "at least one implementation is required");
+    for (const implementation<Function>& i : implementations) {
+        if (available.contains(i.required)) {
+            return i;
+        }
+    }
+    return implementations[N - 1];
+}
+
+} // namespace cpu
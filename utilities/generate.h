@@ -1,31 +1,189 @@
 #pragma once
-#include <random>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#include "random_engines.h"
+
+// Bulk generation of uniformly distributed test data
+//
+// Functions fill a whole range at once from an explicitly seeded engine,
+// instead of push_back() of every value through std::uniform_*_distribution.
+// The result depends only on the seed (and the range size), so benchmark inputs are reproducible.
+namespace rng
+{
+
+/// @brief 64 random bits from an engine producing 32 or 64 bits
+template <typename Engine>
+inline std::uint64_t next64(Engine& engine)
+{
+    static_assert(Engine::min() == 0, "engine must produce full-width numbers");
+    if constexpr (Engine::max() >= std::numeric_limits<std::uint64_t>::max()) {
+        return engine();
+    }
+    else {
+        static_assert(Engine::max() == std::numeric_limits<std::uint32_t>::max(), "engine must produce 32 or 64 bits");
+        const std::uint64_t high = engine();
+        return (high << 32) | engine();
+    }
+}
+
+/// @brief Double in [0, 1) from the upper 53 bits
+inline double to_unit_double(std::uint64_t x)
+{
+    return static_cast<double>(x >> 11) * 0x1.0p-53;
+}
+
+/// @brief Float in [0, 1) from the upper 24 bits
+inline float to_unit_float(std::uint64_t x)
+{
+    return static_cast<float>(x >> 40) * 0x1.0p-24F;
+}
+
+/// @brief Unbiased integer in [0, range), range > 0
+/// Multiply-shift maps a 64-bit number to [0, range) by the upper half of the 128-bit product,
+/// and rejects rare products falling into the biased low part (Lemire, "Fast Random Integer Generation in an Interval")
+template <typename Engine>
+inline std::uint64_t bounded(Engine& engine, std::uint64_t range)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 m = static_cast<unsigned __int128>(next64(engine)) * range;
+    std::uint64_t low = static_cast<std::uint64_t>(m);
+    if (low < range) {
+        // 2^64 mod range, the modulo is computed only in this rare branch
+        const std::uint64_t threshold = (0 - range) % range;
+        while (low < threshold) {
+            m = static_cast<unsigned __int128>(next64(engine)) * range;
+            low = static_cast<std::uint64_t>(m);
+        }
+    }
+    return static_cast<std::uint64_t>(m >> 64);
+#else
+    // classic rejection: drop numbers from the incomplete last interval
+    const std::uint64_t threshold = (0 - range) % range;
+    std::uint64_t x;
+    do {
+        x = next64(engine);
+    } while (x < threshold);
+    return x % range;
+#endif
+}
+
+/// @brief Fill [first, last) with uniformly distributed numbers,
+/// integers in the closed interval [from, to], floating point numbers in [from, to)
+template <typename T, typename Engine>
+void fill_uniform(Engine& engine, T* first, T* last, T from, T to)
+{
+    static_assert(std::is_arithmetic_v<T>, "arithmetic type expected");
+    if constexpr (std::is_floating_point_v<T>) {
+        const T width = to - from;
+        for (; first != last; ++first) {
+            if constexpr (std::is_same_v<T, float>) {
+                *first = from + width * to_unit_float(next64(engine));
+            }
+            else {
+                *first = from + width * static_cast<T>(to_unit_double(next64(engine)));
+            }
+        }
+    }
+    else {
+        using unsigned_type = std::make_unsigned_t<T>;
+        // small types are promoted to int, so the difference is converted back to unsigned_type
+        const unsigned_type difference = static_cast<unsigned_type>(static_cast<unsigned_type>(to) - static_cast<unsigned_type>(from));
+        const std::uint64_t range = static_cast<std::uint64_t>(difference) + 1;
+        for (; first != last; ++first) {
+            // range is 0 if [from, to] covers all 64-bit values
+            const std::uint64_t x = range ? bounded(engine, range) : next64(engine);
+            *first = static_cast<T>(static_cast<unsigned_type>(from) + static_cast<unsigned_type>(x));
+        }
+    }
+}
+
+/// @brief Elements generated by a single subsequence in fill_uniform_parallel()
+constexpr size_t parallel_block_size = 64 * 1024;
+
+/// @brief Fill [first, last) in parallel with the same distribution as fill_uniform()
+/// The range is split into blocks of parallel_block_size elements, the block number `b`
+/// is generated by xoshiro256** seeded with `seed` and jumped `b` times.
+/// So blocks never overlap, and the result doesn't depend on the number of threads
+template <typename T>
+void fill_uniform_parallel(std::uint64_t seed, T* first, T* last, T from, T to, unsigned threads = std::thread::hardware_concurrency())
+{
+    const size_t size = static_cast<size_t>(last - first);
+    const size_t blocks = (size + parallel_block_size - 1) / parallel_block_size;
+    threads = static_cast<unsigned>(std::min<size_t>(std::max(threads, 1u), blocks));
+
+    auto worker = [=](unsigned index) {
+        xoshiro256ss engine(seed);
+        for (unsigned i = 0; i < index; ++i) {
+            engine.jump();
+        }
+        for (size_t b = index; b < blocks; b += threads) {
+            T* block = first + b * parallel_block_size;
+            // use a copy, so the next jump() of `engine` starts from the beginning of this block's subsequence
+            xoshiro256ss block_engine = engine;
+            fill_uniform(block_engine, block, std::min(block + parallel_block_size, last), from, to);
+            for (unsigned i = 0; i < threads; ++i) {
+                engine.jump();
+            }
+        }
+    };
+
+    if (threads <= 1) {
+        if (blocks > 0) {
+            worker(0);
+        }
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& w : workers) {
+        w.join();
+    }
+}
+
+/// @brief Vector of `size` uniformly distributed numbers, generated in parallel for large sizes
+template <typename T>
+std::vector<T> uniform_vector(size_t size, T from, T to, std::uint64_t seed)
+{
+    std::vector<T> result(size);
+    // small vectors are not worth starting threads, the result is the same anyway
+    const unsigned threads = size >= 4 * parallel_block_size ? std::thread::hardware_concurrency() : 1;
+    fill_uniform_parallel(seed, result.data(), result.data() + size, from, to, threads);
+    return result;
+}
+
+} // namespace rng
+
 template <typename T>
 class RandomReal
 {
 public:
-    RandomReal() : gen(rd())
+    /// @brief Differently seeded on every run
+    RandomReal() : RandomReal(rng::random_seed())
+    {
+    }
+
+    /// @brief Reproducible sequence
+    explicit RandomReal(std::uint64_t seed) : gen(seed)
     {
     }
 
     /// @brief Generate a random sequence of numbers between 'to' and 'from'
     std::vector<T> generate(T from, T to, size_t size)
     {
-        std::vector<T> result;
-        result.reserve(size);
-        std::uniform_real_distribution<T> dist(from, to);
-        for (size_t i = 0; i < size; ++i) {
-            result.push_back(dist(gen));
-        }
+        std::vector<T> result(size);
+        rng::fill_uniform(gen, result.data(), result.data() + size, from, to);
         return result;
     }
 
 private:
-    //Will be used to obtain a seed for the random number engine
-    std::random_device rd;
-
-    //Standard mersenne_twister_engine seeded with rd()
-    std::mt19937 gen;
+    rng::xoshiro256ss gen;
 };
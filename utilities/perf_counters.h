@@ -0,0 +1,260 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware performance counters around a measured region
+//
+// Wall-clock time says how slow the code is, counters say why:
+// low IPC (instructions per cycle) means the CPU waits, usually for memory or mispredicted branches,
+// cache and TLB misses per element show whether the data layout fits the memory hierarchy.
+//
+// On Linux counters are read with perf_event_open(2), only for the calling thread and only in user space.
+// Every counter is opened separately, so a counter missing on this CPU (or in a VM) doesn't disable the others.
+// If there are more events than hardware counters, the kernel multiplexes them,
+// and values are scaled by the time the counter was actually running.
+// Counters are not available on other systems, in some containers, or if /proc/sys/kernel/perf_event_paranoid > 2;
+// then available() returns false and all values are zero.
+//
+// Usage:
+//     perf_counters counters;
+//     counters.start();
+//     ... measured code ...
+//     counter_values v = counters.stop();
+//     std::cout << v.ipc() << ' ' << v.per_element(hw_counter::llc_misses, n);
+namespace bench
+{
+
+enum class hw_counter
+{
+    cycles,
+    instructions,
+    branch_misses,
+    l1d_misses,
+    llc_misses,
+    dtlb_misses
+};
+
+constexpr size_t hw_counter_count = 6;
+
+inline const char* counter_name(hw_counter c)
+{
+    switch (c) {
+    case hw_counter::cycles: return "cycles";
+    case hw_counter::instructions: return "instructions";
+    case hw_counter::branch_misses: return "branch_misses";
+    case hw_counter::l1d_misses: return "l1d_misses";
+    case hw_counter::llc_misses: return "llc_misses";
+    case hw_counter::dtlb_misses: return "dtlb_misses";
+    }
+    return "unknown";
+}
+
+struct counter_values
+{
+    std::uint64_t value[hw_counter_count] = {};
+    bool available[hw_counter_count] = {};
+
+    bool has(hw_counter c) const
+    {
+        return available[static_cast<size_t>(c)];
+    }
+
+    std::uint64_t operator[](hw_counter c) const
+    {
+        return value[static_cast<size_t>(c)];
+    }
+
+    bool any() const
+    {
+        for (bool a : available) {
+            if (a) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Instructions per cycle, 0 if unknown
+    double ipc() const
+    {
+        if (!has(hw_counter::cycles) || !has(hw_counter::instructions) || 0 == (*this)[hw_counter::cycles]) {
+            return 0;
+        }
+        return static_cast<double>((*this)[hw_counter::instructions]) / static_cast<double>((*this)[hw_counter::cycles]);
+    }
+
+    double per_element(hw_counter c, size_t elements) const
+    {
+        return elements ? static_cast<double>((*this)[c]) / static_cast<double>(elements) : 0;
+    }
+
+    counter_values& operator+=(const counter_values& other)
+    {
+        for (size_t i = 0; i < hw_counter_count; ++i) {
+            value[i] += other.value[i];
+            available[i] = available[i] || other.available[i];
+        }
+        return *this;
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const counter_values& v)
+{
+    if (!v.any()) {
+        return os << "hardware counters are not available";
+    }
+    const char* separator = "";
+    for (size_t i = 0; i < hw_counter_count; ++i) {
+        if (v.available[i]) {
+            os << separator << counter_name(static_cast<hw_counter>(i)) << '=' << v.value[i];
+            separator = " ";
+        }
+    }
+    return os << " ipc=" << v.ipc();
+}
+
+class perf_counters
+{
+public:
+    perf_counters()
+    {
+#if defined(__linux__)
+        for (size_t i = 0; i < hw_counter_count; ++i) {
+            fd[i] = open_counter(static_cast<hw_counter>(i));
+        }
+#endif
+    }
+
+    ~perf_counters()
+    {
+#if defined(__linux__)
+        for (int f : fd) {
+            if (f >= 0) {
+                close(f);
+            }
+        }
+#endif
+    }
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    // True if at least one counter could be opened
+    bool available() const
+    {
+        for (int f : fd) {
+            if (f >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool available(hw_counter c) const
+    {
+        return fd[static_cast<size_t>(c)] >= 0;
+    }
+
+    void start()
+    {
+#if defined(__linux__)
+        for (int f : fd) {
+            if (f >= 0) {
+                ioctl(f, PERF_EVENT_IOC_RESET, 0);
+            }
+        }
+        for (int f : fd) {
+            if (f >= 0) {
+                ioctl(f, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Counts since the last start()
+    counter_values stop()
+    {
+        counter_values v;
+#if defined(__linux__)
+        for (int f : fd) {
+            if (f >= 0) {
+                ioctl(f, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (size_t i = 0; i < hw_counter_count; ++i) {
+            if (fd[i] < 0) {
+                continue;
+            }
+            // value, time enabled, time running
+            std::uint64_t data[3] = {};
+            if (read(fd[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+                continue;
+            }
+            v.available[i] = true;
+            v.value[i] = data[0];
+            if (data[2] > 0 && data[2] < data[1]) {
+                // multiplexed counter, extrapolate to the whole region
+                v.value[i] = static_cast<std::uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+            }
+        }
+#endif
+        return v;
+    }
+
+private:
+#if defined(__linux__)
+    static int open_counter(hw_counter c)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        constexpr std::uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        switch (c) {
+        case hw_counter::cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case hw_counter::instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case hw_counter::branch_misses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case hw_counter::l1d_misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+            break;
+        case hw_counter::llc_misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | read_miss;
+            break;
+        case hw_counter::dtlb_misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+            break;
+        }
+        // this thread, any CPU, no group
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    int fd[hw_counter_count] = {-1, -1, -1, -1, -1, -1};
+};
+
+} // namespace bench
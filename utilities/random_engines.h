@@ -0,0 +1,182 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <random>
+
+// Small fast pseudo-random engines for test data
+//
+// std::mt19937 has 2.5 KB of state and a comparatively slow refill step,
+// and seeding it properly from std::random_device is easy to get wrong.
+// These engines keep 8..32 bytes of state, pass statistical test suites (BigCrush, PractRand),
+// and satisfy the UniformRandomBitGenerator requirements, so they work with <random> distributions as well.
+// None of them is cryptographically secure.
+//
+// All engines are seeded explicitly: the same seed gives the same sequence on every platform,
+// unlike std distributions, whose algorithms are implementation-defined.
+namespace rng
+{
+
+inline constexpr std::uint64_t rotl(std::uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/// @brief SplitMix64, a 64-bit counter passed through a mixing function
+/// Any seed, including 0, is fine. Mostly used to expand a single seed into the state of other engines
+class splitmix64
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit splitmix64(std::uint64_t seed = 0) : state(seed)
+    {
+    }
+
+    result_type operator()()
+    {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+private:
+    std::uint64_t state;
+};
+
+/// @brief xoshiro256** by Blackman and Vigna, 256-bit state, period 2^256 - 1
+/// jump() advances the state by 2^128 steps, so up to 2^128 non-overlapping subsequences
+/// can be given to parallel workers from a single seed
+class xoshiro256ss
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit xoshiro256ss(std::uint64_t seed = 0)
+    {
+        // the state must not be all zeros, splitmix64 never produces four zeros in a row
+        splitmix64 sm(seed);
+        for (std::uint64_t& word : s) {
+            word = sm();
+        }
+    }
+
+    result_type operator()()
+    {
+        const std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    /// @brief Equivalent of 2^128 calls
+    void jump()
+    {
+        static constexpr std::uint64_t polynomial[] = {
+            0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+        apply(polynomial);
+    }
+
+    /// @brief Equivalent of 2^192 calls, e.g. a separate range of jump() subsequences per machine
+    void long_jump()
+    {
+        static constexpr std::uint64_t polynomial[] = {
+            0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+        apply(polynomial);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+private:
+    void apply(const std::uint64_t (&polynomial)[4])
+    {
+        std::uint64_t t[4] = {};
+        for (std::uint64_t word : polynomial) {
+            for (int b = 0; b < 64; ++b) {
+                if (word & (std::uint64_t(1) << b)) {
+                    for (int i = 0; i < 4; ++i) {
+                        t[i] ^= s[i];
+                    }
+                }
+                (*this)();
+            }
+        }
+        for (int i = 0; i < 4; ++i) {
+            s[i] = t[i];
+        }
+    }
+
+    std::uint64_t s[4];
+};
+
+/// @brief PCG32 (XSH RR variant) by O'Neill: 64-bit LCG with a permuted 32-bit output
+/// Every odd increment gives a different stream, and advance() jumps ahead in O(log n)
+class pcg32
+{
+public:
+    using result_type = std::uint32_t;
+
+    explicit pcg32(std::uint64_t seed = 0, std::uint64_t stream = 0)
+    {
+        increment = (stream << 1) | 1;
+        state = 0;
+        (*this)();
+        state += seed;
+        (*this)();
+    }
+
+    result_type operator()()
+    {
+        const std::uint64_t old = state;
+        state = old * multiplier + increment;
+        const std::uint32_t xorshifted = static_cast<std::uint32_t>(((old >> 18) ^ old) >> 27);
+        const std::uint32_t rot = static_cast<std::uint32_t>(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+    }
+
+    /// @brief Equivalent of `delta` calls: LCG steps are composed by squaring, like fast exponentiation
+    void advance(std::uint64_t delta)
+    {
+        std::uint64_t current_multiplier = multiplier;
+        std::uint64_t current_increment = increment;
+        std::uint64_t accumulated_multiplier = 1;
+        std::uint64_t accumulated_increment = 0;
+        while (delta > 0) {
+            if (delta & 1) {
+                accumulated_multiplier *= current_multiplier;
+                accumulated_increment = accumulated_increment * current_multiplier + current_increment;
+            }
+            current_increment = (current_multiplier + 1) * current_increment;
+            current_multiplier *= current_multiplier;
+            delta >>= 1;
+        }
+        state = accumulated_multiplier * state + accumulated_increment;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+private:
+    static constexpr std::uint64_t multiplier = 6364136223846793005ULL;
+
+    std::uint64_t state;
+    std::uint64_t increment;
+};
+
+/// @brief Non-reproducible seed for runs which should differ, print it to be able to repeat the run
+inline std::uint64_t random_seed()
+{
+    std::random_device rd;
+    return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+}
+
+} // namespace rng